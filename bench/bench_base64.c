@@ -0,0 +1,144 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Throughput of base64 encoding and decoding.
+ *
+ * A megabyte of random bytes is encoded with bBase64Encode, which breaks
+ * lines as MIME asks, with bBase64EncodeBlk without line breaks and with
+ * the URL safe alphabet, and in 4 KB pieces with bBase64EncodeStep. The
+ * results are decoded again with bBase64DecodeEx and bBase64DecodeBlk.
+ * Rates are in MB/s of unencoded data.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include "bstrlib.h"
+#include "bstraux.h"
+
+#define SIZE (1024 * 1024)
+#define PASSES 100
+#define PIECE 4096
+
+static void
+report(const char *name, double t)
+{
+	printf("%-22s %10.1f\n", name, benchRate((double)SIZE * PASSES, t));
+}
+
+int
+main(void)
+{
+	struct bBase64State st;
+	unsigned int seed = 1;
+	bstring data = bfromcstralloc(SIZE + 1, "");
+	bstring mime = NULL, flat = bfromcstr(""), out = bfromcstr("");
+	double t0;
+	int i, j;
+	if (!data || !flat || !out) {
+		fputs("Out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < SIZE; i++) {
+		data->data[i] = (unsigned char)(benchRand(&seed) >> 8);
+	}
+	data->slen = SIZE;
+
+	t0 = benchNow();
+	for (i = 0; i < PASSES; i++) {
+		bdestroy(mime);
+		mime = bBase64Encode(data);
+		benchSink += mime->slen;
+	}
+	report("bBase64Encode", benchNow() - t0);
+
+	t0 = benchNow();
+	for (i = 0; i < PASSES; i++) {
+		flat->slen = 0;
+		bBase64EncodeBlk(flat, data->data, SIZE, BSTR_B64_NOWRAP);
+		benchSink += flat->slen;
+	}
+	report("EncodeBlk NOWRAP", benchNow() - t0);
+
+	t0 = benchNow();
+	for (i = 0; i < PASSES; i++) {
+		out->slen = 0;
+		bBase64EncodeBlk(out, data->data, SIZE,
+				 BSTR_B64_URL | BSTR_B64_NOWRAP);
+		benchSink += out->slen;
+	}
+	report("EncodeBlk URL NOWRAP", benchNow() - t0);
+
+	t0 = benchNow();
+	for (i = 0; i < PASSES; i++) {
+		out->slen = 0;
+		bBase64Init(&st, 0);
+		for (j = 0; j < SIZE; j += PIECE) {
+			bBase64EncodeStep(&st, out, data->data + j, PIECE);
+		}
+		bBase64EncodeEnd(&st, out);
+		benchSink += out->slen;
+	}
+	report("EncodeStep 4 KB", benchNow() - t0);
+
+	t0 = benchNow();
+	for (i = 0; i < PASSES; i++) {
+		bstring d = bBase64DecodeEx(mime, NULL);
+		benchSink += d->slen;
+		bdestroy(d);
+	}
+	report("bBase64DecodeEx", benchNow() - t0);
+
+	t0 = benchNow();
+	for (i = 0; i < PASSES; i++) {
+		out->slen = 0;
+		bBase64DecodeBlk(out, mime->data, mime->slen, 0);
+		benchSink += out->slen;
+	}
+	report("DecodeBlk", benchNow() - t0);
+
+	t0 = benchNow();
+	for (i = 0; i < PASSES; i++) {
+		out->slen = 0;
+		bBase64DecodeBlk(out, flat->data, flat->slen, 0);
+		benchSink += out->slen;
+	}
+	report("DecodeBlk NOWRAP", benchNow() - t0);
+
+	bdestroy(data);
+	bdestroy(mime);
+	bdestroy(flat);
+	bdestroy(out);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Substring search throughput of binstr and binstrr.
+ *
+ * A needle is planted at the far end of a pseudo-random haystack and each
+ * function is timed scanning for it. Both are drawn from a 16 letter
+ * alphabet so that partial matches are common, except for the last byte of
+ * the needle which never occurs elsewhere in the haystack. A straightforward byte-at-a-time
+ * search is timed alongside as a reference point.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "bstrlib.h"
+
+#define TARGET_BYTES (32L * 1024 * 1024)
+
+static int
+naiveInstr(const bstring h, int pos, const bstring n)
+{
+	int i, j;
+	for (i = pos; i <= h->slen - n->slen; i++) {
+		for (j = 0; j < n->slen; j++) {
+			if (h->data[i + j] != n->data[j]) {
+				break;
+			}
+		}
+		if (j == n->slen) {
+			return i;
+		}
+	}
+	return BSTR_ERR;
+}
+
+static double
+timeSearch(int (*fn)(const bstring, int, const bstring),
+	   const bstring h, int pos, const bstring n, long reps)
+{
+	long r;
+	double t0 = benchNow();
+	for (r = 0; r < reps; r++) {
+		benchSink += fn(h, pos, n);
+	}
+	return benchRate((double)h->slen * (double)reps, benchNow() - t0);
+}
+
+int
+main(void)
+{
+	static const int needles[] = { 1, 2, 3, 4, 8, 16, 32, 64 };
+	unsigned int seed = 42;
+	long hsize, reps;
+	size_t k;
+	int i;
+	bstring h, n;
+
+	printf("%10s %6s %12s %12s %12s\n", "haystack", "needle",
+	       "binstr MB/s", "binstrr MB/s", "naive MB/s");
+	for (hsize = 64; hsize <= 16L * 1024 * 1024; hsize *= 4) {
+		for (k = 0; k < sizeof(needles) / sizeof(needles[0]); k++) {
+			int nlen = needles[k];
+			double fwd, rev, ref;
+			h = bfromcstralloc((int)hsize + 1, "");
+			n = bfromcstralloc(nlen + 1, "");
+			if (!h || !n) {
+				fputs("Out of memory\n", stderr);
+				return EXIT_FAILURE;
+			}
+			for (i = 0; i < nlen - 1; i++) {
+				bconchar(n, (char)('a' + benchRand(&seed) % 16));
+			}
+			bconchar(n, 'Z');
+			for (i = 0; i < (int)hsize - nlen; i++) {
+				bconchar(h, (char)('a' + benchRand(&seed) % 16));
+			}
+			/* Put a copy of the needle at both ends, so that the
+			 * forward search starting after the first copy and the
+			 * reverse search starting before the last one both
+			 * scan the entire haystack.
+			 */
+			binsert(h, 0, n, '?');
+			btrunc(h, (int)hsize - nlen);
+			bconcat(h, n);
+			reps = TARGET_BYTES / hsize;
+			if (reps < 1) {
+				reps = 1;
+			}
+			fwd = timeSearch(binstr, h, 1, n, reps);
+			rev = timeSearch(binstrr, h, h->slen - nlen - 1, n,
+					 reps);
+			ref = timeSearch(naiveInstr, h, 1, n, reps);
+			printf("%10ld %6d %12.1f %12.1f %12.1f\n", hsize, nlen,
+			       fwd, rev, ref);
+			bdestroy(n);
+			bdestroy(h);
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,156 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Cost of assembling a string from many pieces.
+ *
+ * An HTTP style response of a status line, a few dozen headers and a body
+ * joined from a list is built with bconcat, bcatblk and bformata, and with a
+ * string builder which is then flattened, or written out through a vectored
+ * write without being assembled at all.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "bstrlib.h"
+#include "bstraux.h"
+
+#define RESPONSES 200000
+#define HEADERS 24
+#define ROWS 40
+
+static int
+sinkWritev(const struct bstrIoVec *iov, int iovcnt, void *parm)
+{
+	int i, n = 0;
+	(void)parm;
+	for (i = 0; i < iovcnt; i++) {
+		n += (int)iov[i].len;
+		benchSink += ((const unsigned char *)iov[i].base)[0];
+	}
+	return n;
+}
+
+int
+main(void)
+{
+	struct tagbstring crlf = bsStatic("\r\n");
+	struct tagbstring colon = bsStatic(": ");
+	struct bstrList *rows;
+	struct bStrBuilder *sb;
+	bstring names[HEADERS], b, body;
+	double t0, concat, flat, vec;
+	long r;
+	int i;
+
+	rows = bstrListCreate();
+	sb = bsbCreate();
+	if (!rows || !sb || bstrListAlloc(rows, ROWS) != BSTR_OK) {
+		fputs("Out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < HEADERS; i++) {
+		names[i] = bformat("X-Header-Number-%d", i);
+	}
+	for (i = 0; i < ROWS; i++) {
+		rows->entry[rows->qty++] = bformat("{\"row\": %d, \"name\": "
+						   "\"item %d\"}", i, i * 7);
+	}
+
+	t0 = benchNow();
+	for (r = 0; r < RESPONSES; r++) {
+		b = bfromcstr("");
+		bformata(b, "HTTP/1.1 %d %s\r\n", 200, "OK");
+		for (i = 0; i < HEADERS; i++) {
+			bconcat(b, names[i]);
+			bcatblk(b, colon.data, colon.slen);
+			bformata(b, "%ld", r + i);
+			bcatblk(b, crlf.data, crlf.slen);
+		}
+		bcatblk(b, crlf.data, crlf.slen);
+		body = bjoinblk(rows, ",\n", 2);
+		bconcat(b, body);
+		bdestroy(body);
+		benchSink += b->slen;
+		bdestroy(b);
+	}
+	concat = benchNow() - t0;
+
+	t0 = benchNow();
+	for (r = 0; r < RESPONSES; r++) {
+		bsbReset(sb);
+		bsbFormat(sb, "HTTP/1.1 %d %s\r\n", 200, "OK");
+		for (i = 0; i < HEADERS; i++) {
+			bsbAppendRef(sb, names[i]);
+			bsbAppendRef(sb, &colon);
+			bsbFormat(sb, "%ld", r + i);
+			bsbAppendRef(sb, &crlf);
+		}
+		bsbAppendRef(sb, &crlf);
+		bsbJoinBlk(sb, rows, ",\n", 2);
+		b = bsbFlatten(sb);
+		benchSink += b->slen;
+		bdestroy(b);
+	}
+	flat = benchNow() - t0;
+
+	t0 = benchNow();
+	for (r = 0; r < RESPONSES; r++) {
+		bsbReset(sb);
+		bsbFormat(sb, "HTTP/1.1 %d %s\r\n", 200, "OK");
+		for (i = 0; i < HEADERS; i++) {
+			bsbAppendRef(sb, names[i]);
+			bsbAppendRef(sb, &colon);
+			bsbFormat(sb, "%ld", r + i);
+			bsbAppendRef(sb, &crlf);
+		}
+		bsbAppendRef(sb, &crlf);
+		bsbJoinBlk(sb, rows, ",\n", 2);
+		bsbWritev(sb, sinkWritev, NULL);
+	}
+	vec = benchNow() - t0;
+
+	printf("%-24s %12s\n", "method", "ns/response");
+	printf("%-24s %12.1f\n", "bconcat/bformata", concat * 1e9 / RESPONSES);
+	printf("%-24s %12.1f\n", "builder + flatten", flat * 1e9 / RESPONSES);
+	printf("%-24s %12.1f\n", "builder + writev", vec * 1e9 / RESPONSES);
+
+	for (i = 0; i < HEADERS; i++) {
+		bdestroy(names[i]);
+	}
+	bstrListDestroy(rows);
+	bsbDestroy(sb);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Throughput of case conversion and caseless comparison.
+ *
+ * Mixed case text of several lengths is converted in place with btoupper and
+ * btolower, and compared against an upper cased copy of itself with
+ * bstricmp, bstrnicmp and biseqcaselessblk. Every function is timed in both
+ * the default ASCII mode and the locale mode selected through bsetctype, in
+ * which each byte goes through toupper or tolower.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "bstrlib.h"
+
+#define TARGET_BYTES (64L * 1024 * 1024)
+
+static bstring a, b;
+
+static void
+opUpper(void)
+{
+	benchSink += btoupper(a);
+}
+
+static void
+opLower(void)
+{
+	benchSink += btolower(a);
+}
+
+static void
+opStricmp(void)
+{
+	benchSink += bstricmp(a, b);
+}
+
+static void
+opStrnicmp(void)
+{
+	benchSink += bstrnicmp(a, b, a->slen);
+}
+
+static void
+opIseqcaseless(void)
+{
+	benchSink += biseqcaselessblk(a, b->data, b->slen);
+}
+
+static double
+timeOp(void (*op)(void), long reps)
+{
+	long r;
+	double t0 = benchNow();
+	for (r = 0; r < reps; r++) {
+		op();
+	}
+	return benchRate((double)a->slen * (double)reps, benchNow() - t0);
+}
+
+int
+main(void)
+{
+	static const struct {
+		const char *name;
+		void (*op)(void);
+	} ops[] = {
+		{ "btoupper", opUpper },
+		{ "btolower", opLower },
+		{ "bstricmp", opStricmp },
+		{ "bstrnicmp", opStrnicmp },
+		{ "biseqcaselessblk", opIseqcaseless },
+	};
+	unsigned int seed = 11;
+	long len, reps;
+	size_t k;
+	int i;
+
+	printf("%-18s %10s %12s %12s\n", "function", "length",
+	       "ASCII MB/s", "locale MB/s");
+	for (k = 0; k < sizeof(ops) / sizeof(ops[0]); k++) {
+		for (len = 16; len <= 1024L * 1024; len *= 8) {
+			double ascii, locale;
+			a = bfromcstralloc((int)len + 1, "");
+			if (!a) {
+				fputs("Out of memory\n", stderr);
+				return EXIT_FAILURE;
+			}
+			for (i = 0; i < len; i++) {
+				unsigned int r = benchRand(&seed);
+				a->data[i] = (unsigned char)((r & 1 ? 'a' : 'A') +
+							     (r >> 1) % 26);
+			}
+			a->data[len] = '\0';
+			a->slen = (int)len;
+			b = bstrcpy(a);
+			if (!b || btoupper(b) != BSTR_OK) {
+				fputs("Out of memory\n", stderr);
+				return EXIT_FAILURE;
+			}
+			reps = TARGET_BYTES / len;
+			bsetctype(BSTR_CTYPE_ASCII);
+			ascii = timeOp(ops[k].op, reps);
+			bsetctype(BSTR_CTYPE_LOCALE);
+			locale = timeOp(ops[k].op, reps);
+			bsetctype(BSTR_CTYPE_ASCII);
+			printf("%-18s %10ld %12.1f %12.1f\n", ops[k].name, len,
+			       ascii, locale);
+			bdestroy(a);
+			bdestroy(b);
+		}
+	}
+	return EXIT_SUCCESS;
+}
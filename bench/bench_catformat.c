@@ -0,0 +1,141 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Cost of the native appends of bstrfmt against bformata.
+ *
+ * A telemetry style line of a timestamp, a name, a counter and a measured
+ * value is appended to a log which is emptied every so often, once with
+ * bformata, once with bcatformat and once with the typed appends.  The
+ * name is passed both as a C string and as a bstring through %B.  The
+ * last two columns format random doubles with bformata "%.17g" and with
+ * the shortest round trip form of bcatdouble.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include "bstrfmt.h"
+#include "bstrlib.h"
+
+#define LINES 1000000
+
+static void
+flush(bstring log)
+{
+	if (log->slen > 65536) {
+		benchSink += log->slen;
+		log->slen = 0;
+	}
+}
+
+int
+main(void)
+{
+	struct tagbstring name = bsStatic("http.requests.latency");
+	double t0, fmtT, catT, catBT, typedT, gT, dblT, *vals;
+	unsigned int seed = 1;
+	bstring log = bfromcstr("");
+	long i;
+	vals = malloc(LINES * sizeof(*vals));
+	if (!log || !vals) {
+		fputs("Out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < LINES; i++) {
+		seed = seed * 1103515245u + 12345u;
+		vals[i] = (double)(seed >> 8) / 1000.0;
+	}
+
+	t0 = benchNow();
+	for (i = 0; i < LINES; i++) {
+		bformata(log, "%ld %s %d %x\n", 1700000000000L + i,
+			 (char *)name.data, (int)(i * 7), (unsigned)i);
+		flush(log);
+	}
+	fmtT = benchNow() - t0;
+
+	t0 = benchNow();
+	for (i = 0; i < LINES; i++) {
+		bcatformat(log, "%ld %s %d %x\n", 1700000000000L + i,
+			   (char *)name.data, (int)(i * 7), (unsigned)i);
+		flush(log);
+	}
+	catT = benchNow() - t0;
+
+	t0 = benchNow();
+	for (i = 0; i < LINES; i++) {
+		bcatformat(log, "%ld %B %d %x\n", 1700000000000L + i, &name,
+			   (int)(i * 7), (unsigned)i);
+		flush(log);
+	}
+	catBT = benchNow() - t0;
+
+	t0 = benchNow();
+	for (i = 0; i < LINES; i++) {
+		bcatint(log, 1700000000000L + i);
+		bconchar(log, ' ');
+		bconcat(log, &name);
+		bconchar(log, ' ');
+		bcatint(log, (int)(i * 7));
+		bconchar(log, ' ');
+		bcathex(log, (unsigned)i);
+		bconchar(log, '\n');
+		flush(log);
+	}
+	typedT = benchNow() - t0;
+
+	t0 = benchNow();
+	for (i = 0; i < LINES; i++) {
+		bformata(log, "%.17g\n", vals[i]);
+		flush(log);
+	}
+	gT = benchNow() - t0;
+
+	t0 = benchNow();
+	for (i = 0; i < LINES; i++) {
+		bcatdouble(log, vals[i]);
+		bconchar(log, '\n');
+		flush(log);
+	}
+	dblT = benchNow() - t0;
+
+	printf("%10s %10s %10s %10s %10s %10s\n", "bformata", "bcatformat",
+	       "%B", "typed", "%.17g", "bcatdouble");
+	printf("%10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+	       fmtT * 1e9 / LINES, catT * 1e9 / LINES, catBT * 1e9 / LINES,
+	       typedT * 1e9 / LINES, gT * 1e9 / LINES, dblT * 1e9 / LINES);
+	bdestroy(log);
+	free(vals);
+	return EXIT_SUCCESS;
+}
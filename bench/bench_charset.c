@@ -0,0 +1,130 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Throughput of character set scanning.
+ *
+ * binchr, binchrr and bninchr are timed on text that holds no member of the
+ * set being searched for, or only members of it in the case of bninchr, so
+ * each call scans the whole string. The white space trims are timed on
+ * strings padded with white space at both ends. A byte-at-a-time search
+ * with a 256 entry table is timed alongside as a reference point.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "bstrlib.h"
+
+#define TARGET_BYTES (64L * 1024 * 1024)
+
+static unsigned char table[256];
+
+static int
+naiveInchr(const bstring b, int pos)
+{
+	int i;
+	for (i = pos; i < b->slen; i++) {
+		if (table[b->data[i]]) {
+			return i;
+		}
+	}
+	return BSTR_ERR;
+}
+
+int
+main(void)
+{
+	static struct tagbstring set = bsStatic(",;:|\t\n\"");
+	static struct tagbstring alpha = bsStatic("abcdefghijklmnopqrstuvwxyz");
+	unsigned int seed = 23;
+	long len, reps, r;
+	double t0, fwd, rev, neg, trim, ref;
+	bstring b, p;
+	int i;
+
+	for (i = 0; i < set.slen; i++) {
+		table[set.data[i]] = 1;
+	}
+	printf("%10s %12s %12s %12s %12s %12s\n", "length", "binchr MB/s",
+	       "binchrr MB/s", "bninchr MB/s", "btrimws MB/s", "naive MB/s");
+	for (len = 16; len <= 4L * 1024 * 1024; len *= 4) {
+		b = bfromcstralloc((int)len + 1, "");
+		p = bfromcstralloc((int)len + 1, "");
+		if (!b || !p) {
+			fputs("Out of memory\n", stderr);
+			return EXIT_FAILURE;
+		}
+		for (i = 0; i < len; i++) {
+			b->data[i] = alpha.data[benchRand(&seed) % 26];
+		}
+		b->data[len] = '\0';
+		b->slen = (int)len;
+		reps = TARGET_BYTES / len;
+		t0 = benchNow();
+		for (r = 0; r < reps; r++) {
+			benchSink += binchr(b, 0, &set);
+		}
+		fwd = benchRate((double)len * reps, benchNow() - t0);
+		t0 = benchNow();
+		for (r = 0; r < reps; r++) {
+			benchSink += binchrr(b, b->slen - 1, &set);
+		}
+		rev = benchRate((double)len * reps, benchNow() - t0);
+		t0 = benchNow();
+		for (r = 0; r < reps; r++) {
+			benchSink += bninchr(b, 0, &alpha);
+		}
+		neg = benchRate((double)len * reps, benchNow() - t0);
+		t0 = benchNow();
+		for (r = 0; r < reps; r++) {
+			memset(p->data, ' ', (size_t)len / 2);
+			memset(p->data + len / 2, '\t', (size_t)(len - len / 2));
+			p->data[len / 2] = 'x';
+			p->slen = (int)len;
+			benchSink += btrimws(p);
+		}
+		trim = benchRate((double)len * reps, benchNow() - t0);
+		t0 = benchNow();
+		for (r = 0; r < reps; r++) {
+			benchSink += naiveInchr(b, 0);
+		}
+		ref = benchRate((double)len * reps, benchNow() - t0);
+		printf("%10ld %12.1f %12.1f %12.1f %12.1f %12.1f\n", len, fwd,
+		       rev, neg, trim, ref);
+		bdestroy(b);
+		bdestroy(p);
+	}
+	return EXIT_SUCCESS;
+}
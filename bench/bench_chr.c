@@ -0,0 +1,162 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Throughput of single character searches and line splitting.
+ *
+ * A block of log-like text with lines of 40 to 200 bytes is split on
+ * newlines with bsplitcb, and read back a line at a time with bsreadln from
+ * a stream over memory. bstrchrp and bstrrchrp are timed scanning a block
+ * which does not contain the character searched for. A byte-at-a-time
+ * reverse search is timed alongside as a reference point.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "bstrlib.h"
+
+#define TEXT_BYTES (16L * 1024 * 1024)
+#define PASSES 8
+
+struct memStream {
+	const unsigned char *p;
+	size_t rem;
+};
+
+static size_t
+memRead(void *buff, size_t elsize, size_t nelem, void *parm)
+{
+	struct memStream *m = parm;
+	size_t n = elsize * nelem;
+	if (n > m->rem) {
+		n = m->rem;
+	}
+	memcpy(buff, m->p, n);
+	m->p += n;
+	m->rem -= n;
+	return n / elsize;
+}
+
+static int
+countLine(void *parm, int ofs, int len)
+{
+	(void)parm;
+	benchSink += ofs + len;
+	return 0;
+}
+
+static int
+naiveRchr(const bstring b, int c, int pos)
+{
+	int i;
+	for (i = pos; i >= 0; i--) {
+		if (b->data[i] == (unsigned char)c) {
+			return i;
+		}
+	}
+	return BSTR_ERR;
+}
+
+int
+main(void)
+{
+	unsigned int seed = 31;
+	struct memStream m;
+	struct bStream *s;
+	bstring text, line;
+	double t0, fwd, rev, ref, split, read;
+	long i, p;
+	int len;
+
+	text = bfromcstralloc((int)TEXT_BYTES + 256, "");
+	line = bfromcstr("");
+	if (!text || !line) {
+		fputs("Out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+	while (text->slen < TEXT_BYTES) {
+		len = 40 + benchRand(&seed) % 160;
+		for (i = 0; i < len; i++) {
+			text->data[text->slen++] =
+				(unsigned char)(' ' + benchRand(&seed) % 95);
+		}
+		text->data[text->slen++] = '\n';
+	}
+	text->data[text->slen] = '\0';
+	t0 = benchNow();
+	for (p = 0; p < PASSES; p++) {
+		benchSink += bstrchrp(text, '\x01', 0);
+	}
+	fwd = benchRate((double)text->slen * PASSES, benchNow() - t0);
+	t0 = benchNow();
+	for (p = 0; p < PASSES; p++) {
+		benchSink += bstrrchrp(text, '\x01', text->slen - 1);
+	}
+	rev = benchRate((double)text->slen * PASSES, benchNow() - t0);
+	t0 = benchNow();
+	for (p = 0; p < PASSES; p++) {
+		benchSink += naiveRchr(text, '\x01', text->slen - 1);
+	}
+	ref = benchRate((double)text->slen * PASSES, benchNow() - t0);
+	t0 = benchNow();
+	for (p = 0; p < PASSES; p++) {
+		bsplitcb(text, '\n', 0, countLine, NULL);
+	}
+	split = benchRate((double)text->slen * PASSES, benchNow() - t0);
+	t0 = benchNow();
+	for (p = 0; p < PASSES; p++) {
+		m.p = text->data;
+		m.rem = (size_t)text->slen;
+		s = bsopen(memRead, &m);
+		if (!s) {
+			fputs("Out of memory\n", stderr);
+			return EXIT_FAILURE;
+		}
+		while (bsreadln(line, s, '\n') == BSTR_OK) {
+			benchSink += line->slen;
+		}
+		bsclose(s);
+	}
+	read = benchRate((double)text->slen * PASSES, benchNow() - t0);
+	printf("%-22s %12s\n", "operation", "MB/s");
+	printf("%-22s %12.1f\n", "bstrchrp", fwd);
+	printf("%-22s %12.1f\n", "bstrrchrp", rev);
+	printf("%-22s %12.1f\n", "naive reverse search", ref);
+	printf("%-22s %12.1f\n", "bsplitcb lines", split);
+	printf("%-22s %12.1f\n", "bsreadln lines", read);
+	bdestroy(text);
+	bdestroy(line);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Throughput of equality tests and ordered comparison.
+ *
+ * Two copies of a pseudo-random string which differ only in their last byte
+ * are compared with biseq, bstrcmp and bstrncmp at several lengths, so each
+ * call has to examine every byte. A straightforward byte-at-a-time version
+ * of bstrcmp is timed alongside as a reference point.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "bstrlib.h"
+
+#define TARGET_BYTES (64L * 1024 * 1024)
+
+static bstring a, b;
+
+static int
+naiveCmp(const bstring b0, const bstring b1)
+{
+	int i, v, n = b0->slen < b1->slen ? b0->slen : b1->slen;
+	for (i = 0; i < n; i++) {
+		v = ((char)b0->data[i]) - ((char)b1->data[i]);
+		if (v != 0) {
+			return v;
+		}
+		if (b0->data[i] == (unsigned char)'\0') {
+			return BSTR_OK;
+		}
+	}
+	return b0->slen - b1->slen;
+}
+
+static void
+opBiseq(void)
+{
+	benchSink += biseq(a, b);
+}
+
+static void
+opBstrcmp(void)
+{
+	benchSink += bstrcmp(a, b);
+}
+
+static void
+opBstrncmp(void)
+{
+	benchSink += bstrncmp(a, b, a->slen);
+}
+
+static void
+opNaive(void)
+{
+	benchSink += naiveCmp(a, b);
+}
+
+static double
+timeOp(void (*op)(void), long reps)
+{
+	long r;
+	double t0 = benchNow();
+	for (r = 0; r < reps; r++) {
+		op();
+	}
+	return benchRate((double)a->slen * (double)reps, benchNow() - t0);
+}
+
+int
+main(void)
+{
+	static const int lengths[] = { 4, 8, 16, 24, 32, 64, 128, 256, 1024,
+				       4096, 65536, 1048576 };
+	unsigned int seed = 5;
+	long reps;
+	size_t k;
+	int i, len;
+
+	printf("%10s %12s %12s %12s %12s\n", "length", "biseq MB/s",
+	       "bstrcmp MB/s", "bstrncmp MB/s", "naive MB/s");
+	for (k = 0; k < sizeof(lengths) / sizeof(lengths[0]); k++) {
+		double eq, cmp, ncmp, ref;
+		len = lengths[k];
+		a = bfromcstralloc(len + 1, "");
+		if (!a) {
+			fputs("Out of memory\n", stderr);
+			return EXIT_FAILURE;
+		}
+		for (i = 0; i < len; i++) {
+			a->data[i] = (unsigned char)(1 + benchRand(&seed) % 255);
+		}
+		a->data[len] = '\0';
+		a->slen = len;
+		b = bstrcpy(a);
+		if (!b) {
+			fputs("Out of memory\n", stderr);
+			return EXIT_FAILURE;
+		}
+		b->data[len - 1] ^= 0x40;
+		reps = TARGET_BYTES / len;
+		eq = timeOp(opBiseq, reps);
+		cmp = timeOp(opBstrcmp, reps);
+		ncmp = timeOp(opBstrncmp, reps);
+		ref = timeOp(opNaive, reps);
+		printf("%10d %12.1f %12.1f %12.1f %12.1f\n", len, eq, cmp,
+		       ncmp, ref);
+		bdestroy(a);
+		bdestroy(b);
+	}
+	return EXIT_SUCCESS;
+}
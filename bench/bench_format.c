@@ -0,0 +1,113 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Cost of printf style formatting.
+ *
+ * Log lines of a few lengths are formatted with bformat, with bassignformat
+ * into a reused bstring and with bformata appending to a growing log which
+ * is emptied every so often.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "bstrlib.h"
+
+#define LINES 1000000
+
+static void
+run(int msgLen)
+{
+	char *msg = malloc(msgLen + 1);
+	double t0, fmtT, assignT, appendT, bytes;
+	bstring b, log;
+	long i;
+	if (!msg) {
+		fputs("Out of memory\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+	memset(msg, 'm', msgLen);
+	msg[msgLen] = '\0';
+
+	t0 = benchNow();
+	for (i = 0; i < LINES; i++) {
+		b = bformat("%ld [%s] worker-%d: %s\n", i, "INFO",
+			    (int)(i & 7), msg);
+		benchSink += b->slen;
+		bdestroy(b);
+	}
+	fmtT = benchNow() - t0;
+
+	b = bfromcstr("");
+	t0 = benchNow();
+	for (i = 0; i < LINES; i++) {
+		bassignformat(b, "%ld [%s] worker-%d: %s\n", i, "INFO",
+			      (int)(i & 7), msg);
+		benchSink += b->slen;
+	}
+	assignT = benchNow() - t0;
+	bytes = (double)b->slen;
+	bdestroy(b);
+
+	log = bfromcstr("");
+	t0 = benchNow();
+	for (i = 0; i < LINES; i++) {
+		bformata(log, "%ld [%s] worker-%d: %s\n", i, "INFO",
+			 (int)(i & 7), msg);
+		if (log->slen > 65536) {
+			benchSink += log->slen;
+			log->slen = 0;
+		}
+	}
+	appendT = benchNow() - t0;
+	bdestroy(log);
+	free(msg);
+
+	printf("%6.0f %12.1f %12.1f %12.1f\n", bytes,
+	       fmtT * 1e9 / LINES, assignT * 1e9 / LINES,
+	       appendT * 1e9 / LINES);
+}
+
+int
+main(void)
+{
+	printf("%6s %12s %12s %12s\n", "bytes", "bformat", "bassignformat",
+	       "bformata");
+	run(20);
+	run(60);
+	run(300);
+	run(2000);
+	return EXIT_SUCCESS;
+}
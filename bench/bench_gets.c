@@ -0,0 +1,152 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Cost of reading a large file line by line.
+ *
+ * A temporary file of lines of varying length is read with bgets and
+ * bassigngets driven by fgetc, which make one call per byte, and with
+ * bsreadln, bsreadlna and bsgets on a bStream driven by fread, which read
+ * blocks and search them for the terminator.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "bstrlib.h"
+
+#define FILE_SIZE (64 << 20)
+
+static FILE *
+makeFile(int maxLine, double *bytes)
+{
+	unsigned int seed = 1;
+	char line[4096];
+	long total = 0;
+	int i, n;
+	FILE *fp = tmpfile();
+	if (!fp) {
+		return NULL;
+	}
+	while (total < FILE_SIZE) {
+		n = 1 + (int)(benchRand(&seed) % (unsigned int)maxLine);
+		for (i = 0; i < n - 1; i++) {
+			line[i] = (char)('a' + benchRand(&seed) % 26);
+		}
+		line[n - 1] = '\n';
+		if (fwrite(line, 1, n, fp) != (size_t)n) {
+			fclose(fp);
+			return NULL;
+		}
+		total += n;
+	}
+	*bytes = (double)total;
+	return fp;
+}
+
+static void
+run(int maxLine)
+{
+	struct bStream *s;
+	double t0, bytes = 0, getsT, assignT, lnT, lnaT, sgetsT;
+	bstring b;
+	FILE *fp = makeFile(maxLine, &bytes);
+	if (!fp) {
+		fputs("Cannot create a temporary file\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	rewind(fp);
+	t0 = benchNow();
+	while ((b = bgets((bNgetc)fgetc, fp, '\n')) != NULL) {
+		benchSink += b->slen;
+		bdestroy(b);
+	}
+	getsT = benchNow() - t0;
+
+	rewind(fp);
+	b = bfromcstr("");
+	t0 = benchNow();
+	while (bassigngets(b, (bNgetc)fgetc, fp, '\n') == 0) {
+		benchSink += b->slen;
+	}
+	assignT = benchNow() - t0;
+
+	rewind(fp);
+	s = bsopen((bNread)fread, fp);
+	t0 = benchNow();
+	while (bsreadln(b, s, '\n') == BSTR_OK) {
+		benchSink += b->slen;
+	}
+	lnT = benchNow() - t0;
+	bsclose(s);
+
+	rewind(fp);
+	s = bsopen((bNread)fread, fp);
+	t0 = benchNow();
+	for (b->slen = 0; bsreadlna(b, s, '\n') == BSTR_OK; b->slen = 0) {
+		benchSink += b->slen;
+	}
+	lnaT = benchNow() - t0;
+	bsclose(s);
+	bdestroy(b);
+
+	rewind(fp);
+	s = bsopen((bNread)fread, fp);
+	t0 = benchNow();
+	while ((b = bsgets(s, '\n')) != NULL) {
+		benchSink += b->slen;
+		bdestroy(b);
+	}
+	sgetsT = benchNow() - t0;
+	bsclose(s);
+	fclose(fp);
+
+	printf("%8d %10.1f %10.1f %10.1f %10.1f %10.1f\n", maxLine,
+	       benchRate(bytes, getsT), benchRate(bytes, assignT),
+	       benchRate(bytes, lnT), benchRate(bytes, lnaT),
+	       benchRate(bytes, sgetsT));
+}
+
+int
+main(void)
+{
+	printf("%8s %10s %10s %10s %10s %10s\n", "max line", "bgets",
+	       "bassigngets", "bsreadln", "bsreadlna", "bsgets");
+	run(16);
+	run(80);
+	run(400);
+	run(4000);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Cost of hashing bstrings.
+ *
+ * bhash and bhashcaseless are timed on pseudo-random text of several
+ * lengths, and the cost of looking up the hash of a key through a
+ * struct bstrHashKey, which hashes once and then answers from its cache, is
+ * set against hashing the key again each time.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "bstrlib.h"
+
+#define TARGET_BYTES (256L * 1024 * 1024)
+#define LOOKUPS (16L * 1024 * 1024)
+
+int
+main(void)
+{
+	static const int lengths[] = { 4, 8, 16, 32, 64, 256, 1024, 65536 };
+	unsigned int seed = 41;
+	struct bstrHashKey k;
+	double t0, exact, caseless, cached, rehash;
+	long reps, r;
+	size_t n;
+	int i, len;
+	bstring b;
+
+	printf("%10s %10s %12s %10s %12s %10s %10s\n", "length", "bhash ns",
+	       "bhash MB/s", "caseless", "caseless MB", "key ns", "rehash ns");
+	for (n = 0; n < sizeof(lengths) / sizeof(lengths[0]); n++) {
+		len = lengths[n];
+		b = bfromcstralloc(len + 1, "");
+		if (!b) {
+			fputs("Out of memory\n", stderr);
+			return EXIT_FAILURE;
+		}
+		for (i = 0; i < len; i++) {
+			b->data[i] = (unsigned char)('A' + benchRand(&seed) % 58);
+		}
+		b->slen = len;
+		reps = TARGET_BYTES / len;
+		if (reps > LOOKUPS) {
+			reps = LOOKUPS;
+		}
+		t0 = benchNow();
+		for (r = 0; r < reps; r++) {
+			benchSink += (long)bhash(b, (uint64_t)r);
+		}
+		exact = benchNow() - t0;
+		t0 = benchNow();
+		for (r = 0; r < reps; r++) {
+			benchSink += (long)bhashcaseless(b, (uint64_t)r);
+		}
+		caseless = benchNow() - t0;
+		bhashkeyinit(&k, b, 0);
+		t0 = benchNow();
+		for (r = 0; r < LOOKUPS; r++) {
+			benchSink += (long)bhashkey(&k, 0);
+		}
+		cached = benchNow() - t0;
+		t0 = benchNow();
+		for (r = 0; r < reps; r++) {
+			benchSink += (long)bhash(b, 0);
+		}
+		rehash = benchNow() - t0;
+		printf("%10d %10.1f %12.1f %10.1f %12.1f %10.2f %10.2f\n", len,
+		       exact * 1e9 / reps, benchRate((double)len * reps, exact),
+		       caseless * 1e9 / reps,
+		       benchRate((double)len * reps, caseless),
+		       cached * 1e9 / LOOKUPS, rehash * 1e9 / reps);
+		bdestroy(b);
+	}
+	return EXIT_SUCCESS;
+}
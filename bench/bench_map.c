@@ -0,0 +1,332 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Cost of the bstring hash map.
+ *
+ * Keys are inserted into a struct bstrMap, looked up, both present and
+ * absent, and erased again, and each step is set against the same work done
+ * by a plain chained hash table, which holds a bstring copy of every key in
+ * a list node of its own and grows by doubling its array of buckets.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "bstrlib.h"
+#include "bstrmap.h"
+
+#define OPERATIONS (4L * 1024 * 1024)
+
+struct chainNode {
+	struct chainNode *next;
+	uint64_t hash;
+	bstring key;
+	void *value;
+};
+
+struct chainMap {
+	struct chainNode **buckets;
+	size_t mask;
+	size_t count;
+};
+
+static int
+chainGrow(struct chainMap *c)
+{
+	size_t i, n = (c->mask + 1) * 2;
+	struct chainNode **b = calloc(n, sizeof(struct chainNode *));
+	struct chainNode *e, *next;
+	if (!b) {
+		return -1;
+	}
+	for (i = 0; i <= c->mask; i++) {
+		for (e = c->buckets[i]; e; e = next) {
+			next = e->next;
+			e->next = b[e->hash & (n - 1)];
+			b[e->hash & (n - 1)] = e;
+		}
+	}
+	free(c->buckets);
+	c->buckets = b;
+	c->mask = n - 1;
+	return 0;
+}
+
+static struct chainNode **
+chainSlot(struct chainMap *c, const bstring key, uint64_t h)
+{
+	struct chainNode **p = &c->buckets[h & c->mask];
+	while (*p && ((*p)->hash != h || !biseq((*p)->key, key))) {
+		p = &(*p)->next;
+	}
+	return p;
+}
+
+static int
+chainSet(struct chainMap *c, const bstring key, void *value)
+{
+	uint64_t h = bhash(key, 0);
+	struct chainNode **p = chainSlot(c, key, h), *e;
+	if (*p) {
+		(*p)->value = value;
+		return 0;
+	}
+	if (!(e = malloc(sizeof(struct chainNode)))) {
+		return -1;
+	}
+	if (!(e->key = bstrcpy(key))) {
+		free(e);
+		return -1;
+	}
+	e->hash = h;
+	e->value = value;
+	e->next = NULL;
+	*p = e;
+	if (++c->count > c->mask + 1) {
+		return chainGrow(c);
+	}
+	return 1;
+}
+
+static int
+chainFind(struct chainMap *c, const bstring key, void **value)
+{
+	struct chainNode **p = chainSlot(c, key, bhash(key, 0));
+	if (!*p) {
+		return 0;
+	}
+	*value = (*p)->value;
+	return 1;
+}
+
+static int
+chainErase(struct chainMap *c, const bstring key)
+{
+	struct chainNode **p = chainSlot(c, key, bhash(key, 0)), *e;
+	if (!(e = *p)) {
+		return 0;
+	}
+	*p = e->next;
+	bdestroy(e->key);
+	free(e);
+	c->count--;
+	return 1;
+}
+
+static void
+chainFree(struct chainMap *c)
+{
+	size_t i;
+	struct chainNode *e, *next;
+	for (i = 0; i <= c->mask; i++) {
+		for (e = c->buckets[i]; e; e = next) {
+			next = e->next;
+			bdestroy(e->key);
+			free(e);
+		}
+	}
+	free(c->buckets);
+}
+
+/*
+ * Time n insertions, reps passes of n lookups of present and of absent keys,
+ * and n erasures, adding the seconds taken by each to t. Lookups and
+ * erasures visit the keys in the order given by order, the absent keys
+ * being those following the first n.
+ */
+static int
+timeMap(struct tagbstring *keys, const int *order, int n, long reps,
+	double *t)
+{
+	struct bstrMap *m = bstrMapCreate();
+	void *v = NULL;
+	double t0;
+	long r;
+	int i;
+	if (!m) {
+		return -1;
+	}
+	t0 = benchNow();
+	for (i = 0; i < n; i++) {
+		benchSink += bstrMapSet(m, &keys[i], &keys[i]);
+	}
+	t[0] += benchNow() - t0;
+	if (reps > 0) {
+		t0 = benchNow();
+		for (r = 0; r < reps; r++) {
+			for (i = 0; i < n; i++) {
+				benchSink += bstrMapFind(m, &keys[order[i]],
+							 &v);
+			}
+		}
+		t[1] += benchNow() - t0;
+		t0 = benchNow();
+		for (r = 0; r < reps; r++) {
+			for (i = 0; i < n; i++) {
+				benchSink += bstrMapFind(m,
+					&keys[n + order[i]], &v);
+			}
+		}
+		t[2] += benchNow() - t0;
+	}
+	t0 = benchNow();
+	for (i = 0; i < n; i++) {
+		benchSink += bstrMapErase(m, &keys[order[i]], NULL);
+	}
+	t[3] += benchNow() - t0;
+	bstrMapDestroy(m);
+	return 0;
+}
+
+static int
+timeChain(struct tagbstring *keys, const int *order, int n, long reps,
+	  double *t)
+{
+	struct chainMap c;
+	void *v = NULL;
+	double t0;
+	long r;
+	int i;
+	c.mask = 15;
+	c.count = 0;
+	if (!(c.buckets = calloc(16, sizeof(struct chainNode *)))) {
+		return -1;
+	}
+	t0 = benchNow();
+	for (i = 0; i < n; i++) {
+		benchSink += chainSet(&c, &keys[i], &keys[i]);
+	}
+	t[0] += benchNow() - t0;
+	if (reps > 0) {
+		t0 = benchNow();
+		for (r = 0; r < reps; r++) {
+			for (i = 0; i < n; i++) {
+				benchSink += chainFind(&c, &keys[order[i]],
+						       &v);
+			}
+		}
+		t[1] += benchNow() - t0;
+		t0 = benchNow();
+		for (r = 0; r < reps; r++) {
+			for (i = 0; i < n; i++) {
+				benchSink += chainFind(&c,
+					&keys[n + order[i]], &v);
+			}
+		}
+		t[2] += benchNow() - t0;
+	}
+	t0 = benchNow();
+	for (i = 0; i < n; i++) {
+		benchSink += chainErase(&c, &keys[order[i]]);
+	}
+	t[3] += benchNow() - t0;
+	chainFree(&c);
+	return 0;
+}
+
+static void
+report(int n, const char *table, const double *t, long ops)
+{
+	printf("%9d %-7s %10.1f %10.1f %10.1f %10.1f\n", n, table,
+	       t[0] * 1e9 / ops, t[1] * 1e9 / ops, t[2] * 1e9 / ops,
+	       t[3] * 1e9 / ops);
+}
+
+int
+main(void)
+{
+	static const int sizes[] = { 1000, 100000, 1000000 };
+	struct tagbstring *keys;
+	unsigned char *text;
+	unsigned int seed = 23;
+	double tm[4], tc[4];
+	int *order;
+	long reps, r;
+	size_t s;
+	int i, j, n, len;
+
+	printf("%9s %-7s %10s %10s %10s %10s\n", "keys", "table", "insert ns",
+	       "hit ns", "miss ns", "erase ns");
+	for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		n = sizes[s];
+		/* Twice as many keys, the second half of them never inserted */
+		keys = malloc(sizeof(struct tagbstring) * 2 * n);
+		text = malloc((size_t)n * 2 * 24);
+		order = malloc(sizeof(int) * n);
+		if (!keys || !text || !order) {
+			fputs("Out of memory\n", stderr);
+			return EXIT_FAILURE;
+		}
+		for (i = 0; i < 2 * n; i++) {
+			len = 8 + (int)(benchRand(&seed) % 16);
+			for (j = 0; j < len; j++) {
+				text[i * 24 + j] = (unsigned char)('a' +
+					benchRand(&seed) % 26);
+			}
+			blk2tbstr(keys[i], text + i * 24, len);
+		}
+		/* Look the keys up in an order unrelated to their insertion */
+		for (i = 0; i < n; i++) {
+			order[i] = i;
+		}
+		for (i = n - 1; i > 0; i--) {
+			j = (int)((benchRand(&seed) << 15 | benchRand(&seed)) %
+				  (unsigned int)(i + 1));
+			len = order[i];
+			order[i] = order[j];
+			order[j] = len;
+		}
+		reps = OPERATIONS / n;
+		if (reps < 1) {
+			reps = 1;
+		}
+		for (i = 0; i < 4; i++) {
+			tm[i] = tc[i] = 0;
+		}
+		for (r = 0; r < reps; r++) {
+			if (timeMap(keys, order, n, r ? 0 : reps, tm) ||
+			    timeChain(keys, order, n, r ? 0 : reps, tc)) {
+				fputs("Out of memory\n", stderr);
+				return EXIT_FAILURE;
+			}
+		}
+		report(n, "bstrMap", tm, reps * n);
+		report(n, "chain", tc, reps * n);
+		free(keys);
+		free(text);
+		free(order);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,157 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Allocation count and access cost of packed versus ordinary bstrings.
+ *
+ * A large table of short keys is built with blk2bstr and again with
+ * blk2bstrpacked. The allocations made by each are counted through
+ * bstrSetAllocator, and the table is then read in a shuffled order so that
+ * nearly every key is a cache miss. An ordinary bstring needs a second,
+ * dependent load to reach its characters, which a packed one avoids.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "bstrlib.h"
+
+#define KEYS (1L << 20)
+#define PASSES 8
+
+struct counter {
+	long calls;
+	double bytes;
+};
+
+static void *
+countMalloc(size_t size, void *ctx)
+{
+	struct counter *c = ctx;
+	c->calls++;
+	c->bytes += (double)size;
+	return malloc(size);
+}
+
+static void *
+countRealloc(void *ptr, size_t size, void *ctx)
+{
+	struct counter *c = ctx;
+	c->calls++;
+	c->bytes += (double)size;
+	return realloc(ptr, size);
+}
+
+static void
+countFree(void *ptr, BSTR_UNUSED void *ctx)
+{
+	free(ptr);
+}
+
+static void
+run(const char *name, bstring (*make)(const void *, int), const long *order)
+{
+	struct counter c = { 0, 0.0 };
+	unsigned int seed = 7;
+	unsigned char key[24];
+	double t0, build, scan;
+	bstring *tbl;
+	long i, p;
+	int j, len;
+
+	tbl = malloc(KEYS * sizeof(bstring));
+	if (!tbl) {
+		fputs("Out of memory\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+	bstrSetAllocator(countMalloc, countRealloc, countFree, &c);
+	t0 = benchNow();
+	for (i = 0; i < KEYS; i++) {
+		len = 4 + benchRand(&seed) % 20;
+		for (j = 0; j < len; j++) {
+			key[j] = (unsigned char)('a' + benchRand(&seed) % 26);
+		}
+		tbl[i] = make(key, len);
+		if (!tbl[i]) {
+			fputs("Out of memory\n", stderr);
+			exit(EXIT_FAILURE);
+		}
+	}
+	build = benchNow() - t0;
+	t0 = benchNow();
+	for (p = 0; p < PASSES; p++) {
+		for (i = 0; i < KEYS; i++) {
+			bstring b = tbl[order[i]];
+			benchSink += b->data[b->slen - 1];
+		}
+	}
+	scan = benchNow() - t0;
+	for (i = 0; i < KEYS; i++) {
+		bdestroy(tbl[i]);
+	}
+	bstrSetAllocator(NULL, NULL, NULL, NULL);
+	free(tbl);
+	printf("%-16s %10ld %12.1f %12.1f %12.1f\n", name, c.calls,
+	       c.bytes / KEYS, build * 1e9 / KEYS,
+	       scan * 1e9 / ((double)KEYS * PASSES));
+}
+
+int
+main(void)
+{
+	unsigned int seed = 99;
+	long *order, i, j, t;
+
+	order = malloc(KEYS * sizeof(long));
+	if (!order) {
+		fputs("Out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < KEYS; i++) {
+		order[i] = i;
+	}
+	for (i = KEYS - 1; i > 0; i--) {
+		j = (long)(((unsigned long)benchRand(&seed) << 15 |
+			    benchRand(&seed)) % (unsigned long)(i + 1));
+		t = order[i];
+		order[i] = order[j];
+		order[j] = t;
+	}
+	printf("%-16s %10s %12s %12s %12s\n", "constructor", "allocs",
+	       "bytes/key", "build ns", "access ns");
+	run("blk2bstr", blk2bstr, order);
+	run("blk2bstrpacked", blk2bstrpacked, order);
+	free(order);
+	return EXIT_SUCCESS;
+}
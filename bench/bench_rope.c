@@ -0,0 +1,121 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Cost of editing a large string.
+ *
+ * Small insertions and deletions are made near the start of a large
+ * document, which is the worst case for a bstring since every edit moves
+ * the rest of the document, and then throughout it, held first in a bstring
+ * and then in a rope. Searching the rope across its chunks is set against
+ * binstr on the flat string.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "bstrlib.h"
+#include "bstrrope.h"
+
+#define DOCUMENT (64 * 1024 * 1024)
+#define EDITS 2000
+
+int
+main(void)
+{
+	struct tagbstring word = bsStatic("<edit>");
+	struct tagbstring needle = bsStatic("needle in a haystack");
+	struct bstrRope *r;
+	unsigned int seed = 7;
+	double t0, flat[2], rope[2], search[2];
+	bstring b;
+	int i, pass, pos;
+
+	b = bfromcstralloc(DOCUMENT + 1, "");
+	if (!b) {
+		fputs("Out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < DOCUMENT; i++) {
+		b->data[i] = (unsigned char)('a' + benchRand(&seed) % 26);
+	}
+	b->slen = DOCUMENT;
+	b->data[b->slen] = '\0';
+	/* Plant the needle at the end of the document */
+	memcpy(b->data + DOCUMENT - needle.slen, needle.data,
+	       (size_t)needle.slen);
+	if (!(r = bstrRopeFromBstr(b))) {
+		fputs("Out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+
+	printf("%-12s %14s %14s\n", "edits", "bstring us", "rope us");
+	for (pass = 0; pass < 2; pass++) {
+		seed = 11;
+		t0 = benchNow();
+		for (i = 0; i < EDITS; i++) {
+			pos = pass ? (int)((benchRand(&seed) << 11) %
+					   (unsigned int)(DOCUMENT / 2)) :
+				     (int)(benchRand(&seed) % 4096);
+			binsert(b, pos, &word, ' ');
+			bdelete(b, pos + 3, word.slen);
+		}
+		flat[pass] = benchNow() - t0;
+		seed = 11;
+		t0 = benchNow();
+		for (i = 0; i < EDITS; i++) {
+			pos = pass ? (int)((benchRand(&seed) << 11) %
+					   (unsigned int)(DOCUMENT / 2)) :
+				     (int)(benchRand(&seed) % 4096);
+			bstrRopeInsert(r, pos, &word);
+			bstrRopeDelete(r, pos + 3, word.slen);
+		}
+		rope[pass] = benchNow() - t0;
+		printf("%-12s %14.2f %14.2f\n", pass ? "throughout" : "near start",
+		       flat[pass] * 1e6 / EDITS, rope[pass] * 1e6 / EDITS);
+	}
+
+	t0 = benchNow();
+	benchSink += binstr(b, 0, &needle);
+	search[0] = benchNow() - t0;
+	t0 = benchNow();
+	benchSink += bstrRopeInStr(r, 0, &needle);
+	search[1] = benchNow() - t0;
+	printf("%-12s %14.1f %14.1f   MB/s\n", "binstr",
+	       benchRate(DOCUMENT, search[0]), benchRate(DOCUMENT, search[1]));
+
+	bdestroy(b);
+	bstrRopeDestroy(r);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Cost of rendering a compiled format against interpreting it every time.
+ *
+ * A few templates typical of log and protocol lines are appended to a log
+ * which is emptied every so often: with bformata, with bcatformat, and
+ * with a format compiled once by bstrFormatCreate and rendered with
+ * bstrFormatCat.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include "bstrfmt.h"
+#include "bstrlib.h"
+
+#define LINES 1000000
+
+static const char *const templates[] = {
+	"%ld [%s] worker-%d: %s\n",
+	"%s %s HTTP/1.1\r\nHost: %s\r\nContent-Length: %u\r\n\r\n",
+	"{\"id\":%d,\"name\":\"%s\",\"count\":%u,\"flags\":\"%x\"}\n",
+	"%-8s|%6d|%08x|%s\n",
+};
+
+static void
+emit(int which, int mode, bstring log, struct bstrFormat *f, long i)
+{
+	static const char *const names[] = {
+		"INFO", "GET", "sensor", "alpha"
+	};
+	const char *msg = "request handled without incident";
+#define ARGS(...) \
+	(mode == 0 ? bformata(log, templates[which], __VA_ARGS__) : \
+	 mode == 1 ? bcatformat(log, templates[which], __VA_ARGS__) : \
+		     bstrFormatCat(log, f, __VA_ARGS__))
+	switch (which) {
+	case 0:
+		ARGS(i, names[0], (int)(i & 7), msg);
+		break;
+	case 1:
+		ARGS(names[1], "/index.html", "example.com", (unsigned)i);
+		break;
+	case 2:
+		ARGS((int)i, names[2], (unsigned)(i * 7), (unsigned)i);
+		break;
+	default:
+		ARGS(names[3], (int)i, (unsigned)i, msg);
+		break;
+	}
+#undef ARGS
+	if (log->slen > 65536) {
+		benchSink += log->slen;
+		log->slen = 0;
+	}
+}
+
+int
+main(void)
+{
+	double t0, t[3];
+	bstring log = bfromcstr("");
+	struct bstrFormat *f;
+	int which, mode;
+	long i;
+	if (!log) {
+		fputs("Out of memory\n", stderr);
+		return EXIT_FAILURE;
+	}
+	printf("%8s %12s %12s %12s\n", "template", "bformata", "bcatformat",
+	       "compiled");
+	for (which = 0; which < 4; which++) {
+		if (NULL == (f = bstrFormatCreate(templates[which]))) {
+			fputs("Out of memory\n", stderr);
+			return EXIT_FAILURE;
+		}
+		for (mode = 0; mode < 3; mode++) {
+			t0 = benchNow();
+			for (i = 0; i < LINES; i++) {
+				emit(which, mode, log, f, i);
+			}
+			t[mode] = benchNow() - t0;
+		}
+		bstrFormatDestroy(f);
+		printf("%8d %12.1f %12.1f %12.1f\n", which,
+		       t[0] * 1e9 / LINES, t[1] * 1e9 / LINES,
+		       t[2] * 1e9 / LINES);
+	}
+	bdestroy(log);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * Cost of writing large strings and joined lists to a stream.
+ *
+ * A list of entries is written joined by a separator, first by building the
+ * joined string with bjoin and writing it, and then with bwsWriteList, to a
+ * stream opened with bwsOpen and to one opened with bwsOpenv, whose writes
+ * are sent straight from the entries. The sink only reads the first byte of
+ * each block, so that the copies made on the way dominate.
+ */
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "bstrlib.h"
+#include "bstraux.h"
+
+#define PASSES 200
+
+static int
+sinkWrite(const void *buf, size_t elsize, size_t nelem, void *parm)
+{
+	(void)parm;
+	benchSink += ((const unsigned char *)buf)[0] + elsize;
+	return (int)nelem;
+}
+
+static int
+sinkWritev(const struct bstrIoVec *iov, int iovcnt, void *parm)
+{
+	int i, n = 0;
+	(void)parm;
+	for (i = 0; i < iovcnt; i++) {
+		n += (int)iov[i].len;
+		benchSink += ((const unsigned char *)iov[i].base)[0];
+	}
+	return n;
+}
+
+static void
+run(int entries, int len)
+{
+	struct tagbstring sep = bsStatic("\r\n");
+	struct bwriteStream *ws;
+	struct bstrList *sl;
+	double t0, joined, buffered, vectored, bytes;
+	bstring b;
+	int i, p;
+
+	sl = bstrListCreate();
+	if (!sl || bstrListAlloc(sl, entries) != BSTR_OK) {
+		fputs("Out of memory\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < entries; i++) {
+		sl->entry[sl->qty++] = b = bfromcstralloc(len, "");
+		memset(b->data, 'a' + i % 26, len);
+		b->slen = len;
+		b->data[len] = '\0';
+	}
+	bytes = (double)PASSES * (entries * (len + 2.0) - 2);
+
+	ws = bwsOpen(sinkWrite, NULL);
+	t0 = benchNow();
+	for (p = 0; p < PASSES; p++) {
+		b = bjoin(sl, &sep);
+		bwsWriteBstr(ws, b);
+		bdestroy(b);
+	}
+	bwsClose(ws);
+	joined = benchNow() - t0;
+
+	ws = bwsOpen(sinkWrite, NULL);
+	t0 = benchNow();
+	for (p = 0; p < PASSES; p++) {
+		bwsWriteList(ws, sl, &sep);
+	}
+	bwsClose(ws);
+	buffered = benchNow() - t0;
+
+	ws = bwsOpenv(sinkWritev, NULL);
+	t0 = benchNow();
+	for (p = 0; p < PASSES; p++) {
+		bwsWriteList(ws, sl, &sep);
+	}
+	bwsClose(ws);
+	vectored = benchNow() - t0;
+
+	printf("%6d x %-7d %12.1f %12.1f %12.1f\n", entries, len,
+	       benchRate(bytes, joined), benchRate(bytes, buffered),
+	       benchRate(bytes, vectored));
+	bstrListDestroy(sl);
+}
+
+int
+main(void)
+{
+	printf("%-16s %12s %12s %12s\n", "entries x len", "bjoin",
+	       "bwsOpen", "bwsOpenv");
+	run(10000, 16);
+	run(2000, 1024);
+	run(200, 65536);
+	run(4, 1 << 22);
+	return EXIT_SUCCESS;
+}
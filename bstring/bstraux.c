@@ -40,11 +40,15 @@
 #endif
 
 #include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <ctype.h>
 #include "bstraux.h"
+#include "bstralloc.h"
+#include "bstrsimd.h"
 
 bstring
 bTail(bstring b, int n)
@@ -297,8 +301,16 @@ bStr2NetStr(const bstring b)
 		bdestroy(s);
 		return NULL;
 	}
+#if defined(BSTRLIB_SMALL_INLINE)
+	/* Short strings share a block with their header, so the buffer is
+	 * copied out rather than detached.
+	 */
+	buff = (unsigned char *)bstr2cstr(s, '\0');
+	bdestroy(s);
+#else
 	buff = s->data;
 	bcstrfree((char *)s);
+#endif
 	return (char *)buff;
 }
 
@@ -344,102 +356,419 @@ bNetStr2Bstr(const char * buff)
 	return b;
 }
 
-static char b64ETable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-			  "abcdefghijklmnopqrstuvwxyz"
-			  "0123456789+/";
+static const char b64ETable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+				"abcdefghijklmnopqrstuvwxyz"
+				"0123456789+/";
+
+static const char b64UrlETable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+				   "abcdefghijklmnopqrstuvwxyz"
+				   "0123456789-_";
+
+#define B64_WS (-3)
+#define B64_PAD (-2)
+#define B64_ERR (-1)
+
+/* The values of the characters, or B64_WS, B64_PAD or B64_ERR */
+static const signed char b64DTable[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -3, -3, -1, -1, -3, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+	52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -2, -1, -1,
+	-1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+	15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+	-1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+static const signed char b64UrlDTable[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -3, -3, -1, -1, -3, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1,
+	52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -2, -1, -1,
+	-1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+	15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, 63,
+	-1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+#define B64_LINE (76)
+
+int
+bBase64EncodeLen(int len, int flags)
+{
+	size_t c;
+	if (len < 0) {
+		return BSTR_ERR;
+	}
+	c = (size_t)(len / 3) * 4;
+	if (len % 3) {
+		c += (flags & BSTR_B64_NOPAD) ? (size_t)(len % 3 + 1) : 4;
+	}
+	if (!(flags & BSTR_B64_NOWRAP)) {
+		c += 2 * (size_t)(len / 57);
+	}
+	return c > INT_MAX ? BSTR_ERR : (int)c;
+}
+
+void
+bBase64Init(struct bBase64State *st, int flags)
+{
+	st->flags = flags;
+	st->col = 0;
+	st->n = 0;
+	st->pad = 0;
+	st->end = 0;
+	st->acc = 0;
+}
+
+/* Encode the ngroups groups of 3 bytes at s to d, ending every line of
+ * 76 characters with CRLF unless st says otherwise, and return the end of
+ * the output.
+ */
+static unsigned char *
+b64EncodeGroups(struct bBase64State *st, unsigned char *d,
+		const unsigned char *s, int ngroups)
+{
+	int url = st->flags & BSTR_B64_URL;
+	const char *t = url ? b64UrlETable : b64ETable;
+	unsigned int v;
+	int k, j;
+	while (ngroups > 0) {
+		k = ngroups;
+		if (!(st->flags & BSTR_B64_NOWRAP) &&
+		    k > (B64_LINE - st->col) / 4) {
+			k = (B64_LINE - st->col) / 4;
+		}
+		j = (int)(bSimdBase64Encode(d, s, (size_t)k * 3, url) / 3);
+		d += 4 * j;
+		s += 3 * j;
+		for (; j < k; j++) {
+			v = ((unsigned int)s[0] << 16) |
+			    ((unsigned int)s[1] << 8) | s[2];
+			d[0] = (unsigned char)t[v >> 18];
+			d[1] = (unsigned char)t[(v >> 12) & 0x3F];
+			d[2] = (unsigned char)t[(v >> 6) & 0x3F];
+			d[3] = (unsigned char)t[v & 0x3F];
+			d += 4;
+			s += 3;
+		}
+		ngroups -= k;
+		if (!(st->flags & BSTR_B64_NOWRAP)) {
+			st->col += 4 * k;
+			if (st->col == B64_LINE) {
+				*d++ = (unsigned char)'\r';
+				*d++ = (unsigned char)'\n';
+				st->col = 0;
+			}
+		}
+	}
+	return d;
+}
+
+/* Make room for size more characters in out, finding blk again if it lies
+ * within out.
+ */
+static int
+b64Reserve(bstring out, const unsigned char **blk, size_t size)
+{
+	ptrdiff_t pd = *blk - out->data;
+	if (size > (size_t)(INT_MAX - 1 - out->slen)) {
+		return BSTR_ERR;
+	}
+	if (BSTR_OK != balloc(out, out->slen + (int)size + 1)) {
+		return BSTR_ERR;
+	}
+	if (*blk && 0 <= pd && pd <= out->slen) {
+		*blk = out->data + pd;
+	}
+	return BSTR_OK;
+}
+
+#define b64Bad(st, out, blk, len) \
+	((st) == NULL || (out) == NULL || (out)->data == NULL || \
+	 (out)->slen < 0 || (out)->mlen <= 0 || (out)->mlen < (out)->slen || \
+	 (len) < 0 || ((blk) == NULL && (len) > 0))
+
+int
+bBase64EncodeStep(struct bBase64State *st, bstring out, const void *blk,
+		  int len)
+{
+	const unsigned char *s = blk;
+	unsigned char *d, g[3];
+	size_t groups, size;
+	if (b64Bad(st, out, blk, len)) {
+		return BSTR_ERR;
+	}
+	groups = ((size_t)st->n + len) / 3;
+	size = 4 * groups;
+	if (!(st->flags & BSTR_B64_NOWRAP)) {
+		size += 2 * ((st->col + size) / B64_LINE);
+	}
+	if (BSTR_OK != b64Reserve(out, &s, size)) {
+		return BSTR_ERR;
+	}
+	d = out->data + out->slen;
+	if (st->n > 0) {
+		for (; st->n < 3 && len > 0; st->n++, len--) {
+			st->acc = (st->acc << 8) | *s++;
+		}
+		if (st->n < 3) {
+			return BSTR_OK;
+		}
+		g[0] = (unsigned char)(st->acc >> 16);
+		g[1] = (unsigned char)(st->acc >> 8);
+		g[2] = (unsigned char)st->acc;
+		d = b64EncodeGroups(st, d, g, 1);
+		st->n = 0;
+		st->acc = 0;
+	}
+	d = b64EncodeGroups(st, d, s, len / 3);
+	for (s += len - len % 3; st->n < len % 3; st->n++) {
+		st->acc = (st->acc << 8) | *s++;
+	}
+	out->slen = (int)(d - out->data);
+	out->data[out->slen] = (unsigned char)'\0';
+	return BSTR_OK;
+}
+
+int
+bBase64EncodeEnd(struct bBase64State *st, bstring out)
+{
+	const char *t;
+	const unsigned char *s = NULL;
+	unsigned char *d;
+	unsigned int v;
+	int pad;
+	if (b64Bad(st, out, s, 0)) {
+		return BSTR_ERR;
+	}
+	if (st->n > 0) {
+		t = (st->flags & BSTR_B64_URL) ? b64UrlETable : b64ETable;
+		pad = !(st->flags & BSTR_B64_NOPAD);
+		if (BSTR_OK != b64Reserve(out, &s, 4)) {
+			return BSTR_ERR;
+		}
+		d = out->data + out->slen;
+		v = st->acc << (st->n == 1 ? 16 : 8);
+		*d++ = (unsigned char)t[v >> 18];
+		*d++ = (unsigned char)t[(v >> 12) & 0x3F];
+		if (st->n == 2) {
+			*d++ = (unsigned char)t[(v >> 6) & 0x3F];
+		} else if (pad) {
+			*d++ = (unsigned char)'=';
+		}
+		if (pad) {
+			*d++ = (unsigned char)'=';
+		}
+		out->slen = (int)(d - out->data);
+		out->data[out->slen] = (unsigned char)'\0';
+	}
+	bBase64Init(st, st->flags);
+	return BSTR_OK;
+}
+
+int
+bBase64EncodeBlk(bstring out, const void *blk, int len, int flags)
+{
+	struct bBase64State st;
+	const unsigned char *s = blk;
+	int size = bBase64EncodeLen(len, flags);
+	if (size < 0 || b64Bad(&st, out, blk, len) ||
+	    BSTR_OK != b64Reserve(out, &s, (size_t)size)) {
+		return BSTR_ERR;
+	}
+	bBase64Init(&st, flags);
+	if (BSTR_OK != bBase64EncodeStep(&st, out, s, len)) {
+		return BSTR_ERR;
+	}
+	return bBase64EncodeEnd(&st, out);
+}
 
 bstring
 bBase64Encode(const bstring b)
 {
-	int i, c0, c1, c2, c3;
 	bstring out;
+	int size;
 	if (b == NULL || b->slen < 0 || b->data == NULL) {
 		return NULL;
 	}
-	out = bfromcstr("");
-	for (i = 0; i + 2 < b->slen; i += 3) {
-		if (i && ((i % 57) == 0)) {
-			if (bconchar(out, (char)'\015') < 0 ||
-			    bconchar(out, (char)'\012') < 0) {
-				bdestroy(out);
-				return NULL;
+	size = bBase64EncodeLen(b->slen, 0);
+	if (size < 0 || NULL == (out = bfromcstralloc(size + 1, ""))) {
+		return NULL;
+	}
+	if (BSTR_OK != bBase64EncodeBlk(out, b->data, b->slen, 0)) {
+		bdestroy(out);
+		return NULL;
+	}
+	return out;
+}
+
+/* Decode whole groups of 4 characters of the alphabet at s to d, for as
+ * long as there are any, and return the number of characters decoded.
+ */
+static int
+b64DecodeGroups(const signed char *t, int url, unsigned char *d,
+		const unsigned char *s, int len)
+{
+	int i = (int)bSimdBase64Decode(d, s, (size_t)len, url);
+	unsigned int v;
+	d += i / 4 * 3;
+	for (; i + 4 <= len; i += 4) {
+		if ((t[s[i]] | t[s[i + 1]] | t[s[i + 2]] | t[s[i + 3]]) < 0) {
+			break;
+		}
+		v = ((unsigned int)t[s[i]] << 18) |
+		    ((unsigned int)t[s[i + 1]] << 12) |
+		    ((unsigned int)t[s[i + 2]] << 6) | (unsigned int)t[s[i + 3]];
+		d[0] = (unsigned char)(v >> 16);
+		d[1] = (unsigned char)(v >> 8);
+		d[2] = (unsigned char)v;
+		d += 3;
+	}
+	return i;
+}
+
+int
+bBase64DecodeStep(struct bBase64State *st, bstring out, const void *blk,
+		  int len)
+{
+	const unsigned char *s = blk;
+	const signed char *t;
+	unsigned char *d;
+	int url, i = 0, c, k;
+	if (b64Bad(st, out, blk, len) ||
+	    BSTR_OK != b64Reserve(out, &s, ((size_t)st->n + len) / 4 * 3 + 2)) {
+		return BSTR_ERR;
+	}
+	url = st->flags & BSTR_B64_URL;
+	t = url ? b64UrlDTable : b64DTable;
+	d = out->data + out->slen;
+	while (i < len) {
+		if (st->n == 0 && !st->end) {
+			k = b64DecodeGroups(t, url, d, s + i, len - i);
+			d += k / 4 * 3;
+			i += k;
+			if (i >= len) {
+				break;
 			}
 		}
-		c0 = b->data[i] >> 2;
-		c1 = ((b->data[i] << 4) | (b->data[i+1] >> 4)) & 0x3F;
-		c2 = ((b->data[i+1] << 2) | (b->data[i+2] >> 6)) & 0x3F;
-		c3 = b->data[i+2] & 0x3F;
-		if (bconchar(out, b64ETable[c0]) < 0 ||
-		    bconchar(out, b64ETable[c1]) < 0 ||
-		    bconchar(out, b64ETable[c2]) < 0 ||
-		    bconchar(out, b64ETable[c3]) < 0) {
-			bdestroy(out);
-			return NULL;
+		c = t[s[i++]];
+		if (c >= 0) {
+			if (st->end) {
+				goto bad;
+			}
+			st->acc = (st->acc << 6) | (unsigned int)c;
+			if (++st->n == 4) {
+				*d++ = (unsigned char)(st->acc >> 16);
+				*d++ = (unsigned char)(st->acc >> 8);
+				*d++ = (unsigned char)st->acc;
+				st->n = 0;
+				st->acc = 0;
+			}
+		} else if (c == B64_PAD) {
+			if (st->end) {
+				if (st->pad-- == 0) {
+					goto bad;
+				}
+				continue;
+			}
+			/* Padding may end a group of 2 or 3 characters */
+			if (st->n < 2) {
+				goto bad;
+			}
+			st->acc <<= 6 * (4 - st->n);
+			*d++ = (unsigned char)(st->acc >> 16);
+			if (st->n == 3) {
+				*d++ = (unsigned char)(st->acc >> 8);
+			}
+			st->pad = 3 - st->n;
+			st->end = 1;
+			st->n = 0;
+			st->acc = 0;
+		} else if (c == B64_WS) {
+			while (i < len && t[s[i]] == B64_WS) {
+				i++;
+			}
+		} else {
+			goto bad;
 		}
 	}
-	if (i && ((i % 57) == 0)) {
-		if (bconchar(out, (char)'\015') < 0 ||
-		    bconchar(out, (char)'\012') < 0) {
-			bdestroy(out);
-			return NULL;
-		}
+	out->slen = (int)(d - out->data);
+	out->data[out->slen] = (unsigned char)'\0';
+	return BSTR_OK;
+bad:
+	out->data[out->slen] = (unsigned char)'\0';
+	return BSTR_ERR;
+}
+
+int
+bBase64DecodeEnd(struct bBase64State *st, bstring out)
+{
+	const unsigned char *s = NULL;
+	int ret = BSTR_OK;
+	if (b64Bad(st, out, s, 0)) {
+		return BSTR_ERR;
 	}
-	switch (i + 2 - b->slen) {
-	case 0:	c0 = b->data[i] >> 2;
-		c1 = ((b->data[i] << 4) | (b->data[i+1] >> 4)) & 0x3F;
-		c2 = (b->data[i+1] << 2) & 0x3F;
-		if (bconchar(out, b64ETable[c0]) < 0 ||
-		    bconchar(out, b64ETable[c1]) < 0 ||
-		    bconchar(out, b64ETable[c2]) < 0 ||
-		    bconchar(out, (char)'=') < 0) {
-			bdestroy(out);
-			return NULL;
+	if (st->end ? st->pad > 0 : st->n == 1) {
+		ret = BSTR_ERR;
+	} else if (st->n > 1) {
+		if (BSTR_OK != b64Reserve(out, &s, 2)) {
+			return BSTR_ERR;
 		}
-		break;
-	case 1:	c0 =  b->data[i] >> 2;
-		c1 = (b->data[i] << 4) & 0x3F;
-		if (bconchar(out, b64ETable[c0]) < 0 ||
-		    bconchar(out, b64ETable[c1]) < 0 ||
-		    bconchar(out, (char)'=') < 0 ||
-		    bconchar(out, (char)'=') < 0) {
-			bdestroy(out);
-			return NULL;
+		st->acc <<= 6 * (4 - st->n);
+		out->data[out->slen++] = (unsigned char)(st->acc >> 16);
+		if (st->n == 3) {
+			out->data[out->slen++] = (unsigned char)(st->acc >> 8);
 		}
-		break;
-	case 2:
-		break;
+		out->data[out->slen] = (unsigned char)'\0';
 	}
-	return out;
+	bBase64Init(st, st->flags);
+	return ret;
 }
 
-#define B64_PAD (-2)
-#define B64_ERR (-1)
-
-static int
-base64DecodeSymbol(unsigned char alpha)
-{
-	if ((alpha >= 'A') && (alpha <= 'Z')) {
-		return (int)(alpha - 'A');
-	} else if ((alpha >= 'a') && (alpha <= 'z')) {
-		return 26 + (int)(alpha - 'a');
-	} else if ((alpha >= '0') && (alpha <= '9')) {
-		return 52 + (int)(alpha - '0');
-	} else if (alpha == '+') {
-		return 62;
-	} else if (alpha == '/') {
-		return 63;
-	} else if (alpha == '=') {
-		return B64_PAD;
-	} else {
-		return B64_ERR;
+int
+bBase64DecodeBlk(bstring out, const void *blk, int len, int flags)
+{
+	struct bBase64State st;
+	int olen;
+	if (b64Bad(&st, out, blk, len)) {
+		return BSTR_ERR;
+	}
+	olen = out->slen;
+	bBase64Init(&st, flags);
+	if (BSTR_OK != bBase64DecodeStep(&st, out, blk, len) ||
+	    BSTR_OK != bBase64DecodeEnd(&st, out)) {
+		out->slen = olen;
+		out->data[olen] = (unsigned char)'\0';
+		return BSTR_ERR;
 	}
+	return BSTR_OK;
 }
 
 bstring
-bBase64DecodeEx(const bstring b, int * boolTruncError)
+bBase64DecodeEx(const bstring b, int *boolTruncError)
 {
-	int i, v;
-	unsigned char c0, c1, c2;
+	const signed char *t = b64DTable;
+	const unsigned char *s;
+	unsigned char *d;
+	int i = 0, k, v;
+	unsigned int c0, c1, c2;
 	bstring out;
 	if (b == NULL || b->slen < 0 || b->data == NULL) {
 		return NULL;
@@ -447,108 +776,80 @@ bBase64DecodeEx(const bstring b, int * boolTruncError)
 	if (boolTruncError) {
 		*boolTruncError = 0;
 	}
-	out = bfromcstr("");
-	i = 0;
+	out = bfromcstralloc(b->slen / 4 * 3 + 3, "");
+	if (out == NULL) {
+		return NULL;
+	}
+	s = b->data;
+	d = out->data;
+	/* Characters outside the alphabet are skipped */
 	while (1) {
+		k = b64DecodeGroups(t, 0, d, s + i, b->slen - i);
+		i += k;
+		d += k / 4 * 3;
 		do {
 			if (i >= b->slen) {
-				return out;
+				goto done;
 			}
-			if (b->data[i] == '=') {
+			if (s[i] == '=') {
 				/* Bad "too early" truncation */
-				if (boolTruncError) {
-					*boolTruncError = 1;
-					return out;
-				}
-				bdestroy(out);
-				return NULL;
+				goto trunc;
 			}
-			v = base64DecodeSymbol(b->data[i]);
-			i++;
+			v = t[s[i++]];
 		} while (v < 0);
-		c0 = (unsigned char)(v << 2);
+		c0 = (unsigned int)v << 2;
 		do {
-			if (i >= b->slen || b->data[i] == '=') {
+			if (i >= b->slen || s[i] == '=') {
 				/* Bad "too early" truncation */
-				if (boolTruncError) {
-					*boolTruncError = 1;
-					return out;
-				}
-				bdestroy(out);
-				return NULL;
+				goto trunc;
 			}
-			v = base64DecodeSymbol(b->data[i]);
-			i++;
+			v = t[s[i++]];
 		} while (v < 0);
-		c0 |= (unsigned char)(v >> 4);
-		c1  = (unsigned char)(v << 4);
+		c0 |= (unsigned int)v >> 4;
+		c1 = (unsigned int)v << 4;
 		do {
 			if (i >= b->slen) {
-				if (boolTruncError) {
-					*boolTruncError = 1;
-					return out;
-				}
-				bdestroy(out);
-				return NULL;
+				goto trunc;
 			}
-			if (b->data[i] == '=') {
+			if (s[i] == '=') {
 				i++;
-				if (i >= b->slen || b->data[i] != '=' ||
-				    bconchar(out, c0) < 0) {
-					if (boolTruncError) {
-						*boolTruncError = 1;
-						return out;
-					}
+				if (i >= b->slen || s[i] != '=') {
 					/* Missing "=" at the end. */
-					bdestroy(out);
-					return NULL;
+					goto trunc;
 				}
-				return out;
+				*d++ = (unsigned char)c0;
+				goto done;
 			}
-			v = base64DecodeSymbol(b->data[i]);
-			i++;
+			v = t[s[i++]];
 		} while (v < 0);
-		c1 |= (unsigned char)(v >> 2);
-		c2  = (unsigned char)(v << 6);
+		c1 |= (unsigned int)v >> 2;
+		c2 = (unsigned int)v << 6;
 		do {
 			if (i >= b->slen) {
-				if (boolTruncError) {
-					*boolTruncError = 1;
-					return out;
-				}
-				bdestroy(out);
-				return NULL;
+				goto trunc;
 			}
-			if (b->data[i] == '=') {
-				if (bconchar(out, c0) < 0 ||
-				    bconchar(out, c1) < 0) {
-					if (boolTruncError) {
-						*boolTruncError = 1;
-						return out;
-					}
-					bdestroy(out);
-					return NULL;
-				}
-				if (boolTruncError) {
-					*boolTruncError = 0;
-				}
-				return out;
+			if (s[i] == '=') {
+				*d++ = (unsigned char)c0;
+				*d++ = (unsigned char)c1;
+				goto done;
 			}
-			v = base64DecodeSymbol(b->data[i]);
-			i++;
+			v = t[s[i++]];
 		} while (v < 0);
-		c2 |= (unsigned char)(v);
-		if (bconchar(out, c0) < 0 ||
-				bconchar(out, c1) < 0 ||
-				bconchar(out, c2) < 0) {
-			if (boolTruncError) {
-				*boolTruncError = -1;
-				return out;
-			}
-			bdestroy(out);
-			return NULL;
-		}
+		c2 |= (unsigned int)v;
+		*d++ = (unsigned char)c0;
+		*d++ = (unsigned char)c1;
+		*d++ = (unsigned char)c2;
+	}
+trunc:
+	if (!boolTruncError) {
+		bdestroy(out);
+		return NULL;
 	}
+	*boolTruncError = 1;
+done:
+	out->slen = (int)(d - out->data);
+	out->data[out->slen] = (unsigned char)'\0';
+	return out;
 }
 
 #define UU_DECODE_BYTE(b) \
@@ -697,7 +998,7 @@ exit:
 	if (ctx) {
 		bdestroy(ctx->io.dst);
 		bdestroy(ctx->io.src);
-		free(ctx);
+		bMemFree(ctx);
 	}
 	bsclose(s);
 	return b;
@@ -778,7 +1079,7 @@ done:
 struct bStream *
 bsUuDecode(struct bStream *sInp, int *badlines)
 {
-	struct bsUuCtx *ctx = (struct bsUuCtx *)malloc(sizeof(struct bsUuCtx));
+	struct bsUuCtx *ctx = (struct bsUuCtx *)bMemAlloc(sizeof(struct bsUuCtx));
 	struct bStream *sOut;
 	if (NULL == ctx) {
 		return NULL;
@@ -801,7 +1102,7 @@ bsUuDecode(struct bStream *sInp, int *badlines)
 error:
 	bdestroy(ctx->io.dst);
 	bdestroy(ctx->io.src);
-	free(ctx);
+	bMemFree(ctx);
 	return NULL;
 }
 
@@ -1089,6 +1390,7 @@ struct bwriteStream {
 	bstring buff; /* Buffer for underwrites */
 	void * parm; /* The stream handle for core stream */
 	bNwrite writeFn; /* fwrite work-a-like fnptr for core stream */
+	bNwritev writevFn; /* writev work-a-like fnptr for core stream */
 	int isEOF; /* track stream's EOF state */
 	int minBuffSz;
 };
@@ -1100,14 +1402,15 @@ bwsOpen(bNwrite writeFn, void *parm)
 	if (NULL == writeFn) {
 		return NULL;
 	}
-	ws = (struct bwriteStream *)malloc(sizeof(struct bwriteStream));
+	ws = (struct bwriteStream *)bMemAlloc(sizeof(struct bwriteStream));
 	if (ws) {
 		if (NULL == (ws->buff = bfromcstr(""))) {
-			free(ws);
+			bMemFree(ws);
 			ws = NULL;
 		} else {
 			ws->parm = parm;
 			ws->writeFn = writeFn;
+			ws->writevFn = NULL;
 			ws->isEOF = 0;
 			ws->minBuffSz = BWS_BUFF_SZ;
 		}
@@ -1115,10 +1418,39 @@ bwsOpen(bNwrite writeFn, void *parm)
 	return ws;
 }
 
+/* Write out n blocks, through a single call if the core stream is vectored */
+static int
+bwsOut(struct bwriteStream *ws, const struct bstrIoVec *iov, int n)
+{
+	size_t want = 0;
+	int i, w;
+	if (ws->writevFn) {
+		for (i = 0; i < n; i++) {
+			want += iov[i].len;
+		}
+		w = ws->writevFn(iov, n, ws->parm);
+		if (w < 0 || (size_t)w != want) {
+			ws->isEOF = 1;
+			return BSTR_ERR;
+		}
+		return BSTR_OK;
+	}
+	for (i = 0; i < n; i++) {
+		if (iov[i].len > 0 &&
+		    1 != ws->writeFn(iov[i].base, iov[i].len, 1, ws->parm)) {
+			ws->isEOF = 1;
+			return BSTR_ERR;
+		}
+	}
+	return BSTR_OK;
+}
+
 #define internal_bwswriteout(ws,b) { \
 	if ((b)->slen > 0) { \
-		if (1 != (ws->writeFn ((b)->data, (b)->slen, 1, ws->parm))) { \
-			ws->isEOF = 1; \
+		struct bstrIoVec v_; \
+		v_.base = (b)->data; \
+		v_.len = (size_t)(b)->slen; \
+		if (0 > bwsOut(ws, &v_, 1)) { \
 			return BSTR_ERR; \
 		} \
 	} \
@@ -1130,7 +1462,7 @@ bwsWriteFlush(struct bwriteStream *ws)
 	if (NULL == ws ||
 	    ws->isEOF ||
 	    0 >= ws->minBuffSz ||
-	    NULL == ws->writeFn ||
+	    (NULL == ws->writeFn && NULL == ws->writevFn) ||
 	    NULL == ws->buff) {
 		return BSTR_ERR;
 	}
@@ -1149,7 +1481,7 @@ bwsWriteBstr(struct bwriteStream *ws, const bstring b)
 	    NULL == ws->buff ||
 	    ws->isEOF ||
 	    0 >= ws->minBuffSz ||
-	    NULL == ws->writeFn) {
+	    (NULL == ws->writeFn && NULL == ws->writevFn)) {
 		return BSTR_ERR;
 	}
 	/* Buffer prepacking optimization */
@@ -1160,6 +1492,19 @@ bwsWriteBstr(struct bwriteStream *ws, const bstring b)
 		}
 		return bwsWriteBstr(ws, &empty);
 	}
+	/* Send the buffer and b together rather than copying b */
+	if (ws->writevFn && ws->buff->slen + b->slen >= ws->minBuffSz) {
+		struct bstrIoVec v[2];
+		v[0].base = ws->buff->data;
+		v[0].len = (size_t)ws->buff->slen;
+		v[1].base = b->data;
+		v[1].len = (size_t)b->slen;
+		if (0 > bwsOut(ws, v, 2)) {
+			return BSTR_ERR;
+		}
+		ws->buff->slen = 0;
+		return 0;
+	}
 	if (0 > (l = ws->minBuffSz - ws->buff->slen)) {
 		internal_bwswriteout(ws, ws->buff);
 		ws->buff->slen = 0;
@@ -1198,7 +1543,7 @@ bwsIsEOF(const struct bwriteStream * ws)
 	if (NULL == ws ||
 	    NULL == ws->buff ||
 	    0 > ws->minBuffSz ||
-	    NULL == ws->writeFn) {
+	    (NULL == ws->writeFn && NULL == ws->writevFn)) {
 		return BSTR_ERR;
 	}
 	return ws->isEOF;
@@ -1225,7 +1570,7 @@ bwsClose(struct bwriteStream * ws)
 	if (ws) {
 		if (NULL == ws->buff ||
 		    0 >= ws->minBuffSz ||
-		    NULL == ws->writeFn) {
+		    (NULL == ws->writeFn && NULL == ws->writevFn)) {
 			return NULL;
 		}
 		bwsWriteFlush(ws);
@@ -1233,8 +1578,1062 @@ bwsClose(struct bwriteStream * ws)
 		ws->parm = NULL;
 		ws->minBuffSz = -1;
 		ws->writeFn = NULL;
+		ws->writevFn = NULL;
 		bstrFree(ws->buff);
-		free(ws);
+		bMemFree(ws);
 	}
 	return parm;
 }
+
+#define BIOV_MAX (256)
+
+int
+bstrListIoVec(struct bstrIoVec *iov, int n, const struct bstrList *sl,
+	      const void *blk, int len)
+{
+	int i, c, k;
+	if (sl == NULL || sl->qty < 0 || n < 0 || len < 0 ||
+	    (n > 0 && iov == NULL) || (len > 0 && blk == NULL)) {
+		return BSTR_ERR;
+	}
+	if (sl->qty > 0 && sl->entry == NULL) {
+		return BSTR_ERR;
+	}
+	for (i = 0, c = 0; i < sl->qty; i++) {
+		bstring b = sl->entry[i];
+		if (b == NULL || b->slen < 0 ||
+		    (b->slen > 0 && b->data == NULL)) {
+			return BSTR_ERR;
+		}
+		/* The count of entries needed must not overflow */
+		k = (i > 0 && len > 0) ? 2 : 1;
+		if (c > INT_MAX - k) {
+			return BSTR_ERR;
+		}
+		if (k > 1) {
+			if (c < n) {
+				iov[c].base = blk;
+				iov[c].len = (size_t)len;
+			}
+			c++;
+		}
+		if (c < n) {
+			iov[c].base = b->data;
+			iov[c].len = (size_t)b->slen;
+		}
+		c++;
+	}
+	return c;
+}
+
+struct bwriteStream *
+bwsOpenv(bNwritev writevFn, void *parm)
+{
+	struct bwriteStream *ws;
+	if (NULL == writevFn) {
+		return NULL;
+	}
+	ws = (struct bwriteStream *)bMemAlloc(sizeof(struct bwriteStream));
+	if (ws) {
+		if (NULL == (ws->buff = bfromcstr(""))) {
+			bMemFree(ws);
+			ws = NULL;
+		} else {
+			ws->parm = parm;
+			ws->writeFn = NULL;
+			ws->writevFn = writevFn;
+			ws->isEOF = 0;
+			ws->minBuffSz = BWS_BUFF_SZ;
+		}
+	}
+	return ws;
+}
+
+/* Copy b into the buffer directly if it fits, which it usually will */
+static int
+bwsPut(struct bwriteStream *ws, const bstring b)
+{
+	if (ws->minBuffSz - ws->buff->slen > b->slen &&
+	    ws->buff->mlen >= ws->minBuffSz) {
+		memcpy(ws->buff->data + ws->buff->slen, b->data, b->slen);
+		ws->buff->slen += b->slen;
+		ws->buff->data[ws->buff->slen] = '\0';
+		return 0;
+	}
+	return bwsWriteBstr(ws, b);
+}
+
+/* Entries shorter than this on average are cheaper to copy than to send */
+#define BWS_VEC_MIN (256)
+
+int
+bwsWriteListBlk(struct bwriteStream *ws, const struct bstrList *sl,
+		const void *blk, int len)
+{
+	struct bstrIoVec v[BIOV_MAX];
+	struct tagbstring t;
+	size_t total;
+	int i, n, k = 0;
+	if (NULL == ws ||
+	    NULL == ws->buff ||
+	    ws->isEOF ||
+	    0 >= ws->minBuffSz ||
+	    (NULL == ws->writeFn && NULL == ws->writevFn)) {
+		return BSTR_ERR;
+	}
+	if (0 > (n = bstrListIoVec(NULL, 0, sl, blk, len))) {
+		return BSTR_ERR;
+	}
+	for (i = 0, total = (size_t)(n - sl->qty) * len; i < sl->qty; i++) {
+		total += (size_t)sl->entry[i]->slen;
+	}
+	if (NULL == ws->writevFn ||
+	    ws->buff->slen + total < (size_t)ws->minBuffSz ||
+	    total < (size_t)n * BWS_VEC_MIN) {
+		if (0 > balloc(ws->buff, ws->minBuffSz)) {
+			return BSTR_ERR;
+		}
+		blk2tbstr(t, blk, len);
+		for (i = 0; i < sl->qty; i++) {
+			if (i > 0 && len > 0 && 0 > bwsPut(ws, &t)) {
+				return BSTR_ERR;
+			}
+			if (0 > bwsPut(ws, sl->entry[i])) {
+				return BSTR_ERR;
+			}
+		}
+		return 0;
+	}
+	/* Send the buffer and the pieces of the list without joining them */
+	if (ws->buff->slen > 0) {
+		v[0].base = ws->buff->data;
+		v[0].len = (size_t)ws->buff->slen;
+		k = 1;
+	}
+	for (i = 0; i < sl->qty; i++) {
+		if (i > 0 && len > 0) {
+			v[k].base = blk;
+			v[k++].len = (size_t)len;
+		}
+		if (sl->entry[i]->slen > 0) {
+			v[k].base = sl->entry[i]->data;
+			v[k++].len = (size_t)sl->entry[i]->slen;
+		}
+		if (k > BIOV_MAX - 2 || (i == sl->qty - 1 && k > 0)) {
+			if (0 > bwsOut(ws, v, k)) {
+				return BSTR_ERR;
+			}
+			ws->buff->slen = 0;
+			k = 0;
+		}
+	}
+	return 0;
+}
+
+int
+bwsWriteList(struct bwriteStream *ws, const struct bstrList *sl,
+	     const bstring sep)
+{
+	if (sep == NULL) {
+		return bwsWriteListBlk(ws, sl, NULL, 0);
+	}
+	if (sep->slen < 0 || (sep->slen > 0 && sep->data == NULL)) {
+		return BSTR_ERR;
+	}
+	return bwsWriteListBlk(ws, sl, sep->data, sep->slen);
+}
+
+#define BSB_COPY_SZ (1024)
+
+struct bStrBuilder {
+	struct bArena *arena; /* Holds the copied pieces */
+	struct bstrIoVec *piece;
+	int qty;
+	int mlen;
+	int length;
+	unsigned char *cur; /* Free space for small copies */
+	int curLeft;
+};
+
+struct bStrBuilder *
+bsbCreate(void)
+{
+	struct bStrBuilder *sb;
+	sb = (struct bStrBuilder *)bMemAlloc(sizeof(struct bStrBuilder));
+	if (sb) {
+		if (NULL == (sb->arena = bArenaCreate(0))) {
+			bMemFree(sb);
+			return NULL;
+		}
+		sb->piece = NULL;
+		sb->qty = sb->mlen = sb->length = 0;
+		sb->cur = NULL;
+		sb->curLeft = 0;
+	}
+	return sb;
+}
+
+int
+bsbDestroy(struct bStrBuilder *sb)
+{
+	if (sb == NULL) {
+		return BSTR_ERR;
+	}
+	bArenaDestroy(sb->arena);
+	if (sb->piece) {
+		bMemFree(sb->piece);
+	}
+	bMemFree(sb);
+	return BSTR_OK;
+}
+
+int
+bsbReset(struct bStrBuilder *sb)
+{
+	if (sb == NULL) {
+		return BSTR_ERR;
+	}
+	bArenaReset(sb->arena);
+	sb->qty = sb->length = 0;
+	sb->cur = NULL;
+	sb->curLeft = 0;
+	return BSTR_OK;
+}
+
+int
+bsbLength(const struct bStrBuilder *sb)
+{
+	if (sb == NULL) {
+		return BSTR_ERR;
+	}
+	return sb->length;
+}
+
+/* Make room for n more pieces */
+static int
+bsbGrow(struct bStrBuilder *sb, int n)
+{
+	struct bstrIoVec *p;
+	int m;
+	if (n <= sb->mlen - sb->qty) {
+		return BSTR_OK;
+	}
+	if (n > INT_MAX / 2 - sb->qty) {
+		return BSTR_ERR;
+	}
+	for (m = sb->mlen ? sb->mlen : 16; m < sb->qty + n; m += m) {
+	}
+	p = (struct bstrIoVec *)bMemRealloc(sb->piece,
+					    sizeof(struct bstrIoVec) * m);
+	if (p == NULL) {
+		return BSTR_ERR;
+	}
+	sb->piece = p;
+	sb->mlen = m;
+	return BSTR_OK;
+}
+
+/* Record a piece, extending the last one if it runs on into this one */
+static void
+bsbAdd(struct bStrBuilder *sb, const unsigned char *p, int len)
+{
+	struct bstrIoVec *last;
+	if (len <= 0) {
+		return;
+	}
+	last = sb->qty ? &sb->piece[sb->qty - 1] : NULL;
+	if (last && (const unsigned char *)last->base + last->len == p) {
+		last->len += (size_t)len;
+	} else {
+		sb->piece[sb->qty].base = p;
+		sb->piece[sb->qty].len = (size_t)len;
+		sb->qty++;
+	}
+	sb->length += len;
+}
+
+/* Find len bytes of builder memory for a copy, small copies being packed
+ * one after another so that their pieces merge.
+ */
+static unsigned char *
+bsbSpace(struct bStrBuilder *sb, int len)
+{
+	unsigned char *p;
+	if (len > sb->curLeft) {
+		if (len > BSB_COPY_SZ / 4) {
+			return (unsigned char *)bArenaAlloc(sb->arena, len);
+		}
+		p = (unsigned char *)bArenaAlloc(sb->arena, BSB_COPY_SZ);
+		if (p == NULL) {
+			return NULL;
+		}
+		sb->cur = p;
+		sb->curLeft = BSB_COPY_SZ;
+	}
+	p = sb->cur;
+	sb->cur += len;
+	sb->curLeft -= len;
+	return p;
+}
+
+int
+bsbAppendRefBlk(struct bStrBuilder *sb, const void *blk, int len)
+{
+	if (sb == NULL || blk == NULL || len < 0 ||
+	    len > INT_MAX - sb->length) {
+		return BSTR_ERR;
+	}
+	if (bsbGrow(sb, 1) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	bsbAdd(sb, (const unsigned char *)blk, len);
+	return BSTR_OK;
+}
+
+int
+bsbAppendRef(struct bStrBuilder *sb, const bstring b)
+{
+	if (b == NULL || b->data == NULL || b->slen < 0) {
+		return BSTR_ERR;
+	}
+	return bsbAppendRefBlk(sb, b->data, b->slen);
+}
+
+int
+bsbAppendBlk(struct bStrBuilder *sb, const void *blk, int len)
+{
+	unsigned char *p;
+	if (sb == NULL || blk == NULL || len < 0 ||
+	    len > INT_MAX - sb->length) {
+		return BSTR_ERR;
+	}
+	if (len == 0) {
+		return BSTR_OK;
+	}
+	if (bsbGrow(sb, 1) != BSTR_OK || NULL == (p = bsbSpace(sb, len))) {
+		return BSTR_ERR;
+	}
+	memcpy(p, blk, (size_t)len);
+	bsbAdd(sb, p, len);
+	return BSTR_OK;
+}
+
+int
+bsbAppend(struct bStrBuilder *sb, const bstring b)
+{
+	if (b == NULL || b->data == NULL || b->slen < 0) {
+		return BSTR_ERR;
+	}
+	return bsbAppendBlk(sb, b->data, b->slen);
+}
+
+int
+bsbAppendCstr(struct bStrBuilder *sb, const char *s)
+{
+	size_t len;
+	if (s == NULL) {
+		return BSTR_ERR;
+	}
+	len = strlen(s);
+	if (len > INT_MAX) {
+		return BSTR_ERR;
+	}
+	return bsbAppendBlk(sb, s, (int)len);
+}
+
+int
+bsbAppendChar(struct bStrBuilder *sb, char c)
+{
+	return bsbAppendBlk(sb, &c, 1);
+}
+
+int
+bsbFormat(struct bStrBuilder *sb, const char *fmt, ...)
+{
+	va_list arglist;
+	unsigned char *p;
+	int n;
+	if (sb == NULL || fmt == NULL || bsbGrow(sb, 1) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	/* Try the free space left for copies first */
+	va_start(arglist, fmt);
+	n = vsnprintf((char *)sb->cur, (size_t)sb->curLeft, fmt, arglist);
+	va_end(arglist);
+	if (n < 0 || n > INT_MAX - sb->length) {
+		return BSTR_ERR;
+	}
+	if (n < sb->curLeft) {
+		p = bsbSpace(sb, n);
+	} else {
+		if (n == INT_MAX || NULL == (p = bsbSpace(sb, n + 1))) {
+			return BSTR_ERR;
+		}
+		va_start(arglist, fmt);
+		n = vsnprintf((char *)p, (size_t)n + 1, fmt, arglist);
+		va_end(arglist);
+		if (n < 0) {
+			return BSTR_ERR;
+		}
+	}
+	bsbAdd(sb, p, n);
+	return BSTR_OK;
+}
+
+int
+bsbJoinBlk(struct bStrBuilder *sb, const struct bstrList *bl,
+	   const void *blk, int len)
+{
+	unsigned char *sep = NULL;
+	int i, total;
+	if (sb == NULL || bl == NULL || bl->qty < 0 || len < 0 ||
+	    (len > 0 && blk == NULL)) {
+		return BSTR_ERR;
+	}
+	for (i = 0, total = 0; i < bl->qty; i++) {
+		if (bl->entry[i] == NULL || bl->entry[i]->slen < 0 ||
+		    bl->entry[i]->data == NULL ||
+		    bl->entry[i]->slen > INT_MAX - sb->length - total) {
+			return BSTR_ERR;
+		}
+		total += bl->entry[i]->slen;
+		if (i > 0) {
+			if (len > INT_MAX - sb->length - total) {
+				return BSTR_ERR;
+			}
+			total += len;
+		}
+	}
+	if (bl->qty > INT_MAX / 2 || bsbGrow(sb, 2 * bl->qty) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	if (len > 0 && bl->qty > 1) {
+		if (NULL == (sep = (unsigned char *)bArenaAlloc(sb->arena,
+								len))) {
+			return BSTR_ERR;
+		}
+		memcpy(sep, blk, (size_t)len);
+	}
+	for (i = 0; i < bl->qty; i++) {
+		if (i > 0 && sep) {
+			bsbAdd(sb, sep, len);
+		}
+		bsbAdd(sb, bl->entry[i]->data, bl->entry[i]->slen);
+	}
+	return BSTR_OK;
+}
+
+int
+bsbJoin(struct bStrBuilder *sb, const struct bstrList *bl,
+	const bstring sep)
+{
+	if (sep == NULL) {
+		return bsbJoinBlk(sb, bl, NULL, 0);
+	}
+	if (sep->slen < 0 || (sep->slen > 0 && sep->data == NULL)) {
+		return BSTR_ERR;
+	}
+	return bsbJoinBlk(sb, bl, sep->data, sep->slen);
+}
+
+static void
+bsbCopyOut(const struct bStrBuilder *sb, unsigned char *out)
+{
+	int i;
+	for (i = 0; i < sb->qty; i++) {
+		memcpy(out, sb->piece[i].base, sb->piece[i].len);
+		out += sb->piece[i].len;
+	}
+}
+
+bstring
+bsbFlatten(const struct bStrBuilder *sb)
+{
+	bstring b;
+	if (sb == NULL) {
+		return NULL;
+	}
+	b = bfromcstralloc(sb->length + 1, "");
+	if (b) {
+		bsbCopyOut(sb, b->data);
+		b->slen = sb->length;
+		b->data[b->slen] = (unsigned char)'\0';
+	}
+	return b;
+}
+
+int
+bsbFlattenTo(const struct bStrBuilder *sb, bstring b)
+{
+	const unsigned char *p;
+	bstring t;
+	int i, ret;
+	if (sb == NULL || b == NULL || b->data == NULL || b->slen < 0 ||
+	    b->mlen <= 0 || b->mlen < b->slen ||
+	    sb->length > INT_MAX - 1 - b->slen) {
+		return BSTR_ERR;
+	}
+	/* Growing b would move any pieces which refer to it */
+	for (i = 0; i < sb->qty; i++) {
+		p = (const unsigned char *)sb->piece[i].base;
+		if (p >= b->data && p < b->data + b->mlen) {
+			if (NULL == (t = bsbFlatten(sb))) {
+				return BSTR_ERR;
+			}
+			ret = bconcat(b, t);
+			bdestroy(t);
+			return ret;
+		}
+	}
+	if (balloc(b, b->slen + sb->length + 1) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	bsbCopyOut(sb, b->data + b->slen);
+	b->slen += sb->length;
+	b->data[b->slen] = (unsigned char)'\0';
+	return BSTR_OK;
+}
+
+int
+bsbWritev(const struct bStrBuilder *sb, bNwritev writevFn, void *parm)
+{
+	int i, n, w;
+	size_t want;
+	if (sb == NULL || writevFn == NULL) {
+		return BSTR_ERR;
+	}
+	for (i = 0; i < sb->qty; i += n) {
+		n = sb->qty - i < BIOV_MAX ? sb->qty - i : BIOV_MAX;
+		for (w = 0, want = 0; w < n; w++) {
+			want += sb->piece[i + w].len;
+		}
+		w = writevFn(sb->piece + i, n, parm);
+		if (w < 0 || (size_t)w != want) {
+			return BSTR_ERR;
+		}
+	}
+	return BSTR_OK;
+}
+
+struct bNeedleSet {
+	int qty; /* Number of needles */
+	int nclass; /* Number of input character classes */
+	int cls[UCHAR_MAX + 1]; /* Character to class map */
+	int *delta; /* Transition table, nclass entries per state */
+	int *depth; /* Length of the prefix each state represents */
+	int *out; /* Lowest numbered needle ending at each state, or -1 */
+	int *same; /* Next needle equal to each needle, or -1 */
+	int *dict; /* Next state on the fail chain with a needle, or -1 */
+};
+
+#define bnsnext(ns, s, c) \
+	((ns)->delta[(s) * (ns)->nclass + (ns)->cls[(c)]])
+
+static struct bNeedleSet *
+bnscompile(const struct bstrList *needles, int caseless)
+{
+	struct bNeedleSet *ns;
+	unsigned char fold[UCHAR_MAX + 1];
+	int i, j, c, s, v, n, head, tail, nstates;
+	int *fail = NULL, *queue = NULL;
+	size_t total = 1;
+	if (needles == NULL || needles->qty <= 0 || needles->entry == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < needles->qty; i++) {
+		bstring b = needles->entry[i];
+		if (b == NULL || b->data == NULL || b->slen <= 0) {
+			return NULL;
+		}
+		total += (size_t)b->slen;
+		if (total >= INT_MAX) {
+			return NULL;
+		}
+	}
+	ns = (struct bNeedleSet *)bMemAlloc(sizeof(struct bNeedleSet));
+	if (ns == NULL) {
+		return NULL;
+	}
+	memset(ns, 0, sizeof(struct bNeedleSet));
+	ns->qty = needles->qty;
+	/* Characters which do not occur in any needle share class 0, so the
+	 * transition table only needs a column per distinct needle character.
+	 */
+	for (i = 0; i <= UCHAR_MAX; i++) {
+		fold[i] = (unsigned char)(caseless ? bDowncase(i) : i);
+		ns->cls[i] = 0;
+	}
+	for (i = 0; i < needles->qty; i++) {
+		bstring b = needles->entry[i];
+		for (j = 0; j < b->slen; j++) {
+			ns->cls[fold[b->data[j]]] = 1;
+		}
+	}
+	ns->nclass = 1;
+	for (i = 0; i <= UCHAR_MAX; i++) {
+		if (ns->cls[i]) {
+			ns->cls[i] = ns->nclass++;
+		}
+	}
+	for (i = 0; i <= UCHAR_MAX; i++) {
+		ns->cls[i] = ns->cls[fold[i]];
+	}
+	n = (int)total;
+	if ((size_t)n > ((size_t)INT_MAX / sizeof(int)) / (size_t)ns->nclass) {
+		goto fail;
+	}
+	ns->delta = (int *)bMemAlloc((size_t)n * ns->nclass * sizeof(int));
+	ns->depth = (int *)bMemAlloc((size_t)n * sizeof(int));
+	ns->out = (int *)bMemAlloc((size_t)n * sizeof(int));
+	ns->dict = (int *)bMemAlloc((size_t)n * sizeof(int));
+	ns->same = (int *)bMemAlloc((size_t)ns->qty * sizeof(int));
+	fail = (int *)bMemAlloc((size_t)n * sizeof(int));
+	queue = (int *)bMemAlloc((size_t)n * sizeof(int));
+	if (!ns->delta || !ns->depth || !ns->out || !ns->dict ||
+	    !ns->same || !fail || !queue) {
+		goto fail;
+	}
+	memset(ns->delta, 0, (size_t)n * ns->nclass * sizeof(int));
+	/* Build the trie; a zero transition means there is no child yet,
+	 * since no edge of a trie leads back to the root.
+	 */
+	nstates = 1;
+	ns->depth[0] = 0;
+	ns->out[0] = -1;
+	for (i = 0; i < needles->qty; i++) {
+		bstring b = needles->entry[i];
+		s = 0;
+		for (j = 0; j < b->slen; j++) {
+			int *t = &bnsnext(ns, s, b->data[j]);
+			if (*t == 0) {
+				*t = nstates;
+				ns->depth[nstates] = j + 1;
+				ns->out[nstates] = -1;
+				nstates++;
+			}
+			s = *t;
+		}
+		/* Needles which are equal, or equal up to case, end at the
+		 * same state and are chained in index order.
+		 */
+		ns->same[i] = -1;
+		if (ns->out[s] < 0) {
+			ns->out[s] = i;
+		} else {
+			v = ns->out[s];
+			while (ns->same[v] >= 0) {
+				v = ns->same[v];
+			}
+			ns->same[v] = i;
+		}
+	}
+	/* Breadth first pass computing the failure links, the dictionary
+	 * links and completing the transition table into a DFA.
+	 */
+	head = tail = 0;
+	fail[0] = 0;
+	ns->dict[0] = -1;
+	for (c = 0; c < ns->nclass; c++) {
+		v = ns->delta[c];
+		if (v) {
+			fail[v] = 0;
+			ns->dict[v] = -1;
+			queue[tail++] = v;
+		}
+	}
+	while (head < tail) {
+		s = queue[head++];
+		for (c = 0; c < ns->nclass; c++) {
+			int *t = &ns->delta[s * ns->nclass + c];
+			int f = ns->delta[fail[s] * ns->nclass + c];
+			if (*t) {
+				v = *t;
+				fail[v] = f;
+				ns->dict[v] = (ns->out[f] >= 0) ? f : ns->dict[f];
+				queue[tail++] = v;
+			} else {
+				*t = f;
+			}
+		}
+	}
+	bMemFree(fail);
+	bMemFree(queue);
+	return ns;
+fail:
+	bMemFree(fail);
+	bMemFree(queue);
+	bNeedleSetDestroy(ns);
+	return NULL;
+}
+
+struct bNeedleSet *
+bNeedleSetCreate(const struct bstrList *needles)
+{
+	return bnscompile(needles, 0);
+}
+
+struct bNeedleSet *
+bNeedleSetCreateCaseless(const struct bstrList *needles)
+{
+	return bnscompile(needles, 1);
+}
+
+int
+bNeedleSetDestroy(struct bNeedleSet *ns)
+{
+	if (ns == NULL) {
+		return BSTR_ERR;
+	}
+	bMemFree(ns->delta);
+	bMemFree(ns->depth);
+	bMemFree(ns->out);
+	bMemFree(ns->dict);
+	bMemFree(ns->same);
+	bMemFree(ns);
+	return BSTR_OK;
+}
+
+/*
+ * Find the leftmost match at or after pos, preferring the longest needle
+ * among those which start at the same position. The scan stops as soon as
+ * the automaton state shows that no match can start at or before the best
+ * one found so far.
+ */
+static int
+bnsleftmost(const struct bNeedleSet *ns, const unsigned char *d, int pos,
+	    int len, int *which, int *mlen)
+{
+	int i, s = 0, t, st, best = -1, bestLen = 0;
+	for (i = pos; i < len; i++) {
+		s = bnsnext(ns, s, d[i]);
+		t = (ns->out[s] >= 0) ? s : ns->dict[s];
+		if (t >= 0) {
+			st = i + 1 - ns->depth[t];
+			if (best < 0 || st < best ||
+			    (st == best && ns->depth[t] > bestLen)) {
+				best = st;
+				bestLen = ns->depth[t];
+				*which = ns->out[t];
+			}
+		}
+		if (best >= 0 && i + 1 - ns->depth[s] > best) {
+			break;
+		}
+	}
+	*mlen = bestLen;
+	return best;
+}
+
+int
+binstrNeedleSet(const bstring b, int pos, const struct bNeedleSet *ns,
+		int *which)
+{
+	int w = -1, l, ret;
+	if (b == NULL || b->data == NULL || b->slen < 0 || ns == NULL ||
+	    pos < 0 || pos > b->slen) {
+		return BSTR_ERR;
+	}
+	ret = bnsleftmost(ns, b->data, pos, b->slen, &w, &l);
+	if (ret < 0) {
+		return BSTR_ERR;
+	}
+	if (which) {
+		*which = w;
+	}
+	return ret;
+}
+
+int
+bNeedleSetFindAll(const bstring b, int pos, const struct bNeedleSet *ns,
+		  int (*cb)(void *parm, int ofs, int len, int which),
+		  void *parm)
+{
+	int i, k, s = 0, t, ret;
+	if (b == NULL || b->data == NULL || b->slen < 0 || ns == NULL ||
+	    cb == NULL || pos < 0 || pos > b->slen) {
+		return BSTR_ERR;
+	}
+	for (i = pos; i < b->slen; i++) {
+		s = bnsnext(ns, s, b->data[i]);
+		t = (ns->out[s] >= 0) ? s : ns->dict[s];
+		for (; t >= 0; t = ns->dict[t]) {
+			for (k = ns->out[t]; k >= 0; k = ns->same[k]) {
+				ret = cb(parm, i + 1 - ns->depth[t],
+					 ns->depth[t], k);
+				if (ret < 0) {
+					return ret;
+				}
+			}
+		}
+	}
+	return BSTR_OK;
+}
+
+int
+bNeedleSetReplace(bstring out, const bstring b, int pos,
+		  const struct bNeedleSet *ns, const struct bstrList *repl)
+{
+	int i, m, l, w = -1;
+	if (out == NULL || out->data == NULL || out->slen < 0 ||
+	    out->mlen <= 0 || out->mlen < out->slen ||
+	    b == NULL || b->data == NULL || b->slen < 0 ||
+	    out == b || out->data == b->data ||
+	    ns == NULL || pos < 0 || pos > b->slen ||
+	    repl == NULL || repl->entry == NULL || repl->qty < ns->qty) {
+		return BSTR_ERR;
+	}
+	for (i = 0; i < ns->qty; i++) {
+		if (repl->entry[i] == NULL || repl->entry[i]->data == NULL ||
+		    repl->entry[i]->slen < 0) {
+			return BSTR_ERR;
+		}
+	}
+	if (BSTR_OK != balloc(out, out->slen + b->slen + 1)) {
+		return BSTR_ERR;
+	}
+	if (BSTR_OK != bcatblk(out, b->data, pos)) {
+		return BSTR_ERR;
+	}
+	while ((m = bnsleftmost(ns, b->data, pos, b->slen, &w, &l)) >= 0) {
+		if (BSTR_OK != bcatblk(out, b->data + pos, m - pos) ||
+		    BSTR_OK != bconcat(out, repl->entry[w])) {
+			return BSTR_ERR;
+		}
+		pos = m + l;
+	}
+	return bcatblk(out, b->data + pos, b->slen - pos);
+}
+
+#define BARENA_CHUNK_SZ (4096)
+
+/* Every allocation from an arena is rounded up to a multiple of this, so
+ * that the bstring headers carved out of it are suitably aligned.
+ */
+union bArenaAlign {
+	void *p;
+	double d;
+	long l;
+};
+
+#define BARENA_ALIGN (sizeof(union bArenaAlign))
+
+struct bArenaChunk {
+	struct bArenaChunk *next;
+	size_t size; /* Usable bytes following the chunk header */
+	size_t used;
+	union bArenaAlign mem[]; /* The usable bytes */
+};
+
+struct bArena {
+	struct bArenaChunk *head;
+	struct bArenaChunk *cur; /* Chunk currently being allocated from */
+	size_t chunkSz;
+};
+
+struct bArena *
+bArenaCreate(int chunkSz)
+{
+	struct bArena *a;
+	if (chunkSz < 0) {
+		return NULL;
+	}
+	a = (struct bArena *)bMemAlloc(sizeof(struct bArena));
+	if (a) {
+		a->head = a->cur = NULL;
+		a->chunkSz = chunkSz ? (size_t)chunkSz : BARENA_CHUNK_SZ;
+	}
+	return a;
+}
+
+void *
+bArenaAlloc(struct bArena *a, int len)
+{
+	struct bArenaChunk *c;
+	size_t sz;
+	if (a == NULL || len < 0) {
+		return NULL;
+	}
+	sz = ((size_t)len + BARENA_ALIGN - 1) & ~(BARENA_ALIGN - 1);
+	if (sz == 0) {
+		sz = BARENA_ALIGN;
+	}
+	c = a->cur;
+	if (c == NULL || c->size - c->used < sz) {
+		/* Move on to a chunk kept from before the last reset if it is
+		 * big enough, otherwise chain a new one in after the current
+		 * chunk.
+		 */
+		if (c && c->next && c->next->size >= sz) {
+			c = c->next;
+		} else if (!c && a->head && a->head->size >= sz) {
+			c = a->head;
+		} else {
+			struct bArenaChunk *n;
+			size_t csz = (sz > a->chunkSz) ? sz : a->chunkSz;
+			n = (struct bArenaChunk *)bMemAlloc(
+				sizeof(struct bArenaChunk) + csz);
+			if (n == NULL) {
+				return NULL;
+			}
+			n->size = csz;
+			n->used = 0;
+			if (c) {
+				n->next = c->next;
+				c->next = n;
+			} else {
+				n->next = a->head;
+				a->head = n;
+			}
+			c = n;
+		}
+		c->used = 0;
+		a->cur = c;
+	}
+	c->used += sz;
+	return (char *)c->mem + (c->used - sz);
+}
+
+int
+bArenaReset(struct bArena *a)
+{
+	if (a == NULL) {
+		return BSTR_ERR;
+	}
+	a->cur = NULL;
+	return BSTR_OK;
+}
+
+int
+bArenaDestroy(struct bArena *a)
+{
+	struct bArenaChunk *c, *n;
+	if (a == NULL) {
+		return BSTR_ERR;
+	}
+	for (c = a->head; c; c = n) {
+		n = c->next;
+		bMemFree(c);
+	}
+	bMemFree(a);
+	return BSTR_OK;
+}
+
+bstring
+bArenaBlk2bstr(struct bArena *a, const void *blk, int len)
+{
+	bstring b;
+	if (blk == NULL || len < 0 || len > INT_MAX - 1 -
+	    (int)sizeof(struct tagbstring)) {
+		return NULL;
+	}
+	b = (bstring)bArenaAlloc(a, (int)sizeof(struct tagbstring) + len + 1);
+	if (b == NULL) {
+		return NULL;
+	}
+	b->data = (unsigned char *)(b + 1);
+	if (len > 0) {
+		memcpy(b->data, blk, len);
+	}
+	b->data[len] = (unsigned char)'\0';
+	b->slen = len;
+	/* Permanently write protected, as the memory cannot be grown */
+	b->mlen = -__LINE__;
+	return b;
+}
+
+bstring
+bArenaFromCstr(struct bArena *a, const char *str)
+{
+	size_t j;
+	if (str == NULL) {
+		return NULL;
+	}
+	j = strlen(str);
+	if (j > INT_MAX) {
+		return NULL;
+	}
+	return bArenaBlk2bstr(a, str, (int)j);
+}
+
+bstring
+bArenaStrcpy(struct bArena *a, const bstring b)
+{
+	if (b == NULL || b->data == NULL || b->slen < 0) {
+		return NULL;
+	}
+	return bArenaBlk2bstr(a, b->data, b->slen);
+}
+
+bstring
+bArenaMidstr(struct bArena *a, const bstring b, int left, int len)
+{
+	if (b == NULL || b->slen < 0 || b->data == NULL) {
+		return NULL;
+	}
+	if (left < 0) {
+		len += left;
+		left = 0;
+	}
+	if (len > b->slen - left) {
+		len = b->slen - left;
+	}
+	if (len <= 0) {
+		return bArenaBlk2bstr(a, "", 0);
+	}
+	return bArenaBlk2bstr(a, b->data + left, len);
+}
+
+struct bArenaSplitCtx {
+	struct bArena *a;
+	bstring str;
+	struct bstrList *bl;
+};
+
+static int
+bArenaSplitCount(void *parm, BSTR_UNUSED int ofs, BSTR_UNUSED int len)
+{
+	(*(int *)parm)++;
+	return 0;
+}
+
+static int
+bArenaSplitEntry(void *parm, int ofs, int len)
+{
+	struct bArenaSplitCtx *ctx = (struct bArenaSplitCtx *)parm;
+	bstring b = bArenaBlk2bstr(ctx->a, ctx->str->data + ofs, len);
+	if (b == NULL) {
+		return BSTR_ERR;
+	}
+	ctx->bl->entry[ctx->bl->qty++] = b;
+	return 0;
+}
+
+struct bstrList *
+bArenaSplit(struct bArena *a, const bstring str, unsigned char splitChar)
+{
+	struct bArenaSplitCtx ctx = { NULL, NULL, NULL };
+	int n = 0;
+	if (a == NULL || str == NULL || str->data == NULL || str->slen < 0) {
+		return NULL;
+	}
+	(void)bsplitcb(str, splitChar, 0, bArenaSplitCount, &n);
+	ctx.bl = (struct bstrList *)bArenaAlloc(a, sizeof(struct bstrList));
+	if (ctx.bl == NULL) {
+		return NULL;
+	}
+	if ((size_t)n > INT_MAX / sizeof(bstring)) {
+		return NULL;
+	}
+	ctx.bl->entry = (bstring *)bArenaAlloc(a, n * (int)sizeof(bstring));
+	if (ctx.bl->entry == NULL) {
+		return NULL;
+	}
+	ctx.bl->qty = 0;
+	ctx.bl->mlen = n;
+	ctx.a = a;
+	ctx.str = str;
+	if (bsplitcb(str, splitChar, 0, bArenaSplitEntry, &ctx) < 0) {
+		return NULL;
+	}
+	return ctx.bl;
+}
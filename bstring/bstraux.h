@@ -271,6 +271,134 @@ bBase64Encode(const bstring b);
 BSTR_PUBLIC bstring
 bBase64DecodeEx(const bstring b, int *boolTruncError);
 
+/**
+ * Flag for the base64 functions below: use the URL and filename safe
+ * alphabet of RFC 4648, with '-' and '_' in place of '+' and '/'.
+ */
+#define BSTR_B64_URL 1
+
+/**
+ * Flag for the base64 encoding functions: do not break the output into
+ * lines. Otherwise CRLF is written after the encoding of every 57 bytes of
+ * input, that is after every 76 characters, as bBase64Encode does.
+ */
+#define BSTR_B64_NOWRAP 2
+
+/**
+ * Flag for the base64 encoding functions: leave out the '=' characters
+ * which pad the output to a multiple of 4 characters.
+ */
+#define BSTR_B64_NOPAD 4
+
+/**
+ * Return the exact number of characters bBase64EncodeBlk produces for len
+ * bytes with the given flags, or BSTR_ERR if len is negative or the result
+ * does not fit an int.
+ */
+BSTR_PUBLIC int
+bBase64EncodeLen(int len, int flags);
+
+/**
+ * Append the base64 encoding of the len bytes at blk to out.
+ *
+ * The output is sized exactly with bBase64EncodeLen, so out is grown at
+ * most once, and whole blocks are encoded with vector instructions where
+ * the processor has them. The flags are any of BSTR_B64_URL,
+ * BSTR_B64_NOWRAP and BSTR_B64_NOPAD; with none of them the output is that
+ * of bBase64Encode. The data at blk may lie within out.
+ *
+ * Returns BSTR_ERR if out is NULL, invalid or write protected, if len is
+ * negative, if blk is NULL and len is not 0, or if memory cannot be
+ * allocated, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bBase64EncodeBlk(bstring out, const void *blk, int len, int flags);
+
+/**
+ * Append the bytes encoded as base64 by the len characters at blk to out.
+ *
+ * Unlike bBase64DecodeEx this is strict: spaces, tabs, CR and LF are
+ * skipped, but any other character outside the alphabet chosen by the
+ * BSTR_B64_URL flag, a group of a single character, or data after the
+ * padding is an error. Padding is optional, but when present it must be
+ * complete. The data at blk may lie within out.
+ *
+ * Returns BSTR_ERR, leaving out unchanged, if the input is not valid
+ * base64, if out is NULL, invalid or write protected, if len is negative,
+ * if blk is NULL and len is not 0, or if memory cannot be allocated,
+ * otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bBase64DecodeBlk(bstring out, const void *blk, int len, int flags);
+
+/**
+ * The state of a base64 encoding or decoding carried out in pieces.
+ *
+ * Initialize it with bBase64Init, pass the input to bBase64EncodeStep or
+ * bBase64DecodeStep in as many pieces as it arrives in, and finish with
+ * bBase64EncodeEnd or bBase64DecodeEnd. The output is the same as that of
+ * bBase64EncodeBlk or bBase64DecodeBlk for the whole input, however it is
+ * divided. The members are private.
+ */
+struct bBase64State {
+	int flags;
+	int col;
+	int n;
+	int pad;
+	int end;
+	unsigned int acc;
+};
+
+/**
+ * Initialize st for encoding or decoding with the given flags.
+ */
+BSTR_PUBLIC void
+bBase64Init(struct bBase64State *st, int flags);
+
+/**
+ * Append the base64 encoding of the len bytes at blk to out, holding back
+ * up to 2 bytes which do not make up a whole group for the next call.
+ *
+ * See bBase64EncodeBlk for the return value.
+ */
+BSTR_PUBLIC int
+bBase64EncodeStep(struct bBase64State *st, bstring out, const void *blk,
+		  int len);
+
+/**
+ * Append the encoding of the bytes held back in st, with any padding, to
+ * out, and initialize st again with the same flags.
+ *
+ * Returns BSTR_ERR if st or out is NULL or out is invalid or write
+ * protected, or if memory cannot be allocated, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bBase64EncodeEnd(struct bBase64State *st, bstring out);
+
+/**
+ * Append the bytes decoded from the len characters of base64 at blk to
+ * out, holding back up to 3 characters which do not make up a whole group
+ * for the next call.
+ *
+ * See bBase64DecodeBlk for the rules. On error, what earlier calls have
+ * appended is left in out, and st must be initialized again before it is
+ * used for anything else.
+ */
+BSTR_PUBLIC int
+bBase64DecodeStep(struct bBase64State *st, bstring out, const void *blk,
+		  int len);
+
+/**
+ * Append the bytes decoded from the characters held back in st to out,
+ * and initialize st again with the same flags.
+ *
+ * BSTR_ERR is returned if the input ended in the middle of a group or of
+ * its padding, or for the reasons given for bBase64EncodeEnd, otherwise
+ * BSTR_OK.
+ */
+BSTR_PUBLIC int
+bBase64DecodeEnd(struct bBase64State *st, bstring out);
+
 /**
  * Creates a bStream which performs the UUDecode of an an input stream.
  *
@@ -332,6 +460,183 @@ bYDecode(const bstring src);
 BSTR_PUBLIC int
 bSGMLEncode(bstring b);
 
+/* Multiple pattern search functions */
+
+/**
+ * Compile the list of needles into an automaton which finds occurrences of
+ * all of them in a single pass over the searched string.
+ *
+ * The needles are referred to by their index in the list, and the automaton
+ * keeps no reference to the list or its entries. If the list is NULL or
+ * empty, if any entry is NULL, invalid or empty, or if memory cannot be
+ * allocated, NULL is returned.
+ */
+BSTR_PUBLIC struct bNeedleSet *
+bNeedleSetCreate(const struct bstrList *needles);
+
+/**
+ * Compile the list of needles into an automaton which matches without
+ * regard to case, as chosen by bsetctype() when it is compiled.
+ *
+ * Otherwise this is the same as bNeedleSetCreate.
+ */
+BSTR_PUBLIC struct bNeedleSet *
+bNeedleSetCreateCaseless(const struct bstrList *needles);
+
+/**
+ * Free an automaton created by bNeedleSetCreate or
+ * bNeedleSetCreateCaseless.
+ *
+ * Returns BSTR_ERR if ns is NULL, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bNeedleSetDestroy(struct bNeedleSet *ns);
+
+/**
+ * Search b for the first occurrence of any of the needles of ns, starting
+ * at position pos.
+ *
+ * Returns the position of the leftmost match, or BSTR_ERR if there is none.
+ * When several needles match at that position the longest one is chosen,
+ * and if which is not NULL its index is stored there. If the list holds
+ * that needle more than once, the lowest of its indexes is stored.
+ */
+BSTR_PUBLIC int
+binstrNeedleSet(const bstring b, int pos, const struct bNeedleSet *ns,
+		int *which);
+
+/**
+ * Report every occurrence of every needle of ns in b, starting at position
+ * pos, including overlapping ones.
+ *
+ * For each match the callback function cb is called with the parm value,
+ * the position and length of the match, and the index of the needle.
+ * Matches are reported in order of the position at which they end, and
+ * among those which end at the same position, longest first. A needle
+ * which occurs more than once in the list, or for a caseless automaton
+ * more than once up to case, is reported once for each of its indexes, in
+ * increasing order. If cb returns with a negative value the search is
+ * aborted and that value is returned, otherwise BSTR_OK is returned once b
+ * has been searched.
+ */
+BSTR_PUBLIC int
+bNeedleSetFindAll(const bstring b, int pos, const struct bNeedleSet *ns,
+		  int (*cb)(void *parm, int ofs, int len, int which),
+		  void *parm);
+
+/**
+ * Replace the occurrences of the needles of ns in b, from position pos
+ * onward, with the corresponding entries of repl and append the result to
+ * out.
+ *
+ * The string is scanned once from left to right; at each step the leftmost
+ * remaining match is replaced, preferring the longest needle where several
+ * start at the same position, and the scan resumes after it. The part of b
+ * before pos is copied unchanged. repl must have at least as many entries
+ * as there are needles, and out must not share its data with b. Returns
+ * BSTR_OK on success and BSTR_ERR on error.
+ */
+BSTR_PUBLIC int
+bNeedleSetReplace(bstring out, const bstring b, int pos,
+		  const struct bNeedleSet *ns, const struct bstrList *repl);
+
+/* Arena allocation functions */
+
+/**
+ * Create an arena from which bstrings and other memory can be allocated by
+ * bumping a pointer, and which is released all at once.
+ *
+ * Memory is obtained from the system in chunks of chunkSz bytes, or of a
+ * default size if chunkSz is 0; larger requests get a chunk of their own.
+ * If chunkSz is negative or memory cannot be allocated, NULL is returned.
+ */
+BSTR_PUBLIC struct bArena *
+bArenaCreate(int chunkSz);
+
+/**
+ * Allocate len bytes from the arena a.
+ *
+ * The memory is suitably aligned for any bstrlib structure and remains
+ * valid until the arena is reset or destroyed. If a is NULL, len is
+ * negative or memory cannot be allocated, NULL is returned.
+ */
+BSTR_PUBLIC void *
+bArenaAlloc(struct bArena *a, int len);
+
+/**
+ * Release everything allocated from the arena a at once.
+ *
+ * The chunks obtained so far are kept and reused by subsequent
+ * allocations, so an arena which is reset after each unit of work soon
+ * stops allocating from the system altogether. Returns BSTR_ERR if a is
+ * NULL, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bArenaReset(struct bArena *a);
+
+/**
+ * Free the arena a along with all the memory allocated from it.
+ *
+ * Returns BSTR_ERR if a is NULL, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bArenaDestroy(struct bArena *a);
+
+/**
+ * Create a bstring in the arena a containing a copy of the block of len
+ * bytes at blk.
+ *
+ * The header and the data of the bstring are allocated together from the
+ * arena. Since arena memory cannot be grown or freed individually, the
+ * result is permanently write protected: it can be read and searched with
+ * any bstrlib function, but functions which would modify it, including
+ * bdestroy, return BSTR_ERR. It is released with bArenaReset or
+ * bArenaDestroy. If an error occurs NULL is returned.
+ */
+BSTR_PUBLIC bstring
+bArenaBlk2bstr(struct bArena *a, const void *blk, int len);
+
+/**
+ * Create a write protected bstring in the arena a from a '\0' terminated
+ * char buffer, in the manner of bfromcstr.
+ *
+ * See bArenaBlk2bstr. If an error occurs NULL is returned.
+ */
+BSTR_PUBLIC bstring
+bArenaFromCstr(struct bArena *a, const char *str);
+
+/**
+ * Create a write protected copy of the bstring b in the arena a, in the
+ * manner of bstrcpy.
+ *
+ * See bArenaBlk2bstr. If an error occurs NULL is returned.
+ */
+BSTR_PUBLIC bstring
+bArenaStrcpy(struct bArena *a, const bstring b);
+
+/**
+ * Create a write protected bstring in the arena a which is the substring
+ * of b starting from position left and running for a length len, in the
+ * manner of bmidstr.
+ *
+ * See bArenaBlk2bstr. If an error occurs NULL is returned.
+ */
+BSTR_PUBLIC bstring
+bArenaMidstr(struct bArena *a, const bstring b, int left, int len);
+
+/**
+ * Create a list of the substrings of str divided by the character
+ * splitChar, in the manner of bsplit, with the list and all of its entries
+ * allocated from the arena a.
+ *
+ * The entries are write protected as described for bArenaBlk2bstr. The
+ * list must not be passed to bstrListDestroy or grown with bstrListAlloc;
+ * it is released with bArenaReset or bArenaDestroy. If an error occurs
+ * NULL is returned.
+ */
+BSTR_PUBLIC struct bstrList *
+bArenaSplit(struct bArena *a, const bstring str, unsigned char splitChar);
+
 /* Writable stream */
 typedef int
 (*bNwrite)(const void *buf, size_t elsize, size_t nelem, void *parm);
@@ -394,6 +699,228 @@ bwsBuffLength(struct bwriteStream *stream, int sz);
 BSTR_PUBLIC void *
 bwsClose(struct bwriteStream *stream);
 
+/* Vectored output */
+
+/**
+ * A block of memory to be written as part of a vectored write.
+ *
+ * The layout matches struct iovec on POSIX systems, so an array of these
+ * may be passed to writev.
+ */
+struct bstrIoVec {
+	const void *base;
+	size_t len;
+};
+
+/**
+ * A writev work-a-like function pointer: write the iovcnt blocks of iov in
+ * order to the stream described by parm, and return the number of bytes
+ * written, or a negative value on error.
+ */
+typedef int
+(*bNwritev)(const struct bstrIoVec *iov, int iovcnt, void *parm);
+
+/**
+ * Describe the contents of a bstrList joined by a separator as an array of
+ * blocks, without joining them.
+ *
+ * The blocks are the entries of sl in order, with the len bytes of blk
+ * between each pair of entries if len is greater than zero. Up to n blocks
+ * are stored in iov, which refer to the memory of sl and blk rather than
+ * copying it. Returns the total number of blocks, which may be more than
+ * n, so that a call with n of zero finds the size of array needed, or
+ * BSTR_ERR if the parameters are invalid.
+ */
+BSTR_PUBLIC int
+bstrListIoVec(struct bstrIoVec *iov, int n, const struct bstrList *sl,
+	      const void *blk, int len);
+
+/**
+ * Wrap a given open stream (described by a writev work-a-like function
+ * pointer and stream handle) into an open bwriteStream.
+ *
+ * The stream behaves as one opened with bwsOpen, except that data which
+ * would overflow the buffer is sent to the core stream together with the
+ * buffered data in a single vectored write, rather than being copied into
+ * the buffer first. A write which does not take all of the data puts the
+ * stream at EOF.
+ */
+BSTR_PUBLIC struct bwriteStream *
+bwsOpenv(bNwritev writevFn, void *parm);
+
+/**
+ * Send the entries of a bstrList, joined by sep, to a bwriteStream.
+ *
+ * The effect is that of writing the result of bjoin, but the joined string
+ * is never built. On a stream opened with bwsOpenv a list too large for the
+ * buffer is sent straight from the memory of its entries. If sep is NULL no
+ * separator is written. If the stream is at EOF or the parameters are
+ * invalid BSTR_ERR is returned.
+ */
+BSTR_PUBLIC int
+bwsWriteList(struct bwriteStream *stream, const struct bstrList *sl,
+	     const bstring sep);
+
+/**
+ * Send the entries of a bstrList, joined by the block blk of length len, to
+ * a bwriteStream.
+ *
+ * See bwsWriteList.
+ */
+BSTR_PUBLIC int
+bwsWriteListBlk(struct bwriteStream *stream, const struct bstrList *sl,
+		const void *blk, int len);
+
+/* String builder */
+
+/**
+ * Create an empty string builder.
+ *
+ * A builder records the pieces of a string as they are appended and
+ * assembles them only once, when the string is complete, so that building
+ * a string of n pieces costs one allocation of the final size, or none if
+ * the pieces are written straight out with bsbWritev, rather than the
+ * repeated growing and copying of n calls to bconcat. Pieces may be
+ * borrowed references to memory which outlives the builder, or copies,
+ * which are packed into memory owned by the builder. NULL is returned if
+ * memory cannot be allocated.
+ */
+BSTR_PUBLIC struct bStrBuilder *
+bsbCreate(void);
+
+/**
+ * Destroy a string builder.
+ *
+ * Returns BSTR_ERR if sb is NULL, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bsbDestroy(struct bStrBuilder *sb);
+
+/**
+ * Empty a string builder, keeping the memory it has allocated for the next
+ * string.
+ *
+ * Returns BSTR_ERR if sb is NULL, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bsbReset(struct bStrBuilder *sb);
+
+/**
+ * Return the length of the string built so far, or BSTR_ERR if sb is NULL.
+ */
+BSTR_PUBLIC int
+bsbLength(const struct bStrBuilder *sb);
+
+/**
+ * Append the contents of b by reference.
+ *
+ * Nothing is copied, so the contents of b must not be changed, and b must
+ * not be destroyed, until the builder is done with: flattened, written out,
+ * reset or destroyed. Returns BSTR_ERR if sb or b is NULL, b is invalid,
+ * the string would become too long or memory cannot be allocated,
+ * otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bsbAppendRef(struct bStrBuilder *sb, const bstring b);
+
+/**
+ * Append the len bytes at blk by reference, as for bsbAppendRef.
+ */
+BSTR_PUBLIC int
+bsbAppendRefBlk(struct bStrBuilder *sb, const void *blk, int len);
+
+/**
+ * Append a copy of the contents of b.
+ *
+ * Returns BSTR_ERR if sb or b is NULL, b is invalid, the string would
+ * become too long or memory cannot be allocated, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bsbAppend(struct bStrBuilder *sb, const bstring b);
+
+/**
+ * Append a copy of the len bytes at blk, as for bsbAppend.
+ */
+BSTR_PUBLIC int
+bsbAppendBlk(struct bStrBuilder *sb, const void *blk, int len);
+
+/**
+ * Append a copy of a '\0' terminated char buffer, as for bsbAppend.
+ */
+BSTR_PUBLIC int
+bsbAppendCstr(struct bStrBuilder *sb, const char *s);
+
+/**
+ * Append the character c, as for bsbAppend.
+ */
+BSTR_PUBLIC int
+bsbAppendChar(struct bStrBuilder *sb, char c);
+
+/**
+ * Append text formatted in the manner of bformata.
+ *
+ * The text is formatted straight into memory owned by the builder. Returns
+ * BSTR_ERR if sb or fmt is NULL, the formatting fails, the string would
+ * become too long or memory cannot be allocated, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bsbFormat(struct bStrBuilder *sb, const char *fmt, ...);
+
+/**
+ * Append the entries of bl separated by the len bytes at blk, in the
+ * manner of bjoinblk.
+ *
+ * The entries are appended by reference, as for bsbAppendRef, so neither
+ * the list nor its entries may be changed until the builder is done with.
+ * The separators are copied once. Returns BSTR_ERR if sb or bl is NULL,
+ * len is negative, blk is NULL while len is positive, an entry is invalid,
+ * the string would become too long or memory cannot be allocated, in which
+ * case nothing is appended. Otherwise BSTR_OK is returned.
+ */
+BSTR_PUBLIC int
+bsbJoinBlk(struct bStrBuilder *sb, const struct bstrList *bl,
+	   const void *blk, int len);
+
+/**
+ * Append the entries of bl separated by sep, in the manner of bjoin.
+ *
+ * sep may be NULL, for no separator. See bsbJoinBlk.
+ */
+BSTR_PUBLIC int
+bsbJoin(struct bStrBuilder *sb, const struct bstrList *bl,
+	const bstring sep);
+
+/**
+ * Return a newly allocated bstring holding the string built so far.
+ *
+ * The result is made with a single allocation of exactly the size needed.
+ * The builder is unchanged. NULL is returned if sb is NULL or memory cannot
+ * be allocated.
+ */
+BSTR_PUBLIC bstring
+bsbFlatten(const struct bStrBuilder *sb);
+
+/**
+ * Append the string built so far to b, growing b at most once.
+ *
+ * Returns BSTR_ERR if sb or b is NULL, b is invalid or write protected, or
+ * memory cannot be allocated, otherwise BSTR_OK. The builder is unchanged.
+ */
+BSTR_PUBLIC int
+bsbFlattenTo(const struct bStrBuilder *sb, bstring b);
+
+/**
+ * Write the string built so far with the vectored write function writevFn,
+ * without assembling it.
+ *
+ * writevFn is handed the pieces of the string in order, in batches of at
+ * most a few hundred. Returns BSTR_ERR if sb or writevFn is NULL, or if
+ * writevFn reports an error or writes less than it was given, otherwise
+ * BSTR_OK. The builder is unchanged.
+ */
+BSTR_PUBLIC int
+bsbWritev(const struct bStrBuilder *sb, bNwritev writevFn, void *parm);
+
 /* Security functions */
 #define bSecureDestroy(b) \
 do { \
@@ -0,0 +1,1329 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * bstrfmt.c
+ *
+ * This file implements the native formatting functions. Integers are
+ * converted two digits at a time from a table of digit pairs. Doubles are
+ * converted to their shortest round trip form by searching for the
+ * smallest power of ten which scales the value to an integer that divides
+ * back to exactly the same double, which settles most values met in
+ * practice with a few multiplications and divisions; the others, and any
+ * case where more than one candidate divides back, are settled by a binary
+ * search over the precision with snprintf and strtod. Formats are
+ * interpreted a conversion at a time, and conversions which are not
+ * handled natively are formatted by snprintf straight into the spare
+ * capacity of the output. A compiled format is rendered in two passes:
+ * the first reads the arguments and measures each piece, formatting those
+ * left to snprintf into a scratch buffer, and the second writes the pieces
+ * once the output has been grown to its final size.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include "bstrfmt.h"
+#include "bstralloc.h"
+
+static const char fmtDigitPairs[201] =
+	"00010203040506070809101112131415161718192021222324252627282930313233"
+	"34353637383940414243444546474849505152535455565758596061626364656667"
+	"6869707172737475767778798081828384858687888990919293949596979899";
+
+static const char fmtLowerHex[] = "0123456789abcdef";
+static const char fmtUpperHex[] = "0123456789ABCDEF";
+
+static const double fmtPow10[18] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+	1e13, 1e14, 1e15, 1e16, 1e17
+};
+
+/* Room for the digits of any uintmax_t */
+#define FMT_UBUF (3 * sizeof(uintmax_t) + 2)
+
+#define fmtBad(b) \
+	((b) == NULL || (b)->data == NULL || (b)->slen < 0 || \
+	 (b)->mlen <= 0 || (b)->mlen < (b)->slen)
+
+/* Write the decimal digits of v so that they end at end, and return their
+ * number.
+ */
+static int
+fmtUdec(char *end, uintmax_t v)
+{
+	char *p = end;
+	while (v >= 100) {
+		unsigned int r = (unsigned int)(v % 100);
+		v /= 100;
+		p -= 2;
+		memcpy(p, fmtDigitPairs + 2 * r, 2);
+	}
+	if (v >= 10) {
+		p -= 2;
+		memcpy(p, fmtDigitPairs + 2 * (unsigned int)v, 2);
+	} else {
+		*--p = (char)('0' + (unsigned int)v);
+	}
+	return (int)(end - p);
+}
+
+static int
+fmtUhex(char *end, uintmax_t v, const char *digits)
+{
+	char *p = end;
+	do {
+		*--p = digits[v & 15];
+		v >>= 4;
+	} while (v);
+	return (int)(end - p);
+}
+
+static int
+fmtPut(bstring b, const void *s, int n)
+{
+	if (n > INT_MAX - 1 - b->slen) {
+		return BSTR_ERR;
+	}
+	if (b->mlen <= b->slen + n && BSTR_OK != balloc(b, b->slen + n + 1)) {
+		return BSTR_ERR;
+	}
+	memcpy(b->data + b->slen, s, n);
+	b->slen += n;
+	b->data[b->slen] = (unsigned char)'\0';
+	return BSTR_OK;
+}
+
+static int
+fmtPad(bstring b, int n)
+{
+	if (n <= 0) {
+		return BSTR_OK;
+	}
+	if (n > INT_MAX - 1 - b->slen ||
+	    BSTR_OK != balloc(b, b->slen + n + 1)) {
+		return BSTR_ERR;
+	}
+	memset(b->data + b->slen, ' ', n);
+	b->slen += n;
+	b->data[b->slen] = (unsigned char)'\0';
+	return BSTR_OK;
+}
+
+int
+bcatint(bstring b, long long v)
+{
+	char buf[FMT_UBUF];
+	uintmax_t u;
+	int n;
+	if (fmtBad(b)) {
+		return BSTR_ERR;
+	}
+	u = v < 0 ? (uintmax_t)0 - (uintmax_t)v : (uintmax_t)v;
+	n = fmtUdec(buf + sizeof(buf), u);
+	if (v < 0) {
+		buf[sizeof(buf) - ++n] = '-';
+	}
+	return fmtPut(b, buf + sizeof(buf) - n, n);
+}
+
+int
+bcatuint(bstring b, unsigned long long v)
+{
+	char buf[FMT_UBUF];
+	int n;
+	if (fmtBad(b)) {
+		return BSTR_ERR;
+	}
+	n = fmtUdec(buf + sizeof(buf), v);
+	return fmtPut(b, buf + sizeof(buf) - n, n);
+}
+
+int
+bcathex(bstring b, unsigned long long v)
+{
+	char buf[FMT_UBUF];
+	int n;
+	if (fmtBad(b)) {
+		return BSTR_ERR;
+	}
+	n = fmtUhex(buf + sizeof(buf), v, fmtLowerHex);
+	return fmtPut(b, buf + sizeof(buf) - n, n);
+}
+
+/* Find the shortest digits of the positive finite v, nearest to v, which
+ * read back as v. They are stored in digits, without a terminator, and
+ * their number is returned; the value is 0.digits times 10 to the power
+ * *exp10.
+ */
+static int
+fmtShortest(char *digits, int *exp10, double v)
+{
+	char buf[40], *p;
+	uintmax_t c, top, hit = 0;
+	int k, n, lo, hi, hits, e;
+	/* The first power of ten which scales v to an integer that divides
+	 * back to v gives the shortest digits. If the rounding interval of v
+	 * were as wide as one unit at that scale, two of the candidates below
+	 * would divide back, so a single hit is the only possible one.
+	 */
+	if (v >= 1e-7 && v < 4503599627370496.0) {
+		for (k = 0; k < 18; k++) {
+			double s = v * fmtPow10[k];
+			if (s >= 1125899906842624.0) {
+				break;
+			}
+			top = (uintmax_t)s + 2;
+			hits = 0;
+			for (c = top > 2 ? top - 3 : 0; c <= top; c++) {
+				if ((double)c / fmtPow10[k] == v) {
+					hit = c;
+					hits++;
+				}
+			}
+			if (hits > 1) {
+				break;
+			}
+			if (hits == 1) {
+				n = fmtUdec(buf + sizeof(buf), hit);
+				p = buf + sizeof(buf) - n;
+				*exp10 = n - k;
+				while (n > 1 && p[n - 1] == '0') {
+					n--;
+				}
+				memcpy(digits, p, n);
+				return n;
+			}
+		}
+	}
+	/* Otherwise find the least precision whose correctly rounded value
+	 * reads back, which is also the nearest of that precision.
+	 */
+	lo = 1;
+	hi = 17;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		snprintf(buf, sizeof(buf), "%.*e", mid - 1, v);
+		if (strtod(buf, NULL) == v) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	snprintf(buf, sizeof(buf), "%.*e", lo - 1, v);
+	for (n = 0, p = buf; *p && *p != 'e'; p++) {
+		if (*p >= '0' && *p <= '9') {
+			digits[n++] = *p;
+		}
+	}
+	e = *p ? atoi(p + 1) : 0;
+	while (n > 1 && digits[n - 1] == '0') {
+		n--;
+	}
+	*exp10 = e + 1;
+	return n;
+}
+
+/* Write v as described for bcatdouble into buf, which must have room for
+ * 32 characters, and return the length.
+ */
+static int
+fmtDouble(char *buf, double v)
+{
+	char d[20];
+	int k, n, i = 0, e;
+	if (v != v) {
+		memcpy(buf, "nan", 3);
+		return 3;
+	}
+	if (signbit(v)) {
+		buf[i++] = '-';
+		v = -v;
+	}
+	if (v > DBL_MAX) {
+		memcpy(buf + i, "inf", 3);
+		return i + 3;
+	}
+	if (v == 0) {
+		buf[i++] = '0';
+		return i;
+	}
+	k = fmtShortest(d, &n, v);
+	if (k <= n && n <= 21) {
+		memcpy(buf + i, d, k);
+		memset(buf + i + k, '0', n - k);
+		return i + n;
+	}
+	if (0 < n && n <= 21) {
+		memcpy(buf + i, d, n);
+		buf[i + n] = '.';
+		memcpy(buf + i + n + 1, d + n, k - n);
+		return i + k + 1;
+	}
+	if (-6 < n && n <= 0) {
+		buf[i++] = '0';
+		buf[i++] = '.';
+		memset(buf + i, '0', -n);
+		memcpy(buf + i - n, d, k);
+		return i - n + k;
+	}
+	buf[i++] = d[0];
+	if (k > 1) {
+		buf[i++] = '.';
+		memcpy(buf + i, d + 1, k - 1);
+		i += k - 1;
+	}
+	buf[i++] = 'e';
+	e = n - 1;
+	buf[i++] = e < 0 ? '-' : '+';
+	n = fmtUdec(d + sizeof(d), (uintmax_t)(e < 0 ? -e : e));
+	memcpy(buf + i, d + sizeof(d) - n, n);
+	return i + n;
+}
+
+int
+bcatdouble(bstring b, double v)
+{
+	char buf[32];
+	if (fmtBad(b)) {
+		return BSTR_ERR;
+	}
+	return fmtPut(b, buf, fmtDouble(buf, v));
+}
+
+/* Length modifiers */
+enum {
+	FMT_NONE, FMT_HH, FMT_H, FMT_L, FMT_LL, FMT_J, FMT_Z, FMT_T, FMT_LD
+};
+
+/* Argument types passed on to snprintf */
+enum {
+	FK_INT, FK_UINT, FK_LONG, FK_ULONG, FK_LLONG, FK_ULLONG, FK_IMAX,
+	FK_UMAX, FK_SSIZE, FK_SIZE, FK_DOUBLE, FK_LDOUBLE, FK_PTR, FK_WSTR,
+	FK_WINT
+};
+
+struct fmtSpec {
+	char flags[8]; /* As written, for passing on to snprintf */
+	int nflags;
+	int left; /* Pad on the right */
+	int width; /* -1 if none */
+	int prec; /* -1 if none */
+	int len;
+	int conv;
+};
+
+union fmtArg {
+	intmax_t i;
+	uintmax_t u;
+	double d;
+	long double ld;
+	const void *p;
+	wint_t wc;
+};
+
+/* Width or precision given by an argument which has not been read yet */
+#define FMT_STAR (-2)
+
+static int
+fmtStarWidth(struct fmtSpec *sp, int v)
+{
+	if (v < 0) {
+		if (v == INT_MIN) {
+			return BSTR_ERR;
+		}
+		v = -v;
+		sp->left = 1;
+		sp->flags[sp->nflags++] = '-';
+	}
+	sp->width = v;
+	return BSTR_OK;
+}
+
+static void
+fmtStarPrec(struct fmtSpec *sp, int v)
+{
+	sp->prec = v < 0 ? -1 : v;
+}
+
+/* Parse the conversion following a '%'. A '*' width or precision is read
+ * from ap, or left as FMT_STAR if ap is NULL.
+ */
+static const char *
+fmtParse(const char *p, struct fmtSpec *sp, va_list *ap)
+{
+	int v;
+	sp->nflags = 0;
+	sp->left = 0;
+	sp->width = -1;
+	sp->prec = -1;
+	sp->len = FMT_NONE;
+	while (*p && strchr("-+ #0", *p)) {
+		if (sp->nflags < 5) {
+			sp->flags[sp->nflags++] = *p;
+		}
+		sp->left |= (*p == '-');
+		p++;
+	}
+	if (*p == '*') {
+		if (ap == NULL) {
+			sp->width = FMT_STAR;
+		} else if (BSTR_OK != fmtStarWidth(sp, va_arg(*ap, int))) {
+			return NULL;
+		}
+		p++;
+	} else if (*p >= '0' && *p <= '9') {
+		for (v = 0; *p >= '0' && *p <= '9'; p++) {
+			if (v > (INT_MAX - 9) / 10) {
+				return NULL;
+			}
+			v = v * 10 + (*p - '0');
+		}
+		sp->width = v;
+	}
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			if (ap == NULL) {
+				sp->prec = FMT_STAR;
+			} else {
+				fmtStarPrec(sp, va_arg(*ap, int));
+			}
+			p++;
+		} else {
+			for (v = 0; *p >= '0' && *p <= '9'; p++) {
+				if (v > (INT_MAX - 9) / 10) {
+					return NULL;
+				}
+				v = v * 10 + (*p - '0');
+			}
+			sp->prec = v;
+		}
+	}
+	switch (*p) {
+	case 'h':
+		sp->len = (p[1] == 'h') ? FMT_HH : FMT_H;
+		p += 1 + (p[1] == 'h');
+		break;
+	case 'l':
+		sp->len = (p[1] == 'l') ? FMT_LL : FMT_L;
+		p += 1 + (p[1] == 'l');
+		break;
+	case 'j':
+		sp->len = FMT_J;
+		p++;
+		break;
+	case 'z':
+		sp->len = FMT_Z;
+		p++;
+		break;
+	case 't':
+		sp->len = FMT_T;
+		p++;
+		break;
+	case 'L':
+		sp->len = FMT_LD;
+		p++;
+		break;
+	}
+	if (*p == '\0') {
+		return NULL;
+	}
+	sp->conv = (unsigned char)*p;
+	return p + 1;
+}
+
+static intmax_t
+fmtSigned(int len, va_list *ap)
+{
+	switch (len) {
+	case FMT_HH:
+		return (signed char)va_arg(*ap, int);
+	case FMT_H:
+		return (short)va_arg(*ap, int);
+	case FMT_L:
+		return va_arg(*ap, long);
+	case FMT_LL:
+		return va_arg(*ap, long long);
+	case FMT_J:
+		return va_arg(*ap, intmax_t);
+	case FMT_Z:
+	case FMT_T:
+		return va_arg(*ap, ptrdiff_t);
+	default:
+		return va_arg(*ap, int);
+	}
+}
+
+static uintmax_t
+fmtUnsigned(int len, va_list *ap)
+{
+	switch (len) {
+	case FMT_HH:
+		return (unsigned char)va_arg(*ap, unsigned int);
+	case FMT_H:
+		return (unsigned short)va_arg(*ap, unsigned int);
+	case FMT_L:
+		return va_arg(*ap, unsigned long);
+	case FMT_LL:
+		return va_arg(*ap, unsigned long long);
+	case FMT_J:
+		return va_arg(*ap, uintmax_t);
+	case FMT_Z:
+	case FMT_T:
+		return va_arg(*ap, size_t);
+	default:
+		return va_arg(*ap, unsigned int);
+	}
+}
+
+static int
+fmtCall(char *out, size_t cap, const char *spec, int kind,
+	const union fmtArg *a)
+{
+	switch (kind) {
+	case FK_INT:
+		return snprintf(out, cap, spec, (int)a->i);
+	case FK_UINT:
+		return snprintf(out, cap, spec, (unsigned int)a->u);
+	case FK_LONG:
+		return snprintf(out, cap, spec, (long)a->i);
+	case FK_ULONG:
+		return snprintf(out, cap, spec, (unsigned long)a->u);
+	case FK_LLONG:
+		return snprintf(out, cap, spec, (long long)a->i);
+	case FK_ULLONG:
+		return snprintf(out, cap, spec, (unsigned long long)a->u);
+	case FK_IMAX:
+		return snprintf(out, cap, spec, a->i);
+	case FK_UMAX:
+		return snprintf(out, cap, spec, a->u);
+	case FK_SSIZE:
+		return snprintf(out, cap, spec, (ptrdiff_t)a->i);
+	case FK_SIZE:
+		return snprintf(out, cap, spec, (size_t)a->u);
+	case FK_DOUBLE:
+		return snprintf(out, cap, spec, a->d);
+	case FK_LDOUBLE:
+		return snprintf(out, cap, spec, a->ld);
+	case FK_PTR:
+		return snprintf(out, cap, spec, (void *)a->p);
+	case FK_WSTR:
+		return snprintf(out, cap, spec, (const wchar_t *)a->p);
+	default:
+		return snprintf(out, cap, spec, a->wc);
+	}
+}
+
+/* Fetch the argument of a conversion which is not handled natively, and
+ * return the kind under which it is passed on to snprintf, or -1.
+ */
+static int
+fmtFetch(const struct fmtSpec *sp, va_list *ap, union fmtArg *a)
+{
+	static const int skind[] = {
+		FK_INT, FK_INT, FK_INT, FK_LONG, FK_LLONG, FK_IMAX, FK_SSIZE,
+		FK_SSIZE, FK_INT
+	};
+	static const int ukind[] = {
+		FK_UINT, FK_UINT, FK_UINT, FK_ULONG, FK_ULLONG, FK_UMAX,
+		FK_SIZE, FK_SIZE, FK_UINT
+	};
+	switch (sp->conv) {
+	case 'd': case 'i':
+		a->i = fmtSigned(sp->len, ap);
+		return skind[sp->len];
+	case 'o': case 'u': case 'x': case 'X':
+		a->u = fmtUnsigned(sp->len, ap);
+		return ukind[sp->len];
+	case 'e': case 'E': case 'f': case 'F':
+	case 'g': case 'G': case 'a': case 'A':
+		if (sp->len == FMT_LD) {
+			a->ld = va_arg(*ap, long double);
+			return FK_LDOUBLE;
+		}
+		a->d = va_arg(*ap, double);
+		return FK_DOUBLE;
+	case 'c':
+		if (sp->len == FMT_L) {
+			a->wc = va_arg(*ap, wint_t);
+			return FK_WINT;
+		}
+		a->i = va_arg(*ap, int);
+		return FK_INT;
+	case 's':
+		a->p = va_arg(*ap, const wchar_t *);
+		return a->p == NULL ? -1 : FK_WSTR;
+	case 'p':
+		a->p = va_arg(*ap, void *);
+		return FK_PTR;
+	default:
+		return -1;
+	}
+}
+
+/* Write the conversion sp, with any '*' resolved, as a format for snprintf.
+ * The spec must have room for FMT_SPEC characters.
+ */
+#define FMT_SPEC (48)
+
+static void
+fmtSpecString(char *spec, const struct fmtSpec *sp)
+{
+	static const char lens[][3] = {
+		"", "hh", "h", "l", "ll", "j", "z", "t", "L"
+	};
+	char *s = spec;
+	*s++ = '%';
+	memcpy(s, sp->flags, sp->nflags);
+	s += sp->nflags;
+	if (sp->width >= 0) {
+		s += sprintf(s, "%d", sp->width);
+	}
+	if (sp->prec >= 0) {
+		s += sprintf(s, ".%d", sp->prec);
+	}
+	strcpy(s, lens[sp->len]);
+	s += strlen(s);
+	*s++ = (char)sp->conv;
+	*s = '\0';
+}
+
+/* Format a conversion which is not handled natively with snprintf, straight
+ * into the spare capacity of b.
+ */
+static int
+fmtDelegate(bstring b, const struct fmtSpec *sp, va_list *ap)
+{
+	char spec[FMT_SPEC];
+	union fmtArg a;
+	int kind, r, i;
+	if (0 > (kind = fmtFetch(sp, ap, &a))) {
+		return BSTR_ERR;
+	}
+	fmtSpecString(spec, sp);
+	for (i = 0; i < 2; i++) {
+		size_t cap = (size_t)(b->mlen - b->slen);
+		r = fmtCall((char *)b->data + b->slen, cap, spec, kind, &a);
+		if (r < 0) {
+			return BSTR_ERR;
+		}
+		if ((size_t)r < cap) {
+			b->slen += r;
+			return BSTR_OK;
+		}
+		if (r > INT_MAX - 1 - b->slen ||
+		    BSTR_OK != balloc(b, b->slen + r + 1)) {
+			return BSTR_ERR;
+		}
+	}
+	return BSTR_ERR;
+}
+
+/* The offset of s within the first mlen bytes at data, or -1. Since data is
+ * where b was before it may have grown, s is only compared as an address.
+ */
+static ptrdiff_t
+fmtOrigin(uintptr_t data, int mlen, const void *s)
+{
+	uintptr_t u = (uintptr_t)s;
+	return u >= data && u - data < (uintptr_t)mlen ?
+		(ptrdiff_t)(u - data) : -1;
+}
+
+/* The length of the string at s, reading no more than max characters */
+static size_t
+fmtStrLen(const unsigned char *s, size_t max)
+{
+	const char *q = memchr(s, '\0', max);
+	return q ? (size_t)(q - (const char *)s) : max;
+}
+
+/* Append the n characters at s, padded to the width of sp. If pd is not -1
+ * the characters are at offset pd within b instead, which formatting leaves
+ * alone, and they are found there again after b has grown.
+ */
+static int
+fmtPutStr(bstring b, ptrdiff_t pd, const unsigned char *s, int n,
+	  const struct fmtSpec *sp)
+{
+	int pad = sp->width > n ? sp->width - n : 0;
+	if (!sp->left && BSTR_OK != fmtPad(b, pad)) {
+		return BSTR_ERR;
+	}
+	if (n > INT_MAX - 1 - b->slen ||
+	    (b->mlen <= b->slen + n && BSTR_OK != balloc(b, b->slen + n + 1))) {
+		return BSTR_ERR;
+	}
+	memcpy(b->data + b->slen, pd >= 0 ? b->data + pd : s, n);
+	b->slen += n;
+	b->data[b->slen] = (unsigned char)'\0';
+	return sp->left ? fmtPad(b, pad) : BSTR_OK;
+}
+
+/* Whether the integer conversion sp, which may have a width and the '-'
+ * and '0' flags but nothing else, can be written natively.
+ */
+static int
+fmtIntSpec(const struct fmtSpec *sp)
+{
+	int i;
+	if (sp->prec != -1 || NULL == strchr("diuxX", sp->conv)) {
+		return 0;
+	}
+	for (i = 0; i < sp->nflags; i++) {
+		if (sp->flags[i] != '-' && sp->flags[i] != '0') {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Write the n characters of the integer u, with a sign if neg, padded with
+ * pad spaces or zeros as sp asks, at d.
+ */
+static void
+fmtWriteInt(unsigned char *d, uintmax_t u, int neg, int n, int pad,
+	    const struct fmtSpec *sp)
+{
+	int zero = !sp->left && NULL != memchr(sp->flags, '0', sp->nflags);
+	if (!sp->left && !zero) {
+		memset(d, ' ', pad);
+		d += pad;
+	}
+	if (neg) {
+		*d++ = '-';
+		n--;
+	}
+	if (zero) {
+		memset(d, '0', pad);
+		d += pad;
+	}
+	if (sp->conv == 'x' || sp->conv == 'X') {
+		fmtUhex((char *)d + n, u,
+			sp->conv == 'x' ? fmtLowerHex : fmtUpperHex);
+	} else {
+		fmtUdec((char *)d + n, u);
+	}
+	if (sp->left) {
+		memset(d + n, ' ', pad);
+	}
+}
+
+static int
+fmtDecLen(uintmax_t v)
+{
+	int n = 1;
+	for (; v >= 100; v /= 100) {
+		n += 2;
+	}
+	return n + (v >= 10);
+}
+
+static int
+fmtHexLen(uintmax_t v)
+{
+	int n = 1;
+	for (; v >= 16; v >>= 4) {
+		n++;
+	}
+	return n;
+}
+
+/* Read the argument of the integer conversion sp, and return the number of
+ * characters it needs without padding.
+ */
+static int
+fmtIntArg(const struct fmtSpec *sp, va_list *ap, uintmax_t *u, int *neg)
+{
+	intmax_t v;
+	if (sp->conv == 'd' || sp->conv == 'i') {
+		v = fmtSigned(sp->len, ap);
+		*neg = v < 0;
+		*u = v < 0 ? (uintmax_t)0 - (uintmax_t)v : (uintmax_t)v;
+		return fmtDecLen(*u) + *neg;
+	}
+	*u = fmtUnsigned(sp->len, ap);
+	*neg = 0;
+	return sp->conv == 'u' ? fmtDecLen(*u) : fmtHexLen(*u);
+}
+
+static int
+fmtPutInt(bstring b, const struct fmtSpec *sp, va_list *ap)
+{
+	uintmax_t u;
+	int neg, n = fmtIntArg(sp, ap, &u, &neg);
+	int pad = sp->width > n ? sp->width - n : 0;
+	if (pad > INT_MAX - 1 - n - b->slen ||
+	    (b->mlen <= b->slen + n + pad &&
+	     BSTR_OK != balloc(b, b->slen + n + pad + 1))) {
+		return BSTR_ERR;
+	}
+	fmtWriteInt(b->data + b->slen, u, neg, n, pad, sp);
+	b->slen += n + pad;
+	b->data[b->slen] = (unsigned char)'\0';
+	return BSTR_OK;
+}
+
+static int
+fmtRun(bstring b, const char *fmt, va_list *ap)
+{
+	struct fmtSpec sp;
+	const unsigned char *s;
+	const struct tagbstring *bs;
+	const char *q;
+	char buf[1];
+	/* Arguments are found in b by where it was when they were passed */
+	uintptr_t odata = (uintptr_t)b->data;
+	int olen = b->slen, omlen = b->mlen, n, ret;
+	ptrdiff_t pd;
+	size_t l;
+	while (*fmt) {
+		if (*fmt != '%') {
+			q = strchr(fmt, '%');
+			l = q ? (size_t)(q - fmt) : strlen(fmt);
+			if (l > INT_MAX || BSTR_OK != fmtPut(b, fmt, (int)l)) {
+				return BSTR_ERR;
+			}
+			fmt += l;
+			continue;
+		}
+		fmt = fmtParse(fmt + 1, &sp, ap);
+		if (fmt == NULL) {
+			return BSTR_ERR;
+		}
+		if (sp.conv == 'B' || (sp.conv == 's' && sp.len != FMT_L)) {
+			if (sp.conv == 'B') {
+				bs = va_arg(*ap, const struct tagbstring *);
+				if (bs == NULL || bs->data == NULL ||
+				    bs->slen < 0) {
+					return BSTR_ERR;
+				}
+				s = bs->data;
+				n = bs->slen;
+				pd = bs == b ? 0 : fmtOrigin(odata, omlen, s);
+				if (bs == b || (pd >= 0 && n > olen - pd)) {
+					n = pd > olen ? 0 : olen - (int)pd;
+				}
+				if (sp.prec >= 0 && n > sp.prec) {
+					n = sp.prec;
+				}
+			} else {
+				s = (const unsigned char *)
+				    va_arg(*ap, const char *);
+				if (s == NULL) {
+					return BSTR_ERR;
+				}
+				/* Text in b is cut off where b ended */
+				pd = fmtOrigin(odata, omlen, s);
+				if (pd >= 0) {
+					s = b->data + pd;
+					l = pd > olen ? 0 : (size_t)(olen - pd);
+					if (sp.prec >= 0 && (int)l > sp.prec) {
+						l = (size_t)sp.prec;
+					}
+					l = fmtStrLen(s, l);
+				} else if (sp.prec >= 0) {
+					l = fmtStrLen(s, (size_t)sp.prec);
+				} else {
+					l = strlen((const char *)s);
+				}
+				if (l > INT_MAX) {
+					return BSTR_ERR;
+				}
+				n = (int)l;
+			}
+			ret = fmtPutStr(b, pd, s, n, &sp);
+		} else if (fmtIntSpec(&sp)) {
+			ret = fmtPutInt(b, &sp, ap);
+		} else if (sp.nflags || sp.width >= 0 || sp.prec >= 0) {
+			if (sp.conv == '%') {
+				ret = fmtPut(b, "%", 1);
+			} else if (sp.conv == 'n') {
+				ret = BSTR_ERR;
+			} else {
+				ret = fmtDelegate(b, &sp, ap);
+			}
+		} else {
+			switch (sp.conv) {
+			case 'c':
+				if (sp.len == FMT_L) {
+					ret = fmtDelegate(b, &sp, ap);
+				} else {
+					buf[0] = (char)va_arg(*ap, int);
+					ret = fmtPut(b, buf, 1);
+				}
+				break;
+			case '%':
+				ret = fmtPut(b, "%", 1);
+				break;
+			case 'n':
+				ret = BSTR_ERR;
+				break;
+			default:
+				ret = fmtDelegate(b, &sp, ap);
+				break;
+			}
+		}
+		if (ret != BSTR_OK) {
+			return BSTR_ERR;
+		}
+	}
+	return BSTR_OK;
+}
+
+int
+bvcatformat(bstring b, const char *fmt, va_list arglist)
+{
+	va_list ap;
+	bstring f = NULL;
+	ptrdiff_t pd;
+	int olen, ret;
+	if (fmtBad(b) || fmt == NULL) {
+		return BSTR_ERR;
+	}
+	/* The format itself may lie in b, where the output could move it */
+	pd = (const unsigned char *)fmt - b->data;
+	if (0 <= pd && pd < b->mlen) {
+		if (NULL == (f = bfromcstr(fmt))) {
+			return BSTR_ERR;
+		}
+		fmt = (const char *)f->data;
+	}
+	olen = b->slen;
+	va_copy(ap, arglist);
+	ret = fmtRun(b, fmt, &ap);
+	va_end(ap);
+	if (ret != BSTR_OK) {
+		b->slen = olen;
+		b->data[olen] = (unsigned char)'\0';
+	}
+	bdestroy(f);
+	return ret;
+}
+
+int
+bcatformat(bstring b, const char *fmt, ...)
+{
+	va_list arglist;
+	int ret;
+	va_start(arglist, fmt);
+	ret = bvcatformat(b, fmt, arglist);
+	va_end(arglist);
+	return ret;
+}
+
+/* Steps of a compiled format */
+enum {
+	FO_LIT, FO_STR, FO_BSTR, FO_INT, FO_CHAR, FO_CALL
+};
+
+struct fmtOp {
+	int op;
+	int off, n; /* Span of the literal text, for FO_LIT */
+	struct fmtSpec sp;
+	char spec[FMT_SPEC]; /* For FO_CALL, unless a '*' is pending */
+};
+
+struct bstrFormat {
+	struct fmtOp *ops;
+	int nops, mops;
+	int nargs; /* Number of steps which consume arguments */
+	int litlen; /* Total length of the literal text */
+	unsigned char *text;
+};
+
+/* The values of the arguments of one render, gathered by the first pass */
+struct fmtSlot {
+	union fmtArg a;
+	const unsigned char *s;
+	ptrdiff_t pd; /* Offset of s within b, or -1 */
+	int n, pad, left, neg, kind;
+	int off; /* Offset of the output in the scratch space, or -1 */
+	int width, prec; /* Values read for a '*' */
+};
+
+#define FMT_SLOTS (32)
+#define FMT_SCRATCH (512)
+
+static struct fmtOp *
+fmtAddOp(struct bstrFormat *f, int op)
+{
+	struct fmtOp *o;
+	if (f->nops == f->mops) {
+		int m = f->mops ? 2 * f->mops : 8;
+		if (m > INT_MAX / (int)sizeof(*o) ||
+		    NULL == (o = bMemRealloc(f->ops, m * sizeof(*o)))) {
+			return NULL;
+		}
+		f->ops = o;
+		f->mops = m;
+	}
+	o = &f->ops[f->nops++];
+	o->op = op;
+	o->off = o->n = 0;
+	return o;
+}
+
+/* Append n bytes of literal text, extending the previous step if that is
+ * literal text too.
+ */
+static int
+fmtAddLit(struct bstrFormat *f, const char *s, int n)
+{
+	struct fmtOp *o = f->nops ? &f->ops[f->nops - 1] : NULL;
+	if (n == 0) {
+		return BSTR_OK;
+	}
+	if (o == NULL || o->op != FO_LIT) {
+		if (NULL == (o = fmtAddOp(f, FO_LIT))) {
+			return BSTR_ERR;
+		}
+		o->off = f->litlen;
+	}
+	memcpy(f->text + f->litlen, s, n);
+	f->litlen += n;
+	o->n += n;
+	return BSTR_OK;
+}
+
+struct bstrFormat *
+bstrFormatCreate(const char *fmt)
+{
+	struct bstrFormat *f;
+	struct fmtOp *o;
+	struct fmtSpec sp;
+	const char *q;
+	size_t l;
+	int op;
+	if (fmt == NULL || (l = strlen(fmt)) >= INT_MAX) {
+		return NULL;
+	}
+	if (NULL == (f = bMemAlloc(sizeof(*f)))) {
+		return NULL;
+	}
+	f->ops = NULL;
+	f->nops = f->mops = f->nargs = f->litlen = 0;
+	if (NULL == (f->text = bMemAlloc(l + 1))) {
+		goto fail;
+	}
+	while (*fmt) {
+		if (*fmt != '%') {
+			q = strchr(fmt, '%');
+			l = q ? (size_t)(q - fmt) : strlen(fmt);
+			if (BSTR_OK != fmtAddLit(f, fmt, (int)l)) {
+				goto fail;
+			}
+			fmt += l;
+			continue;
+		}
+		if (NULL == (fmt = fmtParse(fmt + 1, &sp, NULL))) {
+			goto fail;
+		}
+		if (sp.conv == '%') {
+			if (BSTR_OK != fmtAddLit(f, "%", 1)) {
+				goto fail;
+			}
+			continue;
+		}
+		if (sp.conv == 'B') {
+			op = FO_BSTR;
+		} else if (sp.conv == 's' && sp.len != FMT_L) {
+			op = FO_STR;
+		} else if (sp.conv == 'n' ||
+			   NULL == strchr("diouxXeEfFgGaAcsp", sp.conv)) {
+			goto fail;
+		} else if (fmtIntSpec(&sp)) {
+			op = FO_INT;
+		} else if (sp.nflags || sp.width != -1 || sp.prec != -1) {
+			op = FO_CALL;
+		} else if (sp.conv == 'c' && sp.len != FMT_L) {
+			op = FO_CHAR;
+		} else {
+			op = FO_CALL;
+		}
+		if (NULL == (o = fmtAddOp(f, op))) {
+			goto fail;
+		}
+		o->sp = sp;
+		if (op == FO_CALL && sp.width != FMT_STAR &&
+		    sp.prec != FMT_STAR) {
+			fmtSpecString(o->spec, &sp);
+		}
+		f->nargs++;
+	}
+	return f;
+fail:
+	bstrFormatDestroy(f);
+	return NULL;
+}
+
+int
+bstrFormatDestroy(struct bstrFormat *f)
+{
+	if (f == NULL) {
+		return BSTR_ERR;
+	}
+	bMemFree(f->ops);
+	bMemFree(f->text);
+	bMemFree(f);
+	return BSTR_OK;
+}
+
+/* Resolve the pending '*' of sp with the values read for them */
+static int
+fmtStars(struct fmtSpec *sp, int width, int prec)
+{
+	if (sp->width == FMT_STAR && BSTR_OK != fmtStarWidth(sp, width)) {
+		return BSTR_ERR;
+	}
+	if (sp->prec == FMT_STAR) {
+		fmtStarPrec(sp, prec);
+	}
+	return BSTR_OK;
+}
+
+/* Read the arguments for f into v, measuring each piece of output, and
+ * return the total length of the output or BSTR_ERR. Conversions passed on
+ * to snprintf are formatted into scratch while it has room.
+ */
+static int
+fmtMeasure(const struct bstrFormat *f, struct fmtSlot *v, const bstring b,
+	   char *scratch, va_list *ap)
+{
+	const struct fmtOp *o;
+	const struct tagbstring *bs;
+	const char *q;
+	struct fmtSpec sp;
+	char spec[FMT_SPEC];
+	int i, n, used = 0, total = f->litlen;
+	size_t l;
+	for (i = 0, o = f->ops; i < f->nops; i++, o++) {
+		if (o->op == FO_LIT) {
+			continue;
+		}
+		sp = o->sp;
+		v->width = sp.width == FMT_STAR ? va_arg(*ap, int) : 0;
+		v->prec = sp.prec == FMT_STAR ? va_arg(*ap, int) : 0;
+		if (BSTR_OK != fmtStars(&sp, v->width, v->prec)) {
+			return BSTR_ERR;
+		}
+		v->left = sp.left;
+		v->pad = 0;
+		switch (o->op) {
+		case FO_BSTR:
+			bs = va_arg(*ap, const struct tagbstring *);
+			if (bs == NULL || bs->data == NULL || bs->slen < 0) {
+				return BSTR_ERR;
+			}
+			v->s = bs->data;
+			n = bs->slen;
+			/* Text within b is found again after b has grown */
+			v->pd = fmtOrigin((uintptr_t)b->data, b->mlen, v->s);
+			if (v->pd >= 0 && n > b->slen - v->pd) {
+				n = v->pd > b->slen ? 0 : b->slen - (int)v->pd;
+			}
+			if (sp.prec >= 0 && n > sp.prec) {
+				n = sp.prec;
+			}
+			v->pad = sp.width > n ? sp.width - n : 0;
+			break;
+		case FO_STR:
+			v->s = (const unsigned char *)va_arg(*ap, const char *);
+			if (v->s == NULL) {
+				return BSTR_ERR;
+			}
+			/* Text in b is cut off where b ends */
+			v->pd = fmtOrigin((uintptr_t)b->data, b->mlen, v->s);
+			if (v->pd >= 0) {
+				l = v->pd > b->slen ? 0 :
+					(size_t)(b->slen - v->pd);
+				if (sp.prec >= 0 && (int)l > sp.prec) {
+					l = (size_t)sp.prec;
+				}
+				l = fmtStrLen(v->s, l);
+			} else if (sp.prec >= 0) {
+				l = fmtStrLen(v->s, (size_t)sp.prec);
+			} else {
+				l = strlen((const char *)v->s);
+			}
+			if (l > INT_MAX) {
+				return BSTR_ERR;
+			}
+			n = (int)l;
+			v->pad = sp.width > n ? sp.width - n : 0;
+			break;
+		case FO_INT:
+			n = fmtIntArg(&sp, ap, &v->a.u, &v->neg);
+			v->pad = sp.width > n ? sp.width - n : 0;
+			break;
+		case FO_CHAR:
+			v->a.i = va_arg(*ap, int);
+			n = 1;
+			break;
+		default:
+			if (0 > (v->kind = fmtFetch(&sp, ap, &v->a))) {
+				return BSTR_ERR;
+			}
+			q = o->spec;
+			if (o->sp.width == FMT_STAR || o->sp.prec == FMT_STAR) {
+				fmtSpecString(spec, &sp);
+				q = spec;
+			}
+			n = fmtCall(scratch + used, FMT_SCRATCH - used, q,
+				    v->kind, &v->a);
+			if (n < 0) {
+				return BSTR_ERR;
+			}
+			/* Otherwise it is formatted again once b has grown */
+			v->off = n < FMT_SCRATCH - used ? used : -1;
+			if (v->off >= 0) {
+				used += n;
+			}
+			break;
+		}
+		v->n = n;
+		if (n > INT_MAX - total || v->pad > INT_MAX - total - n) {
+			return BSTR_ERR;
+		}
+		total += n + v->pad;
+		v++;
+	}
+	return total;
+}
+
+/* Write the output measured by fmtMeasure at d */
+static void
+fmtRender(const struct bstrFormat *f, const struct fmtSlot *v,
+	  const bstring b, unsigned char *d, const char *scratch)
+{
+	const struct fmtOp *o;
+	const unsigned char *s;
+	struct fmtSpec sp;
+	char spec[FMT_SPEC];
+	int i;
+	for (i = 0, o = f->ops; i < f->nops; i++, o++) {
+		switch (o->op) {
+		case FO_LIT:
+			memcpy(d, f->text + o->off, o->n);
+			d += o->n;
+			continue;
+		case FO_STR:
+		case FO_BSTR:
+			s = v->pd >= 0 ? b->data + v->pd : v->s;
+			if (!v->left) {
+				memset(d, ' ', v->pad);
+				d += v->pad;
+			}
+			memcpy(d, s, v->n);
+			d += v->n;
+			if (v->left) {
+				memset(d, ' ', v->pad);
+				d += v->pad;
+			}
+			break;
+		case FO_INT:
+			sp = o->sp;
+			fmtStars(&sp, v->width, v->prec);
+			fmtWriteInt(d, v->a.u, v->neg, v->n, v->pad, &sp);
+			d += v->n + v->pad;
+			break;
+		case FO_CHAR:
+			*d++ = (unsigned char)v->a.i;
+			break;
+		default:
+			if (v->off >= 0) {
+				memcpy(d, scratch + v->off, v->n);
+			} else {
+				sp = o->sp;
+				fmtStars(&sp, v->width, v->prec);
+				fmtSpecString(spec, &sp);
+				fmtCall((char *)d, (size_t)v->n + 1, spec,
+					v->kind, &v->a);
+			}
+			d += v->n;
+			break;
+		}
+		v++;
+	}
+}
+
+int
+bstrFormatVCat(bstring b, const struct bstrFormat *f, va_list arglist)
+{
+	struct fmtSlot stack[FMT_SLOTS], *v = stack;
+	char scratch[FMT_SCRATCH];
+	va_list ap;
+	int n, ret = BSTR_ERR;
+	if (fmtBad(b) || f == NULL) {
+		return BSTR_ERR;
+	}
+	if (f->nargs > FMT_SLOTS &&
+	    NULL == (v = bMemAlloc((size_t)f->nargs * sizeof(*v)))) {
+		return BSTR_ERR;
+	}
+	va_copy(ap, arglist);
+	n = fmtMeasure(f, v, b, scratch, &ap);
+	va_end(ap);
+	if (n >= 0 && n <= INT_MAX - 1 - b->slen &&
+	    BSTR_OK == balloc(b, b->slen + n + 1)) {
+		fmtRender(f, v, b, b->data + b->slen, scratch);
+		b->slen += n;
+		b->data[b->slen] = (unsigned char)'\0';
+		ret = BSTR_OK;
+	}
+	if (v != stack) {
+		bMemFree(v);
+	}
+	return ret;
+}
+
+int
+bstrFormatCat(bstring b, const struct bstrFormat *f, ...)
+{
+	va_list arglist;
+	int ret;
+	va_start(arglist, f);
+	ret = bstrFormatVCat(b, f, arglist);
+	va_end(arglist);
+	return ret;
+}
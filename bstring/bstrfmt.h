@@ -0,0 +1,187 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/**
+ * \file
+ * \brief Native formatting: typed appends and a printf work-a-like.
+ *
+ * bformata and its relatives hand the whole format to vsnprintf, which has
+ * to parse it, find the length of every %s argument with strlen and write
+ * into a temporary buffer. The functions here append numbers and strings
+ * to a bstring directly: bcatint, bcatuint and bcathex write integers,
+ * bcatdouble writes the shortest decimal form of a double which reads back
+ * as the same value, and bcatformat interprets a printf style format itself,
+ * with a %B conversion which appends a bstring using its stored length.
+ * A format which is used many times may be compiled once with
+ * bstrFormatCreate and rendered with bstrFormatCat.
+ *
+ * Depends on bstrlib.h.
+ */
+
+#ifndef BSTRLIB_FMT_H
+#define BSTRLIB_FMT_H
+
+#include "bstrlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Append the decimal form of v to b.
+ *
+ * BSTR_ERR is returned if b is NULL, invalid or write protected, or if
+ * memory cannot be allocated, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bcatint(bstring b, long long v);
+
+/**
+ * Append the decimal form of the unsigned value v to b.
+ *
+ * See bcatint.
+ */
+BSTR_PUBLIC int
+bcatuint(bstring b, unsigned long long v);
+
+/**
+ * Append the lower case hexadecimal form of v to b, without a prefix or
+ * leading zeros.
+ *
+ * See bcatint.
+ */
+BSTR_PUBLIC int
+bcathex(bstring b, unsigned long long v);
+
+/**
+ * Append the shortest decimal form of v which reads back as v to b.
+ *
+ * Of the decimal numbers with the fewest significant digits which strtod
+ * converts back to exactly v, the one nearest to v is written. It is
+ * written in fixed notation ("1200", "0.1", "0.000125") unless its
+ * magnitude is at least 1e21 or below 1e-6, in which case it is written in
+ * exponential notation ("1e+21", "1.5e-7"), which are the rules used by
+ * JavaScript. Negative zero is written as "-0", and infinities and NaNs as
+ * "inf", "-inf" and "nan". Since 17 significant digits are enough for any
+ * double, the output is never longer than 25 characters. See bcatint for
+ * the return value.
+ */
+BSTR_PUBLIC int
+bcatdouble(bstring b, double v);
+
+/**
+ * Append to b under the control of the printf style format fmt.
+ *
+ * The format is interpreted natively: literal text, %c and %% without
+ * flags, width or precision, %d, %i, %u, %x and %X with at most a width
+ * and the '-' and '0' flags, and %s and %B with any of them are written
+ * directly, and the remaining conversions are passed one at a time to
+ * snprintf. The %B conversion takes a bstring and
+ * appends its contents using its stored length, so it may contain '\0'
+ * characters; a precision limits the number of characters taken from it,
+ * and a width pads it with spaces as for %s. Unlike bformata, a '\0'
+ * character produced by the output, for instance by %c, does not end it.
+ *
+ * Arguments of %s and %B may refer to b itself. BSTR_ERR is returned, and
+ * b is left unchanged, if b is NULL, invalid or write protected, if fmt is
+ * NULL or holds an unknown conversion or %n, if the argument of %s or %B is
+ * NULL or invalid, or if memory cannot be allocated. Otherwise BSTR_OK is
+ * returned.
+ */
+BSTR_PUBLIC int
+bcatformat(bstring b, const char *fmt, ...);
+
+/**
+ * Append to b under the control of fmt, with the arguments taken from
+ * arglist.
+ *
+ * This is the va_list form of bcatformat. Unlike bvcformata it needs no
+ * size hint and makes a single pass over the arguments, so arglist may be
+ * passed straight on from a variadic function.
+ */
+BSTR_PUBLIC int
+bvcatformat(bstring b, const char *fmt, va_list arglist);
+
+struct bstrFormat;
+
+/**
+ * Compile the printf style format fmt for repeated use.
+ *
+ * The format is parsed once into spans of literal text and typed slots
+ * for the arguments, which bstrFormatCat then renders without looking at
+ * the format again. The conversions accepted are those of bcatformat,
+ * including %B, and the compiled format holds its own copy of the literal
+ * text, so fmt may be released afterwards.
+ *
+ * NULL is returned if fmt is NULL, holds %n, an unknown conversion or an
+ * incomplete one at its end, or if memory cannot be allocated.
+ */
+BSTR_PUBLIC struct bstrFormat *
+bstrFormatCreate(const char *fmt);
+
+/**
+ * Destroy a compiled format.
+ *
+ * Returns BSTR_ERR if f is NULL, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bstrFormatDestroy(struct bstrFormat *f);
+
+/**
+ * Append the compiled format f, rendered with the arguments which follow,
+ * to b.
+ *
+ * The arguments are read and the length of every piece of the output is
+ * measured first, so that b is grown with a single call to balloc before
+ * anything is written. The output is the same as that of bcatformat with
+ * the format f was compiled from, and the same errors are reported; on
+ * error b is left unchanged. A compiled format is not modified by
+ * rendering, so it may be shared between threads.
+ */
+BSTR_PUBLIC int
+bstrFormatCat(bstring b, const struct bstrFormat *f, ...);
+
+/**
+ * Append the compiled format f, rendered with the arguments taken from
+ * arglist, to b.
+ *
+ * This is the va_list form of bstrFormatCat.
+ */
+BSTR_PUBLIC int
+bstrFormatVCat(bstring b, const struct bstrFormat *f, va_list arglist);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BSTRLIB_FMT_H */
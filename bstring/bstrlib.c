@@ -44,6 +44,10 @@
 # define _CRT_SECURE_NO_WARNINGS
 #endif
 
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 #include <stdio.h>
 #include <stddef.h>
 #include <stdarg.h>
@@ -52,6 +56,82 @@
 #include <ctype.h>
 #include <limits.h>
 #include "bstrlib.h"
+#include "bstralloc.h"
+#include "bstrsimd.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define BSTR_HAVE_MMAP
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BSTR_HAVE_MMAP
+#endif
+
+static void *
+bDefaultMalloc(size_t size, BSTR_UNUSED void *ctx)
+{
+	return malloc(size);
+}
+
+static void *
+bDefaultRealloc(void *ptr, size_t size, BSTR_UNUSED void *ctx)
+{
+	return realloc(ptr, size);
+}
+
+static void
+bDefaultFree(void *ptr, BSTR_UNUSED void *ctx)
+{
+	free(ptr);
+}
+
+static bMalloc bMallocFn = bDefaultMalloc;
+static bRealloc bReallocFn = bDefaultRealloc;
+static bFree bFreeFn = bDefaultFree;
+static void *bAllocCtx = NULL;
+
+int
+bstrSetAllocator(bMalloc mallocFn, bRealloc reallocFn, bFree freeFn,
+		 void *ctx)
+{
+	if (mallocFn == NULL && reallocFn == NULL && freeFn == NULL) {
+		mallocFn = bDefaultMalloc;
+		reallocFn = bDefaultRealloc;
+		freeFn = bDefaultFree;
+		ctx = NULL;
+	} else if (mallocFn == NULL || reallocFn == NULL || freeFn == NULL) {
+		return BSTR_ERR;
+	}
+	bMallocFn = mallocFn;
+	bReallocFn = reallocFn;
+	bFreeFn = freeFn;
+	bAllocCtx = ctx;
+	return BSTR_OK;
+}
+
+void *
+bMemAlloc(size_t size)
+{
+	return bMallocFn(size, bAllocCtx);
+}
+
+void *
+bMemRealloc(void *ptr, size_t size)
+{
+	return bReallocFn(ptr, size, bAllocCtx);
+}
+
+void
+bMemFree(void *ptr)
+{
+	if (ptr) {
+		bFreeFn(ptr, bAllocCtx);
+	}
+}
 
 /* Just a length safe wrapper for memmove. */
 
@@ -93,6 +173,114 @@ snapUpSize(int i) {
 	return i;
 }
 
+/* A packed bstring keeps its data in the same block as its header, directly
+ * after it. Such a buffer is never passed to realloc or free on its own.
+ * Every header allocated by this library records whether it is packed. The
+ * record is only read when the data is where packed data would be, so that
+ * headers constructed by hand, which have no such record, are left alone
+ * unless their data is placed exactly there.
+ */
+struct bHeader {
+	struct tagbstring s;
+	const struct bHeader *packed; /* This header if packed, else NULL */
+};
+
+#define bPackedData(b) ((unsigned char *)((struct bHeader *)(b) + 1))
+#define bIsPacked(b) ((b)->data == bPackedData(b) && \
+	((const struct bHeader *)(b))->packed == (const struct bHeader *)(b))
+
+/**
+ * Allocate the header of a bstring whose data is kept separately.
+ */
+static bstring
+bHeaderAlloc(void)
+{
+	struct bHeader *h = bMemAlloc(sizeof(struct bHeader));
+	if (h == NULL) {
+		return NULL;
+	}
+	h->packed = NULL;
+	return &h->s;
+}
+
+/**
+ * Record that the data of b has been moved out of its header block.
+ */
+#define bUnpack(b) (((struct bHeader *)(b))->packed = NULL)
+
+/**
+ * Allocate a packed bstring with room for mlen bytes of data.
+ */
+static bstring
+bPackedAlloc(int mlen)
+{
+	struct bHeader *h;
+	if (mlen <= 0 ||
+	    (size_t)mlen > ((size_t)-1) - sizeof(struct bHeader)) {
+		return NULL;
+	}
+	h = bMemAlloc(sizeof(struct bHeader) + (size_t)mlen);
+	if (h == NULL) {
+		return NULL;
+	}
+	h->s.slen = 0;
+	h->s.mlen = mlen;
+	h->s.data = bPackedData(h);
+	h->packed = h;
+	return &h->s;
+}
+
+/**
+ * Compute the buffer size of a packed bstring holding len bytes.
+ *
+ * There is no room to grow in place, so this is just the terminator plus
+ * enough padding to fill out the block to pointer alignment.
+ */
+static int
+bPackedSize(int len)
+{
+	int i = len + 1;
+	int r = (int)sizeof(void *) - 1;
+	if (i <= INT_MAX - r) {
+		i = (i + r) & ~r;
+	}
+	return i;
+}
+
+#if defined(BSTRLIB_SMALL_INLINE)
+/* Strings whose buffer fits in this many bytes are created packed, so that
+ * short strings need no heap buffer of their own.
+ */
+#define BSTR_SMALL_MAX 32
+#endif
+
+/**
+ * Allocate an empty bstring with a buffer of mlen bytes. When built with
+ * BSTRLIB_SMALL_INLINE it is packed if small.
+ */
+static bstring
+bNewAlloc(int mlen)
+{
+	bstring b;
+#if defined(BSTRLIB_SMALL_INLINE)
+	if (mlen <= BSTR_SMALL_MAX) {
+		return bPackedAlloc(mlen);
+	}
+#endif
+	b = bHeaderAlloc();
+	if (b == NULL) {
+		return NULL;
+	}
+	b->data = bMemAlloc(mlen);
+	if (b->data == NULL) {
+		bMemFree(b);
+		return NULL;
+	}
+	b->slen = 0;
+	b->mlen = mlen;
+	return b;
+}
+
 int
 balloc(bstring b, int olen)
 {
@@ -107,19 +295,35 @@ balloc(bstring b, int olen)
 		if ((len = snapUpSize(olen)) <= b->mlen) {
 			return BSTR_OK;
 		}
-		/* Assume probability of a non-moving realloc is 0.125 */
-		if (7 * b->mlen < 8 * b->slen) {
+		if (bIsPacked(b)) {
+			/* Packed data cannot be resized or released, so move
+			 * it out to a buffer of its own
+			 */
+			x = bMemAlloc(len);
+			if (!x) {
+				len = olen;
+				x = bMemAlloc(len);
+				if (!x) {
+					return BSTR_ERR;
+				}
+			}
+			if (b->slen) {
+				memcpy(x, b->data, b->slen);
+			}
+			bUnpack(b);
+		} else if (7 * b->mlen < 8 * b->slen) {
+			/* Assume probability of a non-moving realloc is 0.125 */
 			/* If slen is close to mlen in size then use realloc
 			 * to reduce the memory defragmentation
 			 */
 retry:
-			x = realloc(b->data, len);
+			x = bMemRealloc(b->data, len);
 			if (x == NULL) {
 				/* Since we failed, try mallocating the tightest
 				 * possible mallocation
 				 */
 				len = olen;
-				x = realloc(b->data, len);
+				x = bMemRealloc(b->data, len);
 				if (!x) {
 					return BSTR_ERR;
 				}
@@ -129,7 +333,7 @@ retry:
 			 * of copying the extra bytes that are mallocated, but
 			 * not considered part of the string
 			 */
-			x = malloc(len);
+			x = bMemAlloc(len);
 			if (!x) {
 				/* Perhaps there is no available memory for the
 				 * two mallocations to be in memory at once
@@ -139,7 +343,7 @@ retry:
 				if (b->slen) {
 					memcpy(x, b->data, b->slen);
 				}
-				free(b->data);
+				bMemFree(b->data);
 			}
 		}
 		b->data = x;
@@ -171,8 +375,21 @@ ballocmin(bstring b, int len)
 	if (len < b->slen + 1) {
 		len = b->slen + 1;
 	}
-	if (len != b->mlen) {
-		s = realloc(b->data, (size_t)len);
+	if (bIsPacked(b)) {
+		/* The packed buffer stays where it is when shrinking */
+		if (len > b->mlen) {
+			s = bMemAlloc((size_t)len);
+			if (NULL == s) {
+				return BSTR_ERR;
+			}
+			bBlockCopy(s, b->data, b->slen);
+			s[b->slen] = (unsigned char)'\0';
+			bUnpack(b);
+			b->data = s;
+		}
+		b->mlen = len;
+	} else if (len != b->mlen) {
+		s = bMemRealloc(b->data, (size_t)len);
 		if (NULL == s) {
 			return BSTR_ERR;
 		}
@@ -198,17 +415,11 @@ bfromcstr(const char *str)
 	if (i <= (int)j) {
 		return NULL;
 	}
-	b = malloc(sizeof(struct tagbstring));
+	b = bNewAlloc(i);
 	if (!b) {
 		return NULL;
 	}
 	b->slen = (int)j;
-	b->mlen = i;
-	b->data = malloc(b->mlen);
-	if (!b->data) {
-		free (b);
-		return NULL;
-	}
 	memcpy(b->data, str, j + 1);
 	return b;
 }
@@ -238,21 +449,21 @@ bfromcstrrangealloc(int minl, int maxl, const char *str)
 	}
 	i = maxl;
 
-	b = malloc(sizeof(struct tagbstring));
+	b = bHeaderAlloc();
 	if (b == NULL) {
 		return NULL;
 	}
 	b->slen = (int)j;
 
 	while (1) {
-		b->data = malloc(i);
+		b->data = bMemAlloc(i);
 		if (b->data != NULL) {
 			b->mlen = i;
 			break;
 		}
 		int k = (i >> 1) + (minl >> 1);
 		if (i == k || i < minl) {
-			free(b);
+			bMemFree(b);
 			return NULL;
 		}
 		i = k;
@@ -276,29 +487,63 @@ blk2bstr(const void *blk, int len)
 	if (len < 0 || (len > 0 && blk == NULL)) {
 		return NULL;
 	}
-	b = malloc(sizeof(struct tagbstring));
+	i = len + (2 - (len != 0));
+	i = snapUpSize(i);
+	if (i <= len) {
+		return NULL;
+	}
+	b = bNewAlloc(i);
 	if (b == NULL) {
 		return NULL;
 	}
 	b->slen = len;
-	i = len + (2 - (len != 0));
-	i = snapUpSize(i);
-	b->mlen = i;
-	b->data = malloc(b->mlen);
-	if (!b->data) {
-		free(b);
+	if (len > 0) {
+		memcpy(b->data, blk, len);
+	}
+	b->data[len] = (unsigned char)'\0';
+	return b;
+}
+
+bstring
+blk2bstrpacked(const void *blk, int len)
+{
+	bstring b;
+	if (len < 0 || (len > 0 && blk == NULL) || len >= INT_MAX) {
+		return NULL;
+	}
+	b = bPackedAlloc(bPackedSize(len));
+	if (b == NULL) {
 		return NULL;
 	}
 	if (len > 0) {
 		memcpy(b->data, blk, len);
 	}
-	if (b->mlen > len) {
-	    b->data[len] = (unsigned char)'\0';
-	} else {
-		free(b);
+	b->slen = len;
+	b->data[len] = (unsigned char)'\0';
+	return b;
+}
+
+bstring
+bfromcstrpacked(const char *str)
+{
+	size_t j;
+	if (str == NULL) {
 		return NULL;
 	}
-	return b;
+	j = strlen(str);
+	if (j >= INT_MAX) {
+		return NULL;
+	}
+	return blk2bstrpacked(str, (int)j);
+}
+
+bstring
+bstrcpypacked(const bstring b)
+{
+	if (!b || b->slen < 0 || !b->data) {
+		return NULL;
+	}
+	return blk2bstrpacked(b->data, b->slen);
 }
 
 char *
@@ -310,7 +555,7 @@ bstr2cstr(const bstring b, char z)
 		return NULL;
 	}
 	l = b->slen;
-	r = malloc((size_t)(l + 1));
+	r = bMemAlloc((size_t)(l + 1));
 	if (r == NULL) {
 		return r;
 	}
@@ -324,7 +569,7 @@ bstr2cstr(const bstring b, char z)
 int
 bcstrfree(char *s)
 {
-	free(s);
+	bMemFree(s);
 	return BSTR_OK;
 }
 
@@ -437,24 +682,17 @@ bstrcpy(const bstring b)
 	if (!b || b->slen < 0 || !b->data) {
 		return NULL;
 	}
-	b0 = malloc(sizeof(struct tagbstring));
-	if (!b0) {
-		/* Unable to mallocate memory for string header */
-		return NULL;
-	}
 	i = b->slen;
 	j = snapUpSize(i + 1);
-	b0->data = malloc(j);
-	if (b0->data == NULL) {
+	b0 = bNewAlloc(j);
+	if (b0 == NULL) {
+		/* Try again with the tightest possible allocation */
 		j = i + 1;
-		b0->data = (unsigned char *)malloc(j);
-		if (b0->data == NULL) {
-			/* Unable to mallocate memory for string data */
-			free(b0);
+		b0 = bNewAlloc(j);
+		if (b0 == NULL) {
 			return NULL;
 		}
 	}
-	b0->mlen = j;
 	b0->slen = i;
 	if (i) {
 		memcpy(b0->data, b->data, i);
@@ -577,14 +815,112 @@ btrunc(bstring b, int n)
 	return BSTR_OK;
 }
 
+static int bCtypeMode = BSTR_CTYPE_ASCII;
+
+int
+bsetctype(int mode)
+{
+	int old = bCtypeMode;
+	if (mode != BSTR_CTYPE_ASCII && mode != BSTR_CTYPE_LOCALE) {
+		return BSTR_ERR;
+	}
+	bCtypeMode = mode;
+	return old;
+}
+
+static int
+bUpcase(unsigned char c)
+{
+	if (bCtypeMode == BSTR_CTYPE_LOCALE) {
+		return toupper(c);
+	}
+	return (unsigned int)(c - 'a') < 26u ? c ^ 0x20 : c;
+}
+
+int
+bDowncase(unsigned char c)
+{
+	if (bCtypeMode == BSTR_CTYPE_LOCALE) {
+		return tolower(c);
+	}
+	return (unsigned int)(c - 'A') < 26u ? c ^ 0x20 : c;
+}
+
+static int
+bIsSpace(unsigned char c)
+{
+	if (bCtypeMode == BSTR_CTYPE_LOCALE) {
+		return isspace(c);
+	}
+	return c == ' ' || (unsigned int)(c - '\t') < 5u;
+}
+
 #define upcase(c) \
-	(toupper((unsigned char)c))
+	(bUpcase((unsigned char)(c)))
 
 #define downcase(c) \
-	(tolower((unsigned char)c))
+	(bDowncase((unsigned char)(c)))
 
 #define wspace(c) \
-	(isspace((unsigned char)c))
+	(bIsSpace((unsigned char)(c)))
+
+/* Every byte other than the ASCII white space characters, laid out as a set
+ * for the vector kernels.
+ */
+static const unsigned char bNonSpace[BSTR_SIMD_SET_SIZE] = {
+	0xfb, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xfe, 0xfe, 0xfe, 0xfe, 0xfe, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+/* Return the index of the first byte of p which is not white space, or n. */
+static int
+bSkipSpace(const unsigned char *p, int n)
+{
+	const unsigned char *q;
+	int i;
+	if (bCtypeMode == BSTR_CTYPE_ASCII) {
+		q = bSimdSetFind(bNonSpace, p, (size_t)n);
+		return q ? (int)(q - p) : n;
+	}
+	for (i = 0; i < n && wspace(p[i]); i++)
+		;
+	return i;
+}
+
+/* Return the index of the last byte of p which is not white space, or -1. */
+static int
+bSkipSpaceRev(const unsigned char *p, int n)
+{
+	const unsigned char *q;
+	int i;
+	if (bCtypeMode == BSTR_CTYPE_ASCII) {
+		q = bSimdSetFindLast(bNonSpace, p, (size_t)n);
+		return q ? (int)(q - p) : -1;
+	}
+	for (i = n - 1; i >= 0 && wspace(p[i]); i--)
+		;
+	return i;
+}
+
+/* Find the first index below n at which a and b differ without regard to
+ * case, or n if there is none.
+ */
+static int
+bCaselessMismatch(const unsigned char *a, const unsigned char *b, int n)
+{
+	int i;
+	if (bCtypeMode == BSTR_CTYPE_ASCII) {
+		return (int)bSimdAsciiCaselessMismatch(a, b, (size_t)n);
+	}
+	for (i = 0; i < n; i++) {
+		if (a[i] != b[i] && downcase(a[i]) != downcase(b[i])) {
+			break;
+		}
+	}
+	return i;
+}
 
 int
 btoupper(bstring b)
@@ -595,6 +931,10 @@ btoupper(bstring b)
 	    b->mlen <= 0) {
 		return BSTR_ERR;
 	}
+	if (bCtypeMode == BSTR_CTYPE_ASCII) {
+		bSimdAsciiToUpper(b->data, (size_t)b->slen);
+		return BSTR_OK;
+	}
 	for (i = 0, len = b->slen; i < len; i++) {
 		b->data[i] = (unsigned char)upcase(b->data[i]);
 	}
@@ -610,6 +950,10 @@ btolower(bstring b)
 	    b->mlen <= 0) {
 		return BSTR_ERR;
 	}
+	if (bCtypeMode == BSTR_CTYPE_ASCII) {
+		bSimdAsciiToLower(b->data, (size_t)b->slen);
+		return BSTR_OK;
+	}
 	for (i = 0, len = b->slen; i < len; i++) {
 		b->data[i] = (unsigned char)downcase(b->data[i]);
 	}
@@ -629,11 +973,9 @@ bstricmp(const bstring b0, const bstring b1)
 	} else if (b0->slen == b1->slen && b0->data == b1->data) {
 		return BSTR_OK;
 	}
-	for (i = 0; i < n; i ++) {
-		v  = (char)downcase(b0->data[i]) - (char)downcase(b1->data[i]);
-		if (0 != v) {
-			return v;
-		}
+	i = bCaselessMismatch(b0->data, b1->data, n);
+	if (i < n) {
+		return (char)downcase(b0->data[i]) - (char)downcase(b1->data[i]);
 	}
 	if (b0->slen > n) {
 		v = (char)downcase(b0->data[n]);
@@ -669,12 +1011,9 @@ bstrnicmp(const bstring b0, const bstring b1, int n)
 		m = b1->slen;
 	}
 	if (b0->data != b1->data) {
-		for (i = 0; i < m; i ++) {
-			v  = (char)downcase(b0->data[i]);
-			v -= (char)downcase(b1->data[i]);
-			if (v != 0) {
-				return b0->data[i] - b1->data[i];
-			}
+		i = bCaselessMismatch(b0->data, b1->data, m);
+		if (i < m) {
+			return b0->data[i] - b1->data[i];
 		}
 	}
 	if (n == m || b0->slen == b1->slen) {
@@ -697,7 +1036,6 @@ bstrnicmp(const bstring b0, const bstring b1, int n)
 int
 biseqcaselessblk(const bstring b, const void *blk, int len)
 {
-	int i;
 	if (bdata(b) == NULL || b->slen < 0 ||
 	    blk == NULL || len < 0) {
 		return BSTR_ERR;
@@ -708,15 +1046,7 @@ biseqcaselessblk(const bstring b, const void *blk, int len)
 	if (len == 0 || b->data == blk) {
 		return 1;
 	}
-	for (i = 0; i < len; i++) {
-		if (b->data[i] != ((const unsigned char *)blk)[i]) {
-			unsigned char c = (unsigned char)downcase(b->data[i]);
-			if (c != (unsigned char)downcase(((unsigned char *)blk)[i])) {
-				return 0;
-			}
-		}
-	}
-	return 1;
+	return bCaselessMismatch(b->data, (const unsigned char *)blk, len) == len;
 }
 
 int
@@ -731,7 +1061,6 @@ biseqcaseless(const bstring b0, const bstring b1)
 int
 bisstemeqcaselessblk(const bstring b0, const void *blk, int len)
 {
-	int i;
 	if (bdata(b0) == NULL || b0->slen < 0 || NULL == blk || len < 0) {
 		return BSTR_ERR;
 	}
@@ -741,15 +1070,8 @@ bisstemeqcaselessblk(const bstring b0, const void *blk, int len)
 	if (b0->data == (const unsigned char *)blk || len == 0) {
 		return 1;
 	}
-	for (i = 0; i < len; i++) {
-		if (b0->data[i] != ((const unsigned char *)blk)[i]) {
-			if (downcase(b0->data[i]) !=
-			    downcase(((const unsigned char *)blk)[i])) {
-				return 0;
-			}
-		}
-	}
-	return 1;
+	return bCaselessMismatch(b0->data, (const unsigned char *)blk,
+				 len) == len;
 }
 
 int
@@ -761,10 +1083,10 @@ bltrimws(bstring b)
 	    b->mlen <= 0) {
 		return BSTR_ERR;
 	}
-	for (len = b->slen, i = 0; i < len; i++) {
-		if (!wspace(b->data[i])) {
-			return bdelete(b, 0, i);
-		}
+	len = b->slen;
+	i = bSkipSpace(b->data, len);
+	if (i < len) {
+		return bdelete(b, 0, i);
 	}
 	b->data[0] = (unsigned char) '\0';
 	b->slen = 0;
@@ -782,14 +1104,13 @@ brtrimws(bstring b)
 	    b->mlen <= 0) {
 		return BSTR_ERR;
 	}
-	for (i = b->slen - 1; i >= 0; i--) {
-		if (!wspace(b->data[i])) {
-			if (b->mlen > i) {
-				b->data[i + 1] = (unsigned char)'\0';
-			}
-			b->slen = i + 1;
-			return BSTR_OK;
+	i = bSkipSpaceRev(b->data, b->slen);
+	if (i >= 0) {
+		if (b->mlen > i) {
+			b->data[i + 1] = (unsigned char)'\0';
 		}
+		b->slen = i + 1;
+		return BSTR_OK;
 	}
 	b->data[0] = (unsigned char)'\0';
 	b->slen = 0;
@@ -807,22 +1128,38 @@ btrimws(bstring b)
 	    b->mlen <= 0) {
 		return BSTR_ERR;
 	}
-	for (i = b->slen - 1; i >= 0; i--) {
-		if (!wspace(b->data[i])) {
-			if (b->mlen > i) {
-				b->data[i + 1] = (unsigned char)'\0';
-			}
-			b->slen = i + 1;
-			for (j = 0; wspace (b->data[j]); j++)
-				;
-			return bdelete(b, 0, j);
+	i = bSkipSpaceRev(b->data, b->slen);
+	if (i >= 0) {
+		if (b->mlen > i) {
+			b->data[i + 1] = (unsigned char)'\0';
 		}
+		b->slen = i + 1;
+		j = bSkipSpace(b->data, i);
+		return bdelete(b, 0, j);
 	}
 	b->data[0] = (unsigned char)'\0';
 	b->slen = 0;
 	return BSTR_OK;
 }
 
+/* Find the first byte at which a and b differ or a holds a '\0'. Short runs
+ * are compared in place, which is cheaper than a call to the vector kernel.
+ */
+static int
+bStrMismatch(const unsigned char *a, const unsigned char *b, int n)
+{
+	int i;
+	if (n >= 16) {
+		return (int)bSimdStrMismatch(a, b, (size_t)n);
+	}
+	for (i = 0; i < n; i++) {
+		if (a[i] != b[i] || a[i] == '\0') {
+			break;
+		}
+	}
+	return i;
+}
+
 int
 biseqblk(const bstring b, const void *blk, int len)
 {
@@ -868,12 +1205,7 @@ bisstemeqblk(const bstring b0, const void *blk, int len)
 	if (b0->data == (const unsigned char *)blk || len == 0) {
 		return 1;
 	}
-	for (int i = 0; i < len; i ++) {
-		if (b0->data[i] != ((const unsigned char *)blk)[i]) {
-			return BSTR_OK;
-		}
-	}
-	return 1;
+	return !memcmp(b0->data, blk, len);
 }
 
 int
@@ -910,7 +1242,7 @@ biseqcstrcaseless(const bstring b, const char *s)
 int
 bstrcmp(const bstring b0, const bstring b1)
 {
-	int i, v, n;
+	int i, n;
 	if (!b0 || !b1 || !b0->data || !b1->data ||
 	    b0->slen < 0 || b1->slen < 0) {
 		return SHRT_MIN;
@@ -922,14 +1254,9 @@ bstrcmp(const bstring b0, const bstring b1)
 	if (b0->slen == b1->slen && (b0->data == b1->data || b0->slen == 0)) {
 		return BSTR_OK;
 	}
-	for (i = 0; i < n; i ++) {
-		v = ((char)b0->data[i]) - ((char)b1->data[i]);
-		if (v != 0) {
-			return v;
-		}
-		if (b0->data[i] == (unsigned char)'\0') {
-			return BSTR_OK;
-		}
+	i = bStrMismatch(b0->data, b1->data, n);
+	if (i < n) {
+		return ((char)b0->data[i]) - ((char)b1->data[i]);
 	}
 	if (b0->slen > n) {
 		return 1;
@@ -943,7 +1270,7 @@ bstrcmp(const bstring b0, const bstring b1)
 int
 bstrncmp(const bstring b0, const bstring b1, int n)
 {
-	int i, v, m;
+	int i, m;
 	if (!b0 || !b1 || !b0->data || !b1->data ||
 	    b0->slen < 0 || b1->slen < 0) {
 		return SHRT_MIN;
@@ -956,14 +1283,9 @@ bstrncmp(const bstring b0, const bstring b1, int n)
 		m = b1->slen;
 	}
 	if (b0->data != b1->data) {
-		for (i = 0; i < m; i++) {
-			v = ((char)b0->data[i]) - ((char)b1->data[i]);
-			if (v != 0) {
-				return v;
-			}
-			if (b0->data[i] == (unsigned char)'\0') {
-				return BSTR_OK;
-			}
+		i = bStrMismatch(b0->data, b1->data, m);
+		if (i < m) {
+			return ((char)b0->data[i]) - ((char)b1->data[i]);
 		}
 	}
 	if (n == m || b0->slen == b1->slen) {
@@ -975,26 +1297,218 @@ bstrncmp(const bstring b0, const bstring b1, int n)
 	return -1;
 }
 
-bstring
-bmidstr(const bstring b, int left, int len)
-{
-	if (b == NULL || b->slen < 0 || b->data == NULL) {
-		return NULL;
-	}
-	if (left < 0) {
-		len += left;
-		left = 0;
-	}
-	if (len > b->slen - left) {
-		len = b->slen - left;
-	}
-	if (len <= 0) {
-		return bfromcstr("");
-	}
-	return blk2bstr(b->data + left, len);
-}
+/* The hash follows the construction of wyhash: input is consumed in 16 byte
+ * blocks, each folded into the state with a 64 x 64 -> 128 bit multiply
+ * whose halves are xored together.
+ */
+#define BHASH_S0 (0xa0761d6478bd642full)
+#define BHASH_S1 (0xe7037ed1a0b428dbull)
+#define BHASH_S2 (0x8ebc6af09c88c6e3ull)
+#define BHASH_S3 (0x589965cc75374cc3ull)
 
-int
+/* How the bytes are folded as they are read */
+#define BHASH_EXACT (0)
+#define BHASH_ASCII (1)
+#define BHASH_LOCALE (2)
+
+static void
+bHashMum(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+	__extension__ typedef unsigned __int128 bHashU128;
+	bHashU128 r = (bHashU128)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32;
+	uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl, lo;
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static uint64_t
+bHashMix(uint64_t a, uint64_t b)
+{
+	bHashMum(&a, &b);
+	return a ^ b;
+}
+
+/* Read 8 or 4 bytes as a little endian value */
+#define bHashR8(p) \
+	((uint64_t)(p)[0] | (uint64_t)(p)[1] << 8 | \
+	 (uint64_t)(p)[2] << 16 | (uint64_t)(p)[3] << 24 | \
+	 (uint64_t)(p)[4] << 32 | (uint64_t)(p)[5] << 40 | \
+	 (uint64_t)(p)[6] << 48 | (uint64_t)(p)[7] << 56)
+#define bHashR4(p) \
+	((uint64_t)(p)[0] | (uint64_t)(p)[1] << 8 | \
+	 (uint64_t)(p)[2] << 16 | (uint64_t)(p)[3] << 24)
+
+/* Fold the bytes of v to lower case. In ASCII mode the letters of a whole
+ * word are found at once.
+ */
+static uint64_t
+bHashFoldAscii(uint64_t v)
+{
+	uint64_t t = v & 0x7f7f7f7f7f7f7f7full;
+	t = ((t + 0x3f3f3f3f3f3f3f3full) ^ (t + 0x2525252525252525ull)) &
+	    ~v & 0x8080808080808080ull;
+	return v | t >> 2;
+}
+
+static uint64_t
+bHashFoldLocale(uint64_t v)
+{
+	uint64_t t = 0;
+	int i;
+	for (i = 56; i >= 0; i -= 8) {
+		t = (t << 8) | (unsigned char)downcase((unsigned char)(v >> i));
+	}
+	return t;
+}
+
+#define bHashFold(v, fold) \
+	((fold) == BHASH_EXACT ? (v) : (fold) == BHASH_ASCII ? \
+	 bHashFoldAscii(v) : bHashFoldLocale(v))
+#define bHashRead8(p, fold) \
+	(bHashFold(bHashR8(p), (fold)))
+#define bHashRead4(p, fold) \
+	(bHashFold(bHashR4(p), (fold)))
+#define bHashRead1(p, fold) \
+	(bHashFold((uint64_t)(p)[0], (fold)))
+
+static uint64_t
+bHashCore(const unsigned char *p, size_t len, uint64_t seed, int fold)
+{
+	uint64_t a, b, see1, see2;
+	size_t i = len;
+	seed ^= bHashMix(seed ^ BHASH_S0, BHASH_S1);
+	if (len <= 16) {
+		if (len >= 4) {
+			size_t d = (len >> 3) << 2;
+			a = (bHashRead4(p, fold) << 32) |
+			    bHashRead4(p + d, fold);
+			b = (bHashRead4(p + len - 4, fold) << 32) |
+			    bHashRead4(p + len - 4 - d, fold);
+		} else if (len > 0) {
+			a = (bHashRead1(p, fold) << 16) |
+			    (bHashRead1(p + (len >> 1), fold) << 8) |
+			    bHashRead1(p + len - 1, fold);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		if (i > 48) {
+			see1 = see2 = seed;
+			do {
+				seed = bHashMix(bHashRead8(p, fold) ^ BHASH_S1,
+					bHashRead8(p + 8, fold) ^ seed);
+				see1 = bHashMix(bHashRead8(p + 16, fold) ^
+					BHASH_S2, bHashRead8(p + 24, fold) ^ see1);
+				see2 = bHashMix(bHashRead8(p + 32, fold) ^
+					BHASH_S3, bHashRead8(p + 40, fold) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16) {
+			seed = bHashMix(bHashRead8(p, fold) ^ BHASH_S1,
+					bHashRead8(p + 8, fold) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		a = bHashRead8(p + i - 16, fold);
+		b = bHashRead8(p + i - 8, fold);
+	}
+	a ^= BHASH_S1;
+	b ^= seed;
+	bHashMum(&a, &b);
+	return bHashMix(a ^ BHASH_S0 ^ len, b ^ BHASH_S1);
+}
+
+uint64_t
+bhashblk(const void *blk, int len, uint64_t seed)
+{
+	if (blk == NULL || len < 0) {
+		return 0;
+	}
+	return bHashCore((const unsigned char *)blk, (size_t)len, seed,
+			 BHASH_EXACT);
+}
+
+uint64_t
+bhash(const bstring b, uint64_t seed)
+{
+	if (b == NULL || b->data == NULL || b->slen < 0) {
+		return 0;
+	}
+	return bHashCore(b->data, (size_t)b->slen, seed, BHASH_EXACT);
+}
+
+uint64_t
+bhashcaseless(const bstring b, uint64_t seed)
+{
+	if (b == NULL || b->data == NULL || b->slen < 0) {
+		return 0;
+	}
+	return bHashCore(b->data, (size_t)b->slen, seed,
+			 bCtypeMode == BSTR_CTYPE_ASCII ?
+			 BHASH_ASCII : BHASH_LOCALE);
+}
+
+int
+bhashkeyinit(struct bstrHashKey *k, const bstring b, uint64_t seed)
+{
+	if (k == NULL || b == NULL || b->data == NULL || b->slen < 0) {
+		return BSTR_ERR;
+	}
+	blk2tbstr(k->str, b->data, b->slen);
+	bwriteprotect(k->str);
+	k->seed = seed;
+	k->hash = bHashCore(b->data, (size_t)b->slen, seed, BHASH_EXACT);
+	return BSTR_OK;
+}
+
+uint64_t
+bhashkey(struct bstrHashKey *k, uint64_t seed)
+{
+	if (k == NULL) {
+		return 0;
+	}
+	if (k->seed != seed) {
+		k->hash = bHashCore(k->str.data, (size_t)k->str.slen, seed,
+				    BHASH_EXACT);
+		k->seed = seed;
+	}
+	return k->hash;
+}
+
+bstring
+bmidstr(const bstring b, int left, int len)
+{
+	if (b == NULL || b->slen < 0 || b->data == NULL) {
+		return NULL;
+	}
+	if (left < 0) {
+		len += left;
+		left = 0;
+	}
+	if (len > b->slen - left) {
+		len = b->slen - left;
+	}
+	if (len <= 0) {
+		return bfromcstr("");
+	}
+	return blk2bstr(b->data + left, len);
+}
+
+int
 bdelete(bstring b, int pos, int len)
 {
 	/* Clamp to left side of bstring */
@@ -1028,8 +1542,8 @@ bdestroy(bstring b)
 	    b->data == NULL) {
 		return BSTR_ERR;
 	}
-	if (b->data != NULL) {
-		free(b->data);
+	if (!bIsPacked(b)) {
+		bMemFree(b->data);
 	}
 	/* In case there is any stale usage, there is one more chance to
 	 * notice this error.
@@ -1037,19 +1551,14 @@ bdestroy(bstring b)
 	b->slen = -1;
 	b->mlen = -__LINE__;
 	b->data = NULL;
-	free(b);
+	bMemFree(b);
 	return BSTR_OK;
 }
 
 int
 binstr(const bstring b1, int pos, const bstring b2)
 {
-	int j, ii, ll, lf;
-	unsigned char *d0;
-	unsigned char c0;
-	register unsigned char *d1;
-	register unsigned char c1;
-	register int i;
+	const unsigned char *p;
 	if (b1 == NULL || b1->data == NULL || b1->slen < 0 ||
 	    b2 == NULL || b2->data == NULL || b2->slen < 0) {
 		return BSTR_ERR;
@@ -1064,69 +1573,17 @@ binstr(const bstring b1, int pos, const bstring b2)
 		return pos;
 	}
 	/* No space to find such a string? */
-	if ((lf = b1->slen - b2->slen + 1) <= pos) {
+	if (b1->slen - b2->slen + 1 <= pos) {
 		return BSTR_ERR;
 	}
 	/* An obvious alias case */
 	if (b1->data == b2->data && pos == 0) {
 		return 0;
 	}
-	i = pos;
-	d0 = b2->data;
-	d1 = b1->data;
-	ll = b2->slen;
-	/* Peel off the b2->slen == 1 case */
-	c0 = d0[0];
-	if (1 == ll) {
-		for (; i < lf; i++) {
-			if (c0 == d1[i]) {
-				return i;
-			}
-		}
-		return BSTR_ERR;
-	}
-	c1 = c0;
-	j = 0;
-	lf = b1->slen - 1;
-	ii = -1;
-	if (i < lf) {
-		do {
-			/* Unrolled current character test */
-			if (c1 != d1[i]) {
-				if (c1 != d1[1+i]) {
-					i += 2;
-					continue;
-				}
-				i++;
-			}
-			/* Take note if this is the start of a potential
-			 * match
-			 */
-			if (0 == j) {
-				ii = i;
-			}
-			/* Shift the test character down by one */
-			j++;
-			i++;
-			/* If this isn't past the last character continue */
-			if (j < ll) {
-				c1 = d0[j];
-				continue;
-			}
-N0:
-			/* If no characters mismatched, then we matched */
-			if (i == ii + j) {
-				return ii;
-			}
-			/* Shift back to the beginning */
-			i -= j;
-			j  = 0;
-			c1 = c0;
-		} while (i < lf);
-	}
-	/* Deal with last case if unrolling caused a misalignment */
-	if (i == lf && ll == j + 1 && c1 == d1[i]) {
-		goto N0;
+	p = bSimdMemmem(b1->data + pos, (size_t)(b1->slen - pos),
+			b2->data, (size_t)b2->slen);
+	if (p) {
+		return (int)(p - b1->data);
 	}
 	return BSTR_ERR;
 }
@@ -1134,8 +1591,8 @@ N0:
 int
 binstrr(const bstring b1, int pos, const bstring b2)
 {
-	int j, i, l;
-	unsigned char *d0, *d1;
+	int i, l;
+	const unsigned char *p;
 	if (b1 == NULL || b1->data == NULL || b1->slen < 0 ||
 	    b2 == NULL || b2->data == NULL || b2->slen < 0) {
 		return BSTR_ERR;
@@ -1161,23 +1618,10 @@ binstrr(const bstring b1, int pos, const bstring b2)
 	if (l + 1 <= i) {
 		i = l;
 	}
-	j = 0;
-	d0 = b2->data;
-	d1 = b1->data;
-	l  = b2->slen;
-	while (1) {
-		if (d0[j] == d1[i + j]) {
-			j++;
-			if (j >= l) {
-				return i;
-			}
-		} else {
-			i--;
-			if (i < 0) {
-				break;
-			}
-			j = 0;
-		}
+	p = bSimdMemrmem(b1->data, (size_t)i + (size_t)b2->slen,
+			 b2->data, (size_t)b2->slen);
+	if (p) {
+		return (int)(p - b1->data);
 	}
 	return BSTR_ERR;
 }
@@ -1287,12 +1731,12 @@ binstrrcaseless(const bstring b1, int pos, const bstring b2)
 int
 bstrchrp(const bstring b, int c, int pos)
 {
-	unsigned char *p;
+	const unsigned char *p;
 	if (b == NULL || b->data == NULL || b->slen <= pos || pos < 0) {
 		return BSTR_ERR;
 	}
-	p = (unsigned char *)memchr((b->data + pos), (unsigned char)c,
-				    (b->slen - pos));
+	p = bSimdMemchr(b->data + pos, (unsigned char)c,
+			(size_t)(b->slen - pos));
 	if (p) {
 		return (int)(p - b->data);
 	}
@@ -1302,35 +1746,35 @@ bstrchrp(const bstring b, int c, int pos)
 int
 bstrrchrp(const bstring b, int c, int pos)
 {
-	int i;
+	const unsigned char *p;
 	if (b == NULL || b->data == NULL || b->slen <= pos || pos < 0) {
 		return BSTR_ERR;
 	}
-	for (i = pos; i >= 0; i--) {
-		if (b->data[i] == (unsigned char)c) {
-			return i;
-		}
+	p = bSimdMemrchr(b->data, (unsigned char)c, (size_t)pos + 1);
+	if (p) {
+		return (int)(p - b->data);
 	}
 	return BSTR_ERR;
 }
 
 #ifndef BSTRLIB_AGGRESSIVE_MEMORY_FOR_SPEED_TRADEOFF
-#define LONG_LOG_BITS_QTY (3)
-#define LONG_BITS_QTY \
-	(1 << LONG_LOG_BITS_QTY)
-#define LONG_TYPE unsigned char
+/* The layout is the one the vector kernels work on */
 #define CFCLEN \
-	((1 << CHAR_BIT) / LONG_BITS_QTY)
+	(BSTR_SIMD_SET_SIZE)
 struct charField {
-	LONG_TYPE content[CFCLEN];
+	unsigned char content[CFCLEN];
 };
 #define testInCharField(cf, c) \
-	((cf)->content[(c) >> LONG_LOG_BITS_QTY] & (((long)1) << ((c) & (LONG_BITS_QTY-1))))
+	(bSimdSetTest((cf)->content, (unsigned char)(c)))
 #define setInCharField(cf, idx) \
 do { \
 	unsigned int c = (unsigned int)(idx); \
-	(cf)->content[c >> LONG_LOG_BITS_QTY] |= (LONG_TYPE)(1ul << (c & (LONG_BITS_QTY-1))); \
+	(cf)->content[bSimdSetIndex(c)] |= (unsigned char)bSimdSetBit(c); \
 } while (0)
+#define findInCharField(cf, p, n) \
+	(bSimdSetFind((cf)->content, (p), (n)))
+#define findLastInCharField(cf, p, n) \
+	(bSimdSetFindLast((cf)->content, (p), (n)))
 #else /* BSTRLIB_AGGRESSIVE_MEMORY_FOR_SPEED_TRADEOFF */
 #define CFCLEN \
 	(1 << CHAR_BIT)
@@ -1341,6 +1785,31 @@ struct charField {
 	((cf)->content[(unsigned char) (c)])
 #define setInCharField(cf, idx) \
 	(cf)->content[(unsigned int) (idx)] = ~0
+
+static const unsigned char *
+findInCharField(const struct charField *cf, const unsigned char *p, size_t n)
+{
+	size_t i;
+	for (i = 0; i < n; i++) {
+		if (testInCharField(cf, p[i])) {
+			return p + i;
+		}
+	}
+	return NULL;
+}
+
+static const unsigned char *
+findLastInCharField(const struct charField *cf, const unsigned char *p,
+		    size_t n)
+{
+	while (n > 0) {
+		n--;
+		if (testInCharField(cf, p[n])) {
+			return p + n;
+		}
+	}
+	return NULL;
+}
 #endif /* BSTRLIB_AGGRESSIVE_MEMORY_FOR_SPEED_TRADEOFF */
 
 /* Convert a bstring to charField */
@@ -1372,14 +1841,12 @@ static int
 binchrCF(const unsigned char *data, int len, int pos,
 	 const struct charField *cf)
 {
-	int i;
-	for (i = pos; i < len; i++) {
-		unsigned char c = (unsigned char)data[i];
-		if (testInCharField(cf, c)) {
-			return i;
-		}
+	const unsigned char *p;
+	if (pos >= len) {
+		return BSTR_ERR;
 	}
-	return BSTR_ERR;
+	p = findInCharField(cf, data + pos, (size_t)(len - pos));
+	return p ? (int)(p - data) : BSTR_ERR;
 }
 
 int
@@ -1403,14 +1870,12 @@ binchr(const bstring b0, int pos, const bstring b1)
 static int
 binchrrCF(const unsigned char *data, int pos, const struct charField *cf)
 {
-	int i;
-	for (i = pos; i >= 0; i--) {
-		unsigned int c = (unsigned int)data[i];
-		if (testInCharField(cf, c)) {
-			return i;
-		}
+	const unsigned char *p;
+	if (pos < 0) {
+		return BSTR_ERR;
 	}
-	return BSTR_ERR;
+	p = findLastInCharField(cf, data, (size_t)pos + 1);
+	return p ? (int)(p - data) : BSTR_ERR;
 }
 
 int
@@ -1539,7 +2004,7 @@ binsertblk(bstring b, int pos, const void *blk, int len,
 	/* Aliasing case */
 	if (((size_t)((const unsigned char *)blk + len)) >= ((size_t)b->data) &&
 	    ((size_t)blk) < ((size_t)(b->data + b->mlen))) {
-		if (NULL == (aux = (unsigned char *)malloc(len))) {
+		if (NULL == (aux = (unsigned char *)bMemAlloc(len))) {
 			return BSTR_ERR;
 		}
 		memcpy(aux, blk, len);
@@ -1548,7 +2013,7 @@ binsertblk(bstring b, int pos, const void *blk, int len,
 		/* Inserting past the end of the string */
 		if (balloc(b, l + 1) != BSTR_OK) {
 			if (aux != (const unsigned char *)blk) {
-				free(aux);
+				bMemFree(aux);
 			}
 			return BSTR_ERR;
 		}
@@ -1559,7 +2024,7 @@ binsertblk(bstring b, int pos, const void *blk, int len,
 		/* Inserting in the middle of the string */
 		if (balloc(b, d + 1) != BSTR_OK) {
 			if (aux != (const unsigned char *)blk) {
-				free(aux);
+				bMemFree(aux);
 			}
 			return BSTR_ERR;
 		}
@@ -1569,7 +2034,7 @@ binsertblk(bstring b, int pos, const void *blk, int len,
 	bBlockCopy(b->data + pos, aux, len);
 	b->data[b->slen] = (unsigned char)'\0';
 	if (aux != (const unsigned char *)blk) {
-		free(aux);
+		bMemFree(aux);
 	}
 	return BSTR_OK;
 }
@@ -1647,14 +2112,19 @@ typedef int (*instr_fnptr)(const bstring s1, int pos, const bstring s2);
 #define INITIAL_STATIC_FIND_INDEX_COUNT 32
 
 /*
- *  findreplaceengine is used to implement bfindreplace and
- *  bfindreplacecaseless. It works by breaking the three cases of
- *  expansion, reduction and replacement, and solving each of these
- *  in the most efficient way possible.
+ *  findreplaceengine is used to implement bfindreplace,
+ *  bfindreplacecaseless and bfindreplaceNeedle. It works by breaking the
+ *  three cases of expansion, reduction and replacement, and solving each of
+ *  these in the most efficient way possible. When nd is not NULL it is used
+ *  for the searches in place of instr, and find must describe its pattern.
  */
+
+#define engineinstr(p) \
+	((nd) ? binstrNeedle(b, (p), (nd)) : instr(b, (p), auxf))
+
 static int
 findreplaceengine(bstring b, const bstring find, const bstring repl,
-		  int pos, instr_fnptr instr)
+		  int pos, instr_fnptr instr, const struct bNeedle *nd)
 {
 	int i, ret, slen, mlen, delta, acc;
 	int *d;
@@ -1697,7 +2167,7 @@ findreplaceengine(bstring b, const bstring find, const bstring repl,
 	 * length
 	 */
 	if (delta == 0) {
-		while ((pos = instr(b, pos, auxf)) >= 0) {
+		while ((pos = engineinstr(pos)) >= 0) {
 			memcpy(b->data + pos, auxr->data, auxr->slen);
 			pos += auxf->slen;
 		}
@@ -1712,7 +2182,7 @@ findreplaceengine(bstring b, const bstring find, const bstring repl,
 	/* shrinking replacement since auxf->slen > auxr->slen */
 	if (delta > 0) {
 		acc = 0;
-		while ((i = instr (b, pos, auxf)) >= 0) {
+		while ((i = engineinstr(pos)) >= 0) {
 			if (acc && i > pos) {
 				memmove(b->data + pos - acc, b->data + pos,
 					i - pos);
@@ -1760,7 +2230,7 @@ findreplaceengine(bstring b, const bstring find, const bstring repl,
 	mlen = INITIAL_STATIC_FIND_INDEX_COUNT;
 	d = (int *) static_d; /* Avoid malloc for trivial/initial cases */
 	acc = slen = 0;
-	while ((pos = instr(b, pos, auxf)) >= 0) {
+	while ((pos = engineinstr(pos)) >= 0) {
 		if (slen >= mlen - 1) {
 			int sl, *t;
 			/* Overflow */
@@ -1774,7 +2244,7 @@ findreplaceengine(bstring b, const bstring find, const bstring repl,
 				/* static_d cannot be realloced */
 				d = NULL;
 			}
-			if (NULL == (t = (int *) realloc(d, sl))) {
+			if (NULL == (t = (int *) bMemRealloc(d, sl))) {
 				ret = BSTR_ERR;
 				goto done;
 			}
@@ -1816,7 +2286,7 @@ done:
 	if (static_d == d) {
 		d = NULL;
 	}
-	free(d);
+	bMemFree(d);
 	if (auxf != find) {
 		bdestroy(auxf);
 	}
@@ -1829,13 +2299,147 @@ done:
 int
 bfindreplace(bstring b, const bstring find, const bstring repl, int pos)
 {
-	return findreplaceengine(b, find, repl, pos, binstr);
+	return findreplaceengine(b, find, repl, pos, binstr, NULL);
 }
 
 int
 bfindreplacecaseless(bstring b, const bstring find, const bstring repl, int pos)
 {
-	return findreplaceengine(b, find, repl, pos, binstrcaseless);
+	return findreplaceengine(b, find, repl, pos, binstrcaseless, NULL);
+}
+
+/* Case sensitive needles shorter than this are searched for with the vector
+ * kernels, which beat the skip loop until the skips become long.
+ */
+#define BNEEDLE_SKIP_MIN (160)
+
+struct bNeedle {
+	int slen;
+	int caseless;
+	unsigned char *data;
+	int skip[UCHAR_MAX + 1];
+	unsigned char fold[UCHAR_MAX + 1];
+};
+
+static struct bNeedle *
+bneedlecompile(const bstring find, int caseless)
+{
+	struct bNeedle *nd;
+	int i, last, skip[UCHAR_MAX + 1];
+	if (find == NULL || find->data == NULL || find->slen <= 0) {
+		return NULL;
+	}
+	nd = (struct bNeedle *)bMemAlloc(sizeof(struct bNeedle) + find->slen);
+	if (nd == NULL) {
+		return NULL;
+	}
+	nd->data = (unsigned char *)(nd + 1);
+	nd->slen = find->slen;
+	nd->caseless = caseless;
+	for (i = 0; i <= UCHAR_MAX; i++) {
+		nd->fold[i] = caseless ? (unsigned char)downcase(i)
+				       : (unsigned char)i;
+	}
+	for (i = 0; i < find->slen; i++) {
+		nd->data[i] = nd->fold[find->data[i]];
+	}
+	/* Horspool skip table, built over folded characters and then
+	 * expanded so that it can be indexed with raw ones.
+	 */
+	last = nd->slen - 1;
+	for (i = 0; i <= UCHAR_MAX; i++) {
+		skip[i] = nd->slen;
+	}
+	for (i = 0; i < last; i++) {
+		skip[nd->data[i]] = last - i;
+	}
+	for (i = 0; i <= UCHAR_MAX; i++) {
+		nd->skip[i] = skip[nd->fold[i]];
+	}
+	return nd;
+}
+
+struct bNeedle *
+bNeedleCreate(const bstring find)
+{
+	return bneedlecompile(find, 0);
+}
+
+struct bNeedle *
+bNeedleCreateCaseless(const bstring find)
+{
+	return bneedlecompile(find, 1);
+}
+
+int
+bNeedleDestroy(struct bNeedle *nd)
+{
+	if (nd == NULL) {
+		return BSTR_ERR;
+	}
+	bMemFree(nd);
+	return BSTR_OK;
+}
+
+int
+binstrNeedle(const bstring b, int pos, const struct bNeedle *nd)
+{
+	int i, j, last, end;
+	unsigned char c, c1;
+	const unsigned char *d;
+	if (b == NULL || b->data == NULL || b->slen < 0 || nd == NULL) {
+		return BSTR_ERR;
+	}
+	if (pos < 0 || (end = b->slen - nd->slen) < pos) {
+		return BSTR_ERR;
+	}
+	d = b->data;
+	if (!nd->caseless && nd->slen < BNEEDLE_SKIP_MIN) {
+		const unsigned char *p;
+		p = bSimdMemmem(d + pos, (size_t)(b->slen - pos),
+				nd->data, (size_t)nd->slen);
+		return p ? (int)(p - d) : BSTR_ERR;
+	}
+	last = nd->slen - 1;
+	c1 = nd->data[last];
+	i = pos;
+	if (!nd->caseless) {
+		while (i <= end) {
+			c = d[i + last];
+			if (c == c1 && !memcmp(d + i, nd->data, last)) {
+				return i;
+			}
+			i += nd->skip[c];
+		}
+		return BSTR_ERR;
+	}
+	while (i <= end) {
+		c = d[i + last];
+		if (nd->fold[c] == c1) {
+			for (j = 0; j < last; j++) {
+				if (nd->fold[d[i + j]] != nd->data[j]) {
+					break;
+				}
+			}
+			if (j == last) {
+				return i;
+			}
+		}
+		i += nd->skip[c];
+	}
+	return BSTR_ERR;
+}
+
+int
+bfindreplaceNeedle(bstring b, const struct bNeedle *find, const bstring repl,
+		   int pos)
+{
+	struct tagbstring t;
+	if (find == NULL) {
+		return BSTR_ERR;
+	}
+	blk2tbstr(t, find->data, find->slen);
+	return findreplaceengine(b, &t, repl, pos, binstr, find);
 }
 
 int
@@ -2017,10 +2621,14 @@ bgets(bNgetc getcPtr, void *parm, char terminator)
 
 struct bStream {
 	bstring buff; /* Buffer for over-reads */
+	int buffpos; /* Offset of the first unread byte of buff */
 	void *parm; /* The stream handle for core stream */
 	bNread readFnPtr; /* fread compatible fnptr for core stream */
 	int isEOF; /* track file's EOF state */
 	int maxBuffSz;
+	const unsigned char *map; /* Contents of a memory mapped file */
+	size_t maplen;
+	size_t mappos; /* Offset of the next unread byte of the mapping */
 };
 
 struct bStream *
@@ -2030,85 +2638,312 @@ bsopen (bNread readPtr, void *parm)
 	if (readPtr == NULL) {
 		return NULL;
 	}
-	s = malloc(sizeof (struct bStream));
+	s = bMemAlloc(sizeof (struct bStream));
 	if (!s) {
 		return NULL;
 	}
 	s->parm = parm;
 	s->buff = bfromcstr ("");
+	s->buffpos = 0;
 	s->readFnPtr = readPtr;
 	s->maxBuffSz = BS_BUFF_SZ;
 	s->isEOF = 0;
+	s->map = NULL;
+	s->maplen = 0;
+	s->mappos = 0;
 	return s;
 }
 
-int bsbufflength(struct bStream *s, int sz)
+/* The line readers consume the buffer by advancing buffpos rather than
+ * moving the rest of it down for every line. Functions which work on the
+ * whole buffer call this first to drop the consumed bytes.
+ */
+static void
+bscompact(struct bStream *s)
 {
-	int oldSz;
-	if (!s || sz < 0) {
-		return BSTR_ERR;
-	}
-	oldSz = s->maxBuffSz;
-	if (sz > 0) {
-		s->maxBuffSz = sz;
+	if (s->buffpos > 0) {
+		bdelete(s->buff, 0, s->buffpos);
+		s->buffpos = 0;
 	}
-	return oldSz;
 }
 
-int
-bseof(const struct bStream *s)
+static size_t
+bsmapread(void *buff, size_t elsize, size_t nelem, void *parm)
 {
-	if (!s || !s->readFnPtr) {
-		return BSTR_ERR;
+	struct bStream *s = (struct bStream *)parm;
+	size_t n, rem = s->maplen - s->mappos;
+	if (elsize == 0 || nelem == 0) {
+		return 0;
 	}
-	return s->isEOF && (s->buff->slen == 0);
+	n = rem / elsize < nelem ? rem / elsize : nelem;
+	if (n > 0) {
+		memcpy(buff, s->map + s->mappos, n * elsize);
+		s->mappos += n * elsize;
+	}
+	return n;
 }
 
-void *
-bsclose(struct bStream *s)
+#if defined(_WIN32)
+
+static const unsigned char *
+bsmapfile(const char *path, size_t *len)
 {
-	void *parm;
-	if (s == NULL) {
+	HANDLE f, m;
+	LARGE_INTEGER sz;
+	void *p = NULL;
+	f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (f == INVALID_HANDLE_VALUE) {
 		return NULL;
 	}
-	s->readFnPtr = NULL;
-	if (s->buff) {
-		bdestroy(s->buff);
+	if (!GetFileSizeEx(f, &sz) ||
+	    (unsigned long long)sz.QuadPart > (size_t)-1) {
+		CloseHandle(f);
+		return NULL;
 	}
-	s->buff = NULL;
-	parm = s->parm;
-	s->parm = NULL;
-	s->isEOF = 1;
-	free(s);
-	return parm;
+	*len = (size_t)sz.QuadPart;
+	if (*len == 0) {
+		/* Empty files cannot be mapped, but are still readable */
+		CloseHandle(f);
+		return (const unsigned char *)"";
+	}
+	m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(f);
+	if (m == NULL) {
+		return NULL;
+	}
+	/* The view keeps the mapping object alive after its handle is closed */
+	p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(m);
+	return (const unsigned char *)p;
 }
 
-int
-bsreadlna(bstring r, struct bStream *s, char terminator)
+static void
+bsunmapfile(const unsigned char *p, size_t len)
 {
-	int i, l, ret, rlo;
-	char *b;
-	struct tagbstring x;
-	if (!s || !s->buff ||
-	    !r || r->mlen <= 0 ||
-	    r->slen < 0 || r->mlen < r->slen) {
-		return BSTR_ERR;
+	if (len > 0) {
+		UnmapViewOfFile(p);
 	}
-	l = s->buff->slen;
-	if (BSTR_OK != balloc(s->buff, s->maxBuffSz + 1)) {
-		return BSTR_ERR;
+}
+
+#elif defined(BSTR_HAVE_MMAP)
+
+static const unsigned char *
+bsmapfile(const char *path, size_t *len)
+{
+	struct stat st;
+	void *p;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
 	}
-	b = (char *)s->buff->data;
-	x.data = (unsigned char *)b;
-	/* First check if the current buffer holds the terminator */
-	b[l] = terminator; /* Set sentinel */
-	for (i=0; b[i] != terminator; i++) ;
-	if (i < l) {
+	if (fstat(fd, &st) != 0 || st.st_size < 0 ||
+	    (off_t)(size_t)st.st_size != st.st_size) {
+		close(fd);
+		return NULL;
+	}
+	*len = (size_t)st.st_size;
+	if (*len == 0) {
+		/* Empty files cannot be mapped, but are still readable */
+		close(fd);
+		return (const unsigned char *)"";
+	}
+	p = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		return NULL;
+	}
+	(void)posix_madvise(p, *len, POSIX_MADV_SEQUENTIAL);
+	return (const unsigned char *)p;
+}
+
+static void
+bsunmapfile(const unsigned char *p, size_t len)
+{
+	if (len > 0) {
+		munmap((void *)p, len);
+	}
+}
+
+#endif
+
+struct bStream *
+bsopenmmap(const char *path)
+{
+#if defined(BSTR_HAVE_MMAP)
+	struct bStream *s;
+	const unsigned char *p;
+	size_t len = 0;
+	if (path == NULL) {
+		return NULL;
+	}
+	s = bsopen(bsmapread, NULL);
+	if (s == NULL) {
+		return NULL;
+	}
+	if (s->buff == NULL || (p = bsmapfile(path, &len)) == NULL) {
+		bsclose(s);
+		return NULL;
+	}
+	s->parm = s;
+	s->map = p;
+	s->maplen = len;
+	s->isEOF = (len == 0);
+	return s;
+#else
+	(void)path;
+	return NULL;
+#endif
+}
+
+/* Data read from a mapped stream through the generic functions may be left
+ * over in the stream buffer. If it is still exactly the bytes preceding the
+ * read position, it is dropped by moving the position back, so that reading
+ * can continue straight from the mapping. Returns 1 if the buffer is empty
+ * on return, and 0 if it holds other data, for instance from bsunread.
+ */
+static int
+bsmapunbuffer(struct bStream *s)
+{
+	size_t l;
+	bscompact(s);
+	l = (size_t)s->buff->slen;
+	if (l == 0) {
+		return 1;
+	}
+	if (l > s->mappos ||
+	    memcmp(s->buff->data, s->map + s->mappos - l, l) != 0) {
+		return 0;
+	}
+	s->mappos -= l;
+	s->buff->slen = 0;
+	s->isEOF = 0;
+	return 1;
+}
+
+static void
+bsmapskip(struct bStream *s, size_t n)
+{
+	s->mappos += n;
+	s->isEOF = (s->mappos >= s->maplen);
+}
+
+/* Point t at the next line of a mapped stream, ending with the terminator
+ * or, if cf is not NULL, with any character in cf. The read position is not
+ * moved.
+ */
+static int
+bsmapline(struct bStream *s, const struct charField *cf, char terminator,
+	  struct tagbstring *t)
+{
+	const unsigned char *b = s->map + s->mappos, *q;
+	size_t n, rem = s->maplen - s->mappos;
+	if (rem == 0) {
+		s->isEOF = 1;
+		return BSTR_ERR;
+	}
+	if (cf == NULL) {
+		q = bSimdMemchr(b, (unsigned char)terminator, rem);
+		n = q ? (size_t)(q - b) + 1 : rem;
+	} else {
+		q = findInCharField(cf, b, rem);
+		n = q ? (size_t)(q - b) + 1 : rem;
+	}
+	if (n > INT_MAX) {
+		return BSTR_ERR;
+	}
+	t->data = (unsigned char *)b;
+	t->slen = (int)n;
+	t->mlen = -__LINE__;
+	return BSTR_OK;
+}
+
+int bsbufflength(struct bStream *s, int sz)
+{
+	int oldSz;
+	if (!s || sz < 0) {
+		return BSTR_ERR;
+	}
+	oldSz = s->maxBuffSz;
+	if (sz > 0) {
+		s->maxBuffSz = sz;
+	}
+	return oldSz;
+}
+
+int
+bseof(const struct bStream *s)
+{
+	if (!s || !s->readFnPtr) {
+		return BSTR_ERR;
+	}
+	return s->isEOF && (s->buff->slen == s->buffpos);
+}
+
+void *
+bsclose(struct bStream *s)
+{
+	void *parm;
+	if (s == NULL) {
+		return NULL;
+	}
+	s->readFnPtr = NULL;
+	if (s->buff) {
+		bdestroy(s->buff);
+	}
+	s->buff = NULL;
+	parm = s->parm;
+	s->parm = NULL;
+#if defined(BSTR_HAVE_MMAP)
+	if (s->map) {
+		bsunmapfile(s->map, s->maplen);
+		s->map = NULL;
+		parm = NULL;
+	}
+#endif
+	s->isEOF = 1;
+	bMemFree(s);
+	return parm;
+}
+
+int
+bsreadlna(bstring r, struct bStream *s, char terminator)
+{
+	int i, l, ret, rlo;
+	char *b;
+	const unsigned char *q;
+	struct tagbstring x;
+	if (!s || !s->buff ||
+	    !r || r->mlen <= 0 ||
+	    r->slen < 0 || r->mlen < r->slen) {
+		return BSTR_ERR;
+	}
+	if (s->map && bsmapunbuffer(s)) {
+		if (bsmapline(s, NULL, terminator, &x) != BSTR_OK ||
+		    bconcat(r, &x) != BSTR_OK) {
+			return BSTR_ERR;
+		}
+		bsmapskip(s, (size_t)x.slen);
+		return BSTR_OK;
+	}
+	l = s->buff->slen - s->buffpos;
+	if (BSTR_OK != balloc(s->buff, s->maxBuffSz + 1)) {
+		return BSTR_ERR;
+	}
+	b = (char *)s->buff->data + s->buffpos;
+	x.data = (unsigned char *)b;
+	/* First check if the current buffer holds the terminator */
+	q = bSimdMemchr((unsigned char *)b, (unsigned char)terminator,
+			(size_t)l);
+	if (q) {
+		i = (int)((const char *)q - b);
 		x.slen = i + 1;
 		ret = bconcat(r, &x);
-		s->buff->slen = l;
 		if (BSTR_OK == ret) {
-			bdelete(s->buff, 0, i + 1);
+			s->buffpos += i + 1;
+			if (s->buffpos == s->buff->slen) {
+				s->buff->slen = s->buffpos = 0;
+			}
 		}
 		return BSTR_OK;
 	}
@@ -2118,6 +2953,7 @@ bsreadlna(bstring r, struct bStream *s, char terminator)
 	if (BSTR_OK != bconcat(r, &x)) {
 		return BSTR_ERR;
 	}
+	s->buff->slen = s->buffpos = 0;
 	/* Perform direct in-place reads into the destination to allow for
 	 * the minimum of data-copies
 	 */
@@ -2134,10 +2970,10 @@ bsreadlna(bstring r, struct bStream *s, char terminator)
 			/* If nothing was read return with an error message */
 			return BSTR_ERR & -(r->slen == rlo);
 		}
-		b[l] = terminator; /* Set sentinel */
-		for (i=0; b[i] != terminator; i++)
-			;
-		if (i < l) {
+		q = bSimdMemchr((unsigned char *)b, (unsigned char)terminator,
+				(size_t)l);
+		if (q) {
+			i = (int)((const char *)q - b);
 			break;
 		}
 		r->slen += l;
@@ -2169,22 +3005,30 @@ bsreadlnsa(bstring r, struct bStream *s, const bstring term)
 	if (term->slen < 1 || buildCharField(&cf, term)) {
 		return BSTR_ERR;
 	}
-	l = s->buff->slen;
+	if (s->map && bsmapunbuffer(s)) {
+		if (bsmapline(s, &cf, '\0', &x) != BSTR_OK ||
+		    bconcat(r, &x) != BSTR_OK) {
+			return BSTR_ERR;
+		}
+		bsmapskip(s, (size_t)x.slen);
+		return BSTR_OK;
+	}
+	l = s->buff->slen - s->buffpos;
 	if (BSTR_OK != balloc(s->buff, s->maxBuffSz + 1)) {
 		return BSTR_ERR;
 	}
-	b = (unsigned char *)s->buff->data;
+	b = (unsigned char *)s->buff->data + s->buffpos;
 	x.data = b;
 	/* First check if the current buffer holds the terminator */
-	b[l] = term->data[0]; /* Set sentinel */
-	for (i = 0; !testInCharField(&cf, b[i]); i++)
-		;
-	if (i < l) {
+	i = binchrCF(b, l, 0, &cf);
+	if (i >= 0) {
 		x.slen = i + 1;
 		ret = bconcat(r, &x);
-		s->buff->slen = l;
 		if (BSTR_OK == ret) {
-			bdelete(s->buff, 0, i + 1);
+			s->buffpos += i + 1;
+			if (s->buffpos == s->buff->slen) {
+				s->buff->slen = s->buffpos = 0;
+			}
 		}
 		return BSTR_OK;
 	}
@@ -2194,6 +3038,7 @@ bsreadlnsa(bstring r, struct bStream *s, const bstring term)
 	if (BSTR_OK != bconcat(r, &x)) {
 		return BSTR_ERR;
 	}
+	s->buff->slen = s->buffpos = 0;
 	/* Perform direct in-place reads into the destination to allow for
 	 * the minimum of data-copies
 	 */
@@ -2210,10 +3055,8 @@ bsreadlnsa(bstring r, struct bStream *s, const bstring term)
 			/* If nothing was read return with an error message */
 			return BSTR_ERR & -(r->slen == rlo);
 		}
-		b[l] = term->data[0]; /* Set sentinel */
-		for (i = 0; !testInCharField(&cf, b[i]); i++)
-			;
-		if (i < l) {
+		i = binchrCF(b, l, 0, &cf);
+		if (i >= 0) {
 			break;
 		}
 		r->slen += l;
@@ -2241,6 +3084,7 @@ bsreada(bstring r, struct bStream *s, int n)
 		return BSTR_ERR;
 	}
 	n += r->slen;
+	bscompact(s);
 	l = s->buff->slen;
 	orslen = r->slen;
 	if (0 == l) {
@@ -2327,6 +3171,52 @@ bsreadlns(bstring r, struct bStream *s, const bstring term)
 	return bsreadlnsa(r, s, term);
 }
 
+bstring
+bsgets(struct bStream *s, char terminator)
+{
+	bstring b;
+	if (!s || !s->buff) {
+		return NULL;
+	}
+	if (0 > bsreadlna(b = bfromcstr(""), s, terminator)) {
+		bdestroy(b);
+		return NULL;
+	}
+	return b;
+}
+
+int
+bsreadlnview(struct tagbstring *t, struct bStream *s, char terminator)
+{
+	if (!t || !s || !s->buff || !s->map || !bsmapunbuffer(s)) {
+		return BSTR_ERR;
+	}
+	if (bsmapline(s, NULL, terminator, t) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	bsmapskip(s, (size_t)t->slen);
+	return BSTR_OK;
+}
+
+int
+bsreadlnsview(struct tagbstring *t, struct bStream *s, const bstring term)
+{
+	struct charField cf;
+	if (!t || !s || !s->buff || !s->map || !term || !term->data ||
+	    term->slen < 1 || !bsmapunbuffer(s)) {
+		return BSTR_ERR;
+	}
+	if (term->slen == 1) {
+		return bsreadlnview(t, s, (char)term->data[0]);
+	}
+	if (buildCharField(&cf, term) ||
+	    bsmapline(s, &cf, '\0', t) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	bsmapskip(s, (size_t)t->slen);
+	return BSTR_OK;
+}
+
 int
 bsread(bstring r, struct bStream *s, int n)
 {
@@ -2346,6 +3236,7 @@ bsunread(struct bStream *s, const bstring b)
 	if (!s || !s->buff) {
 		return BSTR_ERR;
 	}
+	bscompact(s);
 	return binsert(s->buff, 0, b, (unsigned char)'?');
 }
 
@@ -2355,7 +3246,8 @@ bspeek(bstring r, const struct bStream *s)
 	if (!s || !s->buff) {
 		return BSTR_ERR;
 	}
-	return bassign(r, s->buff);
+	return bassignblk(r, s->buff->data + s->buffpos,
+			  s->buff->slen - s->buffpos);
 }
 
 bstring
@@ -2386,11 +3278,11 @@ bjoinblk(const struct bstrList *bl, const void *blk, int len)
 			return NULL; /* Wrap around ?? */
 		}
 	}
-	b = (bstring)malloc(sizeof(struct tagbstring));
+	b = bHeaderAlloc();
 	if (len == 0) {
-		p = b->data = (unsigned char *)malloc(c);
+		p = b->data = bMemAlloc(c);
 		if (p == NULL) {
-			free(b);
+			bMemFree(b);
 			return NULL;
 		}
 		for (i = 0; i < bl->qty; i++) {
@@ -2408,9 +3300,9 @@ bjoinblk(const struct bstrList *bl, const void *blk, int len)
 		if (c < v) {
 			return NULL; /* Wrap around ?? */
 		}
-		p = b->data = (unsigned char *)malloc(c);
+		p = b->data = bMemAlloc(c);
 		if (p == NULL) {
-			free(b);
+			bMemFree(b);
 			return NULL;
 		}
 		v = bl->entry[0]->slen;
@@ -2446,6 +3338,58 @@ bjoin(const struct bstrList *bl, const bstring sep)
 
 #define BSSSC_BUFF_LEN (256)
 
+/* Split the rest of a mapped stream, handing cb views into the mapping. The
+ * separators are any character in cf or, if cf is NULL, the whole of
+ * splitStr. Returns 1 with the result in *ret once the split is complete,
+ * or 0 if cb left data in the stream buffer which did not come from the
+ * mapping, in which case the caller continues from offset *p.
+ */
+static int
+bsmapsplit(struct bStream *s, const struct charField *cf,
+	   const bstring splitStr,
+	   int (*cb)(void *parm, int ofs, const bstring entry),
+	   void *parm, int *p, int *ret)
+{
+	struct tagbstring t;
+	const unsigned char *b, *q;
+	size_t n, adv, rem, ofs = 0;
+	while (bsmapunbuffer(s)) {
+		b = s->map + s->mappos;
+		rem = s->maplen - s->mappos;
+		if (cf) {
+			q = findInCharField(cf, b, rem);
+			n = q ? (size_t)(q - b) : rem;
+			adv = n + (q != NULL);
+		} else {
+			q = bSimdMemmem(b, rem, splitStr->data,
+					(size_t)splitStr->slen);
+			n = q ? (size_t)(q - b) : rem;
+			adv = q ? n + (size_t)splitStr->slen : rem;
+		}
+		if (n > INT_MAX) {
+			*ret = BSTR_ERR;
+			return 1;
+		}
+		blk2tbstr(t, b, (int)n);
+		t.mlen = -__LINE__;
+		bsmapskip(s, adv);
+		/* Offsets beyond INT_MAX cannot be represented */
+		*ret = cb(parm, ofs > INT_MAX ? INT_MAX : (int)ofs, &t);
+		if (*ret < 0) {
+			return 1;
+		}
+		if (adv == n) {
+			if (*ret > 0) {
+				*ret = 0;
+			}
+			return 1;
+		}
+		ofs += adv;
+	}
+	*p = ofs > INT_MAX ? INT_MAX : (int)ofs;
+	return 0;
+}
+
 int
 bssplitscb(struct bStream *s, const bstring splitStr,
 	   int (*cb)(void *parm, int ofs, const bstring entry),
@@ -2458,6 +3402,13 @@ bssplitscb(struct bStream *s, const bstring splitStr,
 	    !splitStr || splitStr->slen < 0) {
 		return BSTR_ERR;
 	}
+	p = 0;
+	if (s->map && splitStr->slen > 0) {
+		buildCharField(&chrs, splitStr);
+		if (bsmapsplit(s, &chrs, NULL, cb, parm, &p, &ret)) {
+			return ret;
+		}
+	}
 	buff = bfromcstr ("");
 	if (!buff) {
 		return BSTR_ERR;
@@ -2470,7 +3421,7 @@ bssplitscb(struct bStream *s, const bstring splitStr,
 		}
 	} else {
 		buildCharField(&chrs, splitStr);
-		ret = p = i = 0;
+		ret = i = 0;
 		while (1) {
 			if (i >= buff->slen) {
 				bsreada(buff, s, BSSSC_BUFF_LEN);
@@ -2481,7 +3432,10 @@ bssplitscb(struct bStream *s, const bstring splitStr,
 					break;
 				}
 			}
-			if (testInCharField(&chrs, buff->data[i])) {
+			i = binchrCF(buff->data, buff->slen, i, &chrs);
+			if (i < 0) {
+				i = buff->slen;
+			} else {
 				struct tagbstring t;
 				unsigned char c;
 				blk2tbstr(t, buff->data + i + 1,
@@ -2498,9 +3452,8 @@ bssplitscb(struct bStream *s, const bstring splitStr,
 				buff->data[i] = c;
 				buff->slen = 0;
 				p += i + 1;
-				i = -1;
+				i = 0;
 			}
-			i++;
 		}
 	}
 	bdestroy(buff);
@@ -2521,6 +3474,11 @@ bssplitstrcb(struct bStream *s, const bstring splitStr,
 	if (splitStr->slen == 1) {
 		return bssplitscb(s, splitStr, cb, parm);
 	}
+	p = 0;
+	if (s->map && splitStr->slen > 0 &&
+	    bsmapsplit(s, NULL, splitStr, cb, parm, &p, &ret)) {
+		return ret;
+	}
 	buff = bfromcstr("");
 	if (!buff) {
 		return BSTR_ERR;
@@ -2536,8 +3494,8 @@ bssplitstrcb(struct bStream *s, const bstring splitStr,
 		bdestroy(buff);
 		return BSTR_OK;
 	} else {
-		ret = p = i = 0;
-		for (i = p = 0; ;) {
+		ret = i = 0;
+		for (i = 0; ;) {
 			ret = binstr(buff, 0, splitStr);
 			if (ret >= 0) {
 				struct tagbstring t;
@@ -2568,11 +3526,11 @@ bssplitstrcb(struct bStream *s, const bstring splitStr,
 struct bstrList *
 bstrListCreate(void)
 {
-	struct bstrList *sl = malloc(sizeof(struct bstrList));
+	struct bstrList *sl = bMemAlloc(sizeof(struct bstrList));
 	if (sl) {
-		sl->entry = (bstring *)malloc(1 * sizeof(bstring));
+		sl->entry = (bstring *)bMemAlloc(1 * sizeof(bstring));
 		if (!sl->entry) {
-			free(sl);
+			bMemFree(sl);
 			sl = NULL;
 		} else {
 			sl->qty = 0;
@@ -2597,9 +3555,9 @@ bstrListDestroy(struct bstrList *sl)
 	}
 	sl->qty  = -1;
 	sl->mlen = -1;
-	free(sl->entry);
+	bMemFree(sl->entry);
 	sl->entry = NULL;
-	free(sl);
+	bMemFree(sl);
 	return BSTR_OK;
 }
 
@@ -2622,11 +3580,11 @@ bstrListAlloc(struct bstrList *sl, int msz)
 	if (nsz < (size_t) smsz) {
 		return BSTR_ERR;
 	}
-	l = realloc(sl->entry, nsz);
+	l = bMemRealloc(sl->entry, nsz);
 	if (!l) {
 		smsz = msz;
 		nsz = ((size_t)smsz) * sizeof(bstring);
-		l = realloc(sl->entry, nsz);
+		l = bMemRealloc(sl->entry, nsz);
 		if (!l) {
 			return BSTR_ERR;
 		}
@@ -2656,7 +3614,7 @@ bstrListAllocMin(struct bstrList *sl, int msz)
 	if (nsz < (size_t)msz) {
 		return BSTR_ERR;
 	}
-	l = realloc(sl->entry, nsz);
+	l = bMemRealloc(sl->entry, nsz);
 	if (!l) {
 		return BSTR_ERR;
 	}
@@ -2665,22 +3623,50 @@ bstrListAllocMin(struct bstrList *sl, int msz)
 	return BSTR_OK;
 }
 
+int
+bstrListClear(struct bstrList *sl, struct bstrList *spare)
+{
+	int i;
+	if (!sl || !sl->entry || sl->qty < 0 ||
+	    sl->mlen <= 0 || sl->qty > sl->mlen || sl == spare) {
+		return BSTR_ERR;
+	}
+	if (!spare) {
+		for (i = 0; i < sl->qty; i++) {
+			bdestroy(sl->entry[i]);
+		}
+		sl->qty = 0;
+		return BSTR_OK;
+	}
+	if (sl->qty > 0 && (spare->qty > INT_MAX - sl->qty ||
+	    bstrListAlloc(spare, spare->qty + sl->qty) != BSTR_OK)) {
+		return BSTR_ERR;
+	}
+	/* In reverse, so that the spares are taken back in order */
+	for (i = sl->qty - 1; i >= 0; i--) {
+		if (sl->entry[i] != NULL) {
+			spare->entry[spare->qty++] = sl->entry[i];
+		}
+	}
+	sl->qty = 0;
+	return BSTR_OK;
+}
+
 int
 bsplitcb(const bstring str, unsigned char splitChar, int pos,
 	 int (*cb) (void *parm, int ofs, int len),
 	 void *parm)
 {
+	const unsigned char *q;
 	int i, p, ret;
 	if (!cb || !str || pos < 0 || pos > str->slen) {
 		return BSTR_ERR;
 	}
 	p = pos;
 	do {
-		for (i = p; i < str->slen; i++) {
-			if (str->data[i] == splitChar) {
-				break;
-			}
-		}
+		q = bSimdMemchr(str->data + p, splitChar,
+				(size_t)(str->slen - p));
+		i = q ? (int)(q - str->data) : str->slen;
 		if ((ret = cb(parm, p, i - p)) < 0) {
 			return ret;
 		}
@@ -2712,10 +3698,9 @@ bsplitscb(const bstring str, const bstring splitStr, int pos,
 	buildCharField(&chrs, splitStr);
 	p = pos;
 	do {
-		for (i = p; i < str->slen; i++) {
-			if (testInCharField(&chrs, str->data[i])) {
-				break;
-			}
+		i = binchrCF(str->data, str->slen, p, &chrs);
+		if (i < 0) {
+			i = str->slen;
 		}
 		if ((ret = cb(parm, p, i - p)) < 0) {
 			return ret;
@@ -2771,6 +3756,7 @@ bsplitstrcb(const bstring str, const bstring splitStr, int pos,
 struct genBstrList {
 	bstring b;
 	struct bstrList *bl;
+	struct bstrList *spare;
 };
 
 static int
@@ -2786,7 +3772,7 @@ bscb(void *parm, int ofs, int len)
 			}
 			mlen += mlen;
 		}
-		tbl = (bstring *)realloc(g->bl->entry, sizeof(bstring) * mlen);
+		tbl = (bstring *)bMemRealloc(g->bl->entry, sizeof(bstring) * mlen);
 		if (tbl == NULL) {
 			return BSTR_ERR;
 		}
@@ -2805,14 +3791,14 @@ bsplit(const bstring str, unsigned char splitChar)
 	if (!str || !str->data || str->slen < 0) {
 		return NULL;
 	}
-	g.bl = malloc(sizeof(struct bstrList));
+	g.bl = bMemAlloc(sizeof(struct bstrList));
 	if (!g.bl) {
 		return NULL;
 	}
 	g.bl->mlen = 4;
-	g.bl->entry = malloc(g.bl->mlen * sizeof(bstring));
+	g.bl->entry = bMemAlloc(g.bl->mlen * sizeof(bstring));
 	if (!g.bl->entry) {
-		free(g.bl);
+		bMemFree(g.bl);
 		return NULL;
 	}
 
@@ -2832,14 +3818,14 @@ bsplitstr(const bstring str, const bstring splitStr)
 	if (!str || !str->data || str->slen < 0) {
 		return NULL;
 	}
-	g.bl = malloc(sizeof(struct bstrList));
+	g.bl = bMemAlloc(sizeof(struct bstrList));
 	if (!g.bl) {
 		return NULL;
 	}
 	g.bl->mlen = 4;
-	g.bl->entry = malloc(g.bl->mlen * sizeof (bstring));
+	g.bl->entry = bMemAlloc(g.bl->mlen * sizeof (bstring));
 	if (!g.bl->entry) {
-		free(g.bl);
+		bMemFree(g.bl);
 		return NULL;
 	}
 	g.b = (bstring)str;
@@ -2859,14 +3845,14 @@ bsplits(const bstring str, const bstring splitStr)
 	    !splitStr || splitStr->slen < 0 || !splitStr->data) {
 		return NULL;
 	}
-	g.bl = malloc(sizeof(struct bstrList));
+	g.bl = bMemAlloc(sizeof(struct bstrList));
 	if (!g.bl) {
 		return NULL;
 	}
 	g.bl->mlen = 4;
-	g.bl->entry = malloc (g.bl->mlen * sizeof(bstring));
+	g.bl->entry = bMemAlloc(g.bl->mlen * sizeof(bstring));
 	if (!g.bl->entry) {
-		free(g.bl);
+		bMemFree(g.bl);
 		return NULL;
 	}
 	g.b = (bstring)str;
@@ -2878,12 +3864,271 @@ bsplits(const bstring str, const bstring splitStr)
 	return g.bl;
 }
 
+static int
+bsicb(void *parm, int ofs, int len)
+{
+	struct genBstrList *g = (struct genBstrList *)parm;
+	struct bstrList *sl = g->bl;
+	bstring b = NULL;
+	if (sl->qty >= sl->mlen && bstrListAlloc(sl, sl->qty + 1) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	if (g->spare && g->spare->qty > 0) {
+		b = g->spare->entry[--g->spare->qty];
+	}
+	if (b == NULL) {
+		b = blk2bstr(g->b->data + ofs, len);
+		if (b == NULL) {
+			return BSTR_ERR;
+		}
+	} else if (bassignblk(b, g->b->data + ofs, len) != BSTR_OK) {
+		bdestroy(b);
+		return BSTR_ERR;
+	}
+	sl->entry[sl->qty] = b;
+	sl->qty++;
+	return BSTR_OK;
+}
+
+/* Prepare sl to be refilled from str. If str is one of the entries of sl
+ * or one of the spares then it would be destroyed or overwritten as they
+ * are cleared and reused, so it is copied first and the copy is returned
+ * in g->b.
+ */
+static int
+bsplitintoinit(struct genBstrList *g, struct bstrList *sl,
+	       struct bstrList *spare, const bstring str)
+{
+	int i, alias = 0;
+	if (!str || str->slen < 0 || !str->data) {
+		return BSTR_ERR;
+	}
+	if (spare && (!spare->entry || spare->qty < 0 ||
+		      spare->mlen <= 0 || spare->qty > spare->mlen)) {
+		return BSTR_ERR;
+	}
+	if (!sl || !sl->entry || sl->qty < 0 ||
+	    sl->mlen <= 0 || sl->qty > sl->mlen || sl == spare) {
+		return BSTR_ERR;
+	}
+	for (i = 0; !alias && i < sl->qty; i++) {
+		alias = (sl->entry[i] == str);
+	}
+	for (i = 0; !alias && spare && i < spare->qty; i++) {
+		alias = (spare->entry[i] == str);
+	}
+	g->b = alias ? bstrcpy(str) : (bstring)str;
+	g->bl = sl;
+	g->spare = spare;
+	if (!g->b) {
+		return BSTR_ERR;
+	}
+	if (bstrListClear(sl, spare) != BSTR_OK) {
+		if (g->b != str) {
+			bdestroy(g->b);
+		}
+		return BSTR_ERR;
+	}
+	return BSTR_OK;
+}
+
+static int
+bsplitintodone(struct genBstrList *g, const bstring str, int ret)
+{
+	if (g->b != str) {
+		bdestroy(g->b);
+	}
+	return ret < 0 ? BSTR_ERR : BSTR_OK;
+}
+
+int
+bsplitinto(struct bstrList *sl, struct bstrList *spare, const bstring str,
+	   unsigned char splitChar)
+{
+	struct genBstrList g;
+	if (bsplitintoinit(&g, sl, spare, str) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	return bsplitintodone(&g, str, bsplitcb(g.b, splitChar, 0, bsicb, &g));
+}
+
+int
+bsplitsinto(struct bstrList *sl, struct bstrList *spare, const bstring str,
+	    const bstring splitStr)
+{
+	struct genBstrList g;
+	if (!splitStr || splitStr->slen < 0 || !splitStr->data ||
+	    bsplitintoinit(&g, sl, spare, str) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	return bsplitintodone(&g, str,
+			      bsplitscb(g.b, splitStr, 0, bsicb, &g));
+}
+
+int
+bsplitstrinto(struct bstrList *sl, struct bstrList *spare, const bstring str,
+	      const bstring splitStr)
+{
+	struct genBstrList g;
+	if (bsplitintoinit(&g, sl, spare, str) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	return bsplitintodone(&g, str,
+			      bsplitstrcb(g.b, splitStr, 0, bsicb, &g));
+}
+
+struct bstrViewList *
+bstrViewListCreate(void)
+{
+	struct bstrViewList *vl = bMemAlloc(sizeof(struct bstrViewList));
+	if (vl) {
+		vl->entry = bMemAlloc(4 * sizeof(struct tagbstring));
+		if (!vl->entry) {
+			bMemFree(vl);
+			vl = NULL;
+		} else {
+			vl->qty = 0;
+			vl->mlen = 4;
+		}
+	}
+	return vl;
+}
+
+int
+bstrViewListDestroy(struct bstrViewList *vl)
+{
+	if (!vl || vl->qty < 0) {
+		return BSTR_ERR;
+	}
+	vl->qty  = -1;
+	vl->mlen = -1;
+	bMemFree(vl->entry);
+	vl->entry = NULL;
+	bMemFree(vl);
+	return BSTR_OK;
+}
+
+int
+bstrViewListAlloc(struct bstrViewList *vl, int msz)
+{
+	struct tagbstring *l;
+	int smsz;
+	if (!vl || msz <= 0 ||
+	    !vl->entry || vl->qty < 0 ||
+	    vl->mlen <= 0 || vl->qty > vl->mlen) {
+		return BSTR_ERR;
+	}
+	if (vl->mlen >= msz) {
+		return BSTR_OK;
+	}
+	smsz = snapUpSize(msz);
+	if ((size_t)smsz > ((size_t)-1) / sizeof(struct tagbstring)) {
+		return BSTR_ERR;
+	}
+	l = bMemRealloc(vl->entry, (size_t)smsz * sizeof(struct tagbstring));
+	if (!l) {
+		smsz = msz;
+		l = bMemRealloc(vl->entry,
+				(size_t)smsz * sizeof(struct tagbstring));
+		if (!l) {
+			return BSTR_ERR;
+		}
+	}
+	vl->mlen = smsz;
+	vl->entry = l;
+	return BSTR_OK;
+}
+
+struct genViewList {
+	bstring b;
+	struct bstrViewList *vl;
+};
+
+static int
+bsvcb(void *parm, int ofs, int len)
+{
+	struct genViewList *g = (struct genViewList *)parm;
+	struct tagbstring *t;
+	if (g->vl->qty >= g->vl->mlen) {
+		if (g->vl->qty >= INT_MAX / 2 ||
+		    bstrViewListAlloc(g->vl, g->vl->qty * 2) != BSTR_OK) {
+			return BSTR_ERR;
+		}
+	}
+	t = &g->vl->entry[g->vl->qty];
+	t->data = g->b->data + ofs;
+	t->slen = len;
+	t->mlen = -__LINE__;
+	g->vl->qty++;
+	return BSTR_OK;
+}
+
+static int
+bsplitviewinit(struct genViewList *g, struct bstrViewList *vl,
+	       const bstring str)
+{
+	if (!str || str->slen < 0 || !str->data ||
+	    !vl || vl->qty < 0 || !vl->entry || vl->mlen <= 0) {
+		return BSTR_ERR;
+	}
+	g->b = (bstring)str;
+	g->vl = vl;
+	vl->qty = 0;
+	return BSTR_OK;
+}
+
+int
+bsplitview(struct bstrViewList *vl, const bstring str,
+	   unsigned char splitChar)
+{
+	struct genViewList g;
+	if (bsplitviewinit(&g, vl, str) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	if (bsplitcb(str, splitChar, 0, bsvcb, &g) < 0) {
+		vl->qty = 0;
+		return BSTR_ERR;
+	}
+	return BSTR_OK;
+}
+
+int
+bsplitsview(struct bstrViewList *vl, const bstring str,
+	    const bstring splitStr)
+{
+	struct genViewList g;
+	if (!splitStr || splitStr->slen < 0 || !splitStr->data ||
+	    bsplitviewinit(&g, vl, str) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	if (bsplitscb(str, splitStr, 0, bsvcb, &g) < 0) {
+		vl->qty = 0;
+		return BSTR_ERR;
+	}
+	return BSTR_OK;
+}
+
+int
+bsplitstrview(struct bstrViewList *vl, const bstring str,
+	      const bstring splitStr)
+{
+	struct genViewList g;
+	if (bsplitviewinit(&g, vl, str) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	if (bsplitstrcb(str, splitStr, 0, bsvcb, &g) < 0) {
+		vl->qty = 0;
+		return BSTR_ERR;
+	}
+	return BSTR_OK;
+}
+
 #define exvsnprintf(r, b, n, f, a) \
 { \
 	r = vsnprintf(b, n, f, a); \
 }
 
-#define START_VSNBUFF (16)
+#define BFORMAT_SCRATCH (256)
 
 /* On IRIX vsnprintf returns n-1 when the operation would overflow the target
  * buffer, WATCOM and MSVC both return -1, while C99 requires that the returned
@@ -2893,113 +4138,145 @@ bsplits(const bstring str, const bstring splitStr)
  * required.
  */
 
-int
-bformata(bstring b, const char *fmt, ...)
+/* Format the output into b at offset pos, replacing what follows pos.
+ *
+ * When n is zero the output is written straight into the spare capacity of
+ * b, beyond the terminator of its current contents, or if there is little of
+ * it into a buffer on the stack, and then moved into place. Otherwise a new
+ * buffer with room for n characters of output is allocated, and it only
+ * replaces the buffer of b once the output is complete. Either way the
+ * current contents of b stay intact while the arguments are being read, so
+ * that they may point into b. Returns BSTR_OK, BSTR_ERR, or if the output
+ * did not fit, the negated number of characters to try next, which for a
+ * C99 vsnprintf is exact. Output which fills the buffer up to its
+ * terminator fits, as C99 reports it as such. A failure which is not for
+ * lack of room, such as an encoding error, returns BSTR_ERR at once.
+ */
+static int
+bvformatat(bstring b, int pos, int n, const char *fmt, va_list arglist)
 {
-	va_list arglist;
-	bstring buff;
-	int n, r;
-	if (!b || !fmt || !b->data || b->mlen <= 0 ||
-	    b->slen < 0 || b->slen > b->mlen) {
-		return BSTR_ERR;
-	}
-	/* Since the length is not determinable beforehand, a search is
-	 * performed using the truncating "vsnprintf" call (to avoid buffer
-	 * overflows) on increasing potential sizes for the output result.
-	 */
-	n = (int)(2 * strlen(fmt));
-	if (n < START_VSNBUFF) {
-		n = START_VSNBUFF;
-	}
-	buff = bfromcstralloc(n + 2, "");
-	if (!buff) {
-		n = 1;
-		buff = bfromcstralloc(n + 2, "");
-		if (!buff) {
+	char scratch[BFORMAT_SCRATCH];
+	unsigned char *x = NULL;
+	char *out;
+	int r, len = 0, cap;
+	if (n == 0) {
+		cap = b->mlen - b->slen - 1;
+		if (cap >= BFORMAT_SCRATCH) {
+			out = (char *)b->data + b->slen + 1;
+		} else {
+			out = scratch;
+			cap = BFORMAT_SCRATCH;
+		}
+	} else {
+		if (n > INT_MAX - 2 - pos) {
 			return BSTR_ERR;
 		}
-	}
-	while (1) {
-		if (n < 0 || n > INT_MAX - 2) {
-			bdestroy(buff);
+		len = snapUpSize(pos + n + 2);
+		if (pos < b->slen && len <= INT_MAX / 2) {
+			/* Replacing contents, so leave room for the next output
+			 * beyond the terminator of this one */
+			len += len;
+		}
+		x = bMemAlloc(len);
+		if (!x) {
+			len = pos + n + 2;
+			if (!(x = bMemAlloc(len))) {
+				return BSTR_ERR;
+			}
+		}
+		out = (char *)x + pos;
+		cap = n + 2;
+	}
+	exvsnprintf(r, out, cap, fmt, arglist);
+	if (r < 0) {
+		/* An output shorter than the buffer did not fail for lack of
+		 * room, and nor can one which already had the most there is */
+		out[cap - 1] = '\0';
+		if (memchr(out, '\0', cap - 1) != NULL ||
+		    (n != 0 && n >= INT_MAX - 2 - pos)) {
+			bMemFree(x);
 			return BSTR_ERR;
 		}
-		va_start(arglist, fmt);
-		exvsnprintf(r, (char *) buff->data, n + 1, fmt, arglist);
-		va_end(arglist);
-		buff->data[n] = (unsigned char) '\0';
-		buff->slen = (int) (strlen) ((char *) buff->data);
-
-		if (buff->slen < n) {
-			break;
+	}
+	if (r < 0 || r >= cap) {
+		if (n != 0) {
+			bMemFree(x);
 		}
-		if (r > n) {
+		if (r >= cap) {
+			/* C99 reports the length of the whole output */
 			n = r;
 		} else {
-			n += n;
+			/* Only the length of the buffer tried is known */
+			n = cap > INT_MAX / 2 ? INT_MAX - 2 - pos : cap + cap;
 		}
-		if (BSTR_OK != balloc(buff, n + 2)) {
-			bdestroy(buff);
+		return n > 0 && n <= INT_MAX - 2 - pos ? -n : BSTR_ERR;
+	}
+	/* An early '\0' truncates the output */
+	r = (int)strlen(out);
+	if (n != 0) {
+		if (pos > 0) {
+			memcpy(x, b->data, pos);
+		}
+		if (bIsPacked(b)) {
+			bUnpack(b);
+		} else {
+			bMemFree(b->data);
+		}
+		b->data = x;
+		b->mlen = len;
+	} else if (out == scratch) {
+		if (BSTR_OK != balloc(b, pos + r + 1)) {
 			return BSTR_ERR;
 		}
+		memcpy(b->data + pos, scratch, r);
+	} else {
+		memmove(b->data + pos, out, r);
 	}
-	r = bconcat(b, buff);
-	bdestroy(buff);
-	return r;
+	b->slen = pos + r;
+	b->data[b->slen] = (unsigned char)'\0';
+	return BSTR_OK;
 }
 
 int
-bassignformat(bstring b, const char *fmt, ...)
+bformata(bstring b, const char *fmt, ...)
 {
 	va_list arglist;
-	bstring buff;
-	int n, r;
+	int r;
 	if (!b || !fmt || !b->data || b->mlen <= 0 ||
 	    b->slen < 0 || b->slen > b->mlen) {
 		return BSTR_ERR;
 	}
-	/* Since the length is not determinable beforehand, a search is
-	 * performed using the truncating "vsnprintf" call (to avoid buffer
-	 * overflows) on increasing potential sizes for the output result.
+	/* A single pass is enough unless the output is larger than the space
+	 * available for it, in which case vsnprintf tells how large it is.
 	 */
-	n = (int)(2 * strlen(fmt));
-	if (n < START_VSNBUFF) {
-		n = START_VSNBUFF;
+	va_start(arglist, fmt);
+	r = bvformatat(b, b->slen, 0, fmt, arglist);
+	va_end(arglist);
+	while (r < BSTR_ERR) {
+		va_start(arglist, fmt);
+		r = bvformatat(b, b->slen, -r, fmt, arglist);
+		va_end(arglist);
 	}
-	buff = bfromcstralloc (n + 2, "");
-	if (!buff) {
-		n = 1;
-		buff = bfromcstralloc (n + 2, "");
-		if (!buff) {
-			return BSTR_ERR;
-		}
+	return r;
+}
+
+int
+bassignformat(bstring b, const char *fmt, ...)
+{
+	va_list arglist;
+	int r;
+	if (!b || !fmt || !b->data || b->mlen <= 0 ||
+	    b->slen < 0 || b->slen > b->mlen) {
+		return BSTR_ERR;
 	}
-	while (1) {
-		if (n < 0 || n > INT_MAX - 2) {
-			bdestroy(buff);
-			return BSTR_ERR;
-		}
+	va_start(arglist, fmt);
+	r = bvformatat(b, 0, 0, fmt, arglist);
+	va_end(arglist);
+	while (r < BSTR_ERR) {
 		va_start(arglist, fmt);
-		exvsnprintf(r, (char *)buff->data, n + 1, fmt, arglist);
+		r = bvformatat(b, 0, -r, fmt, arglist);
 		va_end(arglist);
-		buff->data[n] = (unsigned char)'\0';
-		buff->slen = (int)strlen((char *)buff->data);
-		if (buff->slen < n) {
-			break;
-		}
-		if (r > n) {
-			n = r;
-		} else {
-			n += n;
-		}
-		if (BSTR_OK != balloc(buff, n + 2)) {
-			bdestroy(buff);
-			return BSTR_ERR;
-		}
 	}
-
-	r = bassign(b, buff);
-	bdestroy(buff);
 	return r;
 }
 
@@ -3008,48 +4285,25 @@ bformat(const char *fmt, ...)
 {
 	va_list arglist;
 	bstring buff;
-	int n, r;
+	int r;
 	if (!fmt) {
 		return NULL;
 	}
-	/* Since the length is not determinable beforehand, a search is
-	 * performed using the truncating "vsnprintf" call (to avoid buffer
-	 * overflows) on increasing potential sizes for the output result.
-	 */
-	n = (int)(2 * strlen(fmt));
-	if (n < START_VSNBUFF) {
-		n = START_VSNBUFF;
-	}
-	buff = bfromcstralloc(n + 2, "");
+	buff = bfromcstr("");
 	if (!buff) {
-		n = 1;
-		buff = bfromcstralloc(n + 2, "");
-		if (!buff) {
-			return NULL;
-		}
+		return NULL;
 	}
-	while (1) {
-		if (n < 0 || n > INT_MAX - 2) {
-			bdestroy(buff);
-			return NULL;
-		}
+	va_start(arglist, fmt);
+	r = bvformatat(buff, 0, 0, fmt, arglist);
+	va_end(arglist);
+	while (r < BSTR_ERR) {
 		va_start(arglist, fmt);
-		exvsnprintf(r, (char *)buff->data, n + 1, fmt, arglist);
+		r = bvformatat(buff, 0, -r, fmt, arglist);
 		va_end(arglist);
-		buff->data[n] = (unsigned char)'\0';
-		buff->slen = (int)strlen((char *)buff->data);
-		if (buff->slen < n) {
-			break;
-		}
-		if (r > n) {
-			n = r;
-		} else {
-			n += n;
-		}
-		if (BSTR_OK != balloc(buff, n + 2)) {
-			bdestroy(buff);
-			return NULL;
-		}
+	}
+	if (r != BSTR_OK) {
+		bdestroy(buff);
+		return NULL;
 	}
 	return buff;
 }
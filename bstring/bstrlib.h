@@ -78,10 +78,13 @@ extern "C" {
 #include <string.h>
 #include <limits.h>
 #include <ctype.h>
+#include <stdint.h>
 
 #define BSTR_ERR (-1)
 #define BSTR_OK (0)
 #define BSTR_BS_BUFF_LENGTH_GET (0)
+#define BSTR_CTYPE_ASCII (0)
+#define BSTR_CTYPE_LOCALE (1)
 
 typedef struct tagbstring *bstring;
 
@@ -91,6 +94,44 @@ struct tagbstring {
 	unsigned char *data;
 };
 
+typedef void *(*bMalloc)(size_t size, void *ctx);
+typedef void *(*bRealloc)(void *ptr, size_t size, void *ctx);
+typedef void (*bFree)(void *ptr, void *ctx);
+
+/* Memory management functions */
+
+/**
+ * Replace the functions used by the library to allocate, resize and release
+ * memory.
+ *
+ * Every allocation made by the bstring modules, including string headers,
+ * string data, bstrList entries, streams and the C strings returned by
+ * bstr2cstr(), goes through these functions. The ctx parameter is passed
+ * through unchanged to each call, so that arena, pool or tracking
+ * allocators can be plugged in without global state of their own.
+ *
+ * The allocator should be installed before any bstring is created and must
+ * not be changed while memory obtained from the previous allocator is still
+ * live, since that memory will be released through the new free function.
+ * Changing the allocator is not thread safe.
+ *
+ * Passing NULL for all three functions restores the standard library
+ * malloc(), realloc() and free(). If only some of the functions are NULL,
+ * BSTR_ERR is returned and the current allocator is left in place;
+ * otherwise BSTR_OK is returned.
+ *
+ * \code
+ * static void *myMalloc(size_t size, void *ctx) { ... }
+ * static void *myRealloc(void *ptr, size_t size, void *ctx) { ... }
+ * static void myFree(void *ptr, void *ctx) { ... }
+ *
+ * bstrSetAllocator(myMalloc, myRealloc, myFree, &myPool);
+ * \endcode
+ */
+BSTR_PUBLIC int
+bstrSetAllocator(bMalloc mallocFn, bRealloc reallocFn, bFree freeFn,
+		 void *ctx);
+
 /* Copy functions */
 #define cstr2bstr bfromcstr
 
@@ -171,12 +212,10 @@ bstr2cstr(const bstring s, char z);
 /**
  * Frees a C-string generated by bstr2cstr().
  *
- * This is normally unnecessary since it just wraps a call to free(),
- * however, if malloc() and free() have been redefined as a macros within
- * the bstrlib module (via macros in the memdbg.h backdoor) with some
- * difference in behaviour from the std library functions, then this allows
- * a correct way of freeing the memory that allows higher level code to be
- * independent from these macro redefinitions.
+ * The buffer must be released with this function rather than free(), since
+ * it was obtained from the allocator installed with bstrSetAllocator(),
+ * which need not be the standard library one. This allows higher level code
+ * to be independent of the allocator in use.
  */
 BSTR_PUBLIC int
 bcstrfree(char *s);
@@ -190,6 +229,44 @@ bcstrfree(char *s);
 BSTR_PUBLIC bstring
 bstrcpy(const bstring b1);
 
+/**
+ * Create a bstring whose header and data share a single allocation.
+ *
+ * The contents are the length len block pointed to by blk, and the buffer is
+ * sized to fit them with no room to spare. Packed bstrings cost one call to
+ * the allocator instead of two and keep their characters on the same cache
+ * line as the header, which suits large collections of short strings that
+ * are rarely modified.
+ *
+ * A packed bstring is an ordinary bstring in every other respect: it may be
+ * modified by any function in the library and is released with bdestroy().
+ * If it is grown beyond its original capacity, its data is moved to a
+ * separate buffer and the space in the original block goes unused until the
+ * bstring is destroyed. Likewise ballocmin() can lower the mlen of a packed
+ * bstring, but cannot hand the memory back.
+ *
+ * If an error occurs NULL is returned.
+ */
+BSTR_PUBLIC bstring
+blk2bstrpacked(const void *blk, int len);
+
+/**
+ * Create a packed bstring, as with blk2bstrpacked(), which contains the
+ * contents of the '\0' terminated char buffer str.
+ *
+ * If an error occurs NULL is returned.
+ */
+BSTR_PUBLIC bstring
+bfromcstrpacked(const char *str);
+
+/**
+ * Make a packed copy, as with blk2bstrpacked(), of the bstring b.
+ *
+ * If an error occurs NULL is returned.
+ */
+BSTR_PUBLIC bstring
+bstrcpypacked(const bstring b);
+
 /**
  * Overwrite the bstring a with the contents of bstring b.
  *
@@ -243,6 +320,12 @@ bassignblk(bstring a, const void *s, int len);
  * protected. A bstring which is write protected cannot be destroyed via the
  * bdestroy call. Any attempt to do so will result in no action taken, and
  * BSTR_ERR will be returned.
+ *
+ * If the library is built with BSTRLIB_SMALL_INLINE defined, short bstrings
+ * are created with their data in the same allocation as the header, as with
+ * blk2bstrpacked(), and are moved to a separate buffer only when they grow.
+ * In that configuration the data of a bstring created by this library must
+ * never be freed, reallocated or detached from its header directly.
  */
 BSTR_PUBLIC int
 bdestroy(bstring b);
@@ -445,7 +528,7 @@ btrunc(bstring b, int n);
  * two bstrings first differ, otherwise 0 is returned indicating that the
  * bstrings are equal. If the lengths are different, then a difference from 0
  * is given, but if the first extra character is '\0', then it is taken to be
- * the value UCHAR_MAX + 1.
+ * the value UCHAR_MAX + 1. See bsetctype() for which characters have a case.
  */
 BSTR_PUBLIC int
 bstricmp(const bstring b0, const bstring b1);
@@ -610,7 +693,9 @@ bstrncmp(const bstring b0, const bstring b1, int n);
  *
  * If it is found then it returns with the first position after pos where it is
  * found, otherwise it returns BSTR_ERR.  The algorithm used is brute force;
- * O(m*n).
+ * O(m*n), but candidate positions are filtered on the first and last
+ * characters of s2 many bytes at a time using SIMD instructions where they
+ * are available.
  */
 BSTR_PUBLIC int
 binstr(const bstring s1, int pos, const bstring s2);
@@ -623,7 +708,8 @@ binstr(const bstring s1, int pos, const bstring s2);
  * found, otherwise return BSTR_ERR.  Note that the current position at pos is
  * tested as well -- so to be disjoint from a previous forward search it is
  * recommended that the position be backed up (decremented) by one position.
- * The algorithm used is brute force; O(m*n).
+ * The algorithm used is brute force; O(m*n), with the same SIMD filtering of
+ * candidate positions as binstr.
  */
 BSTR_PUBLIC int
 binstrr(const bstring s1, int pos, const bstring s2);
@@ -777,6 +863,142 @@ BSTR_PUBLIC int
 bfindreplacecaseless(bstring b, const bstring find, const bstring repl,
 		     int pos);
 
+/* Precompiled search functions */
+
+/**
+ * Compile the bstring find into a needle which can be searched for
+ * repeatedly with binstrNeedle and bfindreplaceNeedle.
+ *
+ * The needle holds its own copy of the contents of find, so find may be
+ * modified or destroyed afterwards. All of the per search setup is done
+ * here once, including the skip tables which allow searches for long
+ * needles to step over parts of the searched string without examining
+ * them. If find is NULL, invalid or empty, or memory cannot be allocated,
+ * NULL is returned.
+ */
+BSTR_PUBLIC struct bNeedle *
+bNeedleCreate(const bstring find);
+
+/**
+ * Compile the bstring find into a needle which matches without regard to
+ * case, in the manner of binstrcaseless.
+ *
+ * Case folding is captured when the needle is compiled, so later changes to
+ * the locale do not affect it. Otherwise this is the same as bNeedleCreate.
+ */
+BSTR_PUBLIC struct bNeedle *
+bNeedleCreateCaseless(const bstring find);
+
+/**
+ * Free a needle created by bNeedleCreate or bNeedleCreateCaseless.
+ *
+ * Returns BSTR_ERR if nd is NULL, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bNeedleDestroy(struct bNeedle *nd);
+
+/**
+ * Search for the compiled needle nd in b starting at position pos and
+ * looking in a forward (increasing) direction.
+ *
+ * The result is the same as that of binstr, or of binstrcaseless for a
+ * needle created by bNeedleCreateCaseless. If it is found then it returns
+ * with the first position after pos where it is found, otherwise it returns
+ * BSTR_ERR.
+ */
+BSTR_PUBLIC int
+binstrNeedle(const bstring b, int pos, const struct bNeedle *nd);
+
+/**
+ * Replace all occurrences of the compiled needle find with a replace
+ * bstring after a given position in the bstring b.
+ *
+ * The result is the same as that of bfindreplace, or of
+ * bfindreplacecaseless for a needle created by bNeedleCreateCaseless.
+ */
+BSTR_PUBLIC int
+bfindreplaceNeedle(bstring b, const struct bNeedle *find, const bstring repl,
+		   int pos);
+
+/* Hash functions */
+
+/**
+ * Compute a 64 bit hash of the len bytes at blk.
+ *
+ * The hash is a fast, non-cryptographic one in the style of wyhash, suited to
+ * hash tables and checksums against accidental change but not to defending
+ * against a deliberate attacker. Different values of seed give unrelated
+ * hash functions, which lets a table pick a random seed of its own to make
+ * collisions hard to provoke from outside. The result depends only on the
+ * bytes, their number and the seed, and is the same on every platform. If
+ * blk is NULL or len is negative, 0 is returned.
+ */
+BSTR_PUBLIC uint64_t
+bhashblk(const void *blk, int len, uint64_t seed);
+
+/**
+ * Compute a 64 bit hash of the contents of b.
+ *
+ * This is the same as bhashblk(b->data, b->slen, seed), so bstrings for which
+ * biseq() returns 1 always hash to the same value. If b is NULL or invalid, 0
+ * is returned.
+ */
+BSTR_PUBLIC uint64_t
+bhash(const bstring b, uint64_t seed);
+
+/**
+ * Compute a 64 bit hash of the contents of b without regard to case.
+ *
+ * Every character is converted to lower case, as chosen by bsetctype(),
+ * before it is hashed, so bstrings for which biseqcaseless() returns 1
+ * always hash to the same value. The result is that of bhash() on a lower
+ * case copy of b, but no copy is made. If b is NULL or invalid, 0 is
+ * returned.
+ */
+BSTR_PUBLIC uint64_t
+bhashcaseless(const bstring b, uint64_t seed);
+
+/* Hashed string key */
+struct bstrHashKey {
+	struct tagbstring str;
+	uint64_t seed;
+	uint64_t hash;
+};
+
+/**
+ * Initialize k as a write protected reference to the contents of b together
+ * with their hash under seed.
+ *
+ * The struct bstrHashKey structure is declared as follows:
+ *
+ * \code
+ * struct bstrHashKey {
+ *     struct tagbstring str;
+ *     uint64_t seed;
+ *     uint64_t hash;
+ * };
+ * \endcode
+ *
+ * The str field refers to the data of b in the manner of blk2tbstr() and is
+ * write protected, so k owns no memory and needs no cleanup. The contents
+ * of b must not be changed while k is in use, since the hash is computed
+ * only once here. Keys are meant for strings which are looked up many times
+ * and which are immutable, static or write protected anyway. If k or b is
+ * NULL or b is invalid, BSTR_ERR is returned, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bhashkeyinit(struct bstrHashKey *k, const bstring b, uint64_t seed);
+
+/**
+ * Return the hash under seed of the string referred to by k.
+ *
+ * If seed is the one k was last hashed with, the cached hash is returned
+ * without looking at the string. Otherwise the string is hashed again and
+ * the result cached in k for later calls. If k is NULL, 0 is returned.
+ */
+BSTR_PUBLIC uint64_t
+bhashkey(struct bstrHashKey *k, uint64_t seed);
+
 /* List of string container functions */
 struct bstrList {
 	int qty, mlen;
@@ -830,6 +1052,68 @@ bstrListAlloc(struct bstrList *sl, int msz);
 BSTR_PUBLIC int
 bstrListAllocMin(struct bstrList *sl, int msz);
 
+/**
+ * Empty the list sl, moving its bstrings onto the end of the list spare.
+ *
+ * On return sl->qty is 0 and sl keeps its entry array. The bstrings which
+ * were in sl are appended to spare, along with their memory, where the
+ * bsplitinto() family of functions draw on them before allocating new
+ * bstrings. A list which is cleared and refilled with similar contents
+ * through the same spare list therefore soon stops allocating altogether.
+ * The spare list is an ordinary struct bstrList, and its entries are
+ * destroyed by bstrListDestroy() like any other. If spare is NULL the
+ * bstrings are destroyed instead.
+ *
+ * BSTR_OK is returned on success. Otherwise BSTR_ERR is returned and
+ * neither list is modified.
+ */
+BSTR_PUBLIC int
+bstrListClear(struct bstrList *sl, struct bstrList *spare);
+
+/* List of string view container functions */
+struct bstrViewList {
+	int qty, mlen;
+	struct tagbstring *entry;
+};
+
+/**
+ * Create an empty struct bstrViewList.
+ *
+ * The struct bstrViewList output structure is declared as follows:
+ *
+ * \code
+ * struct bstrViewList {
+ *     int qty, mlen;
+ *     struct tagbstring *entry;
+ * };
+ * \endcode
+ *
+ * Unlike a struct bstrList, the entry field is an array of the tagbstring
+ * headers themselves, with qty entries in use and memory for mlen of them.
+ * The entries are write protected views into the data of the bstring they
+ * were split from, in the style of bmid2tbstr(), and own no memory of their
+ * own. A view list is intended to be reused: once it has grown large enough,
+ * splitting into it again allocates nothing.
+ */
+BSTR_PUBLIC struct bstrViewList *
+bstrViewListCreate(void);
+
+/**
+ * Destroy a struct bstrViewList structure.
+ *
+ * Only the list itself is freed; the bstrings the views refer to are not
+ * affected.
+ */
+BSTR_PUBLIC int
+bstrViewListDestroy(struct bstrViewList *vl);
+
+/**
+ * Ensure that there is memory for at least msz number of entries for the
+ * view list.
+ */
+BSTR_PUBLIC int
+bstrViewListAlloc(struct bstrViewList *vl, int msz);
+
 /* String split and join functions */
 
 /**
@@ -864,6 +1148,78 @@ bsplits(const bstring str, const bstring splitStr);
 BSTR_PUBLIC struct bstrList *
 bsplitstr(const bstring str, const bstring splitStr);
 
+/**
+ * Refill the list sl with the sequential substrings of str divided by the
+ * character splitChar, following the same semantics as bsplit().
+ *
+ * The list is first cleared into spare with bstrListClear(), and each
+ * substring is then assigned into a bstring taken from the end of spare
+ * where one is available, reusing its memory, or into a newly allocated
+ * bstring otherwise. spare may be NULL, in which case the old entries are
+ * destroyed and every substring is newly allocated. str may itself be an
+ * entry of sl or spare, but must not otherwise refer to the contents of
+ * their entries.
+ *
+ * BSTR_OK is returned on success. Otherwise BSTR_ERR is returned, and sl
+ * holds the substrings found before the error occurred.
+ */
+BSTR_PUBLIC int
+bsplitinto(struct bstrList *sl, struct bstrList *spare, const bstring str,
+	   unsigned char splitChar);
+
+/**
+ * Refill the list sl with the sequential substrings of str divided by any
+ * character contained in splitStr, following the same semantics as
+ * bsplits(). See bsplitinto() above for how the entries are reused.
+ */
+BSTR_PUBLIC int
+bsplitsinto(struct bstrList *sl, struct bstrList *spare, const bstring str,
+	    const bstring splitStr);
+
+/**
+ * Refill the list sl with the sequential substrings of str divided by the
+ * entire substring splitStr, following the same semantics as bsplitstr().
+ * See bsplitinto() above for how the entries are reused.
+ */
+BSTR_PUBLIC int
+bsplitstrinto(struct bstrList *sl, struct bstrList *spare, const bstring str,
+	      const bstring splitStr);
+
+/**
+ * Fill the view list vl with the sequential substrings of str divided by
+ * the character splitChar, following the same semantics as bsplit().
+ *
+ * Any previous contents of vl are discarded. Each entry is a write protected
+ * view which points into str, so no memory is allocated for the substrings
+ * and the list only grows when it has too few entries. The views remain
+ * valid only for as long as str is neither modified nor destroyed.
+ *
+ * BSTR_OK is returned on success, otherwise BSTR_ERR is returned and vl is
+ * left empty. See bstrViewListCreate() above for structure of struct
+ * bstrViewList.
+ */
+BSTR_PUBLIC int
+bsplitview(struct bstrViewList *vl, const bstring str,
+	   unsigned char splitChar);
+
+/**
+ * Fill the view list vl with the sequential substrings of str divided by
+ * any character contained in splitStr, following the same semantics as
+ * bsplits(). See bsplitview() above for the lifetime of the views.
+ */
+BSTR_PUBLIC int
+bsplitsview(struct bstrViewList *vl, const bstring str,
+	    const bstring splitStr);
+
+/**
+ * Fill the view list vl with the sequential substrings of str divided by
+ * the entire substring splitStr, following the same semantics as
+ * bsplitstr(). See bsplitview() above for the lifetime of the views.
+ */
+BSTR_PUBLIC int
+bsplitstrview(struct bstrViewList *vl, const bstring str,
+	      const bstring splitStr);
+
 /**
  * Join the entries of a bstrList into one bstring by sequentially
  * concatenating them with the sep bstring in between.
@@ -983,11 +1339,32 @@ bsplitstrcb(const bstring str,
 BSTR_PUBLIC int
 bpattern(bstring b, int len);
 
+/**
+ * Select how characters are classified by the case conversion, caseless
+ * comparison and whitespace trimming functions.
+ *
+ * In the default BSTR_CTYPE_ASCII mode only the ASCII letters have a case
+ * and only the ASCII space, tab, newline, vertical tab, form feed and
+ * carriage return characters are whitespace, which matches the "C" locale.
+ * Whole blocks of characters are then processed at once, which is many
+ * times faster than classifying them one at a time. In BSTR_CTYPE_LOCALE
+ * mode every character is classified with toupper(), tolower() and
+ * isspace(), following the current C locale.
+ *
+ * The mode is global to the library, so it should be set once, before
+ * strings are processed, and not changed while other threads may be using
+ * the library. The previous mode is returned, or BSTR_ERR if mode is not
+ * one of the above.
+ */
+BSTR_PUBLIC int
+bsetctype(int mode);
+
 /**
  * Convert contents of bstring to upper case.
  *
  * This function will return with BSTR_ERR if b is NULL or of length 0,
- * otherwise BSTR_OK is returned.
+ * otherwise BSTR_OK is returned. See bsetctype() for which characters are
+ * converted.
  */
 BSTR_PUBLIC int
 btoupper(bstring b);
@@ -996,7 +1373,8 @@ btoupper(bstring b);
  * Convert contents of bstring to lower case.
  *
  * This function will return with BSTR_ERR if b is NULL or of length 0,
- * otherwise BSTR_OK is returned.
+ * otherwise BSTR_OK is returned. See bsetctype() for which characters are
+ * converted.
  */
 BSTR_PUBLIC int
 btolower(bstring b);
@@ -1069,6 +1447,10 @@ bformat(const char *fmt, ...);
  * \code
  * bformata (b0 = bfromcstr ("Hello"), ", %s", b1->data);
  * \endcode
+ *
+ * The output is written straight into the spare capacity of b when there is
+ * enough of it, so appending to a bstring with room to spare costs a single
+ * vsnprintf pass and no allocation. The arguments may point into b.
  */
 BSTR_PUBLIC int
 bformata(bstring b, const char *fmt, ...);
@@ -1091,6 +1473,10 @@ bformata(bstring b, const char *fmt, ...);
  * \code
  * bassignformat (b0 = bfromcstr ("Hello"), ", %s", b1->data);
  * \endcode
+ *
+ * As with bformata, the output is written into the spare capacity of b when
+ * there is enough of it, so reusing the same bstring for each formatted
+ * line usually costs no allocation. The arguments may point into b.
  */
 BSTR_PUBLIC int
 bassignformat(bstring b, const char *fmt, ...);
@@ -1278,11 +1664,29 @@ breada(bstring b, bNread readPtr, void *parm);
 BSTR_PUBLIC struct bStream *
 bsopen(bNread readPtr, void *parm);
 
+/**
+ * Open the file named by path as a read only memory mapped bStream.
+ *
+ * The whole file is mapped into memory, and every bStream function can be
+ * used on the result. Reading lines with bsreadln() and friends copies the
+ * data straight out of the mapping rather than through the stream buffer,
+ * while bsreadlnview(), bsreadlnsview(), bssplitscb() and bssplitstrcb()
+ * hand out write protected views into the mapping without copying at all.
+ *
+ * The file must not be truncated while it is mapped. NULL is returned if
+ * the file cannot be opened or mapped, or if memory mapping is not
+ * supported on this platform.
+ */
+BSTR_PUBLIC struct bStream *
+bsopenmmap(const char *path);
+
 /**
  * Close the bStream, and return the handle to the stream that was
  * originally used to open the given stream.
  *
- * If s is NULL or detectably invalid, NULL will be returned.
+ * If s is NULL or detectably invalid, NULL will be returned. A stream
+ * opened with bsopenmmap() is unmapped, and NULL is returned since there is
+ * no handle to give back. Any views into it become invalid.
  */
 BSTR_PUBLIC void *
 bsclose(struct bStream *s);
@@ -1322,6 +1726,42 @@ bsreadln(bstring b, struct bStream *s, char terminator);
 BSTR_PUBLIC int
 bsreadlns(bstring r, struct bStream *s, const bstring term);
 
+/**
+ * Read a bstring terminated by the terminator character or the end of the
+ * stream from the bStream (s) and return it as a new bstring.
+ *
+ * This is the bStream counterpart of bgets: the core stream is read in
+ * blocks, which are searched for the terminator, instead of a character at
+ * a time, and any characters read beyond the terminator are retained for
+ * subsequent read operations. If the stream has been exhausted of all
+ * available data, or there is some other detectable error, NULL is
+ * returned.
+ */
+BSTR_PUBLIC bstring
+bsgets(struct bStream *s, char terminator);
+
+/**
+ * Read a line terminated by the terminator character or the end of the
+ * stream from a memory mapped bStream (s), as with bsreadln(), without
+ * copying it.
+ *
+ * The tagbstring t is filled in as a write protected view into the mapping,
+ * which remains valid until the stream is closed. BSTR_ERR is returned if
+ * the stream is exhausted, if it was not opened with bsopenmmap(), or if it
+ * holds data pushed back by bsunread() which has yet to be read.
+ */
+BSTR_PUBLIC int
+bsreadlnview(struct tagbstring *t, struct bStream *s, char terminator);
+
+/**
+ * Read a line terminated by any character in the terminators bstring or
+ * the end of the stream from a memory mapped bStream (s), as with
+ * bsreadlns(), without copying it. See bsreadlnview() above for the
+ * details.
+ */
+BSTR_PUBLIC int
+bsreadlnsview(struct tagbstring *t, struct bStream *s, const bstring term);
+
 /**
  * Read a bstring of length n (or, if it is fewer, as many bytes as is
  * remaining) from the bStream.
@@ -1411,6 +1851,10 @@ bspeek(bstring r, const struct bStream *s);
  * practical or desired memory available. As with the other split callback
  * based functions this is abortable and does not impose additional memory
  * allocation.
+ *
+ * For a stream opened with bsopenmmap(), each entry is a write protected
+ * view into the mapping and, unlike the entries of other streams, is not
+ * '\0' terminated.
  */
 BSTR_PUBLIC int
 bssplitscb(struct bStream *s,
@@ -1441,6 +1885,9 @@ bssplitscb(struct bStream *s,
  * practical or desired memory available. As with the other split callback
  * based functions this is abortable and does not impose additional memory
  * allocation.
+ *
+ * For a stream opened with bsopenmmap(), each entry is a write protected
+ * view into the mapping.
  */
 BSTR_PUBLIC int
 bssplitstrcb(struct bStream *s,
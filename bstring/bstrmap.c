@@ -0,0 +1,837 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * bstrmap.c
+ *
+ * This file implements the bstring hash map. The table is a power of two
+ * number of slots, with a control byte per slot which is either empty,
+ * deleted, or holds the low seven bits of the hash of the key in the slot.
+ * The first group of control bytes is repeated after the last one, so that
+ * a group may start at any slot. A probe compares a whole group of control
+ * bytes against the wanted hash at once, with SSE2 where it is available,
+ * and moves on to further groups in triangular steps until it meets a group
+ * with an empty slot. Short keys are copied into their slots. Longer ones
+ * are kept in a list of blocks, and are only moved when the table is rebuilt
+ * with much of that memory belonging to erased keys.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "bstrmap.h"
+#include "bstralloc.h"
+#include "bstrsimd.h"
+
+#if !defined(BSTRLIB_NO_THREADS)
+#if defined(_WIN32)
+#include <windows.h>
+typedef SRWLOCK poolLock;
+#define lockInit(l) (InitializeSRWLock(l), 0)
+#define lockDestroy(l) ((void)(l))
+#define lockShared(l) AcquireSRWLockShared(l)
+#define unlockShared(l) ReleaseSRWLockShared(l)
+#define lockExclusive(l) AcquireSRWLockExclusive(l)
+#define unlockExclusive(l) ReleaseSRWLockExclusive(l)
+#else
+#include <pthread.h>
+typedef pthread_rwlock_t poolLock;
+#define lockInit(l) pthread_rwlock_init(l, NULL)
+#define lockDestroy(l) pthread_rwlock_destroy(l)
+#define lockShared(l) pthread_rwlock_rdlock(l)
+#define unlockShared(l) pthread_rwlock_unlock(l)
+#define lockExclusive(l) pthread_rwlock_wrlock(l)
+#define unlockExclusive(l) pthread_rwlock_unlock(l)
+#endif
+#endif /* BSTRLIB_NO_THREADS */
+
+#define MAP_GROUP 16
+#define MAP_MIN_SLOTS 16
+#define MAP_MAX_SLOTS (1 << 30)
+#define MAP_BLOCK 4096
+#define MAP_INLINE 24
+#define MAP_EMPTY 0x80
+#define MAP_DELETED 0xFE
+
+#define mapH1(h) ((size_t)((h) >> 7))
+#define mapH2(h) ((unsigned char)((h) & 0x7F))
+#define mapGrowth(n) ((n) - (n) / 8)
+
+struct mapEntry {
+	uint64_t hash;
+	void *value;
+	union {
+		unsigned char *ptr;
+		unsigned char buf[MAP_INLINE];
+	} key;
+	int len;
+};
+
+#define entryKey(e) \
+	((e)->len < MAP_INLINE ? (e)->key.buf : (e)->key.ptr)
+
+struct mapBlock {
+	struct mapBlock *next;
+	size_t used;
+	size_t size;
+	unsigned char data[1];
+};
+
+struct bstrMap {
+	unsigned char *ctrl;
+	struct mapEntry *slots;
+	size_t mask;
+	int count;
+	int deleted;
+	int growthLeft;
+	size_t keyBytes;
+	size_t waste;
+	struct mapBlock *blocks;
+	uint64_t seed;
+};
+
+#if defined(BSTR_SIMD_SSE2)
+static unsigned int
+groupMatch(const unsigned char *ctrl, unsigned char c)
+{
+	__m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+	return (unsigned int)_mm_movemask_epi8(
+		_mm_cmpeq_epi8(g, _mm_set1_epi8((char)c)));
+}
+
+static unsigned int
+groupFree(const unsigned char *ctrl)
+{
+	__m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+	return (unsigned int)_mm_movemask_epi8(g);
+}
+#else
+static unsigned int
+groupMatch(const unsigned char *ctrl, unsigned char c)
+{
+	unsigned int m = 0;
+	int i;
+	for (i = 0; i < MAP_GROUP; i++) {
+		m |= (unsigned int)(ctrl[i] == c) << i;
+	}
+	return m;
+}
+
+static unsigned int
+groupFree(const unsigned char *ctrl)
+{
+	unsigned int m = 0;
+	int i;
+	for (i = 0; i < MAP_GROUP; i++) {
+		m |= (unsigned int)(ctrl[i] >> 7) << i;
+	}
+	return m;
+}
+#endif
+
+static void
+setCtrl(struct bstrMap *m, size_t i, unsigned char c)
+{
+	m->ctrl[i] = c;
+	if (i < MAP_GROUP) {
+		m->ctrl[m->mask + 1 + i] = c;
+	}
+}
+
+static long
+mapLookup(const struct bstrMap *m, const unsigned char *p, int len,
+	  uint64_t h)
+{
+	size_t pos, step = 0, i;
+	unsigned int match;
+	struct mapEntry *e;
+	if (m->ctrl == NULL) {
+		return -1;
+	}
+	pos = mapH1(h) & m->mask;
+	for (;;) {
+		match = groupMatch(m->ctrl + pos, mapH2(h));
+		while (match) {
+			i = (pos + (size_t)bSimdLowBit(match)) & m->mask;
+			e = &m->slots[i];
+			if (e->hash == h && e->len == len &&
+			    !memcmp(entryKey(e), p, (size_t)len)) {
+				return (long)i;
+			}
+			match &= match - 1;
+		}
+		if (groupMatch(m->ctrl + pos, MAP_EMPTY)) {
+			return -1;
+		}
+		step += MAP_GROUP;
+		pos = (pos + step) & m->mask;
+	}
+}
+
+static size_t
+mapFreeSlot(const unsigned char *ctrl, size_t mask, uint64_t h)
+{
+	size_t pos = mapH1(h) & mask, step = 0;
+	unsigned int match;
+	while (!(match = groupFree(ctrl + pos))) {
+		step += MAP_GROUP;
+		pos = (pos + step) & mask;
+	}
+	return (pos + (size_t)bSimdLowBit(match)) & mask;
+}
+
+static struct mapBlock *
+blockAlloc(size_t size)
+{
+	struct mapBlock *b;
+	b = bMemAlloc(offsetof(struct mapBlock, data) + size);
+	if (b == NULL) {
+		return NULL;
+	}
+	b->next = NULL;
+	b->used = 0;
+	b->size = size;
+	return b;
+}
+
+static void
+blocksFree(struct mapBlock *b)
+{
+	struct mapBlock *next;
+	while (b != NULL) {
+		next = b->next;
+		bMemFree(b);
+		b = next;
+	}
+}
+
+/*
+ * Take size bytes, aligned to align, from a list of blocks. A request which
+ * does not fit into the block being filled gets a fresh block, except that
+ * one too large for an ordinary block gets a block of its own, linked in
+ * behind the block being filled so that the free space of that is not
+ * abandoned.
+ */
+static void *
+blockTake(struct mapBlock **list, size_t size, size_t align)
+{
+	struct mapBlock *b = *list;
+	size_t at = 0;
+	if (b != NULL) {
+		at = (b->used + align - 1) & ~(align - 1);
+	}
+	if (b == NULL || at > b->size || b->size - at < size) {
+		if (size > MAP_BLOCK / 4) {
+			if ((b = blockAlloc(size)) == NULL) {
+				return NULL;
+			}
+			if (*list != NULL) {
+				b->next = (*list)->next;
+				(*list)->next = b;
+			} else {
+				*list = b;
+			}
+		} else {
+			if ((b = blockAlloc(MAP_BLOCK)) == NULL) {
+				return NULL;
+			}
+			b->next = *list;
+			*list = b;
+		}
+		at = 0;
+	}
+	b->used = at + size;
+	return b->data + at;
+}
+
+static unsigned char *
+keyCopy(struct bstrMap *m, const unsigned char *p, int len)
+{
+	unsigned char *s = blockTake(&m->blocks, (size_t)len + 1, 1);
+	if (s == NULL) {
+		return NULL;
+	}
+	memcpy(s, p, (size_t)len);
+	s[len] = '\0';
+	m->keyBytes += (size_t)len + 1;
+	return s;
+}
+
+static int
+mapRebuild(struct bstrMap *m, size_t slots)
+{
+	unsigned char *ctrl;
+	struct mapEntry *entries, *e;
+	struct mapBlock *keys = NULL;
+	unsigned char *s;
+	size_t i, j;
+	if (slots > MAP_MAX_SLOTS) {
+		return BSTR_ERR;
+	}
+	ctrl = bMemAlloc(slots + MAP_GROUP);
+	if (ctrl == NULL) {
+		return BSTR_ERR;
+	}
+	entries = bMemAlloc(slots * sizeof(struct mapEntry));
+	if (entries == NULL) {
+		bMemFree(ctrl);
+		return BSTR_ERR;
+	}
+	memset(ctrl, MAP_EMPTY, slots + MAP_GROUP);
+	if (m->waste > MAP_BLOCK && m->waste > m->keyBytes) {
+		keys = blockAlloc(m->keyBytes > MAP_BLOCK ?
+				  m->keyBytes : MAP_BLOCK);
+	}
+	if (m->ctrl != NULL) {
+		for (i = 0; i <= m->mask; i++) {
+			if (m->ctrl[i] & 0x80) {
+				continue;
+			}
+			e = &m->slots[i];
+			if (keys != NULL && e->len >= MAP_INLINE) {
+				s = keys->data + keys->used;
+				memcpy(s, e->key.ptr, (size_t)e->len + 1);
+				keys->used += (size_t)e->len + 1;
+				e->key.ptr = s;
+			}
+			j = mapFreeSlot(ctrl, slots - 1, e->hash);
+			ctrl[j] = mapH2(e->hash);
+			if (j < MAP_GROUP) {
+				ctrl[slots + j] = ctrl[j];
+			}
+			entries[j] = *e;
+		}
+		bMemFree(m->ctrl);
+		bMemFree(m->slots);
+	}
+	if (keys != NULL) {
+		blocksFree(m->blocks);
+		m->blocks = keys;
+		m->waste = 0;
+	}
+	m->ctrl = ctrl;
+	m->slots = entries;
+	m->mask = slots - 1;
+	m->deleted = 0;
+	m->growthLeft = (int)mapGrowth(slots) - m->count;
+	return BSTR_OK;
+}
+
+struct bstrMap *
+bstrMapCreate(void)
+{
+	struct {
+		const void *map;
+		const void *stack;
+		time_t now;
+		clock_t ticks;
+	} entropy;
+	struct bstrMap *m = bMemAlloc(sizeof(struct bstrMap));
+	if (m == NULL) {
+		return NULL;
+	}
+	m->ctrl = NULL;
+	m->slots = NULL;
+	m->mask = 0;
+	m->count = 0;
+	m->deleted = 0;
+	m->growthLeft = 0;
+	m->keyBytes = 0;
+	m->waste = 0;
+	m->blocks = NULL;
+	memset(&entropy, 0, sizeof(entropy));
+	entropy.map = m;
+	entropy.stack = &entropy;
+	entropy.now = time(NULL);
+	entropy.ticks = clock();
+	m->seed = bhashblk(&entropy, (int)sizeof(entropy), 0);
+	return m;
+}
+
+int
+bstrMapDestroy(struct bstrMap *m)
+{
+	if (m == NULL) {
+		return BSTR_ERR;
+	}
+	bMemFree(m->ctrl);
+	bMemFree(m->slots);
+	blocksFree(m->blocks);
+	bMemFree(m);
+	return BSTR_OK;
+}
+
+int
+bstrMapClear(struct bstrMap *m)
+{
+	if (m == NULL) {
+		return BSTR_ERR;
+	}
+	if (m->ctrl != NULL) {
+		memset(m->ctrl, MAP_EMPTY, m->mask + 1 + MAP_GROUP);
+		m->growthLeft = (int)mapGrowth(m->mask + 1);
+	}
+	if (m->blocks != NULL) {
+		blocksFree(m->blocks->next);
+		m->blocks->next = NULL;
+		m->blocks->used = 0;
+	}
+	m->count = 0;
+	m->deleted = 0;
+	m->keyBytes = 0;
+	m->waste = 0;
+	return BSTR_OK;
+}
+
+int
+bstrMapCount(const struct bstrMap *m)
+{
+	if (m == NULL) {
+		return BSTR_ERR;
+	}
+	return m->count;
+}
+
+int
+bstrMapReserve(struct bstrMap *m, int n)
+{
+	size_t slots;
+	if (m == NULL || n < 0) {
+		return BSTR_ERR;
+	}
+	slots = m->ctrl != NULL ? m->mask + 1 : MAP_MIN_SLOTS;
+	while (mapGrowth(slots) < (size_t)n) {
+		if (slots >= MAP_MAX_SLOTS) {
+			return BSTR_ERR;
+		}
+		slots <<= 1;
+	}
+	if (m->ctrl != NULL && slots == m->mask + 1) {
+		return BSTR_OK;
+	}
+	return mapRebuild(m, slots);
+}
+
+uint64_t
+bstrMapSeed(const struct bstrMap *m)
+{
+	if (m == NULL) {
+		return 0;
+	}
+	return m->seed;
+}
+
+/*
+ * Add a key known to be absent from the map. Long keys are copied into the
+ * blocks of the map unless borrow is set, in which case the caller promises
+ * that the bytes at p outlive the entry.
+ */
+static int
+mapInsert(struct bstrMap *m, const unsigned char *p, int len, uint64_t h,
+	  void *value, int borrow)
+{
+	struct mapEntry *e;
+	size_t i, slots;
+	if (m->growthLeft <= 0) {
+		/* Grow unless the table is full mostly of deleted slots */
+		slots = m->ctrl != NULL ? m->mask + 1 : MAP_MIN_SLOTS;
+		while ((size_t)m->count + 1 > mapGrowth(slots) / 2) {
+			slots <<= 1;
+		}
+		if (mapRebuild(m, slots) != BSTR_OK) {
+			return BSTR_ERR;
+		}
+	}
+	i = mapFreeSlot(m->ctrl, m->mask, h);
+	e = &m->slots[i];
+	if (len < MAP_INLINE) {
+		memcpy(e->key.buf, p, (size_t)len);
+		e->key.buf[len] = '\0';
+	} else if (borrow) {
+		e->key.ptr = (unsigned char *)p;
+	} else if ((e->key.ptr = keyCopy(m, p, len)) == NULL) {
+		return BSTR_ERR;
+	}
+	e->hash = h;
+	e->len = len;
+	e->value = value;
+	if (m->ctrl[i] == MAP_EMPTY) {
+		m->growthLeft--;
+	} else {
+		m->deleted--;
+	}
+	setCtrl(m, i, mapH2(h));
+	m->count++;
+	return 1;
+}
+
+int
+bstrMapSetBlk(struct bstrMap *m, const void *blk, int len, void *value)
+{
+	const unsigned char *p = (const unsigned char *)blk;
+	uint64_t h;
+	long found;
+	if (m == NULL || blk == NULL || len < 0) {
+		return BSTR_ERR;
+	}
+	h = bhashblk(p, len, m->seed);
+	found = mapLookup(m, p, len, h);
+	if (found >= 0) {
+		m->slots[found].value = value;
+		return 0;
+	}
+	return mapInsert(m, p, len, h, value, 0);
+}
+
+int
+bstrMapSet(struct bstrMap *m, const bstring key, void *value)
+{
+	if (key == NULL || key->data == NULL || key->slen < 0) {
+		return BSTR_ERR;
+	}
+	return bstrMapSetBlk(m, key->data, key->slen, value);
+}
+
+static int
+mapFind(const struct bstrMap *m, const unsigned char *p, int len,
+	uint64_t h, void **value)
+{
+	long i = mapLookup(m, p, len, h);
+	if (i < 0) {
+		return 0;
+	}
+	if (value != NULL) {
+		*value = m->slots[i].value;
+	}
+	return 1;
+}
+
+int
+bstrMapFindBlk(const struct bstrMap *m, const void *blk, int len,
+	       void **value)
+{
+	if (m == NULL || blk == NULL || len < 0) {
+		return BSTR_ERR;
+	}
+	return mapFind(m, (const unsigned char *)blk, len,
+		       bhashblk(blk, len, m->seed), value);
+}
+
+int
+bstrMapFind(const struct bstrMap *m, const bstring key, void **value)
+{
+	if (key == NULL || key->data == NULL || key->slen < 0) {
+		return BSTR_ERR;
+	}
+	return bstrMapFindBlk(m, key->data, key->slen, value);
+}
+
+int
+bstrMapFindKey(const struct bstrMap *m, struct bstrHashKey *k, void **value)
+{
+	if (m == NULL || k == NULL || k->str.data == NULL || k->str.slen < 0) {
+		return BSTR_ERR;
+	}
+	return mapFind(m, k->str.data, k->str.slen, bhashkey(k, m->seed),
+		       value);
+}
+
+int
+bstrMapEraseBlk(struct bstrMap *m, const void *blk, int len, void **value)
+{
+	unsigned int before, after;
+	struct mapEntry *e;
+	long i;
+	if (m == NULL || blk == NULL || len < 0) {
+		return BSTR_ERR;
+	}
+	i = mapLookup(m, (const unsigned char *)blk, len,
+		      bhashblk(blk, len, m->seed));
+	if (i < 0) {
+		return 0;
+	}
+	e = &m->slots[i];
+	if (value != NULL) {
+		*value = e->value;
+	}
+	if (e->len >= MAP_INLINE) {
+		m->keyBytes -= (size_t)e->len + 1;
+		m->waste += (size_t)e->len + 1;
+	}
+	m->count--;
+	/*
+	 * The slot may be marked empty again if no probe can have passed over
+	 * it, which is when there was never a full group of occupied slots
+	 * around it.
+	 */
+	before = groupMatch(m->ctrl + (((size_t)i - MAP_GROUP) & m->mask),
+			    MAP_EMPTY);
+	after = groupMatch(m->ctrl + i, MAP_EMPTY);
+	if (before && after &&
+	    bSimdLowBit(after) + (MAP_GROUP - 1 - bSimdHighBit(before)) <
+	    MAP_GROUP) {
+		setCtrl(m, (size_t)i, MAP_EMPTY);
+		m->growthLeft++;
+	} else {
+		setCtrl(m, (size_t)i, MAP_DELETED);
+		m->deleted++;
+	}
+	return 1;
+}
+
+int
+bstrMapErase(struct bstrMap *m, const bstring key, void **value)
+{
+	if (key == NULL || key->data == NULL || key->slen < 0) {
+		return BSTR_ERR;
+	}
+	return bstrMapEraseBlk(m, key->data, key->slen, value);
+}
+
+int
+bstrMapNext(const struct bstrMap *m, int *pos, struct tagbstring *key,
+	    void **value)
+{
+	struct mapEntry *e;
+	size_t i;
+	if (m == NULL || pos == NULL || key == NULL || *pos < 0) {
+		return BSTR_ERR;
+	}
+	if (m->ctrl == NULL) {
+		return 0;
+	}
+	for (i = (size_t)*pos; i <= m->mask; i++) {
+		if (m->ctrl[i] & 0x80) {
+			continue;
+		}
+		e = &m->slots[i];
+		blk2tbstr(*key, entryKey(e), e->len);
+		bwriteprotect(*key);
+		if (value != NULL) {
+			*value = e->value;
+		}
+		*pos = (int)i + 1;
+		return 1;
+	}
+	*pos = (int)i;
+	return 0;
+}
+
+struct bstrPool {
+	struct bstrMap *map;
+	struct mapBlock *blocks;
+	int locked;
+#if !defined(BSTRLIB_NO_THREADS)
+	poolLock lock;
+#endif
+};
+
+struct bstrPool *
+bstrPoolCreate(int flags)
+{
+	struct bstrPool *pool;
+#if defined(BSTRLIB_NO_THREADS)
+	if (flags & BSTR_POOL_LOCKED) {
+		return NULL;
+	}
+#endif
+	pool = bMemAlloc(sizeof(struct bstrPool));
+	if (pool == NULL) {
+		return NULL;
+	}
+	pool->blocks = NULL;
+	pool->locked = (flags & BSTR_POOL_LOCKED) != 0;
+	if ((pool->map = bstrMapCreate()) == NULL) {
+		bMemFree(pool);
+		return NULL;
+	}
+#if !defined(BSTRLIB_NO_THREADS)
+	if (pool->locked && lockInit(&pool->lock) != 0) {
+		bstrMapDestroy(pool->map);
+		bMemFree(pool);
+		return NULL;
+	}
+#endif
+	return pool;
+}
+
+int
+bstrPoolDestroy(struct bstrPool *pool)
+{
+	if (pool == NULL) {
+		return BSTR_ERR;
+	}
+#if !defined(BSTRLIB_NO_THREADS)
+	if (pool->locked) {
+		lockDestroy(&pool->lock);
+	}
+#endif
+	bstrMapDestroy(pool->map);
+	blocksFree(pool->blocks);
+	bMemFree(pool);
+	return BSTR_OK;
+}
+
+int
+bstrPoolCount(struct bstrPool *pool)
+{
+	int n;
+	if (pool == NULL) {
+		return BSTR_ERR;
+	}
+#if !defined(BSTRLIB_NO_THREADS)
+	if (pool->locked) {
+		lockShared(&pool->lock);
+	}
+#endif
+	n = pool->map->count;
+#if !defined(BSTRLIB_NO_THREADS)
+	if (pool->locked) {
+		unlockShared(&pool->lock);
+	}
+#endif
+	return n;
+}
+
+static bstring
+poolFind(struct bstrPool *pool, const unsigned char *p, int len, uint64_t h)
+{
+	long i;
+#if !defined(BSTRLIB_NO_THREADS)
+	if (pool->locked) {
+		bstring b = NULL;
+		lockShared(&pool->lock);
+		if ((i = mapLookup(pool->map, p, len, h)) >= 0) {
+			b = (bstring)pool->map->slots[i].value;
+		}
+		unlockShared(&pool->lock);
+		return b;
+	}
+#endif
+	if ((i = mapLookup(pool->map, p, len, h)) >= 0) {
+		return (bstring)pool->map->slots[i].value;
+	}
+	return NULL;
+}
+
+/*
+ * Add a string to the pool. The header and the bytes of each string share a
+ * piece of a block, and the map refers to those bytes rather than keeping a
+ * copy of its own.
+ */
+static bstring
+poolAdd(struct bstrPool *pool, const unsigned char *p, int len, uint64_t h)
+{
+	struct tagbstring *t;
+	long i;
+	if ((i = mapLookup(pool->map, p, len, h)) >= 0) {
+		return (bstring)pool->map->slots[i].value;
+	}
+	t = blockTake(&pool->blocks, sizeof(struct tagbstring) + (size_t)len + 1,
+		      sizeof(void *));
+	if (t == NULL) {
+		return NULL;
+	}
+	t->data = (unsigned char *)(t + 1);
+	memcpy(t->data, p, (size_t)len);
+	t->data[len] = '\0';
+	t->slen = len;
+	t->mlen = len + 1;
+	bwriteprotect(*t);
+	if (mapInsert(pool->map, t->data, len, h, t, 1) < 0) {
+		return NULL;
+	}
+	return t;
+}
+
+bstring
+bstrPoolInternBlk(struct bstrPool *pool, const void *blk, int len)
+{
+	const unsigned char *p = (const unsigned char *)blk;
+	uint64_t h;
+	bstring b;
+	if (pool == NULL || blk == NULL || len < 0) {
+		return NULL;
+	}
+	h = bhashblk(p, len, pool->map->seed);
+#if !defined(BSTRLIB_NO_THREADS)
+	if (pool->locked) {
+		if ((b = poolFind(pool, p, len, h)) != NULL) {
+			return b;
+		}
+		lockExclusive(&pool->lock);
+		b = poolAdd(pool, p, len, h);
+		unlockExclusive(&pool->lock);
+		return b;
+	}
+#endif
+	b = poolAdd(pool, p, len, h);
+	return b;
+}
+
+bstring
+bstrPoolIntern(struct bstrPool *pool, const bstring b)
+{
+	if (b == NULL || b->data == NULL || b->slen < 0) {
+		return NULL;
+	}
+	return bstrPoolInternBlk(pool, b->data, b->slen);
+}
+
+bstring
+bstrPoolFindBlk(struct bstrPool *pool, const void *blk, int len)
+{
+	if (pool == NULL || blk == NULL || len < 0) {
+		return NULL;
+	}
+	return poolFind(pool, (const unsigned char *)blk, len,
+			bhashblk(blk, len, pool->map->seed));
+}
+
+bstring
+bstrPoolFind(struct bstrPool *pool, const bstring b)
+{
+	if (b == NULL || b->data == NULL || b->slen < 0) {
+		return NULL;
+	}
+	return bstrPoolFindBlk(pool, b->data, b->slen);
+}
@@ -0,0 +1,279 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/**
+ * \file
+ * \brief Hash map keyed by the contents of bstrings.
+ *
+ * The map is an open addressing table in the style of the Swiss tables: a
+ * byte of metadata per slot holds seven bits of the hash of its key, and a
+ * whole group of these is compared against the hash of a wanted key at once,
+ * so that nearly every lookup examines just one key. The map keeps its own
+ * copy of every key, short keys within the table itself and longer ones
+ * packed into large blocks of memory, so inserting a key does not allocate a
+ * bstring for it.
+ *
+ * The same module provides struct bstrPool, which interns strings: it hands
+ * out one shared bstring for each distinct content, so that strings taken
+ * from the pool can be compared by their pointers alone.
+ *
+ * Depends on bstrlib.h.
+ */
+
+#ifndef BSTRLIB_MAP_H
+#define BSTRLIB_MAP_H
+
+#include "bstrlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct bstrMap;
+
+/**
+ * Create an empty map.
+ *
+ * Each map hashes its keys with a seed of its own, so that the order of its
+ * entries cannot be predicted and collisions cannot be provoked from
+ * outside. NULL is returned if memory cannot be allocated.
+ */
+BSTR_PUBLIC struct bstrMap *
+bstrMapCreate(void);
+
+/**
+ * Destroy a map along with its copies of the keys.
+ *
+ * The values are not affected. Returns BSTR_ERR if m is NULL, otherwise
+ * BSTR_OK.
+ */
+BSTR_PUBLIC int
+bstrMapDestroy(struct bstrMap *m);
+
+/**
+ * Remove every entry from the map, keeping the memory it has allocated for
+ * reuse.
+ *
+ * Returns BSTR_ERR if m is NULL, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bstrMapClear(struct bstrMap *m);
+
+/**
+ * Return the number of entries in the map, or BSTR_ERR if m is NULL.
+ */
+BSTR_PUBLIC int
+bstrMapCount(const struct bstrMap *m);
+
+/**
+ * Ensure that the map can hold at least n entries without growing.
+ *
+ * Returns BSTR_ERR if m is NULL, n is negative or memory cannot be
+ * allocated, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bstrMapReserve(struct bstrMap *m, int n);
+
+/**
+ * Return the seed with which the map hashes its keys.
+ *
+ * A struct bstrHashKey initialized with this seed lets bstrMapFindKey skip
+ * hashing the key. Returns 0 if m is NULL.
+ */
+BSTR_PUBLIC uint64_t
+bstrMapSeed(const struct bstrMap *m);
+
+/**
+ * Associate value with the contents of key, replacing any value it had.
+ *
+ * A copy of the contents of key is stored in the map, so key may be changed
+ * or destroyed afterwards. Returns 1 if key was added, 0 if its value was
+ * replaced, and BSTR_ERR if m or key is NULL, key is invalid or memory
+ * cannot be allocated.
+ */
+BSTR_PUBLIC int
+bstrMapSet(struct bstrMap *m, const bstring key, void *value);
+
+/**
+ * Associate value with the len bytes at blk, as for bstrMapSet.
+ */
+BSTR_PUBLIC int
+bstrMapSetBlk(struct bstrMap *m, const void *blk, int len, void *value);
+
+/**
+ * Look up the contents of key.
+ *
+ * If it is found, 1 is returned and its value is written to *value, unless
+ * value is NULL. If it is not found, 0 is returned and *value is left
+ * unchanged. BSTR_ERR is returned if m or key is NULL or key is invalid.
+ */
+BSTR_PUBLIC int
+bstrMapFind(const struct bstrMap *m, const bstring key, void **value);
+
+/**
+ * Look up the len bytes at blk, as for bstrMapFind.
+ *
+ * This saves building a struct tagbstring just for the lookup.
+ */
+BSTR_PUBLIC int
+bstrMapFindBlk(const struct bstrMap *m, const void *blk, int len,
+	       void **value);
+
+/**
+ * Look up the string referred to by the hashed key k, as for bstrMapFind.
+ *
+ * If k was hashed with the seed of this map, see bstrMapSeed, the cached
+ * hash is used and the key is not hashed again. Otherwise it is rehashed and
+ * k updated for the next lookup.
+ */
+BSTR_PUBLIC int
+bstrMapFindKey(const struct bstrMap *m, struct bstrHashKey *k, void **value);
+
+/**
+ * Remove the entry for the contents of key.
+ *
+ * If it is found, 1 is returned and, unless value is NULL, the value it had
+ * is written to *value so that it can be released. If it is not found, 0 is
+ * returned. BSTR_ERR is returned if m or key is NULL or key is invalid.
+ */
+BSTR_PUBLIC int
+bstrMapErase(struct bstrMap *m, const bstring key, void **value);
+
+/**
+ * Remove the entry for the len bytes at blk, as for bstrMapErase.
+ */
+BSTR_PUBLIC int
+bstrMapEraseBlk(struct bstrMap *m, const void *blk, int len, void **value);
+
+/**
+ * Step through the entries of the map.
+ *
+ * *pos should be 0 before the first call. Each call that finds another entry
+ * returns 1, sets key to a write protected reference to the map's copy of
+ * its key, writes its value to *value unless value is NULL, and advances
+ * *pos. Once every entry has been visited 0 is returned. The entries come in
+ * no particular order. Adding or removing entries ends the iteration, and
+ * invalidates the keys returned by it. BSTR_ERR is returned if m, pos or key
+ * is NULL.
+ *
+ * \code
+ * struct tagbstring key;
+ * void *value;
+ * int pos = 0;
+ *
+ * while (bstrMapNext(m, &pos, &key, &value) == 1) {
+ *     ...
+ * }
+ * \endcode
+ */
+BSTR_PUBLIC int
+bstrMapNext(const struct bstrMap *m, int *pos, struct tagbstring *key,
+	    void **value);
+
+/**
+ * Flag for bstrPoolCreate: make the pool safe to use from several threads at
+ * once.
+ */
+#define BSTR_POOL_LOCKED 1
+
+struct bstrPool;
+
+/**
+ * Create an empty pool of interned strings.
+ *
+ * If flags contains BSTR_POOL_LOCKED, every operation on the pool takes a
+ * lock, which readers may hold together, so that strings can be interned
+ * from several threads at once. Otherwise the pool must only be used by one
+ * thread at a time. NULL is returned if memory cannot be allocated, or if
+ * BSTR_POOL_LOCKED is requested from a library built with
+ * BSTRLIB_NO_THREADS.
+ */
+BSTR_PUBLIC struct bstrPool *
+bstrPoolCreate(int flags);
+
+/**
+ * Destroy a pool, along with every string it has handed out.
+ *
+ * Returns BSTR_ERR if pool is NULL, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bstrPoolDestroy(struct bstrPool *pool);
+
+/**
+ * Return the number of distinct strings in the pool, or BSTR_ERR if pool is
+ * NULL.
+ */
+BSTR_PUBLIC int
+bstrPoolCount(struct bstrPool *pool);
+
+/**
+ * Return the pool's string with the same contents as b, adding one if there
+ * is none.
+ *
+ * Every call with equal contents returns the same pointer, so interned
+ * strings are equal exactly when their pointers are. The string belongs to
+ * the pool and stays valid until the pool is destroyed. It is write
+ * protected, see bwriteprotect, so it cannot be modified, and it must not be
+ * passed to bdestroy. NULL is returned if pool or b is NULL, b is invalid or
+ * memory cannot be allocated.
+ */
+BSTR_PUBLIC bstring
+bstrPoolIntern(struct bstrPool *pool, const bstring b);
+
+/**
+ * Intern the len bytes at blk, as for bstrPoolIntern.
+ *
+ * When the contents are already in the pool, nothing is allocated, so a
+ * parser can intern a token straight out of its input buffer.
+ */
+BSTR_PUBLIC bstring
+bstrPoolInternBlk(struct bstrPool *pool, const void *blk, int len);
+
+/**
+ * Return the pool's string with the same contents as b, or NULL if there is
+ * none, or if pool or b is NULL or b is invalid. Nothing is added.
+ */
+BSTR_PUBLIC bstring
+bstrPoolFind(struct bstrPool *pool, const bstring b);
+
+/**
+ * Look up the len bytes at blk, as for bstrPoolFind.
+ */
+BSTR_PUBLIC bstring
+bstrPoolFindBlk(struct bstrPool *pool, const void *blk, int len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BSTRLIB_MAP_H */
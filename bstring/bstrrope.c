@@ -0,0 +1,825 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * bstrrope.c
+ *
+ * This file implements ropes. A rope is a treap of chunks: each node holds
+ * a chunk of at most ROPE_CHUNK bytes together with the number of bytes in
+ * its subtree, the nodes are in the order of their chunks, and the random
+ * priorities of the nodes keep the tree balanced in expectation. Every edit
+ * first cuts the chunks at the ends of the range it touches, then splits the
+ * tree there and merges the pieces back together, so that only the chunks
+ * at the edit are copied. Small edits within a single chunk are made in
+ * place instead, and small chunks meeting where pieces are joined are
+ * coalesced so that repeated small edits do not fragment the rope.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+#include "bstrrope.h"
+#include "bstralloc.h"
+
+#define ROPE_CHUNK 4096
+#define ROPE_SMALL 512
+#define ROPE_MIN_ALLOC 64
+
+struct ropeNode {
+	struct ropeNode *left;
+	struct ropeNode *right;
+	unsigned int prio;
+	int size;
+	int len;
+	int mlen;
+	unsigned char *data;
+};
+
+struct bstrRope {
+	struct ropeNode *root;
+	unsigned int rng;
+};
+
+typedef int (*ropeVisit)(void *state, const unsigned char *p, int len,
+			 int ofs);
+
+#define nodeSize(t) ((t) != NULL ? (t)->size : 0)
+
+static void
+nodeUpdate(struct ropeNode *t)
+{
+	t->size = nodeSize(t->left) + t->len + nodeSize(t->right);
+}
+
+static int
+chunkAlloc(int len)
+{
+	int n = ROPE_MIN_ALLOC;
+	while (n < len) {
+		n <<= 1;
+	}
+	return n;
+}
+
+static struct ropeNode *
+nodeNew(struct bstrRope *r, const unsigned char *p, int len)
+{
+	struct ropeNode *t = bMemAlloc(sizeof(struct ropeNode));
+	if (t == NULL) {
+		return NULL;
+	}
+	t->mlen = chunkAlloc(len);
+	t->data = bMemAlloc((size_t)t->mlen);
+	if (t->data == NULL) {
+		bMemFree(t);
+		return NULL;
+	}
+	memcpy(t->data, p, (size_t)len);
+	t->left = t->right = NULL;
+	/* xorshift32 */
+	r->rng ^= r->rng << 13;
+	r->rng ^= r->rng >> 17;
+	r->rng ^= r->rng << 5;
+	t->prio = r->rng;
+	t->len = t->size = len;
+	return t;
+}
+
+static void
+treeFree(struct ropeNode *t)
+{
+	struct ropeNode *right;
+	while (t != NULL) {
+		treeFree(t->left);
+		right = t->right;
+		bMemFree(t->data);
+		bMemFree(t);
+		t = right;
+	}
+}
+
+static struct ropeNode *
+treeMerge(struct ropeNode *a, struct ropeNode *b)
+{
+	if (a == NULL) {
+		return b;
+	}
+	if (b == NULL) {
+		return a;
+	}
+	if (a->prio > b->prio) {
+		a->right = treeMerge(a->right, b);
+		nodeUpdate(a);
+		return a;
+	}
+	b->left = treeMerge(a, b->left);
+	nodeUpdate(b);
+	return b;
+}
+
+/*
+ * Split t into the chunks before pos and those from pos on. pos must fall
+ * on a boundary between chunks, see ropeCut.
+ */
+static void
+treeSplit(struct ropeNode *t, int pos, struct ropeNode **l,
+	  struct ropeNode **r)
+{
+	int ls;
+	if (t == NULL) {
+		*l = *r = NULL;
+		return;
+	}
+	ls = nodeSize(t->left);
+	if (pos <= ls) {
+		treeSplit(t->left, pos, l, &t->left);
+		*r = t;
+	} else {
+		treeSplit(t->right, pos - ls - t->len, &t->right, r);
+		*l = t;
+	}
+	nodeUpdate(t);
+}
+
+/* Build a tree holding a copy of the len bytes at p */
+static int
+treeBuild(struct bstrRope *r, const unsigned char *p, int len,
+	  struct ropeNode **out)
+{
+	struct ropeNode *t = NULL, *n;
+	int i, l;
+	for (i = 0; i < len; i += l) {
+		l = len - i < ROPE_CHUNK ? len - i : ROPE_CHUNK;
+		if ((n = nodeNew(r, p + i, l)) == NULL) {
+			treeFree(t);
+			return BSTR_ERR;
+		}
+		t = treeMerge(t, n);
+	}
+	*out = t;
+	return BSTR_OK;
+}
+
+/*
+ * Merge a and b, first moving the first chunk of b onto the end of the last
+ * chunk of a if either is small and they fit in one chunk together.
+ */
+static struct ropeNode *
+treeJoin(struct ropeNode *a, struct ropeNode *b)
+{
+	struct ropeNode *la, *fb, *u, **pp;
+	unsigned char *d;
+	int n;
+	if (a == NULL || b == NULL) {
+		return treeMerge(a, b);
+	}
+	for (la = a; la->right != NULL; la = la->right) {
+	}
+	for (fb = b; fb->left != NULL; fb = fb->left) {
+	}
+	n = fb->len;
+	if ((la->len >= ROPE_SMALL && n >= ROPE_SMALL) ||
+	    la->len + n > ROPE_CHUNK) {
+		return treeMerge(a, b);
+	}
+	if (la->len + n > la->mlen) {
+		d = bMemRealloc(la->data, (size_t)chunkAlloc(la->len + n));
+		if (d == NULL) {
+			return treeMerge(a, b);
+		}
+		la->data = d;
+		la->mlen = chunkAlloc(la->len + n);
+	}
+	memcpy(la->data + la->len, fb->data, (size_t)n);
+	la->len += n;
+	for (u = a; u != NULL; u = u->right) {
+		u->size += n;
+	}
+	for (pp = &b; (*pp)->left != NULL; pp = &(*pp)->left) {
+		(*pp)->size -= n;
+	}
+	*pp = fb->right;
+	bMemFree(fb->data);
+	bMemFree(fb);
+	return treeMerge(a, b);
+}
+
+/*
+ * Make pos a boundary between chunks, by splitting the chunk containing it
+ * in two if need be. The rope is unchanged if this fails.
+ */
+static int
+ropeCut(struct bstrRope *r, int pos)
+{
+	struct ropeNode *t = r->root, *u, *n, *a, *b;
+	int q = pos, ls = 0, off, tail;
+	while (t != NULL) {
+		ls = nodeSize(t->left);
+		if (q < ls) {
+			t = t->left;
+		} else if (q < ls + t->len) {
+			break;
+		} else {
+			q -= ls + t->len;
+			t = t->right;
+		}
+	}
+	if (t == NULL || (off = q - ls) == 0) {
+		return BSTR_OK;
+	}
+	tail = t->len - off;
+	if ((n = nodeNew(r, t->data + off, tail)) == NULL) {
+		return BSTR_ERR;
+	}
+	for (u = r->root, q = pos; u != t;) {
+		ls = nodeSize(u->left);
+		u->size -= tail;
+		if (q < ls) {
+			u = u->left;
+		} else {
+			q -= ls + u->len;
+			u = u->right;
+		}
+	}
+	t->len = off;
+	t->size -= tail;
+	treeSplit(r->root, pos, &a, &b);
+	r->root = treeMerge(treeMerge(a, n), b);
+	return BSTR_OK;
+}
+
+/*
+ * Replace dlen bytes at pos with a copy of the len bytes at p. The range
+ * must be within the rope. The rope is unchanged if this fails.
+ */
+static int
+ropeSplice(struct bstrRope *r, int pos, int dlen, const unsigned char *p,
+	   int len)
+{
+	struct ropeNode *n = NULL, *a, *mid, *c;
+	if (treeBuild(r, p, len, &n) != BSTR_OK) {
+		return BSTR_ERR;
+	}
+	if (ropeCut(r, pos) != BSTR_OK || ropeCut(r, pos + dlen) != BSTR_OK) {
+		treeFree(n);
+		return BSTR_ERR;
+	}
+	treeSplit(r->root, pos, &a, &c);
+	treeSplit(c, dlen, &mid, &c);
+	treeFree(mid);
+	r->root = treeJoin(treeJoin(a, n), c);
+	return BSTR_OK;
+}
+
+/*
+ * Insert within the chunk holding pos, preferring the end of the chunk
+ * before it, if the result still fits in one chunk. Returns 1 if the
+ * insertion was made and 0 if it should be made by ropeSplice.
+ */
+static int
+ropeInsertInPlace(struct bstrRope *r, int pos, const unsigned char *p,
+		  int len)
+{
+	struct ropeNode *t = r->root, *u;
+	unsigned char *d;
+	int q = pos, ls = 0, off;
+	while (t != NULL) {
+		ls = nodeSize(t->left);
+		if (q < ls || (q == ls && ls > 0)) {
+			t = t->left;
+		} else if (q <= ls + t->len) {
+			break;
+		} else {
+			q -= ls + t->len;
+			t = t->right;
+		}
+	}
+	if (t == NULL || t->len + len > ROPE_CHUNK ||
+	    (p >= t->data && p < t->data + t->mlen)) {
+		return 0;
+	}
+	off = q - ls;
+	if (t->len + len > t->mlen) {
+		d = bMemRealloc(t->data, (size_t)chunkAlloc(t->len + len));
+		if (d == NULL) {
+			return 0;
+		}
+		t->data = d;
+		t->mlen = chunkAlloc(t->len + len);
+	}
+	for (u = r->root, q = pos; u != t;) {
+		ls = nodeSize(u->left);
+		u->size += len;
+		if (q < ls || (q == ls && ls > 0)) {
+			u = u->left;
+		} else {
+			q -= ls + u->len;
+			u = u->right;
+		}
+	}
+	memmove(t->data + off + len, t->data + off, (size_t)(t->len - off));
+	memcpy(t->data + off, p, (size_t)len);
+	t->len += len;
+	t->size += len;
+	return 1;
+}
+
+/*
+ * Delete within the chunk holding pos if the range lies inside it and
+ * leaves some of it. Returns 1 if the deletion was made and 0 if it should
+ * be made by ropeSplice.
+ */
+static int
+ropeDeleteInPlace(struct bstrRope *r, int pos, int len)
+{
+	struct ropeNode *t = r->root, *u;
+	int q = pos, ls = 0, off;
+	while (t != NULL) {
+		ls = nodeSize(t->left);
+		if (q < ls) {
+			t = t->left;
+		} else if (q < ls + t->len) {
+			break;
+		} else {
+			q -= ls + t->len;
+			t = t->right;
+		}
+	}
+	off = q - ls;
+	if (t == NULL || off + len > t->len || len >= t->len) {
+		return 0;
+	}
+	for (u = r->root, q = pos; u != t;) {
+		ls = nodeSize(u->left);
+		u->size -= len;
+		if (q < ls) {
+			u = u->left;
+		} else {
+			q -= ls + u->len;
+			u = u->right;
+		}
+	}
+	memmove(t->data + off, t->data + off + len,
+		(size_t)(t->len - off - len));
+	t->len -= len;
+	t->size -= len;
+	return 1;
+}
+
+/*
+ * Call fn on the chunks of t in order, starting at position from, with the
+ * first chunk trimmed to start there. base is the position of t in the
+ * rope. The walk stops when fn returns non-zero, and that value is returned.
+ */
+static int
+treeWalk(const struct ropeNode *t, int base, int from, ropeVisit fn,
+	 void *state)
+{
+	int ls, s, ret;
+	while (t != NULL) {
+		ls = nodeSize(t->left);
+		if (from < base + ls) {
+			ret = treeWalk(t->left, base, from, fn, state);
+			if (ret) {
+				return ret;
+			}
+		}
+		base += ls;
+		if (from < base + t->len) {
+			s = from > base ? from - base : 0;
+			ret = fn(state, t->data + s, t->len - s, base + s);
+			if (ret) {
+				return ret;
+			}
+		}
+		base += t->len;
+		t = t->right;
+	}
+	return 0;
+}
+
+struct bstrRope *
+bstrRopeCreate(void)
+{
+	struct bstrRope *r = bMemAlloc(sizeof(struct bstrRope));
+	if (r == NULL) {
+		return NULL;
+	}
+	r->root = NULL;
+	r->rng = 2463534242u;
+	return r;
+}
+
+struct bstrRope *
+bstrRopeFromBstr(const bstring b)
+{
+	struct bstrRope *r;
+	if (b == NULL || b->data == NULL || b->slen < 0) {
+		return NULL;
+	}
+	if ((r = bstrRopeCreate()) == NULL) {
+		return NULL;
+	}
+	if (treeBuild(r, b->data, b->slen, &r->root) != BSTR_OK) {
+		bMemFree(r);
+		return NULL;
+	}
+	return r;
+}
+
+int
+bstrRopeDestroy(struct bstrRope *r)
+{
+	if (r == NULL) {
+		return BSTR_ERR;
+	}
+	treeFree(r->root);
+	bMemFree(r);
+	return BSTR_OK;
+}
+
+int
+bstrRopeLength(const struct bstrRope *r)
+{
+	if (r == NULL) {
+		return BSTR_ERR;
+	}
+	return nodeSize(r->root);
+}
+
+int
+bstrRopeCharAt(const struct bstrRope *r, int pos)
+{
+	const struct ropeNode *t;
+	int ls;
+	if (r == NULL || pos < 0 || pos >= nodeSize(r->root)) {
+		return BSTR_ERR;
+	}
+	t = r->root;
+	for (;;) {
+		ls = nodeSize(t->left);
+		if (pos < ls) {
+			t = t->left;
+		} else if (pos < ls + t->len) {
+			return t->data[pos - ls];
+		} else {
+			pos -= ls + t->len;
+			t = t->right;
+		}
+	}
+}
+
+int
+bstrRopeInsertBlk(struct bstrRope *r, int pos, const void *blk, int len)
+{
+	int ret;
+	if (r == NULL || blk == NULL || len < 0 || pos < 0 ||
+	    pos > nodeSize(r->root) || len > INT_MAX - nodeSize(r->root)) {
+		return BSTR_ERR;
+	}
+	if (len == 0) {
+		return BSTR_OK;
+	}
+	ret = ropeInsertInPlace(r, pos, (const unsigned char *)blk, len);
+	if (ret) {
+		return BSTR_OK;
+	}
+	return ropeSplice(r, pos, 0, (const unsigned char *)blk, len);
+}
+
+int
+bstrRopeInsert(struct bstrRope *r, int pos, const bstring b)
+{
+	if (b == NULL || b->data == NULL || b->slen < 0) {
+		return BSTR_ERR;
+	}
+	return bstrRopeInsertBlk(r, pos, b->data, b->slen);
+}
+
+int
+bstrRopeAppend(struct bstrRope *r, const bstring b)
+{
+	if (r == NULL) {
+		return BSTR_ERR;
+	}
+	return bstrRopeInsert(r, nodeSize(r->root), b);
+}
+
+int
+bstrRopeDelete(struct bstrRope *r, int pos, int len)
+{
+	int total;
+	if (pos < 0) {
+		len += pos;
+		pos = 0;
+	}
+	if (r == NULL || len < 0) {
+		return BSTR_ERR;
+	}
+	total = nodeSize(r->root);
+	if (len == 0 || pos >= total) {
+		return BSTR_OK;
+	}
+	if (len > total - pos) {
+		len = total - pos;
+	}
+	if (ropeDeleteInPlace(r, pos, len)) {
+		return BSTR_OK;
+	}
+	return ropeSplice(r, pos, len, NULL, 0);
+}
+
+int
+bstrRopeReplace(struct bstrRope *r, int pos, int len, const bstring b)
+{
+	int total;
+	if (r == NULL || b == NULL || b->data == NULL || b->slen < 0 ||
+	    pos < 0 || len < 0) {
+		return BSTR_ERR;
+	}
+	total = nodeSize(r->root);
+	if (pos > total) {
+		return BSTR_ERR;
+	}
+	if (len > total - pos) {
+		len = total - pos;
+	}
+	if (b->slen - len > INT_MAX - total) {
+		return BSTR_ERR;
+	}
+	return ropeSplice(r, pos, len, b->data, b->slen);
+}
+
+int
+bstrRopeConcat(struct bstrRope *r, struct bstrRope *other)
+{
+	if (r == NULL || other == NULL || r == other ||
+	    nodeSize(other->root) > INT_MAX - nodeSize(r->root)) {
+		return BSTR_ERR;
+	}
+	r->root = treeJoin(r->root, other->root);
+	other->root = NULL;
+	return BSTR_OK;
+}
+
+struct bstrRope *
+bstrRopeSplit(struct bstrRope *r, int pos)
+{
+	struct bstrRope *tail;
+	if (r == NULL || pos < 0 || pos > nodeSize(r->root)) {
+		return NULL;
+	}
+	if ((tail = bstrRopeCreate()) == NULL) {
+		return NULL;
+	}
+	if (ropeCut(r, pos) != BSTR_OK) {
+		bMemFree(tail);
+		return NULL;
+	}
+	tail->rng = r->rng ^ 0x9E3779B9u;
+	treeSplit(r->root, pos, &r->root, &tail->root);
+	return tail;
+}
+
+struct ropeCopy {
+	unsigned char *out;
+	int left;
+};
+
+static int
+copyVisit(void *state, const unsigned char *p, int len, int ofs)
+{
+	struct ropeCopy *c = (struct ropeCopy *)state;
+	(void)ofs;
+	if (len > c->left) {
+		len = c->left;
+	}
+	memcpy(c->out, p, (size_t)len);
+	c->out += len;
+	c->left -= len;
+	return c->left == 0;
+}
+
+bstring
+bstrRopeSubstr(const struct bstrRope *r, int pos, int len)
+{
+	struct ropeCopy c;
+	bstring b;
+	int total;
+	if (r == NULL) {
+		return NULL;
+	}
+	total = nodeSize(r->root);
+	if (pos < 0) {
+		len += pos;
+		pos = 0;
+	}
+	if (len > total - pos) {
+		len = total - pos;
+	}
+	if (len <= 0) {
+		return bfromcstr("");
+	}
+	if ((b = bfromcstralloc(len + 1, "")) == NULL) {
+		return NULL;
+	}
+	c.out = b->data;
+	c.left = len;
+	treeWalk(r->root, 0, pos, copyVisit, &c);
+	b->slen = len;
+	b->data[len] = '\0';
+	return b;
+}
+
+bstring
+bstrRopeFlatten(const struct bstrRope *r)
+{
+	if (r == NULL) {
+		return NULL;
+	}
+	return bstrRopeSubstr(r, 0, nodeSize(r->root));
+}
+
+struct ropeChunks {
+	int (*cb)(void *parm, int ofs, const bstring chunk);
+	void *parm;
+	int ret;
+};
+
+static int
+chunkVisit(void *state, const unsigned char *p, int len, int ofs)
+{
+	struct ropeChunks *c = (struct ropeChunks *)state;
+	struct tagbstring t;
+	blk2tbstr(t, p, len);
+	c->ret = c->cb(c->parm, ofs, &t);
+	return c->ret < 0;
+}
+
+int
+bstrRopeChunks(const struct bstrRope *r,
+	       int (*cb)(void *parm, int ofs, const bstring chunk),
+	       void *parm)
+{
+	struct ropeChunks c;
+	if (r == NULL || cb == NULL) {
+		return BSTR_ERR;
+	}
+	c.cb = cb;
+	c.parm = parm;
+	c.ret = BSTR_OK;
+	if (treeWalk(r->root, 0, 0, chunkVisit, &c)) {
+		return c.ret;
+	}
+	return BSTR_OK;
+}
+
+/*
+ * A search visits the chunks in order, looking for the string first across
+ * the seam between the bytes seen so far and the chunk, then within the
+ * chunk. Only the last flen - 1 bytes seen can begin a match which has not
+ * yet been looked for, so only those are kept.
+ */
+struct ropeSearch {
+	const struct tagbstring *find;
+	int (*instr)(const bstring b1, int pos, const bstring b2);
+	unsigned char *tail;
+	int tlen;
+	int tofs;
+	int found;
+};
+
+static int
+searchVisit(void *state, const unsigned char *p, int len, int ofs)
+{
+	struct ropeSearch *s = (struct ropeSearch *)state;
+	struct tagbstring t;
+	int keep = s->find->slen - 1, head, i;
+	if (s->tlen > 0) {
+		head = len < keep ? len : keep;
+		memcpy(s->tail + s->tlen, p, (size_t)head);
+		blk2tbstr(t, s->tail, s->tlen + head);
+		if ((i = s->instr(&t, 0, (bstring)s->find)) >= 0) {
+			s->found = s->tofs + i;
+			return 1;
+		}
+	}
+	if (len > keep) {
+		blk2tbstr(t, p, len);
+		if ((i = s->instr(&t, 0, (bstring)s->find)) >= 0) {
+			s->found = ofs + i;
+			return 1;
+		}
+		/* A single byte string keeps nothing, and has no tail */
+		if (keep > 0) {
+			memcpy(s->tail, p + len - keep, (size_t)keep);
+		}
+		s->tlen = keep;
+		s->tofs = ofs + len - keep;
+		return 0;
+	}
+	if (len == 0) {
+		return 0;
+	}
+	/* The whole chunk was appended to the kept bytes above */
+	if (s->tlen == 0) {
+		memcpy(s->tail, p, (size_t)len);
+		s->tofs = ofs;
+	}
+	s->tlen += len;
+	if (s->tlen > keep) {
+		memmove(s->tail, s->tail + s->tlen - keep, (size_t)keep);
+		s->tofs += s->tlen - keep;
+		s->tlen = keep;
+	}
+	return 0;
+}
+
+static int
+ropeSearch(const struct bstrRope *r, int pos, const bstring find,
+	   int (*instr)(const bstring b1, int pos, const bstring b2))
+{
+	struct ropeSearch s;
+	int total;
+	if (r == NULL || find == NULL || find->data == NULL ||
+	    find->slen < 0) {
+		return BSTR_ERR;
+	}
+	total = nodeSize(r->root);
+	if (pos == total) {
+		return find->slen == 0 ? pos : BSTR_ERR;
+	}
+	if (pos < 0 || pos > total) {
+		return BSTR_ERR;
+	}
+	if (find->slen == 0) {
+		return pos;
+	}
+	if (total - find->slen + 1 <= pos) {
+		return BSTR_ERR;
+	}
+	s.find = find;
+	s.instr = instr;
+	s.tail = NULL;
+	s.tlen = 0;
+	s.tofs = 0;
+	s.found = BSTR_ERR;
+	if (find->slen > 1) {
+		s.tail = bMemAlloc(2 * (size_t)(find->slen - 1));
+		if (s.tail == NULL) {
+			return BSTR_ERR;
+		}
+	}
+	treeWalk(r->root, 0, pos, searchVisit, &s);
+	if (s.tail != NULL) {
+		bMemFree(s.tail);
+	}
+	return s.found;
+}
+
+int
+bstrRopeInStr(const struct bstrRope *r, int pos, const bstring find)
+{
+	return ropeSearch(r, pos, find, binstr);
+}
+
+int
+bstrRopeInStrCaseless(const struct bstrRope *r, int pos,
+		      const bstring find)
+{
+	return ropeSearch(r, pos, find, binstrcaseless);
+}
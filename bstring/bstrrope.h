@@ -0,0 +1,222 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/**
+ * \file
+ * \brief Ropes: large strings held as a tree of chunks.
+ *
+ * Editing a bstring moves every byte after the edit, which makes each edit
+ * near the start of a very large string as costly as copying the string. A
+ * rope holds its contents as a sequence of chunks of at most a few
+ * kilobytes, kept in a balanced tree ordered by position. Insertion,
+ * deletion, concatenation and splitting then touch only the chunks at the
+ * edit and a logarithmic number of tree nodes, whatever the length of the
+ * rope. The contents can be visited chunk by chunk, searched as with binstr,
+ * and flattened back into a bstring.
+ *
+ * Depends on bstrlib.h.
+ */
+
+#ifndef BSTRLIB_ROPE_H
+#define BSTRLIB_ROPE_H
+
+#include "bstrlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct bstrRope;
+
+/**
+ * Create an empty rope.
+ *
+ * NULL is returned if memory cannot be allocated.
+ */
+BSTR_PUBLIC struct bstrRope *
+bstrRopeCreate(void);
+
+/**
+ * Create a rope holding a copy of the contents of b.
+ *
+ * NULL is returned if b is NULL or invalid, or if memory cannot be
+ * allocated.
+ */
+BSTR_PUBLIC struct bstrRope *
+bstrRopeFromBstr(const bstring b);
+
+/**
+ * Destroy a rope and its contents.
+ *
+ * Returns BSTR_ERR if r is NULL, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bstrRopeDestroy(struct bstrRope *r);
+
+/**
+ * Return the number of bytes in the rope, or BSTR_ERR if r is NULL.
+ */
+BSTR_PUBLIC int
+bstrRopeLength(const struct bstrRope *r);
+
+/**
+ * Return the byte at position pos of the rope.
+ *
+ * BSTR_ERR is returned if r is NULL or pos is outside the rope.
+ */
+BSTR_PUBLIC int
+bstrRopeCharAt(const struct bstrRope *r, int pos);
+
+/**
+ * Insert a copy of the contents of b into the rope at position pos.
+ *
+ * pos may be anywhere from 0, the start of the rope, to its length, the
+ * end. Returns BSTR_ERR if r or b is NULL, b is invalid, pos is outside
+ * this range or memory cannot be allocated, in which case the rope is left
+ * unchanged. Otherwise BSTR_OK is returned.
+ */
+BSTR_PUBLIC int
+bstrRopeInsert(struct bstrRope *r, int pos, const bstring b);
+
+/**
+ * Insert a copy of the len bytes at blk into the rope, as for
+ * bstrRopeInsert.
+ */
+BSTR_PUBLIC int
+bstrRopeInsertBlk(struct bstrRope *r, int pos, const void *blk, int len);
+
+/**
+ * Append a copy of the contents of b to the rope.
+ */
+BSTR_PUBLIC int
+bstrRopeAppend(struct bstrRope *r, const bstring b);
+
+/**
+ * Remove len bytes from the rope starting at position pos.
+ *
+ * The range is clipped to the rope in the manner of bdelete. Returns
+ * BSTR_ERR if r is NULL, len is negative or memory cannot be allocated, in
+ * which case the contents of the rope are unchanged. Otherwise BSTR_OK is
+ * returned.
+ */
+BSTR_PUBLIC int
+bstrRopeDelete(struct bstrRope *r, int pos, int len);
+
+/**
+ * Replace len bytes of the rope starting at position pos with the contents
+ * of b.
+ *
+ * This is bstrRopeDelete followed by bstrRopeInsert, except that the rope is
+ * unchanged if either step fails. pos must be within the rope as for
+ * bstrRopeInsert, and the range is clipped to the end of the rope.
+ */
+BSTR_PUBLIC int
+bstrRopeReplace(struct bstrRope *r, int pos, int len, const bstring b);
+
+/**
+ * Move the contents of the rope other to the end of the rope r.
+ *
+ * other is left empty, but is not destroyed. Returns BSTR_ERR if r or other
+ * is NULL, if they are the same rope, or if the combined length would
+ * overflow an int, otherwise BSTR_OK.
+ */
+BSTR_PUBLIC int
+bstrRopeConcat(struct bstrRope *r, struct bstrRope *other);
+
+/**
+ * Split the rope at position pos.
+ *
+ * The bytes from pos onwards are moved into a new rope, which is returned,
+ * and the first pos bytes stay in r. NULL is returned if r is NULL, pos is
+ * outside the rope or memory cannot be allocated, in which case r is left
+ * unchanged.
+ */
+BSTR_PUBLIC struct bstrRope *
+bstrRopeSplit(struct bstrRope *r, int pos);
+
+/**
+ * Copy the whole rope into a newly allocated bstring.
+ *
+ * NULL is returned if r is NULL or memory cannot be allocated.
+ */
+BSTR_PUBLIC bstring
+bstrRopeFlatten(const struct bstrRope *r);
+
+/**
+ * Copy len bytes of the rope starting at position pos into a newly
+ * allocated bstring.
+ *
+ * The range is clipped to the rope in the manner of bmidstr. NULL is
+ * returned if r is NULL or memory cannot be allocated.
+ */
+BSTR_PUBLIC bstring
+bstrRopeSubstr(const struct bstrRope *r, int pos, int len);
+
+/**
+ * Call cb on each chunk of the rope in order.
+ *
+ * cb is passed parm, the position in the rope of the start of the chunk,
+ * and a write protected bstring referring to the bytes of the chunk, which
+ * is valid until the rope is next changed. The rope must not be changed by
+ * cb. If cb returns a negative value, the iteration stops and that value is
+ * returned. Otherwise BSTR_OK is returned, or BSTR_ERR if r or cb is NULL.
+ */
+BSTR_PUBLIC int
+bstrRopeChunks(const struct bstrRope *r,
+	       int (*cb)(void *parm, int ofs, const bstring chunk),
+	       void *parm);
+
+/**
+ * Search for the contents of find in the rope, starting at position pos.
+ *
+ * This has the semantics of binstr, including for matches which straddle
+ * the boundary between chunks. The position of the first match is
+ * returned, or BSTR_ERR if there is none, r or find is NULL, find is
+ * invalid or pos is outside the rope.
+ */
+BSTR_PUBLIC int
+bstrRopeInStr(const struct bstrRope *r, int pos, const bstring find);
+
+/**
+ * Search for the contents of find in the rope without regard to case,
+ * starting at position pos, with the semantics of binstrcaseless.
+ */
+BSTR_PUBLIC int
+bstrRopeInStrCaseless(const struct bstrRope *r, int pos,
+		      const bstring find);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BSTRLIB_ROPE_H */
@@ -0,0 +1,1094 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * bstrsimd.c
+ *
+ * This file implements the vector kernels used by the core and auxiliary
+ * modules. Every kernel but those for base64 has a portable implementation
+ * built on the C library. On x86 an SSE2 version is used whenever the
+ * compiler targets SSE2, and SSSE3 and AVX2 versions are selected at run
+ * time on processors which support them. Defining BSTRLIB_NO_SIMD restricts
+ * the build to the portable code.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "bstrsimd.h"
+
+/*
+ * The vector kernels below test the first and the last byte of the needle
+ * at every candidate position of a block at once, and only fall back to a
+ * full comparison of the interior bytes for positions where both agree.
+ * They all assume 0 < nlen <= hlen.
+ */
+
+#define interiorMatch(p, n, nlen) \
+	((nlen) <= 2 || !memcmp((p) + 1, (n) + 1, (nlen) - 2))
+
+static const unsigned char *
+memmemGeneric(const unsigned char *h, size_t hlen,
+	      const unsigned char *n, size_t nlen)
+{
+	const unsigned char *p, *end = h + (hlen - nlen);
+	unsigned char c0 = n[0], c1 = n[nlen - 1];
+	while (h <= end) {
+		p = (const unsigned char *)memchr(h, c0, (size_t)(end - h) + 1);
+		if (!p) {
+			break;
+		}
+		if (p[nlen - 1] == c1 && interiorMatch(p, n, nlen)) {
+			return p;
+		}
+		h = p + 1;
+	}
+	return NULL;
+}
+
+static const unsigned char *
+memrmemGeneric(const unsigned char *h, size_t hlen,
+	       const unsigned char *n, size_t nlen)
+{
+	const unsigned char *p = h + (hlen - nlen);
+	unsigned char c0 = n[0], c1 = n[nlen - 1];
+	for (;;) {
+		if (p[0] == c0 && p[nlen - 1] == c1 &&
+		    interiorMatch(p, n, nlen)) {
+			return p;
+		}
+		if (p == h) {
+			break;
+		}
+		p--;
+	}
+	return NULL;
+}
+
+#if defined(BSTR_SIMD_SSE2)
+static const unsigned char *
+memmemSSE2(const unsigned char *h, size_t hlen,
+	   const unsigned char *n, size_t nlen)
+{
+	size_t i, j, cands = hlen - nlen + 1;
+	unsigned int m;
+	const __m128i v0 = _mm_set1_epi8((char)n[0]);
+	const __m128i v1 = _mm_set1_epi8((char)n[nlen - 1]);
+	for (i = 0; i + 16 <= cands; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(h + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)
+					    (h + i + nlen - 1));
+		m = (unsigned int)_mm_movemask_epi8(
+			_mm_and_si128(_mm_cmpeq_epi8(a, v0),
+				      _mm_cmpeq_epi8(b, v1)));
+		while (m) {
+			j = i + (size_t)bSimdLowBit(m);
+			if (interiorMatch(h + j, n, nlen)) {
+				return h + j;
+			}
+			m &= m - 1;
+		}
+	}
+	if (i < cands) {
+		return memmemGeneric(h + i, hlen - i, n, nlen);
+	}
+	return NULL;
+}
+
+static const unsigned char *
+memrmemSSE2(const unsigned char *h, size_t hlen,
+	    const unsigned char *n, size_t nlen)
+{
+	size_t i = hlen - nlen + 1, j;
+	unsigned int m;
+	int k;
+	const __m128i v0 = _mm_set1_epi8((char)n[0]);
+	const __m128i v1 = _mm_set1_epi8((char)n[nlen - 1]);
+	while (i >= 16) {
+		__m128i a, b;
+		i -= 16;
+		a = _mm_loadu_si128((const __m128i *)(h + i));
+		b = _mm_loadu_si128((const __m128i *)(h + i + nlen - 1));
+		m = (unsigned int)_mm_movemask_epi8(
+			_mm_and_si128(_mm_cmpeq_epi8(a, v0),
+				      _mm_cmpeq_epi8(b, v1)));
+		while (m) {
+			k = bSimdHighBit(m);
+			j = i + (size_t)k;
+			if (interiorMatch(h + j, n, nlen)) {
+				return h + j;
+			}
+			m &= ~(1u << k);
+		}
+	}
+	if (i > 0) {
+		return memrmemGeneric(h, i - 1 + nlen, n, nlen);
+	}
+	return NULL;
+}
+#endif /* BSTR_SIMD_SSE2 */
+
+#if defined(BSTR_SIMD_AVX2)
+#define haveAVX2() __builtin_cpu_supports("avx2")
+
+__attribute__((target("avx2")))
+static const unsigned char *
+memmemAVX2(const unsigned char *h, size_t hlen,
+	   const unsigned char *n, size_t nlen)
+{
+	size_t i, j, cands = hlen - nlen + 1;
+	unsigned int m;
+	const __m256i v0 = _mm256_set1_epi8((char)n[0]);
+	const __m256i v1 = _mm256_set1_epi8((char)n[nlen - 1]);
+	for (i = 0; i + 32 <= cands; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(h + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)
+					       (h + i + nlen - 1));
+		m = (unsigned int)_mm256_movemask_epi8(
+			_mm256_and_si256(_mm256_cmpeq_epi8(a, v0),
+					 _mm256_cmpeq_epi8(b, v1)));
+		while (m) {
+			j = i + (size_t)bSimdLowBit(m);
+			if (interiorMatch(h + j, n, nlen)) {
+				return h + j;
+			}
+			m &= m - 1;
+		}
+	}
+	if (i < cands) {
+		return memmemGeneric(h + i, hlen - i, n, nlen);
+	}
+	return NULL;
+}
+
+__attribute__((target("avx2")))
+static const unsigned char *
+memrmemAVX2(const unsigned char *h, size_t hlen,
+	    const unsigned char *n, size_t nlen)
+{
+	size_t i = hlen - nlen + 1, j;
+	unsigned int m;
+	int k;
+	const __m256i v0 = _mm256_set1_epi8((char)n[0]);
+	const __m256i v1 = _mm256_set1_epi8((char)n[nlen - 1]);
+	while (i >= 32) {
+		__m256i a, b;
+		i -= 32;
+		a = _mm256_loadu_si256((const __m256i *)(h + i));
+		b = _mm256_loadu_si256((const __m256i *)(h + i + nlen - 1));
+		m = (unsigned int)_mm256_movemask_epi8(
+			_mm256_and_si256(_mm256_cmpeq_epi8(a, v0),
+					 _mm256_cmpeq_epi8(b, v1)));
+		while (m) {
+			k = bSimdHighBit(m);
+			j = i + (size_t)k;
+			if (interiorMatch(h + j, n, nlen)) {
+				return h + j;
+			}
+			m &= ~(1u << k);
+		}
+	}
+	if (i > 0) {
+		return memrmemGeneric(h, i - 1 + nlen, n, nlen);
+	}
+	return NULL;
+}
+#endif /* BSTR_SIMD_AVX2 */
+
+const unsigned char *
+bSimdMemmem(const unsigned char *h, size_t hlen,
+	    const unsigned char *n, size_t nlen)
+{
+	if (nlen == 0) {
+		return h;
+	}
+	if (nlen > hlen) {
+		return NULL;
+	}
+	if (nlen == 1) {
+		return (const unsigned char *)memchr(h, n[0], hlen);
+	}
+#if defined(BSTR_SIMD_AVX2)
+	if (hlen - nlen >= 32 && haveAVX2()) {
+		return memmemAVX2(h, hlen, n, nlen);
+	}
+#endif
+#if defined(BSTR_SIMD_SSE2)
+	return memmemSSE2(h, hlen, n, nlen);
+#else
+	return memmemGeneric(h, hlen, n, nlen);
+#endif
+}
+
+const unsigned char *
+bSimdMemrmem(const unsigned char *h, size_t hlen,
+	     const unsigned char *n, size_t nlen)
+{
+	if (nlen == 0) {
+		return h + hlen;
+	}
+	if (nlen > hlen) {
+		return NULL;
+	}
+#if defined(BSTR_SIMD_AVX2)
+	if (hlen - nlen >= 32 && haveAVX2()) {
+		return memrmemAVX2(h, hlen, n, nlen);
+	}
+#endif
+#if defined(BSTR_SIMD_SSE2)
+	return memrmemSSE2(h, hlen, n, nlen);
+#else
+	return memrmemGeneric(h, hlen, n, nlen);
+#endif
+}
+
+/*
+ * ASCII case kernels. A byte is a letter of the case being converted from if
+ * it lies within 26 of first. The bit which distinguishes the two cases of
+ * an ASCII letter is 0x20, so flipping it converts in either direction.
+ */
+
+#define asciiInRange(c, first) ((unsigned int)((c) - (first)) < 26u)
+
+static void
+caseGeneric(unsigned char *p, size_t n, unsigned char first)
+{
+	size_t i;
+	for (i = 0; i < n; i++) {
+		if (asciiInRange(p[i], first)) {
+			p[i] ^= 0x20;
+		}
+	}
+}
+
+static size_t
+caselessGeneric(const unsigned char *a, const unsigned char *b, size_t n)
+{
+	size_t i;
+	for (i = 0; i < n; i++) {
+		unsigned char x = a[i], y = b[i];
+		if (x != y) {
+			x = (unsigned char)(x ^ (asciiInRange(x, 'A') << 5));
+			y = (unsigned char)(y ^ (asciiInRange(y, 'A') << 5));
+			if (x != y) {
+				break;
+			}
+		}
+	}
+	return i;
+}
+
+#if defined(BSTR_SIMD_SSE2)
+/* Offsetting by first and flipping the sign bit turns the unsigned range
+ * test into a single signed comparison.
+ */
+#define caseMaskSSE2(x, first) \
+	_mm_and_si128(_mm_cmplt_epi8( \
+		_mm_xor_si128(_mm_sub_epi8((x), _mm_set1_epi8((char)(first))), \
+			      _mm_set1_epi8((char)0x80)), \
+		_mm_set1_epi8((char)(0x80 + 26))), _mm_set1_epi8(0x20))
+
+static void
+caseSSE2(unsigned char *p, size_t n, unsigned char first)
+{
+	size_t i;
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(p + i));
+		x = _mm_xor_si128(x, caseMaskSSE2(x, first));
+		_mm_storeu_si128((__m128i *)(p + i), x);
+	}
+	caseGeneric(p + i, n - i, first);
+}
+
+static size_t
+caselessSSE2(const unsigned char *a, const unsigned char *b, size_t n)
+{
+	size_t i;
+	unsigned int m;
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		x = _mm_xor_si128(x, caseMaskSSE2(x, 'A'));
+		y = _mm_xor_si128(y, caseMaskSSE2(y, 'A'));
+		m = 0xffffu ^ (unsigned int)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(x, y));
+		if (m) {
+			return i + (size_t)bSimdLowBit(m);
+		}
+	}
+	return i + caselessGeneric(a + i, b + i, n - i);
+}
+#endif /* BSTR_SIMD_SSE2 */
+
+#if defined(BSTR_SIMD_AVX2)
+#define caseMaskAVX2(x, first) \
+	_mm256_and_si256(_mm256_cmpgt_epi8( \
+		_mm256_set1_epi8((char)(0x80 + 26)), \
+		_mm256_xor_si256(_mm256_sub_epi8((x), \
+				 _mm256_set1_epi8((char)(first))), \
+				 _mm256_set1_epi8((char)0x80))), \
+		_mm256_set1_epi8(0x20))
+
+__attribute__((target("avx2")))
+static void
+caseAVX2(unsigned char *p, size_t n, unsigned char first)
+{
+	size_t i;
+	for (i = 0; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(p + i));
+		x = _mm256_xor_si256(x, caseMaskAVX2(x, first));
+		_mm256_storeu_si256((__m256i *)(p + i), x);
+	}
+	caseGeneric(p + i, n - i, first);
+}
+
+__attribute__((target("avx2")))
+static size_t
+caselessAVX2(const unsigned char *a, const unsigned char *b, size_t n)
+{
+	size_t i;
+	unsigned int m;
+	for (i = 0; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+		x = _mm256_xor_si256(x, caseMaskAVX2(x, 'A'));
+		y = _mm256_xor_si256(y, caseMaskAVX2(y, 'A'));
+		m = ~(unsigned int)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(x, y));
+		if (m) {
+			return i + (size_t)bSimdLowBit(m);
+		}
+	}
+	return i + caselessGeneric(a + i, b + i, n - i);
+}
+#endif /* BSTR_SIMD_AVX2 */
+
+static void
+bSimdAsciiCase(unsigned char *p, size_t n, unsigned char first)
+{
+#if defined(BSTR_SIMD_AVX2)
+	if (n >= 32 && haveAVX2()) {
+		caseAVX2(p, n, first);
+		return;
+	}
+#endif
+#if defined(BSTR_SIMD_SSE2)
+	caseSSE2(p, n, first);
+#else
+	caseGeneric(p, n, first);
+#endif
+}
+
+void
+bSimdAsciiToUpper(unsigned char *p, size_t n)
+{
+	bSimdAsciiCase(p, n, 'a');
+}
+
+void
+bSimdAsciiToLower(unsigned char *p, size_t n)
+{
+	bSimdAsciiCase(p, n, 'A');
+}
+
+size_t
+bSimdAsciiCaselessMismatch(const unsigned char *a, const unsigned char *b,
+			   size_t n)
+{
+#if defined(BSTR_SIMD_AVX2)
+	if (n >= 32 && haveAVX2()) {
+		return caselessAVX2(a, b, n);
+	}
+#endif
+#if defined(BSTR_SIMD_SSE2)
+	return caselessSSE2(a, b, n);
+#else
+	return caselessGeneric(a, b, n);
+#endif
+}
+
+/*
+ * Comparison kernels. These find the first byte at which two buffers differ
+ * or the first one holds a '\0', whichever comes first. The portable version
+ * compares a word of eight bytes at a time and uses the classic bit tricks to
+ * flag the bytes of interest without per byte branches. Both tricks are
+ * exact, so the lowest flagged byte is the answer.
+ */
+
+#define HIGHS ((uint64_t)0x8080808080808080u)
+#define nonZeroBytes(v) \
+	(((((v) & ~HIGHS) + ~HIGHS) | (v)) & HIGHS)
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define firstFlagged(m) ((size_t)__builtin_ctzll(m) >> 3)
+#endif
+
+static size_t
+mismatchGeneric(const unsigned char *a, const unsigned char *b, size_t n)
+{
+	size_t i;
+	uint64_t x, y, m;
+	for (i = 0; i + 8 <= n; i += 8) {
+		memcpy(&x, a + i, 8);
+		memcpy(&y, b + i, 8);
+		m = nonZeroBytes(x ^ y) | (nonZeroBytes(x) ^ HIGHS);
+		if (m) {
+#if defined(firstFlagged)
+			return i + firstFlagged(m);
+#else
+			break;
+#endif
+		}
+	}
+	for (; i < n; i++) {
+		if (a[i] != b[i] || a[i] == '\0') {
+			break;
+		}
+	}
+	return i;
+}
+
+#if defined(BSTR_SIMD_SSE2)
+static size_t
+mismatchSSE2(const unsigned char *a, const unsigned char *b, size_t n)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i;
+	unsigned int m;
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		m = 0xffffu ^ (unsigned int)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(x, y));
+		m |= (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero));
+		if (m) {
+			return i + (size_t)bSimdLowBit(m);
+		}
+	}
+	return i + mismatchGeneric(a + i, b + i, n - i);
+}
+#endif /* BSTR_SIMD_SSE2 */
+
+#if defined(BSTR_SIMD_AVX2)
+/* The bytes of a which are equal to those of b, with all others zeroed. A
+ * zero byte in the result is therefore one the search is looking for, and
+ * two blocks can be tested at once by taking their minimum.
+ */
+#define keptAVX2(a, b) \
+	_mm256_and_si256(_mm256_loadu_si256((const __m256i *)(a)), \
+		_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a)), \
+				  _mm256_loadu_si256((const __m256i *)(b))))
+
+__attribute__((target("avx2")))
+static size_t
+mismatchAVX2(const unsigned char *a, const unsigned char *b, size_t n)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i x0, x1;
+	size_t i;
+	unsigned int m;
+	for (i = 0; i + 64 <= n; i += 64) {
+		x0 = keptAVX2(a + i, b + i);
+		x1 = keptAVX2(a + i + 32, b + i + 32);
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+			_mm256_min_epu8(x0, x1), zero))) {
+			break;
+		}
+	}
+	for (; i + 32 <= n; i += 32) {
+		m = (unsigned int)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(keptAVX2(a + i, b + i), zero));
+		if (m) {
+			return i + (size_t)bSimdLowBit(m);
+		}
+	}
+	return i + mismatchGeneric(a + i, b + i, n - i);
+}
+#endif /* BSTR_SIMD_AVX2 */
+
+size_t
+bSimdStrMismatch(const unsigned char *a, const unsigned char *b, size_t n)
+{
+#if defined(BSTR_SIMD_AVX2)
+	if (n >= 64 && haveAVX2()) {
+		return mismatchAVX2(a, b, n);
+	}
+#endif
+#if defined(BSTR_SIMD_SSE2)
+	return mismatchSSE2(a, b, n);
+#else
+	return mismatchGeneric(a, b, n);
+#endif
+}
+
+/*
+ * Character set kernels. The layout of the set described in bstrsimd.h lets
+ * a vector of bytes be classified with two table lookups: the low nibble of
+ * each byte selects an entry of the table for its half of the byte range,
+ * and the high nibble selects the bit within it. A shuffle returns zero for
+ * lanes whose index has the top bit set, which is used to pick the table.
+ */
+
+static const unsigned char *
+setFindGeneric(const unsigned char *set, const unsigned char *p, size_t n)
+{
+	size_t i;
+	for (i = 0; i < n; i++) {
+		if (bSimdSetTest(set, p[i])) {
+			return p + i;
+		}
+	}
+	return NULL;
+}
+
+static const unsigned char *
+setFindLastGeneric(const unsigned char *set, const unsigned char *p,
+		   size_t n)
+{
+	while (n > 0) {
+		n--;
+		if (bSimdSetTest(set, p[n])) {
+			return p + n;
+		}
+	}
+	return NULL;
+}
+
+#if defined(BSTR_SIMD_SSSE3)
+#define haveSSSE3() __builtin_cpu_supports("ssse3")
+
+#define setBitsSSSE3() \
+	_mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, \
+		      1, 2, 4, 8, 16, 32, 64, -128)
+
+/* Returns a mask with a bit set for every member of the set among the 16
+ * bytes at p.
+ */
+__attribute__((target("ssse3")))
+static inline unsigned int
+setMaskSSSE3(__m128i t0, __m128i t1, const unsigned char *p)
+{
+	__m128i x = _mm_loadu_si128((const __m128i *)p);
+	__m128i lo = _mm_and_si128(x, _mm_set1_epi8((char)0x8f));
+	__m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), _mm_set1_epi8(0x0f));
+	__m128i r = _mm_or_si128(_mm_shuffle_epi8(t0, lo),
+		_mm_shuffle_epi8(t1, _mm_xor_si128(lo,
+						   _mm_set1_epi8((char)0x80))));
+	r = _mm_and_si128(r, _mm_shuffle_epi8(setBitsSSSE3(), hi));
+	return 0xffffu ^ (unsigned int)_mm_movemask_epi8(
+		_mm_cmpeq_epi8(r, _mm_setzero_si128()));
+}
+
+__attribute__((target("ssse3")))
+static const unsigned char *
+setFindSSSE3(const unsigned char *set, const unsigned char *p, size_t n)
+{
+	const __m128i t0 = _mm_loadu_si128((const __m128i *)set);
+	const __m128i t1 = _mm_loadu_si128((const __m128i *)(set + 16));
+	size_t i;
+	unsigned int m;
+	for (i = 0; i + 16 <= n; i += 16) {
+		m = setMaskSSSE3(t0, t1, p + i);
+		if (m) {
+			return p + i + bSimdLowBit(m);
+		}
+	}
+	if (i < n) {
+		/* Rescan the final, overlapping, block */
+		m = setMaskSSSE3(t0, t1, p + n - 16) >> (16 - (n - i));
+		if (m) {
+			return p + i + bSimdLowBit(m);
+		}
+	}
+	return NULL;
+}
+
+__attribute__((target("ssse3")))
+static const unsigned char *
+setFindLastSSSE3(const unsigned char *set, const unsigned char *p,
+		 size_t n)
+{
+	const __m128i t0 = _mm_loadu_si128((const __m128i *)set);
+	const __m128i t1 = _mm_loadu_si128((const __m128i *)(set + 16));
+	unsigned int m;
+	while (n >= 16) {
+		n -= 16;
+		m = setMaskSSSE3(t0, t1, p + n);
+		if (m) {
+			return p + n + bSimdHighBit(m);
+		}
+	}
+	if (n > 0) {
+		/* Rescan the first, overlapping, block */
+		m = setMaskSSSE3(t0, t1, p) & ((1u << n) - 1);
+		if (m) {
+			return p + bSimdHighBit(m);
+		}
+	}
+	return NULL;
+}
+#endif /* BSTR_SIMD_SSSE3 */
+
+#if defined(BSTR_SIMD_AVX2)
+__attribute__((target("avx2")))
+static inline unsigned int
+setMaskAVX2(__m256i t0, __m256i t1, const unsigned char *p)
+{
+	__m256i x = _mm256_loadu_si256((const __m256i *)p);
+	__m256i lo = _mm256_and_si256(x, _mm256_set1_epi8((char)0x8f));
+	__m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4),
+				      _mm256_set1_epi8(0x0f));
+	__m256i r = _mm256_or_si256(_mm256_shuffle_epi8(t0, lo),
+		_mm256_shuffle_epi8(t1, _mm256_xor_si256(lo,
+				    _mm256_set1_epi8((char)0x80))));
+	r = _mm256_and_si256(r, _mm256_shuffle_epi8(
+		_mm256_broadcastsi128_si256(setBitsSSSE3()), hi));
+	return ~(unsigned int)_mm256_movemask_epi8(
+		_mm256_cmpeq_epi8(r, _mm256_setzero_si256()));
+}
+
+__attribute__((target("avx2")))
+static const unsigned char *
+setFindAVX2(const unsigned char *set, const unsigned char *p, size_t n)
+{
+	const __m256i t0 = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)set));
+	const __m256i t1 = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)(set + 16)));
+	size_t i;
+	unsigned int m;
+	for (i = 0; i + 32 <= n; i += 32) {
+		m = setMaskAVX2(t0, t1, p + i);
+		if (m) {
+			return p + i + bSimdLowBit(m);
+		}
+	}
+	if (i < n) {
+		m = setMaskAVX2(t0, t1, p + n - 32) >> (32 - (n - i));
+		if (m) {
+			return p + i + bSimdLowBit(m);
+		}
+	}
+	return NULL;
+}
+
+__attribute__((target("avx2")))
+static const unsigned char *
+setFindLastAVX2(const unsigned char *set, const unsigned char *p, size_t n)
+{
+	const __m256i t0 = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)set));
+	const __m256i t1 = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)(set + 16)));
+	unsigned int m;
+	while (n >= 32) {
+		n -= 32;
+		m = setMaskAVX2(t0, t1, p + n);
+		if (m) {
+			return p + n + bSimdHighBit(m);
+		}
+	}
+	if (n > 0) {
+		m = setMaskAVX2(t0, t1, p) & ((1u << n) - 1);
+		if (m) {
+			return p + bSimdHighBit(m);
+		}
+	}
+	return NULL;
+}
+#endif /* BSTR_SIMD_AVX2 */
+
+const unsigned char *
+bSimdSetFind(const unsigned char *set, const unsigned char *p, size_t n)
+{
+#if defined(BSTR_SIMD_AVX2)
+	if (n >= 32 && haveAVX2()) {
+		return setFindAVX2(set, p, n);
+	}
+#endif
+#if defined(BSTR_SIMD_SSSE3)
+	if (n >= 16 && haveSSSE3()) {
+		return setFindSSSE3(set, p, n);
+	}
+#endif
+	return setFindGeneric(set, p, n);
+}
+
+const unsigned char *
+bSimdSetFindLast(const unsigned char *set, const unsigned char *p, size_t n)
+{
+#if defined(BSTR_SIMD_AVX2)
+	if (n >= 32 && haveAVX2()) {
+		return setFindLastAVX2(set, p, n);
+	}
+#endif
+#if defined(BSTR_SIMD_SSSE3)
+	if (n >= 16 && haveSSSE3()) {
+		return setFindLastSSSE3(set, p, n);
+	}
+#endif
+	return setFindLastGeneric(set, p, n);
+}
+
+/*
+ * Single byte searches. The C library's memchr is already vectorised on
+ * every platform of note, so the forward search uses it directly. There is
+ * no standard reverse counterpart, so that one has vector versions of its
+ * own.
+ */
+
+static const unsigned char *
+memrchrGeneric(const unsigned char *p, unsigned char c, size_t n)
+{
+	while (n > 0) {
+		n--;
+		if (p[n] == c) {
+			return p + n;
+		}
+	}
+	return NULL;
+}
+
+#if defined(BSTR_SIMD_SSE2)
+static const unsigned char *
+memrchrSSE2(const unsigned char *p, unsigned char c, size_t n)
+{
+	const __m128i v = _mm_set1_epi8((char)c);
+	unsigned int m;
+	while (n >= 16) {
+		n -= 16;
+		m = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v,
+			_mm_loadu_si128((const __m128i *)(p + n))));
+		if (m) {
+			return p + n + bSimdHighBit(m);
+		}
+	}
+	return memrchrGeneric(p, c, n);
+}
+#endif /* BSTR_SIMD_SSE2 */
+
+#if defined(BSTR_SIMD_AVX2)
+__attribute__((target("avx2")))
+static const unsigned char *
+memrchrAVX2(const unsigned char *p, unsigned char c, size_t n)
+{
+	const __m256i v = _mm256_set1_epi8((char)c);
+	unsigned int m;
+	while (n >= 64) {
+		__m256i x1 = _mm256_cmpeq_epi8(v,
+			_mm256_loadu_si256((const __m256i *)(p + n - 32)));
+		__m256i x0 = _mm256_cmpeq_epi8(v,
+			_mm256_loadu_si256((const __m256i *)(p + n - 64)));
+		if (_mm256_movemask_epi8(_mm256_or_si256(x0, x1))) {
+			m = (unsigned int)_mm256_movemask_epi8(x1);
+			if (m) {
+				return p + n - 32 + bSimdHighBit(m);
+			}
+			m = (unsigned int)_mm256_movemask_epi8(x0);
+			return p + n - 64 + bSimdHighBit(m);
+		}
+		n -= 64;
+	}
+	while (n >= 32) {
+		n -= 32;
+		m = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v,
+			_mm256_loadu_si256((const __m256i *)(p + n))));
+		if (m) {
+			return p + n + bSimdHighBit(m);
+		}
+	}
+	return memrchrGeneric(p, c, n);
+}
+#endif /* BSTR_SIMD_AVX2 */
+
+const unsigned char *
+bSimdMemchr(const unsigned char *p, unsigned char c, size_t n)
+{
+	return (const unsigned char *)memchr(p, c, n);
+}
+
+const unsigned char *
+bSimdMemrchr(const unsigned char *p, unsigned char c, size_t n)
+{
+#if defined(BSTR_SIMD_AVX2)
+	if (n >= 64 && haveAVX2()) {
+		return memrchrAVX2(p, c, n);
+	}
+#endif
+#if defined(BSTR_SIMD_SSE2)
+	return memrchrSSE2(p, c, n);
+#else
+	return memrchrGeneric(p, c, n);
+#endif
+}
+
+/*
+ * Base64. The vector versions follow Muła and Lemire: to encode, each group
+ * of 3 bytes is spread over 4 bytes with a shuffle, the 6 bit fields are
+ * moved into place with multiplications and each is turned into a
+ * character by adding an offset picked by a shuffle on its range. To
+ * decode, the characters are checked with shuffles on their nibbles, turned
+ * into 6 bit fields the same way, and packed with multiply-adds. There are
+ * no portable versions: whatever the vector units do not handle is left to
+ * the caller.
+ */
+
+#if defined(BSTR_SIMD_SSSE3)
+/* Offsets from values to characters, by range: 26-51, 52-61, 62, 63, 0-25 */
+#define base64OffsetsSSSE3(url) \
+	_mm_setr_epi8(71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, \
+		      (url) ? -17 : -19, (url) ? 32 : -16, 65, 0, 0)
+
+/* Nibble classes of the alphabet: a character is valid when the entries
+ * for its low and high nibble have no bit in common.
+ */
+#define base64LowSSSE3(url) ((url) ? \
+	_mm_setr_epi8(0x0b, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, \
+		      0x03, 0x03, 0x07, 0x37, 0x37, 0x35, 0x37, 0x27) : \
+	_mm_setr_epi8(0x0b, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, \
+		      0x03, 0x03, 0x07, 0x15, 0x17, 0x17, 0x17, 0x15))
+#define base64HighSSSE3(url) \
+	_mm_setr_epi8(0x01, 0x01, 0x02, 0x04, 0x08, 0x10, 0x08, \
+		      (url) ? 0x20 : 0x10, 0x01, 0x01, 0x01, 0x01, 0x01, \
+		      0x01, 0x01, 0x01)
+
+/* Offsets from characters to values by high nibble, with a correction for
+ * the one character whose nibble is shared with another range.
+ */
+#define base64RollSSSE3(url) \
+	_mm_setr_epi8(0, 0, (url) ? 17 : 19, 4, -65, -65, -71, -71, \
+		      0, 0, 0, 0, 0, 0, 0, 0)
+#define base64OddChar(url) ((url) ? '_' : '/')
+#define base64OddFix(url) ((url) ? 33 : -3)
+
+__attribute__((target("ssse3")))
+static inline __m128i
+base64EncBlockSSSE3(__m128i x, __m128i offsets)
+{
+	__m128i t0, t1, r;
+	x = _mm_shuffle_epi8(x, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6,
+					      8, 7, 10, 9, 11, 10));
+	t0 = _mm_mulhi_epu16(_mm_and_si128(x, _mm_set1_epi32(0x0fc0fc00)),
+			     _mm_set1_epi32(0x04000040));
+	t1 = _mm_mullo_epi16(_mm_and_si128(x, _mm_set1_epi32(0x003f03f0)),
+			     _mm_set1_epi32(0x01000010));
+	x = _mm_or_si128(t0, t1);
+	r = _mm_or_si128(_mm_subs_epu8(x, _mm_set1_epi8(51)),
+			 _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), x),
+				       _mm_set1_epi8(13)));
+	return _mm_add_epi8(x, _mm_shuffle_epi8(offsets, r));
+}
+
+__attribute__((target("ssse3")))
+static size_t
+base64EncodeSSSE3(unsigned char *d, const unsigned char *s, size_t n,
+		  int url)
+{
+	const __m128i offsets = base64OffsetsSSSE3(url);
+	size_t i;
+	for (i = 0; i + 16 <= n; i += 12) {
+		_mm_storeu_si128((__m128i *)d, base64EncBlockSSSE3(
+			_mm_loadu_si128((const __m128i *)(s + i)), offsets));
+		d += 16;
+	}
+	return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t
+base64DecodeSSSE3(unsigned char *d, const unsigned char *s, size_t n,
+		  int url)
+{
+	const __m128i lut0 = base64LowSSSE3(url);
+	const __m128i lut1 = base64HighSSSE3(url);
+	const __m128i roll = base64RollSSSE3(url);
+	const __m128i odd = _mm_set1_epi8(base64OddChar(url));
+	const __m128i fix = _mm_set1_epi8(base64OddFix(url));
+	const __m128i nib = _mm_set1_epi8(0x0f);
+	size_t i;
+	int v;
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), nib);
+		__m128i lo = _mm_and_si128(x, nib);
+		__m128i bad = _mm_and_si128(_mm_shuffle_epi8(lut0, lo),
+					    _mm_shuffle_epi8(lut1, hi));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(bad,
+				      _mm_setzero_si128())) != 0xffff) {
+			break;
+		}
+		x = _mm_add_epi8(_mm_add_epi8(x, _mm_shuffle_epi8(roll, hi)),
+				 _mm_and_si128(_mm_cmpeq_epi8(x, odd), fix));
+		x = _mm_maddubs_epi16(x, _mm_set1_epi32(0x01400140));
+		x = _mm_madd_epi16(x, _mm_set1_epi32(0x00011000));
+		x = _mm_shuffle_epi8(x, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9,
+						      8, 14, 13, 12, -1, -1,
+						      -1, -1));
+		_mm_storel_epi64((__m128i *)d, x);
+		v = _mm_cvtsi128_si32(_mm_srli_si128(x, 8));
+		memcpy(d + 8, &v, 4);
+		d += 12;
+	}
+	return i;
+}
+#endif /* BSTR_SIMD_SSSE3 */
+
+#if defined(BSTR_SIMD_AVX2)
+__attribute__((target("avx2")))
+static size_t
+base64EncodeAVX2(unsigned char *d, const unsigned char *s, size_t n,
+		 int url)
+{
+	const __m256i offsets = _mm256_broadcastsi128_si256(
+		base64OffsetsSSSE3(url));
+	const __m256i shuf = _mm256_broadcastsi128_si256(
+		_mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11,
+			      10));
+	size_t i;
+	for (i = 0; i + 28 <= n; i += 24) {
+		/* The two lanes take 12 bytes each */
+		__m256i x = _mm256_inserti128_si256(_mm256_castsi128_si256(
+			_mm_loadu_si128((const __m128i *)(s + i))),
+			_mm_loadu_si128((const __m128i *)(s + i + 12)), 1);
+		__m256i t0, t1, r;
+		x = _mm256_shuffle_epi8(x, shuf);
+		t0 = _mm256_mulhi_epu16(
+			_mm256_and_si256(x, _mm256_set1_epi32(0x0fc0fc00)),
+			_mm256_set1_epi32(0x04000040));
+		t1 = _mm256_mullo_epi16(
+			_mm256_and_si256(x, _mm256_set1_epi32(0x003f03f0)),
+			_mm256_set1_epi32(0x01000010));
+		x = _mm256_or_si256(t0, t1);
+		r = _mm256_or_si256(_mm256_subs_epu8(x, _mm256_set1_epi8(51)),
+			_mm256_and_si256(_mm256_cmpgt_epi8(
+				_mm256_set1_epi8(26), x), _mm256_set1_epi8(13)));
+		_mm256_storeu_si256((__m256i *)d, _mm256_add_epi8(x,
+			_mm256_shuffle_epi8(offsets, r)));
+		d += 32;
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t
+base64DecodeAVX2(unsigned char *d, const unsigned char *s, size_t n,
+		 int url)
+{
+	const __m256i lut0 = _mm256_broadcastsi128_si256(base64LowSSSE3(url));
+	const __m256i lut1 = _mm256_broadcastsi128_si256(
+		base64HighSSSE3(url));
+	const __m256i roll = _mm256_broadcastsi128_si256(
+		base64RollSSSE3(url));
+	const __m256i odd = _mm256_set1_epi8(base64OddChar(url));
+	const __m256i fix = _mm256_set1_epi8(base64OddFix(url));
+	const __m256i nib = _mm256_set1_epi8(0x0f);
+	const __m256i pack = _mm256_broadcastsi128_si256(
+		_mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1,
+			      -1, -1));
+	size_t i;
+	for (i = 0; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(s + i));
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), nib);
+		__m256i lo = _mm256_and_si256(x, nib);
+		if (!_mm256_testz_si256(_mm256_shuffle_epi8(lut0, lo),
+					_mm256_shuffle_epi8(lut1, hi))) {
+			break;
+		}
+		x = _mm256_add_epi8(_mm256_add_epi8(x,
+			_mm256_shuffle_epi8(roll, hi)),
+			_mm256_and_si256(_mm256_cmpeq_epi8(x, odd), fix));
+		x = _mm256_maddubs_epi16(x, _mm256_set1_epi32(0x01400140));
+		x = _mm256_madd_epi16(x, _mm256_set1_epi32(0x00011000));
+		x = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(x, pack),
+			_mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+		_mm_storeu_si128((__m128i *)d, _mm256_castsi256_si128(x));
+		_mm_storel_epi64((__m128i *)(d + 16),
+				 _mm256_extracti128_si256(x, 1));
+		d += 24;
+	}
+	return i;
+}
+#endif /* BSTR_SIMD_AVX2 */
+
+size_t
+bSimdBase64Encode(unsigned char *d, const unsigned char *s, size_t n,
+		  int url)
+{
+	size_t i = 0;
+#if defined(BSTR_SIMD_AVX2)
+	if (n >= 28 && haveAVX2()) {
+		i = base64EncodeAVX2(d, s, n, url);
+	}
+#endif
+#if defined(BSTR_SIMD_SSSE3)
+	if (n - i >= 16 && haveSSSE3()) {
+		i += base64EncodeSSSE3(d + i / 3 * 4, s + i, n - i, url);
+	}
+#endif
+	(void)d;
+	(void)s;
+	(void)n;
+	(void)url;
+	return i;
+}
+
+size_t
+bSimdBase64Decode(unsigned char *d, const unsigned char *s, size_t n,
+		  int url)
+{
+	size_t i = 0;
+#if defined(BSTR_SIMD_AVX2)
+	if (n >= 32 && haveAVX2()) {
+		i = base64DecodeAVX2(d, s, n, url);
+		if (i + 32 <= n) {
+			/* Stopped at a character outside the alphabet */
+			return i;
+		}
+	}
+#endif
+#if defined(BSTR_SIMD_SSSE3)
+	if (n - i >= 16 && haveSSSE3()) {
+		i += base64DecodeSSSE3(d + i / 4 * 3, s + i, n - i, url);
+	}
+#endif
+	(void)d;
+	(void)s;
+	(void)n;
+	(void)url;
+	return i;
+}
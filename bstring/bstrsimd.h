@@ -0,0 +1,232 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * bstrsimd.h
+ *
+ * Internal interface to the vector kernels used by the core module. This
+ * header is not installed and nothing declared here is part of the public
+ * API.
+ */
+
+#ifndef BSTRLIB_SIMD_H
+#define BSTRLIB_SIMD_H
+
+#include <stddef.h>
+#include "bstrlib.h"
+
+#if !defined(BSTRLIB_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BSTR_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define BSTR_SIMD_AVX2 1
+#define BSTR_SIMD_SSSE3 1
+#include <immintrin.h>
+#endif
+#endif /* BSTRLIB_NO_SIMD */
+
+/*
+ * Return the index of the lowest or the highest set bit of m, which must not
+ * be zero. These locate the matches in the masks made from vector compares.
+ */
+#if defined(__GNUC__)
+#define bSimdLowBit(m) __builtin_ctz(m)
+#define bSimdHighBit(m) (31 - __builtin_clz(m))
+#elif defined(_MSC_VER)
+#include <intrin.h>
+static inline int
+bSimdLowBit(unsigned int m)
+{
+	unsigned long i;
+	_BitScanForward(&i, m);
+	return (int)i;
+}
+
+static inline int
+bSimdHighBit(unsigned int m)
+{
+	unsigned long i;
+	_BitScanReverse(&i, m);
+	return (int)i;
+}
+#else
+static inline int
+bSimdLowBit(unsigned int m)
+{
+	int i = 0;
+	while (!(m & 1)) {
+		m >>= 1;
+		i++;
+	}
+	return i;
+}
+
+static inline int
+bSimdHighBit(unsigned int m)
+{
+	int i = 0;
+	while (m >>= 1) {
+		i++;
+	}
+	return i;
+}
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Find the first of the n bytes at p which is equal to c. Returns a pointer
+ * to it or NULL.
+ */
+BSTR_PRIVATE const unsigned char *
+bSimdMemchr(const unsigned char *p, unsigned char c, size_t n);
+
+/*
+ * Find the last of the n bytes at p which is equal to c. Returns a pointer
+ * to it or NULL.
+ */
+BSTR_PRIVATE const unsigned char *
+bSimdMemrchr(const unsigned char *p, unsigned char c, size_t n);
+
+/*
+ * Find the first occurrence of the nlen byte needle n in the hlen byte
+ * haystack h. Returns a pointer to the start of the match or NULL. An empty
+ * needle matches at h.
+ */
+BSTR_PRIVATE const unsigned char *
+bSimdMemmem(const unsigned char *h, size_t hlen,
+	    const unsigned char *n, size_t nlen);
+
+/*
+ * Find the last occurrence of the nlen byte needle n which lies entirely
+ * within the hlen byte haystack h. Returns a pointer to the start of the
+ * match or NULL. An empty needle matches at h + hlen.
+ */
+BSTR_PRIVATE const unsigned char *
+bSimdMemrmem(const unsigned char *h, size_t hlen,
+	     const unsigned char *n, size_t nlen);
+
+/*
+ * Convert the ASCII letters among the n bytes at p to upper case, leaving
+ * all other bytes unchanged.
+ */
+BSTR_PRIVATE void
+bSimdAsciiToUpper(unsigned char *p, size_t n);
+
+/*
+ * Convert the ASCII letters among the n bytes at p to lower case, leaving
+ * all other bytes unchanged.
+ */
+BSTR_PRIVATE void
+bSimdAsciiToLower(unsigned char *p, size_t n);
+
+/*
+ * Return the index of the first of the n bytes at which a and b differ when
+ * ASCII letters are compared without regard to case, or n if they do not.
+ */
+BSTR_PRIVATE size_t
+bSimdAsciiCaselessMismatch(const unsigned char *a, const unsigned char *b,
+			   size_t n);
+
+/*
+ * Return the index of the first of the n bytes at which a and b differ or a
+ * holds a '\0', or n if there is no such byte.
+ */
+BSTR_PRIVATE size_t
+bSimdStrMismatch(const unsigned char *a, const unsigned char *b, size_t n);
+
+/*
+ * Character sets for bSimdSetFind and bSimdSetFindLast are BSTR_SIMD_SET_SIZE
+ * bytes long. The byte value c is a member when the bit bSimdSetBit(c) of
+ * entry bSimdSetIndex(c) is set.
+ */
+#define BSTR_SIMD_SET_SIZE (32)
+
+#define bSimdSetIndex(c) \
+	((((unsigned int)(c) >> 7) << 4) | ((unsigned int)(c) & 15))
+
+#define bSimdSetBit(c) \
+	(1u << (((unsigned int)(c) >> 4) & 7))
+
+#define bSimdSetTest(set, c) \
+	((set)[bSimdSetIndex(c)] & bSimdSetBit(c))
+
+/*
+ * Find the first of the n bytes at p which is a member of set. Returns a
+ * pointer to it or NULL.
+ */
+BSTR_PRIVATE const unsigned char *
+bSimdSetFind(const unsigned char *set, const unsigned char *p, size_t n);
+
+/*
+ * Find the last of the n bytes at p which is a member of set. Returns a
+ * pointer to it or NULL.
+ */
+BSTR_PRIVATE const unsigned char *
+bSimdSetFindLast(const unsigned char *set, const unsigned char *p, size_t n);
+
+/*
+ * Encode the n bytes at s as base64 with the alphabet of RFC 4648, using
+ * '-' and '_' for the last two characters if url is set and '+' and '/'
+ * otherwise, writing 4 characters to d for every 3 bytes. Only whole blocks
+ * suited to the vector units are encoded: the number of bytes encoded is
+ * returned, a multiple of 3 which may be anything from 0 to n, and the
+ * rest is for the caller.
+ */
+BSTR_PRIVATE size_t
+bSimdBase64Encode(unsigned char *d, const unsigned char *s, size_t n,
+		  int url);
+
+/*
+ * Decode the n characters at s from base64 with the alphabet chosen by url
+ * as for bSimdBase64Encode, writing 3 bytes to d for every 4 characters.
+ * Decoding stops before the first block holding anything but characters of
+ * the alphabet. The number of characters decoded is returned, a multiple of
+ * 4 which may be anything from 0 to n, and the rest is for the caller.
+ */
+BSTR_PRIVATE size_t
+bSimdBase64Decode(unsigned char *d, const unsigned char *s, size_t n,
+		  int url);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BSTRLIB_SIMD_H */
@@ -3346,6 +3346,1630 @@ START_TEST(core_050)
 }
 END_TEST
 
+static int
+test51_0(const bstring h, int pos, const bstring n, int reverse)
+{
+	int i, j;
+	if (reverse) {
+		if (pos > h->slen - n->slen) {
+			pos = h->slen - n->slen;
+		}
+		for (i = pos; i >= 0; i--) {
+			for (j = 0; j < n->slen && h->data[i + j] == n->data[j];
+			     j++) {
+			}
+			if (j == n->slen) {
+				return i;
+			}
+		}
+		return BSTR_ERR;
+	}
+	for (i = pos; i <= h->slen - n->slen; i++) {
+		for (j = 0; j < n->slen && h->data[i + j] == n->data[j]; j++) {
+		}
+		if (j == n->slen) {
+			return i;
+		}
+	}
+	return BSTR_ERR;
+}
+
+START_TEST(core_051)
+{
+	/* binstr and binstrr against a brute force search, over haystacks
+	 * and needles long enough to exercise the vector kernels
+	 */
+	unsigned int seed = 1;
+	int i, k, ret, len, pos;
+	bstring h, n;
+	h = bfromcstr("");
+	ck_assert(h != NULL);
+	for (i = 0; i < 700; i++) {
+		seed = seed * 1103515245u + 12345u;
+		ret = bconchar(h, (char)('a' + ((seed >> 16) % 3)));
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	for (len = 1; len <= 65; len++) {
+		for (k = 0; k < 8; k++) {
+			seed = seed * 1103515245u + 12345u;
+			pos = (int)((seed >> 8) % (unsigned int)(h->slen - len));
+			/* Alternate between needles taken from the haystack
+			 * and needles that almost certainly do not occur
+			 */
+			n = bmidstr(h, pos, len);
+			ck_assert(n != NULL);
+			if (k & 1) {
+				n->data[len - 1] = 'z';
+			}
+			pos = (int)((seed >> 4) % (unsigned int)h->slen);
+			ck_assert_int_eq(binstr(h, pos, n),
+					 test51_0(h, pos, n, 0));
+			ck_assert_int_eq(binstr(h, 0, n),
+					 test51_0(h, 0, n, 0));
+			ck_assert_int_eq(binstrr(h, pos, n),
+					 test51_0(h, pos, n, 1));
+			ck_assert_int_eq(binstrr(h, h->slen - 1, n),
+					 test51_0(h, h->slen - 1, n, 1));
+			ret = bdestroy(n);
+			ck_assert_int_eq(ret, BSTR_OK);
+		}
+	}
+	/* Matches which straddle the end of the haystack */
+	n = bfromcstr("abc");
+	ck_assert(n != NULL);
+	ret = bcatblk(h, "xyzabc", 6);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(binstr(h, 0, n), test51_0(h, 0, n, 0));
+	ck_assert_int_eq(binstr(h, h->slen - 3, n), h->slen - 3);
+	ck_assert_int_eq(binstr(h, h->slen - 2, n), BSTR_ERR);
+	ck_assert_int_eq(binstrr(h, h->slen - 1, n), h->slen - 3);
+	ret = bdestroy(n);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bdestroy(h);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+static void
+test52_0(const bstring h, const bstring n)
+{
+	struct bNeedle *nd, *ndc;
+	int pos, ret;
+	nd = bNeedleCreate(n);
+	ck_assert(nd != NULL);
+	ndc = bNeedleCreateCaseless(n);
+	ck_assert(ndc != NULL);
+	for (pos = 0; pos <= h->slen; pos += 7) {
+		ck_assert_int_eq(binstrNeedle(h, pos, nd), binstr(h, pos, n));
+		ck_assert_int_eq(binstrNeedle(h, pos, ndc),
+				 binstrcaseless(h, pos, n));
+	}
+	ck_assert_int_eq(binstrNeedle(h, -1, nd), BSTR_ERR);
+	ck_assert_int_eq(binstrNeedle(h, h->slen + 1, nd), BSTR_ERR);
+	ret = bNeedleDestroy(nd);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bNeedleDestroy(ndc);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+
+static void
+test52_1(const char *s, const char *find, const char *repl, int caseless)
+{
+	struct tagbstring f, r;
+	struct bNeedle *nd;
+	bstring b0, b1;
+	int ret;
+	cstr2tbstr(f, find);
+	cstr2tbstr(r, repl);
+	b0 = bfromcstr(s);
+	ck_assert(b0 != NULL);
+	b1 = bfromcstr(s);
+	ck_assert(b1 != NULL);
+	nd = caseless ? bNeedleCreateCaseless(&f) : bNeedleCreate(&f);
+	ck_assert(nd != NULL);
+	ret = bfindreplaceNeedle(b0, nd, &r, 0);
+	ck_assert_int_eq(ret, BSTR_OK);
+	if (caseless) {
+		ret = bfindreplacecaseless(b1, &f, &r, 0);
+	} else {
+		ret = bfindreplace(b1, &f, &r, 0);
+	}
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(biseq(b0, b1), 1);
+	ck_assert_int_eq(b0->data[b0->slen], '\0');
+	ret = bNeedleDestroy(nd);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bdestroy(b0);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bdestroy(b1);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+
+START_TEST(core_052)
+{
+	struct bNeedle *nd;
+	bstring h, n;
+	int i, ret;
+	/* tests with NULL */
+	ck_assert(bNeedleCreate(NULL) == NULL);
+	ck_assert(bNeedleCreateCaseless(NULL) == NULL);
+	ck_assert_int_eq(bNeedleDestroy(NULL), BSTR_ERR);
+	ck_assert_int_eq(binstrNeedle(&shortBstring, 0, NULL), BSTR_ERR);
+	ck_assert_int_eq(bfindreplaceNeedle(NULL, NULL, NULL, 0), BSTR_ERR);
+	/* tests with bad or empty needles */
+	ck_assert(bNeedleCreate(&emptyBstring) == NULL);
+	ck_assert(bNeedleCreate(&badBstring1) == NULL);
+	ck_assert(bNeedleCreate(&badBstring2) == NULL);
+	nd = bNeedleCreate(&shortBstring);
+	ck_assert(nd != NULL);
+	ck_assert_int_eq(binstrNeedle(NULL, 0, nd), BSTR_ERR);
+	ck_assert_int_eq(binstrNeedle(&badBstring1, 0, nd), BSTR_ERR);
+	ck_assert_int_eq(binstrNeedle(&longBstring, 0, nd), 10);
+	ck_assert_int_eq(binstrNeedle(&emptyBstring, 0, nd), BSTR_ERR);
+	ck_assert_int_eq(bfindreplaceNeedle(&shortBstring, nd, &emptyBstring,
+					    0), BSTR_ERR);
+	ret = bNeedleDestroy(nd);
+	ck_assert_int_eq(ret, BSTR_OK);
+	/* short and long needles, matching and not */
+	h = bfromcstr("");
+	ck_assert(h != NULL);
+	for (i = 0; i < 20; i++) {
+		ret = bcatcstr(h, "Mixed Case text with A needle in it; ");
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	n = bfromcstr("a NEEDLE");
+	ck_assert(n != NULL);
+	test52_0(h, n);
+	ret = bassignmidstr(n, h, 37 * 5 + 3, 200);
+	ck_assert_int_eq(ret, BSTR_OK);
+	test52_0(h, n);
+	ret = btoupper(n);
+	ck_assert_int_eq(ret, BSTR_OK);
+	test52_0(h, n);
+	ret = bdestroy(n);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bdestroy(h);
+	ck_assert_int_eq(ret, BSTR_OK);
+	/* replacement */
+	test52_1("aabaAb", "a", "aa", 0);
+	test52_1("AAbaAb", "a", "aa", 1);
+	test52_1("aabaAb", "ab", "", 0);
+	test52_1("aabaAb", "AB", "xy", 1);
+	test52_1("bogus", "x", "y", 0);
+}
+END_TEST
+
+struct test53 {
+	int mallocs;
+	int reallocs;
+	int frees;
+	int live;
+};
+
+static void *
+test53_malloc(size_t size, void *ctx)
+{
+	struct test53 *t = ctx;
+	void *p = malloc(size);
+	if (p) {
+		t->mallocs++;
+		t->live++;
+	}
+	return p;
+}
+
+static void *
+test53_realloc(void *ptr, size_t size, void *ctx)
+{
+	struct test53 *t = ctx;
+	void *p = realloc(ptr, size);
+	if (p) {
+		t->reallocs++;
+		if (!ptr) {
+			t->live++;
+		}
+	}
+	return p;
+}
+
+static void
+test53_free(void *ptr, void *ctx)
+{
+	struct test53 *t = ctx;
+	t->frees++;
+	t->live--;
+	free(ptr);
+}
+
+START_TEST(core_053)
+{
+	struct test53 t = { 0, 0, 0, 0 };
+	struct bstrList *sl;
+	bstring b;
+	char *c;
+	int ret;
+	/* tests with a partial allocator */
+	ret = bstrSetAllocator(test53_malloc, NULL, NULL, &t);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bstrSetAllocator(NULL, test53_realloc, test53_free, &t);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	/* every allocation goes through the installed functions */
+	ret = bstrSetAllocator(test53_malloc, test53_realloc, test53_free, &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	b = bfromcstr("a,b,c");
+	ck_assert(b != NULL);
+	ck_assert(t.mallocs > 0);
+	ret = bcatcstr(b, ",a much longer tail which forces a resize");
+	ck_assert_int_eq(ret, BSTR_OK);
+#if !defined(BSTRLIB_SMALL_INLINE)
+	ck_assert(t.reallocs > 0);
+#endif
+	sl = bsplit(b, ',');
+	ck_assert(sl != NULL);
+	ck_assert_int_eq(sl->qty, 4);
+	ret = bstrListAlloc(sl, 64);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert(t.reallocs > 0);
+	c = bstr2cstr(b, '?');
+	ck_assert(c != NULL);
+	ck_assert(t.live > 0);
+	ret = bcstrfree(c);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bstrListDestroy(sl);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bdestroy(b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(t.live, 0);
+	/* restore the defaults */
+	ret = bstrSetAllocator(NULL, NULL, NULL, NULL);
+	ck_assert_int_eq(ret, BSTR_OK);
+	t.mallocs = 0;
+	b = bfromcstr("default");
+	ck_assert(b != NULL);
+	ret = bdestroy(b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(t.mallocs, 0);
+}
+END_TEST
+
+/* A bump allocator, which places consecutive blocks next to each other */
+static union {
+	void *p;
+	double d;
+	unsigned char c[4096];
+} test54_heap;
+static size_t test54_used;
+
+static void *
+test54_malloc(size_t size, void *ctx)
+{
+	struct test53 *t = ctx;
+	void *p;
+	size = (size + 7) & ~(size_t)7;
+	if (size > sizeof(test54_heap) - test54_used) {
+		return NULL;
+	}
+	p = test54_heap.c + test54_used;
+	test54_used += size;
+	t->mallocs++;
+	t->live++;
+	return p;
+}
+
+static void *
+test54_realloc(void *ptr, size_t size, void *ctx)
+{
+	struct test53 *t = ctx;
+	void *p = test54_malloc(size, ctx);
+	if (p && ptr) {
+		memmove(p, ptr, size);
+		t->live--;
+	}
+	return p;
+}
+
+static void
+test54_free(void *ptr, void *ctx)
+{
+	struct test53 *t = ctx;
+	if (ptr) {
+		t->frees++;
+		t->live--;
+	}
+}
+
+START_TEST(core_054)
+{
+	struct tagbstring upper = bsStatic("ABC\0DEF");
+	struct test53 t = { 0, 0, 0, 0 };
+	bstring b, c;
+	int ret;
+	/* tests with NULL */
+	ck_assert(bfromcstrpacked(NULL) == NULL);
+	ck_assert(blk2bstrpacked(NULL, 1) == NULL);
+	ck_assert(blk2bstrpacked("x", -1) == NULL);
+	ck_assert(bstrcpypacked(NULL) == NULL);
+	ck_assert(bstrcpypacked(&badBstring1) == NULL);
+	/* header and data come from a single allocation */
+	ret = bstrSetAllocator(test53_malloc, test53_realloc, test53_free, &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	b = bfromcstrpacked("");
+	ck_assert(b != NULL);
+	ck_assert_int_eq(t.mallocs, 1);
+	ck_assert_int_eq(b->slen, 0);
+	ck_assert(b->mlen > 0);
+	ck_assert_int_eq(b->data[0], '\0');
+	ret = bdestroy(b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(t.live, 0);
+	b = blk2bstrpacked("abc\0def", 7);
+	ck_assert(b != NULL);
+	ck_assert_int_eq(t.mallocs, 2);
+	ck_assert_int_eq(b->slen, 7);
+	ck_assert(b->mlen >= 8);
+	ck_assert_int_eq(memcmp(b->data, "abc\0def", 8), 0);
+	c = bstrcpypacked(b);
+	ck_assert(c != NULL);
+	ck_assert_int_eq(t.mallocs, 3);
+	ck_assert_int_eq(biseq(b, c), 1);
+	/* in place modification */
+	ret = btoupper(c);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseq(c, &upper);
+	ck_assert_int_eq(ret, 1);
+	ret = ballocmin(c, 1);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(c->mlen, 8);
+	ck_assert_int_eq(t.reallocs, 0);
+	/* growth moves the data out of the header block */
+	ret = bcatcstr(b, " and a tail which does not fit");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(t.reallocs, 0);
+	ck_assert_int_eq(t.mallocs, 4);
+	ck_assert_int_eq(b->slen, 37);
+	ck_assert_int_eq(memcmp(b->data, "abc\0def and a tail", 18), 0);
+	ret = bcatcstr(b, "; then more growth from the heap buffer");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = ballocmin(c, 64);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(c->mlen, 64);
+	ret = bdestroy(b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bdestroy(c);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(t.live, 0);
+	/* a separate buffer placed right after its header is not packed */
+	memset(&t, 0, sizeof(t));
+	ret = bstrSetAllocator(test54_malloc, test54_realloc, test54_free, &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	b = blk2bstr(LONG_STRING, 40);
+	ck_assert(b != NULL);
+	ck_assert_int_eq(t.mallocs, 2);
+	ret = bcatcstr(b, LONG_STRING);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = ballocmin(b, 1);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bdestroy(b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(t.live, 0);
+	b = bfromcstrpacked("packed");
+	ck_assert(b != NULL);
+	c = blk2bstr(LONG_STRING, 40);
+	ck_assert(c != NULL);
+	ck_assert_int_eq(t.live, 3);
+	ret = bdestroy(b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(t.live, 2);
+	ret = bdestroy(c);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(t.live, 0);
+	ret = bstrSetAllocator(NULL, NULL, NULL, NULL);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+/* Allocations made for a short bstring */
+#if defined(BSTRLIB_SMALL_INLINE)
+#define TEST55_SHORT 1
+#else
+#define TEST55_SHORT 2
+#endif
+
+START_TEST(core_055)
+{
+	struct test53 t = { 0, 0, 0, 0 };
+	bstring b, c, d;
+	int ret;
+	ret = bstrSetAllocator(test53_malloc, test53_realloc, test53_free, &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	/* short strings need a single allocation when stored inline */
+	b = bfromcstr("short");
+	ck_assert(b != NULL);
+	ck_assert_int_eq(t.mallocs, TEST55_SHORT);
+	c = bstrcpy(b);
+	ck_assert(c != NULL);
+	ck_assert_int_eq(t.mallocs, 2 * TEST55_SHORT);
+	d = bmidstr(b, 1, 3);
+	ck_assert(d != NULL);
+	ck_assert_int_eq(t.mallocs, 3 * TEST55_SHORT);
+	ck_assert_int_eq(biseqcstr(d, "hor"), 1);
+#if !defined(BSTRLIB_SMALL_INLINE)
+	/* otherwise their data may be detached from the header */
+	{
+		unsigned char *p = d->data;
+		ret = bcstrfree((char *)d);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ck_assert_int_eq(memcmp(p, "hor", 4), 0);
+		ret = bcstrfree((char *)p);
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+#else
+	ret = bdestroy(d);
+	ck_assert_int_eq(ret, BSTR_OK);
+#endif
+	/* longer strings keep a separate buffer */
+	d = blk2bstr(LONG_STRING, (int)strlen(LONG_STRING));
+	ck_assert(d != NULL);
+	ck_assert_int_eq(t.mallocs, 3 * TEST55_SHORT + 2);
+	/* growth, shrinking and in place edits */
+	ret = bconcat(b, d);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(b->slen, 5 + d->slen);
+	ck_assert_int_eq(memcmp(b->data, "short", 5), 0);
+	ck_assert_int_eq(memcmp(b->data + 5, d->data, d->slen), 0);
+	ret = btrunc(b, 5);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = ballocmin(b, 1);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseq(b, c);
+	ck_assert_int_eq(ret, 1);
+	ret = binsertch(c, 0, 20, '-');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(c, "--------------------short");
+	ck_assert_int_eq(ret, 1);
+	ret = ballocmin(c, 1);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(c->mlen, c->slen + 1);
+	ret = bdestroy(b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bdestroy(c);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bdestroy(d);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(t.live, 0);
+	ret = bstrSetAllocator(NULL, NULL, NULL, NULL);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+static void
+test56_0(struct bstrViewList *vl, const struct bstrList *sl)
+{
+	int i;
+	ck_assert(sl != NULL);
+	ck_assert_int_eq(vl->qty, sl->qty);
+	for (i = 0; i < sl->qty; i++) {
+		ck_assert(vl->entry[i].mlen < 0);
+		ck_assert_int_eq(biseq(&vl->entry[i], sl->entry[i]), 1);
+	}
+}
+
+START_TEST(core_056)
+{
+	struct tagbstring comma = bsStatic(",");
+	struct tagbstring seps = bsStatic(",;");
+	struct tagbstring dsep = bsStatic(";;");
+	struct test53 t = { 0, 0, 0, 0 };
+	struct bstrViewList *vl;
+	struct bstrList *sl;
+	bstring b;
+	int ret, i;
+	/* tests with NULL */
+	ck_assert_int_eq(bstrViewListDestroy(NULL), BSTR_ERR);
+	ck_assert_int_eq(bstrViewListAlloc(NULL, 1), BSTR_ERR);
+	vl = bstrViewListCreate();
+	ck_assert(vl != NULL);
+	ck_assert_int_eq(vl->qty, 0);
+	ck_assert_int_eq(bstrViewListAlloc(vl, 0), BSTR_ERR);
+	ck_assert_int_eq(bsplitview(NULL, &shortBstring, ','), BSTR_ERR);
+	ck_assert_int_eq(bsplitview(vl, NULL, ','), BSTR_ERR);
+	ck_assert_int_eq(bsplitview(vl, &badBstring1, ','), BSTR_ERR);
+	ck_assert_int_eq(bsplitsview(vl, &shortBstring, NULL), BSTR_ERR);
+	ck_assert_int_eq(bsplitstrview(vl, &shortBstring, NULL), BSTR_ERR);
+	ck_assert_int_eq(vl->qty, 0);
+	/* results match the copying splits */
+	b = bfromcstr(",a,,bb;cc;;d,");
+	ck_assert(b != NULL);
+	ret = bsplitview(vl, b, ',');
+	ck_assert_int_eq(ret, BSTR_OK);
+	sl = bsplit(b, ',');
+	test56_0(vl, sl);
+	ck_assert_int_eq(bstrListDestroy(sl), BSTR_OK);
+	ret = bsplitsview(vl, b, &seps);
+	ck_assert_int_eq(ret, BSTR_OK);
+	sl = bsplits(b, &seps);
+	test56_0(vl, sl);
+	ck_assert_int_eq(bstrListDestroy(sl), BSTR_OK);
+	ret = bsplitstrview(vl, b, &dsep);
+	ck_assert_int_eq(ret, BSTR_OK);
+	sl = bsplitstr(b, &dsep);
+	test56_0(vl, sl);
+	ck_assert_int_eq(bstrListDestroy(sl), BSTR_OK);
+	ret = bsplitview(vl, &emptyBstring, ',');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(vl->qty, 1);
+	ck_assert_int_eq(vl->entry[0].slen, 0);
+	/* views are write protected */
+	ret = bsplitview(vl, b, ';');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bconchar(&vl->entry[0], 'x');
+	ck_assert_int_eq(ret, BSTR_ERR);
+	/* a warm list splits without allocating */
+	ret = bassigncstr(b, "");
+	ck_assert_int_eq(ret, BSTR_OK);
+	for (i = 0; i < 100; i++) {
+		ret = bcatcstr(b, "field,");
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	ret = bsplitsview(vl, b, &comma);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(vl->qty, 101);
+	ret = bstrSetAllocator(test53_malloc, test53_realloc, test53_free, &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	for (i = 0; i < 10; i++) {
+		ret = bsplitview(vl, b, ',');
+		ck_assert_int_eq(ret, BSTR_OK);
+		ck_assert_int_eq(vl->qty, 101);
+	}
+	ck_assert_int_eq(t.mallocs + t.reallocs, 0);
+	ret = bstrSetAllocator(NULL, NULL, NULL, NULL);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(biseqcstr(&vl->entry[99], "field"), 1);
+	ck_assert_int_eq(vl->entry[100].slen, 0);
+	ck_assert_int_eq(bstrViewListDestroy(vl), BSTR_OK);
+	ck_assert_int_eq(bdestroy(b), BSTR_OK);
+}
+END_TEST
+
+static void
+test57_0(const struct bstrList *sl, const struct bstrList *ref)
+{
+	int i;
+	ck_assert(ref != NULL);
+	ck_assert_int_eq(sl->qty, ref->qty);
+	for (i = 0; i < ref->qty; i++) {
+		ck_assert_int_eq(biseq(sl->entry[i], ref->entry[i]), 1);
+	}
+}
+
+START_TEST(core_057)
+{
+	static const char *lines[] = {
+		"alpha,beta,gamma,delta",
+		"a,,b",
+		"",
+		"one longer field,and another,x,y,z,w",
+		"alpha,beta,gamma,delta",
+	};
+	struct tagbstring seps = bsStatic(",;");
+	struct tagbstring dsep = bsStatic(";;");
+	struct tagbstring abc = bsStatic("a,b,c");
+	struct test53 t = { 0, 0, 0, 0 };
+	struct bstrList *sl, *sp, *ref;
+	bstring b;
+	int ret, i, j;
+	/* tests with NULL */
+	ck_assert_int_eq(bstrListClear(NULL, NULL), BSTR_ERR);
+	ret = bsplitinto(NULL, NULL, &shortBstring, ',');
+	ck_assert_int_eq(ret, BSTR_ERR);
+	sl = bstrListCreate();
+	ck_assert(sl != NULL);
+	sp = bstrListCreate();
+	ck_assert(sp != NULL);
+	ck_assert_int_eq(bsplitinto(sl, sp, NULL, ','), BSTR_ERR);
+	ck_assert_int_eq(bsplitinto(sl, sp, &badBstring1, ','), BSTR_ERR);
+	ret = bsplitsinto(sl, sp, &shortBstring, NULL);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bsplitstrinto(sl, sp, &shortBstring, NULL);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ck_assert_int_eq(bstrListClear(sl, sl), BSTR_ERR);
+	ck_assert_int_eq(bstrListClear(sl, sp), BSTR_OK);
+	ck_assert_int_eq(sl->qty, 0);
+	ck_assert_int_eq(sp->qty, 0);
+	/* results match the allocating splits */
+	for (i = 0; i < (int)(sizeof(lines) / sizeof(lines[0])); i++) {
+		b = bfromcstr(lines[i]);
+		ck_assert(b != NULL);
+		ret = bsplitinto(sl, sp, b, ',');
+		ck_assert_int_eq(ret, BSTR_OK);
+		ref = bsplit(b, ',');
+		test57_0(sl, ref);
+		ck_assert_int_eq(bstrListDestroy(ref), BSTR_OK);
+		ret = bsplitsinto(sl, sp, b, &seps);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ref = bsplits(b, &seps);
+		test57_0(sl, ref);
+		ck_assert_int_eq(bstrListDestroy(ref), BSTR_OK);
+		ret = bsplitstrinto(sl, NULL, b, &dsep);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ref = bsplitstr(b, &dsep);
+		test57_0(sl, ref);
+		ck_assert_int_eq(bstrListDestroy(ref), BSTR_OK);
+		ck_assert_int_eq(bdestroy(b), BSTR_OK);
+	}
+	/* splitting one of the list's own entries */
+	b = bfromcstr("x:y:z");
+	ck_assert(b != NULL);
+	ret = bsplitinto(sl, sp, b, ',');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(bdestroy(b), BSTR_OK);
+	ret = bsplitinto(sl, sp, sl->entry[0], ':');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(sl->qty, 3);
+	ck_assert_int_eq(biseqcstr(sl->entry[0], "x"), 1);
+	ck_assert_int_eq(biseqcstr(sl->entry[2], "z"), 1);
+	ret = bsplitsinto(sl, sp, sl->entry[1], &seps);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(sl->qty, 1);
+	ck_assert_int_eq(biseqcstr(sl->entry[0], "y"), 1);
+	/* ... and without a spare list to take the old entries */
+	b = bfromcstr("a,b:c,d");
+	ck_assert(b != NULL);
+	ret = bsplitinto(sl, NULL, b, ',');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(bdestroy(b), BSTR_OK);
+	ret = bsplitinto(sl, NULL, sl->entry[1], ':');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(sl->qty, 2);
+	ck_assert_int_eq(biseqcstr(sl->entry[0], "b"), 1);
+	ck_assert_int_eq(biseqcstr(sl->entry[1], "c"), 1);
+	ret = bsplitstrinto(sl, NULL, sl->entry[0], &seps);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(sl->qty, 1);
+	ck_assert_int_eq(biseqcstr(sl->entry[0], "b"), 1);
+	/* a warm list splits without allocating */
+	b = bfromcstr("");
+	ck_assert(b != NULL);
+	for (i = 0; i < 50; i++) {
+		ret = bformata(b, "%d,", i * 1000);
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	ret = bsplitinto(sl, sp, b, ',');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(sl->qty, 51);
+	ret = bsplitinto(sl, sp, &shortBstring, ' ');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bsplitinto(sl, sp, b, ',');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bstrSetAllocator(test53_malloc, test53_realloc, test53_free, &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	for (i = 0; i < 10; i++) {
+		ret = bsplitinto(sl, sp, b, ',');
+		ck_assert_int_eq(ret, BSTR_OK);
+		ret = bsplitinto(sl, sp, &shortBstring, ' ');
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	ret = bsplitinto(sl, sp, b, ',');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(t.mallocs + t.reallocs + t.frees, 0);
+	ret = bstrSetAllocator(NULL, NULL, NULL, NULL);
+	ck_assert_int_eq(ret, BSTR_OK);
+	for (i = 0; i < 50; i++) {
+		j = (int)strtol((char *)sl->entry[i]->data, NULL, 10);
+		ck_assert_int_eq(j, i * 1000);
+	}
+	/* spares are an ordinary list, unaffected by resizing sl */
+	ret = bstrListClear(sl, sp);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(sl->qty, 0);
+	ck_assert(sp->qty >= 51);
+	ret = bstrListAllocMin(sl, 1);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(sl->mlen, 1);
+	ret = bsplitinto(sl, sp, b, ',');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(sl->qty, 51);
+	ret = bstrListClear(sl, NULL);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(sl->qty, 0);
+	ck_assert_int_eq(bstrListDestroy(sl), BSTR_OK);
+	/* a cleared list can be filled by hand without leaking */
+	sl = bsplit(&abc, ',');
+	ck_assert(sl != NULL);
+	ck_assert_int_eq(sl->qty, 3);
+	j = sp->qty;
+	ret = bstrListClear(sl, sp);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(sp->qty, j + 3);
+	ck_assert_int_eq(biseqcstr(sp->entry[sp->qty - 1], "a"), 1);
+	ret = bstrListAlloc(sl, 2);
+	ck_assert_int_eq(ret, BSTR_OK);
+	sl->entry[sl->qty++] = bfromcstr("filled");
+	sl->entry[sl->qty++] = bfromcstr("by hand");
+	ck_assert_int_eq(bstrListDestroy(sl), BSTR_OK);
+	/* lists made by bsplit can be refilled too */
+	sl = bsplit(&longBstring, ' ');
+	ck_assert(sl != NULL);
+	ret = bsplitinto(sl, sp, b, ',');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(sl->qty, 51);
+	ck_assert_int_eq(bstrListDestroy(sl), BSTR_OK);
+	ck_assert_int_eq(bstrListDestroy(sp), BSTR_OK);
+	ck_assert_int_eq(bdestroy(b), BSTR_OK);
+}
+END_TEST
+
+static const char *test58_path = "bstest_mmap.tmp";
+
+static void
+test58_0(const bstring contents)
+{
+	FILE *fp = fopen(test58_path, "wb");
+	ck_assert(fp != NULL);
+	if (contents->slen > 0) {
+		ck_assert_int_eq((int)fwrite(contents->data, 1, contents->slen,
+					     fp), contents->slen);
+	}
+	ck_assert_int_eq(fclose(fp), 0);
+}
+
+static int
+test58_1(void *parm, int ofs, const bstring entry)
+{
+	bstring b = (bstring)parm;
+	bformata(b, "%d:", ofs);
+	bconcat(b, entry);
+	bconchar(b, '|');
+	return 0;
+}
+
+START_TEST(core_058)
+{
+	struct tagbstring space = bsStatic(" ");
+	struct tagbstring seps = bsStatic(" .");
+	struct tagbstring dsep = bsStatic("n ");
+	struct tagbstring t;
+	struct sbstr sb;
+	struct bStream *bs, *ref;
+	bstring b, c;
+	char *str;
+	int ret;
+	/* tests with NULL and missing files */
+	ck_assert(bsopenmmap(NULL) == NULL);
+	ck_assert(bsopenmmap("bstest_mmap.does.not.exist") == NULL);
+	ck_assert_int_eq(bsreadlnview(&t, NULL, '\n'), BSTR_ERR);
+	test23_aux_open(&sb, &longBstring);
+	ref = bsopen((bNread)test23_aux_read, &sb);
+	ck_assert(ref != NULL);
+	ck_assert_int_eq(bsreadlnview(&t, ref, '\n'), BSTR_ERR);
+	ck_assert(bsclose(ref) != NULL);
+	/* an empty file */
+	test58_0(&emptyBstring);
+	bs = bsopenmmap(test58_path);
+	ck_assert(bs != NULL);
+	ck_assert_int_eq(bseof(bs), 1);
+	b = bfromcstr("");
+	ck_assert(b != NULL);
+	ck_assert_int_eq(bsreadln(b, bs, '\n'), BSTR_ERR);
+	ck_assert_int_eq(bsreadlnview(&t, bs, '\n'), BSTR_ERR);
+	ck_assert(bsclose(bs) == NULL);
+	/* lines match those read from an ordinary stream */
+	test58_0(&longBstring);
+	for (str = (char *)longBstring.data; *str; str++) {
+		bs = bsopenmmap(test58_path);
+		ck_assert(bs != NULL);
+		test23_aux_open(&sb, &longBstring);
+		ref = bsopen((bNread)test23_aux_read, &sb);
+		ck_assert(ref != NULL);
+		c = bfromcstr("");
+		ck_assert(c != NULL);
+		while (1) {
+			ret = bsreadln(b, bs, *str);
+			ck_assert_int_eq(bsreadln(c, ref, *str), ret);
+			if (ret != BSTR_OK) {
+				break;
+			}
+			ck_assert_int_eq(biseq(b, c), 1);
+			ck_assert_int_eq(bsreadlnview(&t, bs, *str) == BSTR_OK,
+					 bsreadln(c, ref, *str) == BSTR_OK);
+			if (c->slen == 0) {
+				break;
+			}
+			ck_assert(t.mlen < 0);
+			ck_assert_int_eq(biseq(&t, c), 1);
+		}
+		ck_assert_int_eq(bseof(bs), 1);
+		ck_assert(bsclose(bs) == NULL);
+		ck_assert(bsclose(ref) != NULL);
+		ck_assert_int_eq(bdestroy(c), BSTR_OK);
+	}
+	/* multiple terminators, and reads mixed with the buffered functions */
+	bs = bsopenmmap(test58_path);
+	ck_assert(bs != NULL);
+	ck_assert_int_eq(bsreadlns(b, bs, &seps), BSTR_OK);
+	ck_assert_int_eq(biseqcstr(b, "This "), 1);
+	ck_assert_int_eq(bsreadlnsview(&t, bs, &seps), BSTR_OK);
+	ck_assert_int_eq(biseqcstr(&t, "is "), 1);
+	ck_assert_int_eq(bsread(b, bs, 3), BSTR_OK);
+	ck_assert_int_eq(biseqcstr(b, "a b"), 1);
+	ck_assert_int_eq(bsreadlnview(&t, bs, ' '), BSTR_OK);
+	ck_assert_int_eq(biseqcstr(&t, "ogus "), 1);
+	ck_assert_int_eq(bsunread(bs, &shortBstring), BSTR_OK);
+	ck_assert_int_eq(bsreadlnview(&t, bs, ' '), BSTR_ERR);
+	ck_assert_int_eq(bsreadln(b, bs, 'l'), BSTR_OK);
+	ck_assert_int_eq(biseqcstr(b, "bogusbut reasonabl"), 1);
+	ck_assert_int_eq(bsreadlnview(&t, bs, ' '), BSTR_OK);
+	ck_assert_int_eq(biseqcstr(&t, "y "), 1);
+	ck_assert_int_eq(bsreadln(b, bs, ' '), BSTR_OK);
+	ck_assert_int_eq(biseqcstr(b, "long "), 1);
+	ck_assert(bsclose(bs) == NULL);
+	/* splits match those of an ordinary stream */
+	c = bfromcstr("");
+	ck_assert(c != NULL);
+	b->slen = 0;
+	bs = bsopenmmap(test58_path);
+	ck_assert(bs != NULL);
+	ck_assert_int_eq(bssplitscb(bs, &space, test58_1, b), 0);
+	ck_assert(bsclose(bs) == NULL);
+	test23_aux_open(&sb, &longBstring);
+	ref = bsopen((bNread)test23_aux_read, &sb);
+	ck_assert_int_eq(bssplitscb(ref, &space, test58_1, c), 0);
+	ck_assert(bsclose(ref) != NULL);
+	ck_assert_int_eq(biseq(b, c), 1);
+	b->slen = c->slen = 0;
+	bs = bsopenmmap(test58_path);
+	ck_assert(bs != NULL);
+	ck_assert_int_eq(bssplitstrcb(bs, &dsep, test58_1, b), 0);
+	ck_assert(bsclose(bs) == NULL);
+	test23_aux_open(&sb, &longBstring);
+	ref = bsopen((bNread)test23_aux_read, &sb);
+	ck_assert_int_eq(bssplitstrcb(ref, &dsep, test58_1, c), 0);
+	ck_assert(bsclose(ref) != NULL);
+	ck_assert_int_eq(biseq(b, c), 1);
+	ck_assert_int_eq(bdestroy(b), BSTR_OK);
+	ck_assert_int_eq(bdestroy(c), BSTR_OK);
+	ck_assert_int_eq(remove(test58_path), 0);
+}
+END_TEST
+
+static int
+test59_0(int c)
+{
+	return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+/* Reference result of bstricmp with ASCII case folding. */
+static int
+test59_1(const bstring b0, const bstring b1)
+{
+	int i, n = b0->slen < b1->slen ? b0->slen : b1->slen;
+	for (i = 0; i < n; i++) {
+		int v = (char)test59_0(b0->data[i]) -
+			(char)test59_0(b1->data[i]);
+		if (v) {
+			return v;
+		}
+	}
+	if (b0->slen > n) {
+		return b0->data[n] ? (char)test59_0(b0->data[n]) :
+				     UCHAR_MAX + 1;
+	}
+	if (b1->slen > n) {
+		return b1->data[n] ? -(char)test59_0(b1->data[n]) :
+				     -(int)(UCHAR_MAX + 1);
+	}
+	return 0;
+}
+
+START_TEST(core_059)
+{
+	unsigned char all[UCHAR_MAX + 1];
+	unsigned int seed = 1;
+	bstring a, b, c;
+	int ret, i, j, len;
+	/* mode selection */
+	ck_assert_int_eq(bsetctype(-1), BSTR_ERR);
+	ck_assert_int_eq(bsetctype(BSTR_CTYPE_LOCALE), BSTR_CTYPE_ASCII);
+	ck_assert_int_eq(bsetctype(BSTR_CTYPE_ASCII), BSTR_CTYPE_LOCALE);
+	/* every byte value, at every alignment */
+	for (i = 0; i <= UCHAR_MAX; i++) {
+		all[i] = (unsigned char)i;
+	}
+	for (j = 0; j < 40; j++) {
+		a = blk2bstr(all + j, (int)sizeof(all) - j);
+		ck_assert(a != NULL);
+		b = bstrcpy(a);
+		ck_assert(b != NULL);
+		ck_assert_int_eq(btoupper(a), BSTR_OK);
+		ck_assert_int_eq(btolower(b), BSTR_OK);
+		for (i = 0; i < a->slen; i++) {
+			int ch = all[i + j];
+			ck_assert_int_eq(a->data[i],
+					 (ch >= 'a' && ch <= 'z') ?
+					 ch - ('a' - 'A') : ch);
+			ck_assert_int_eq(b->data[i], test59_0(ch));
+		}
+		ck_assert_int_eq(biseqcaseless(a, b), 1);
+		ck_assert_int_eq(bstricmp(a, b), 0);
+		ck_assert_int_eq(bdestroy(a), BSTR_OK);
+		ck_assert_int_eq(bdestroy(b), BSTR_OK);
+	}
+	/* comparisons differing at every position */
+	a = bfromcstr("");
+	b = bfromcstr("");
+	ck_assert(a != NULL && b != NULL);
+	for (len = 0; len < 100; len++) {
+		for (i = 0; i < len; i++) {
+			ret = "abcXYZ@[`{09"[(seed = seed * 1103515245u + 12345u, seed >> 16) % 12];
+			ck_assert_int_eq(bconchar(a, (char)ret), BSTR_OK);
+		}
+		ck_assert_int_eq(bassign(b, a), BSTR_OK);
+		ck_assert_int_eq(btoupper(b), BSTR_OK);
+		ck_assert_int_eq(bstricmp(a, b), 0);
+		ck_assert_int_eq(bstrnicmp(a, b, len), 0);
+		ck_assert_int_eq(biseqcaselessblk(a, b->data, b->slen), 1);
+		ck_assert_int_eq(bisstemeqcaselessblk(a, b->data, b->slen), 1);
+		for (i = 0; i < len; i++) {
+			c = bstrcpy(b);
+			ck_assert(c != NULL);
+			c->data[i] = (unsigned char)"[@`{Aa0"[(seed = seed * 1103515245u + 12345u, seed >> 16) % 7];
+			ck_assert_int_eq(bstricmp(a, c), test59_1(a, c));
+			ck_assert_int_eq(bstricmp(c, a), test59_1(c, a));
+			ret = bstrnicmp(a, c, len);
+			if (test59_1(a, c)) {
+				ck_assert_int_eq(ret, a->data[i] - c->data[i]);
+			} else {
+				ck_assert_int_eq(ret, 0);
+			}
+			ck_assert_int_eq(bstrnicmp(a, c, i), 0);
+			ck_assert_int_eq(biseqcaseless(a, c),
+					 test59_1(a, c) == 0);
+			ck_assert_int_eq(bdestroy(c), BSTR_OK);
+		}
+		ck_assert_int_eq(bconchar(b, '\0'), BSTR_OK);
+		ck_assert_int_eq(bstricmp(a, b), -(int)(UCHAR_MAX + 1));
+		ck_assert_int_eq(bstricmp(b, a), UCHAR_MAX + 1);
+		a->slen = 0;
+	}
+	/* the locale mode gives the same results in the "C" locale */
+	ck_assert_int_eq(bsetctype(BSTR_CTYPE_LOCALE), BSTR_CTYPE_ASCII);
+	ck_assert_int_eq(bassigncstr(a, "Mixed CASE text, 123"), BSTR_OK);
+	ck_assert_int_eq(bassign(b, a), BSTR_OK);
+	ck_assert_int_eq(btolower(b), BSTR_OK);
+	ck_assert_int_eq(biseqcstr(b, "mixed case text, 123"), 1);
+	ck_assert_int_eq(bstricmp(a, b), 0);
+	ck_assert_int_eq(biseqcaseless(a, b), 1);
+	ck_assert_int_eq(bsetctype(BSTR_CTYPE_ASCII), BSTR_CTYPE_LOCALE);
+	ck_assert_int_eq(bdestroy(a), BSTR_OK);
+	ck_assert_int_eq(bdestroy(b), BSTR_OK);
+}
+END_TEST
+
+/* Reference result of bstrcmp and bstrncmp, compared a byte at a time. */
+static int
+test60_0(const bstring b0, const bstring b1, int n)
+{
+	int i, m = n;
+	if (m > b0->slen) {
+		m = b0->slen;
+	}
+	if (m > b1->slen) {
+		m = b1->slen;
+	}
+	for (i = 0; i < m; i++) {
+		int v = ((char)b0->data[i]) - ((char)b1->data[i]);
+		if (v != 0) {
+			return v;
+		}
+		if (b0->data[i] == '\0') {
+			return 0;
+		}
+	}
+	if (n == m || b0->slen == b1->slen) {
+		return 0;
+	}
+	return b0->slen > m ? 1 : -1;
+}
+
+START_TEST(core_060)
+{
+	static const unsigned char bytes[] = { 0, 1, 'a', 'b', 0x7f, 0x80, 0xff };
+	unsigned int seed = 3;
+	bstring a, b;
+	int len, i, j, k;
+	a = bfromcstr("");
+	b = bfromcstr("");
+	ck_assert(a != NULL && b != NULL);
+	for (len = 0; len < 200; len += 1 + len / 16) {
+		ck_assert_int_eq(balloc(a, len + 1), BSTR_OK);
+		for (i = 0; i < len; i++) {
+			seed = seed * 1103515245u + 12345u;
+			a->data[i] = (unsigned char)(1 + (seed >> 16) % 255);
+		}
+		a->slen = len;
+		ck_assert_int_eq(bassign(b, a), BSTR_OK);
+		ck_assert_int_eq(bstrcmp(a, b), 0);
+		ck_assert_int_eq(bstrncmp(a, b, len), 0);
+		ck_assert_int_eq(biseq(a, b), 1);
+		ck_assert_int_eq(bisstemeqblk(a, b->data, len), 1);
+		/* a difference or an embedded '\0' at every position */
+		for (i = 0; i < len; i++) {
+			unsigned char c = b->data[i];
+			for (k = 0; k < (int)sizeof(bytes); k++) {
+				b->data[i] = bytes[k];
+				ck_assert_int_eq(bstrcmp(a, b), test60_0(a, b, len));
+				ck_assert_int_eq(bstrcmp(b, a), test60_0(b, a, len));
+				for (j = i; j <= len + 1; j += 1 + j / 4) {
+					ck_assert_int_eq(bstrncmp(a, b, j),
+							 test60_0(a, b, j));
+				}
+				ck_assert_int_eq(bstrncmp(a, b, i), 0);
+				ck_assert_int_eq(biseq(a, b), c == bytes[k]);
+				ck_assert_int_eq(bisstemeqblk(a, b->data, len),
+						 c == bytes[k]);
+			}
+			b->data[i] = c;
+		}
+		/* a '\0' in both ends the comparison */
+		if (len > 2) {
+			ck_assert_int_eq(bassign(b, a), BSTR_OK);
+			a->data[len / 2] = b->data[len / 2] = '\0';
+			b->data[len - 1] ^= 1;
+			ck_assert_int_eq(bstrcmp(a, b), 0);
+			ck_assert_int_eq(bstrncmp(a, b, len), 0);
+			ck_assert_int_eq(biseq(a, b), 0);
+			a->data[len / 2] = b->data[len / 2] = 'x';
+		}
+		/* a proper prefix orders first */
+		ck_assert_int_eq(bassign(b, a), BSTR_OK);
+		ck_assert_int_eq(bconchar(b, 'z'), BSTR_OK);
+		ck_assert_int_eq(bstrcmp(a, b), -1);
+		ck_assert_int_eq(bstrcmp(b, a), 1);
+		ck_assert_int_eq(bstrncmp(a, b, len), 0);
+		ck_assert_int_eq(bstrncmp(a, b, len + 1), -1);
+		ck_assert_int_eq(biseq(a, b), 0);
+	}
+	ck_assert_int_eq(bdestroy(a), BSTR_OK);
+	ck_assert_int_eq(bdestroy(b), BSTR_OK);
+}
+END_TEST
+
+static int
+test61_0(const bstring set, unsigned char c)
+{
+	return memchr(set->data, c, set->slen) != NULL;
+}
+
+START_TEST(core_061)
+{
+	static const char *sets[] = { ",;", " \t\n", "\x80\xff", "aZ\x7f\x80",
+				      "\x01\x10\x20\x30\x40\x50\x60\x70\x90" };
+	static const char alphabet[] = "abcZ,; \t\n\x01\x10\x7f\x80\x90\xa0\xff";
+	static const char *ws[] = { "", " ", "\t\n\v\f\r ",
+				    "                 ", "\r\n\r\n\r\n\r\n\r\n"
+				    "\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n" };
+	unsigned int seed = 17;
+	struct tagbstring set;
+	struct bstrList *sl;
+	struct bStream *bs;
+	struct sbstr sb;
+	bstring h, r, b;
+	int i, j, k, n, ret;
+	size_t l, t;
+	h = bfromcstr("");
+	ck_assert(h != NULL);
+	for (i = 0; i < 300; i++) {
+		seed = seed * 1103515245u + 12345u;
+		ret = bconchar(h, alphabet[(seed >> 16) %
+					   (sizeof(alphabet) - 1)]);
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	for (k = 0; k < (int)(sizeof(sets) / sizeof(sets[0])); k++) {
+		cstr2tbstr(set, sets[k]);
+		for (i = 0; i <= h->slen; i++) {
+			/* forward searches against a byte at a time scan */
+			for (j = i; j < h->slen; j++) {
+				if (test61_0(&set, h->data[j])) {
+					break;
+				}
+			}
+			ret = binchr(h, i, &set);
+			ck_assert_int_eq(ret, j < h->slen ? j : BSTR_ERR);
+			for (j = i; j < h->slen; j++) {
+				if (!test61_0(&set, h->data[j])) {
+					break;
+				}
+			}
+			ret = bninchr(h, i, &set);
+			ck_assert_int_eq(ret, j < h->slen ? j : BSTR_ERR);
+			/* and reverse ones */
+			for (j = i < h->slen ? i : i - 1; j >= 0; j--) {
+				if (test61_0(&set, h->data[j])) {
+					break;
+				}
+			}
+			ck_assert_int_eq(binchrr(h, i, &set), j);
+			for (j = i < h->slen ? i : i - 1; j >= 0; j--) {
+				if (!test61_0(&set, h->data[j])) {
+					break;
+				}
+			}
+			ck_assert_int_eq(bninchrr(h, i, &set), j);
+		}
+		/* splitting yields one more piece than there are members */
+		sl = bsplits(h, &set);
+		ck_assert(sl != NULL);
+		for (n = 1, j = 0; j < h->slen; j++) {
+			n += test61_0(&set, h->data[j]);
+		}
+		ck_assert_int_eq(sl->qty, n);
+		r = bjoin(sl, NULL);
+		ck_assert(r != NULL);
+		ck_assert_int_eq(r->slen, h->slen - (n - 1));
+		ck_assert_int_eq(bdestroy(r), BSTR_OK);
+		ck_assert_int_eq(bstrListDestroy(sl), BSTR_OK);
+		/* reading lines ends each one at the first member */
+		test23_aux_open(&sb, h);
+		bs = bsopen((bNread)test23_aux_read, &sb);
+		ck_assert(bs != NULL);
+		ck_assert(bsbufflength(bs, 7) > 0);
+		r = bfromcstr("");
+		b = bfromcstr("");
+		ck_assert(r != NULL && b != NULL);
+		while (bsreadlnsa(r, bs, &set) == BSTR_OK) {
+			ck_assert(b->slen < r->slen);
+			for (j = b->slen; j < r->slen - 1; j++) {
+				ck_assert(!test61_0(&set, r->data[j]));
+			}
+			ck_assert(test61_0(&set, r->data[j]) ||
+				  r->slen == h->slen);
+			ck_assert_int_eq(bassign(b, r), BSTR_OK);
+		}
+		ck_assert_int_eq(biseq(r, h), 1);
+		ck_assert(bsclose(bs) != NULL);
+		ck_assert_int_eq(bdestroy(r), BSTR_OK);
+		ck_assert_int_eq(bdestroy(b), BSTR_OK);
+	}
+	ck_assert_int_eq(bdestroy(h), BSTR_OK);
+	/* trimming white space runs of every length in both modes */
+	for (k = BSTR_CTYPE_ASCII; k <= BSTR_CTYPE_LOCALE; k++) {
+		bsetctype(k);
+		for (l = 0; l < sizeof(ws) / sizeof(ws[0]); l++) {
+			for (t = 0; t < sizeof(ws) / sizeof(ws[0]); t++) {
+				b = bformat("%sx \xa0 y%s", ws[l], ws[t]);
+				ck_assert(b != NULL);
+				r = bstrcpy(b);
+				ck_assert(r != NULL);
+				ck_assert_int_eq(bltrimws(r), BSTR_OK);
+				ck_assert_int_eq(r->slen,
+						 b->slen - (int)strlen(ws[l]));
+				ck_assert_int_eq(r->data[0], 'x');
+				ck_assert_int_eq(bassign(r, b), BSTR_OK);
+				ck_assert_int_eq(brtrimws(r), BSTR_OK);
+				ck_assert_int_eq(r->slen,
+						 b->slen - (int)strlen(ws[t]));
+				ck_assert_int_eq(r->data[r->slen - 1], 'y');
+				ck_assert_int_eq(r->data[r->slen], '\0');
+				ck_assert_int_eq(bassign(r, b), BSTR_OK);
+				ck_assert_int_eq(btrimws(r), BSTR_OK);
+				ck_assert_int_eq(biseqcstr(r, "x \xa0 y"), 1);
+				ck_assert_int_eq(bdestroy(b), BSTR_OK);
+				b = bfromcstr(ws[l]);
+				ck_assert(b != NULL);
+				ck_assert_int_eq(bconcat(r, b), BSTR_OK);
+				ck_assert_int_eq(btrimws(b), BSTR_OK);
+				ck_assert_int_eq(b->slen, 0);
+				ck_assert_int_eq(bdestroy(b), BSTR_OK);
+				ck_assert_int_eq(bdestroy(r), BSTR_OK);
+			}
+		}
+	}
+	bsetctype(BSTR_CTYPE_ASCII);
+}
+END_TEST
+
+static int
+test62_0(void *parm, int ofs, int len)
+{
+	bstring b = (bstring)parm;
+	/* every piece but the last ends at a newline */
+	if (ofs + len < b->slen && b->data[ofs + len] != '\n') {
+		return BSTR_ERR;
+	}
+	if (memchr(b->data + ofs, '\n', (size_t)len)) {
+		return BSTR_ERR;
+	}
+	return 0;
+}
+
+START_TEST(core_062)
+{
+	unsigned int seed = 29;
+	struct bStream *bs;
+	struct sbstr sb;
+	bstring h, r;
+	int i, j, k, n;
+	h = bfromcstr("");
+	ck_assert(h != NULL);
+	for (i = 0; i < 500; i++) {
+		seed = seed * 1103515245u + 12345u;
+		k = (int)((seed >> 16) % 97);
+		ck_assert_int_eq(bconchar(h, (char)(k < 3 ? '\n' : 0x80 + k)),
+				 BSTR_OK);
+	}
+	/* searches from every position against a byte at a time scan */
+	for (k = 0; k < 3; k++) {
+		int c = "\n\x81\xff"[k];
+		for (i = 0; i < h->slen; i++) {
+			for (j = i; j < h->slen && h->data[j] != (unsigned char)c;
+			     j++)
+				;
+			ck_assert_int_eq(bstrchrp(h, c, i),
+					 j < h->slen ? j : BSTR_ERR);
+			for (j = i; j >= 0 && h->data[j] != (unsigned char)c;
+			     j--)
+				;
+			ck_assert_int_eq(bstrrchrp(h, c, i), j);
+		}
+	}
+	/* splitting on newlines */
+	ck_assert_int_eq(bsplitcb(h, '\n', 0, test62_0, h), BSTR_OK);
+	ck_assert_int_eq(bsplitcb(h, '\n', h->slen, test62_0, h), BSTR_OK);
+	/* reading lines, with buffers both shorter and longer than a line */
+	for (k = 1; k < 200; k += 37) {
+		test23_aux_open(&sb, h);
+		bs = bsopen((bNread)test23_aux_read, &sb);
+		ck_assert(bs != NULL);
+		bsbufflength(bs, k);
+		r = bfromcstr("");
+		ck_assert(r != NULL);
+		for (n = 0; bsreadlna(r, bs, '\n') == BSTR_OK; n++) {
+			ck_assert(r->data[r->slen - 1] == '\n' ||
+				  r->slen == h->slen);
+			ck_assert_int_eq(r->data[r->slen], '\0');
+		}
+		ck_assert_int_eq(biseq(r, h), 1);
+		for (j = 0, i = 0; i < h->slen; i++) {
+			j += h->data[i] == '\n';
+		}
+		ck_assert_int_eq(n, j + (h->data[h->slen - 1] != '\n'));
+		ck_assert(bsclose(bs) != NULL);
+		ck_assert_int_eq(bdestroy(r), BSTR_OK);
+	}
+	/* one line at a time into a fresh string */
+	test23_aux_open(&sb, h);
+	bs = bsopen((bNread)test23_aux_read, &sb);
+	ck_assert(bs != NULL);
+	r = bfromcstr("");
+	ck_assert(r != NULL);
+	i = 0;
+	while (bsreadln(r, bs, '\n') == BSTR_OK) {
+		j = bstrchrp(h, '\n', i);
+		j = j < 0 ? h->slen : j + 1;
+		ck_assert_int_eq(r->slen, j - i);
+		ck_assert(!memcmp(r->data, h->data + i, (size_t)r->slen));
+		i = j;
+	}
+	ck_assert_int_eq(i, h->slen);
+	ck_assert(bsclose(bs) != NULL);
+	ck_assert_int_eq(bdestroy(r), BSTR_OK);
+	ck_assert_int_eq(bdestroy(h), BSTR_OK);
+}
+END_TEST
+
+START_TEST(core_063)
+{
+	static struct tagbstring fox =
+		bsStatic("The quick brown fox jumps over the lazy dog");
+	unsigned int seed = 37;
+	struct bstrHashKey k;
+	bstring a, b;
+	uint64_t h;
+	int i, j, len;
+	/* tests with NULL and invalid input */
+	ck_assert(bhash(NULL, 0) == 0);
+	ck_assert(bhashcaseless(NULL, 0) == 0);
+	ck_assert(bhashblk(NULL, 1, 0) == 0);
+	ck_assert(bhashblk("", -1, 0) == 0);
+	ck_assert(bhash(&badBstring1, 0) == 0);
+	ck_assert(bhashkey(NULL, 0) == 0);
+	ck_assert_int_eq(bhashkeyinit(NULL, &fox, 0), BSTR_ERR);
+	ck_assert_int_eq(bhashkeyinit(&k, NULL, 0), BSTR_ERR);
+	ck_assert_int_eq(bhashkeyinit(&k, &badBstring2, 0), BSTR_ERR);
+	/* the values do not depend on the platform */
+	ck_assert(bhash(&emptyBstring, 0) == UINT64_C(0x0409638ee2bde459));
+	ck_assert(bhash(&fox, 0) == UINT64_C(0x6303b3bade45a571));
+	ck_assert(bhash(&fox, 42) == UINT64_C(0x4f0e75ed5d33843d));
+	ck_assert(bhashblk(fox.data, fox.slen, 42) == bhash(&fox, 42));
+	/* every length, with single bit changes at every position */
+	a = bfromcstr("");
+	ck_assert(a != NULL);
+	for (len = 0; len < 130; len++) {
+		h = bhash(a, 7);
+		ck_assert(h != bhash(a, 8));
+		for (i = 0; i < len; i++) {
+			for (j = 0; j < 8; j += 7) {
+				a->data[i] ^= (unsigned char)(1 << j);
+				ck_assert(bhash(a, 7) != h);
+				a->data[i] ^= (unsigned char)(1 << j);
+			}
+		}
+		ck_assert(bhash(a, 7) == h);
+		seed = seed * 1103515245u + 12345u;
+		ck_assert_int_eq(bconchar(a, (char)(seed >> 16)), BSTR_OK);
+		ck_assert(bhash(a, 7) != h);
+	}
+	/* caseless hashes agree whenever biseqcaseless does */
+	for (i = BSTR_CTYPE_ASCII; i <= BSTR_CTYPE_LOCALE; i++) {
+		bsetctype(i);
+		for (len = 0; len < 70; len++) {
+			ck_assert_int_eq(bassignmidstr(a, &fox, 0, len), BSTR_OK);
+			b = bstrcpy(a);
+			ck_assert(b != NULL);
+			ck_assert_int_eq(btoupper(b), BSTR_OK);
+			ck_assert_int_eq(biseqcaseless(a, b), 1);
+			ck_assert(bhashcaseless(a, 3) == bhashcaseless(b, 3));
+			ck_assert_int_eq(btolower(b), BSTR_OK);
+			ck_assert(bhashcaseless(a, 3) == bhash(b, 3));
+			ck_assert_int_eq(bdestroy(b), BSTR_OK);
+		}
+		ck_assert(bhashcaseless(&fox, 3) != bhash(&fox, 3));
+	}
+	bsetctype(BSTR_CTYPE_ASCII);
+	ck_assert_int_eq(bassigncstr(a, "@[`{\xc1\xe1"), BSTR_OK);
+	b = bfromcstr("@[`{\xc1\xe1");
+	ck_assert(b != NULL);
+	ck_assert(bhashcaseless(a, 0) == bhash(b, 0));
+	/* keys refer to the string and keep its hash */
+	ck_assert_int_eq(bhashkeyinit(&k, &fox, 5), BSTR_OK);
+	ck_assert(k.str.data == fox.data);
+	ck_assert_int_eq(k.str.slen, fox.slen);
+	ck_assert(biswriteprotected(k.str));
+	ck_assert_int_eq(bconchar(&k.str, 'x'), BSTR_ERR);
+	ck_assert(k.hash == bhash(&fox, 5));
+	ck_assert(bhashkey(&k, 5) == bhash(&fox, 5));
+	k.hash = 1;
+	ck_assert(bhashkey(&k, 5) == 1);
+	ck_assert(bhashkey(&k, 6) == bhash(&fox, 6));
+	ck_assert(bhashkey(&k, 6) == bhash(&fox, 6));
+	ck_assert(bhashkey(&k, 5) == bhash(&fox, 5));
+	ck_assert_int_eq(bdestroy(a), BSTR_OK);
+	ck_assert_int_eq(bdestroy(b), BSTR_OK);
+}
+END_TEST
+
+START_TEST(core_064)
+{
+	unsigned int seed = 11;
+	struct bStream *bs;
+	struct sbstr sb;
+	struct tagbstring t;
+	bstring src, b, c;
+	int i, j, n, pos, ret;
+	/* tests with NULL and invalid input */
+	ck_assert(bsgets(NULL, '\n') == NULL);
+	/* a text with short lines, empty lines and lines longer than the
+	 * stream buffer, without a final terminator */
+	src = bfromcstr("");
+	ck_assert(src != NULL);
+	for (i = 0; i < 600; i++) {
+		seed = seed * 1103515245u + 12345u;
+		n = (int)((seed >> 16) % 100);
+		if (i % 97 == 5) {
+			n += 3000;
+		}
+		for (j = 0; j < n; j++) {
+			ret = bconchar(src, (char)('a' + (i + j) % 26));
+			ck_assert_int_eq(ret, BSTR_OK);
+		}
+		ret = bconchar(src, '\n');
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	ret = bcatcstr(src, "tail");
+	ck_assert_int_eq(ret, BSTR_OK);
+	/* bsgets returns every line in order */
+	sb.ofs = 0;
+	sb.b = src;
+	bs = bsopen((bNread)test23_aux_read, &sb);
+	ck_assert(bs != NULL);
+	c = bfromcstr("");
+	ck_assert(c != NULL);
+	for (i = 0; (b = bsgets(bs, '\n')) != NULL; i++) {
+		ck_assert(b->slen > 0);
+		ck_assert(i == 600 || b->data[b->slen - 1] == '\n');
+		ret = bconcat(c, b);
+		ck_assert_int_eq(ret, BSTR_OK);
+		bdestroy(b);
+	}
+	ck_assert_int_eq(i, 601);
+	ret = biseq(c, src);
+	ck_assert_int_eq(ret, 1);
+	ret = bseof(bs);
+	ck_assert_int_eq(ret, 1);
+	ck_assert(bsclose(bs) == &sb);
+	/* lines read between other operations on the buffer */
+	sb.ofs = 0;
+	bs = bsopen((bNread)test23_aux_read, &sb);
+	ck_assert(bs != NULL);
+	for (i = 0, pos = 0; pos < src->slen; i++) {
+		ret = bsreadln(c, bs, '\n');
+		ck_assert_int_eq(ret, BSTR_OK);
+		ret = bisstemeqblk(c, src->data + pos, c->slen);
+		ck_assert_int_eq(ret, 1);
+		ck_assert(pos + c->slen <= src->slen);
+		if (i % 7 == 0) {
+			ret = bsunread(bs, c);
+			ck_assert_int_eq(ret, BSTR_OK);
+			ret = bsreadln(c, bs, '\n');
+			ck_assert_int_eq(ret, BSTR_OK);
+			ret = bisstemeqblk(c, src->data + pos, c->slen);
+			ck_assert_int_eq(ret, 1);
+		}
+		pos += c->slen;
+		if (i % 3 == 0) {
+			ret = bspeek(c, bs);
+			ck_assert_int_eq(ret, BSTR_OK);
+			ck_assert(pos + c->slen <= src->slen);
+			ret = bisstemeqblk(c, src->data + pos, c->slen);
+			ck_assert_int_eq(ret, 1);
+		}
+		if (i % 5 == 0 && pos < src->slen) {
+			ret = bsread(c, bs, 3);
+			ck_assert_int_eq(ret, BSTR_OK);
+			bmid2tbstr(t, src, pos, 3);
+			ck_assert_int_eq(biseq(c, &t), 1);
+			pos += c->slen;
+		}
+	}
+	ck_assert_int_eq(pos, src->slen);
+	ret = bsreadln(c, bs, '\n');
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bseof(bs);
+	ck_assert_int_eq(ret, 1);
+	ck_assert(bsclose(bs) == &sb);
+	ret = bdestroy(c);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bdestroy(src);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+static void *
+test65_malloc(size_t size, void *ctx)
+{
+	(void)size;
+	(void)ctx;
+	return NULL;
+}
+
+static void *
+test65_realloc(void *ptr, size_t size, void *ctx)
+{
+	(void)ptr;
+	(void)size;
+	(void)ctx;
+	return NULL;
+}
+
+START_TEST(core_065)
+{
+	struct test53 t = { 0, 0, 0, 0 };
+	bstring a, b, c;
+	int i, n, ret;
+	/* output lengths around the size of the stack buffer and of the
+	 * spare capacity of the destination */
+	a = bfromcstr("");
+	ck_assert(a != NULL);
+	for (n = 0; n < 600; n += (n < 240 || n > 270) ? 37 : 1) {
+		ret = bassignformat(a, "%0*d", n > 0 ? n : 1, 7);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ck_assert_int_eq(a->slen, n > 0 ? n : 1);
+		ck_assert_int_eq(a->data[a->slen - 1], '7');
+		ck_assert_int_eq(a->data[a->slen], '\0');
+		b = bformat("%s", a->data);
+		ck_assert(b != NULL);
+		ck_assert_int_eq(biseq(a, b), 1);
+		ret = bformata(b, "%s", a->data);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ck_assert_int_eq(b->slen, 2 * a->slen);
+		ret = bisstemeqblk(b, a->data, a->slen);
+		ck_assert_int_eq(ret, 1);
+		ck_assert(memcmp(b->data + a->slen, a->data, a->slen) == 0);
+		ret = bdestroy(b);
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	/* arguments which point into the destination, with and without
+	 * enough spare capacity for the output */
+	for (i = 0; i < 2; i++) {
+		b = bfromcstr("abc");
+		ck_assert(b != NULL);
+		if (i) {
+			ret = balloc(b, 4096);
+			ck_assert_int_eq(ret, BSTR_OK);
+		}
+		ret = bformata(b, "|%s|%s", b->data, b->data + 1);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ret = biseqcstr(b, "abc|abc|bc");
+		ck_assert_int_eq(ret, 1);
+		ret = bassignformat(b, "[%s]", b->data);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ret = biseqcstr(b, "[abc|abc|bc]");
+		ck_assert_int_eq(ret, 1);
+		for (n = 0; n < 6; n++) {
+			ret = bformata(b, "%s", b->data);
+			ck_assert_int_eq(ret, BSTR_OK);
+			ret = bassignformat(b, "%s", b->data);
+			ck_assert_int_eq(ret, BSTR_OK);
+		}
+		ck_assert_int_eq(b->slen, 12 << 6);
+		c = bfromcstr("[abc|abc|bc]");
+		ck_assert(c != NULL);
+		for (n = 0; n < 6; n++) {
+			ret = bconcat(c, c);
+			ck_assert_int_eq(ret, BSTR_OK);
+		}
+		ret = biseq(b, c);
+		ck_assert_int_eq(ret, 1);
+		ret = bdestroy(c);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ret = bdestroy(b);
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	/* an early '\0' truncates the output */
+	ret = bassignformat(a, "ab%cde", '\0');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(a, "ab");
+	ck_assert_int_eq(ret, 1);
+	ret = bformata(a, "cd%cef", '\0');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(a, "abcd");
+	ck_assert_int_eq(ret, 1);
+	/* output which exactly fills the spare capacity takes one pass */
+	ret = balloc(a, 1024);
+	ck_assert_int_eq(ret, BSTR_OK);
+	n = a->mlen - a->slen - 2;
+	ret = bstrSetAllocator(test53_malloc, test53_realloc, test53_free, &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bformata(a, "%0*d", n, 7);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(a->slen, 4 + n);
+	ck_assert_int_eq(t.mallocs + t.reallocs, 0);
+	/* a failed allocation leaves the destination untouched */
+	b = bfromcstr("keep");
+	ck_assert(b != NULL);
+	ret = bstrSetAllocator(test65_malloc, test65_realloc, test53_free, &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bassignformat(b, "%s/%s", "more than fits", "in the buffer");
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bformata(b, "%s/%s", "more than fits", "in the buffer");
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bstrSetAllocator(NULL, NULL, NULL, NULL);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(b, "keep");
+	ck_assert_int_eq(ret, 1);
+	ck_assert_int_eq(b->data[b->slen], '\0');
+	/* a character which the "C" locale cannot convert is an error
+	 * which more room does not cure */
+	c = bformat("x%lsy", L"\x100");
+	ck_assert(c == NULL);
+	ret = bformata(b, "x%lsy", L"\x100");
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bassignformat(b, "x%lsy", L"\x100");
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = balloc(b, 1024);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bformata(b, "x%lsy", L"\x100");
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = biseqcstr(b, "keep");
+	ck_assert_int_eq(ret, 1);
+	ck_assert_int_eq(b->data[b->slen], '\0');
+	ret = bdestroy(b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bdestroy(a);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
 int
 main(void)
 {
@@ -3404,6 +5028,21 @@ main(void)
 	tcase_add_test(core, core_048);
 	tcase_add_test(core, core_049);
 	tcase_add_test(core, core_050);
+	tcase_add_test(core, core_051);
+	tcase_add_test(core, core_052);
+	tcase_add_test(core, core_053);
+	tcase_add_test(core, core_054);
+	tcase_add_test(core, core_055);
+	tcase_add_test(core, core_056);
+	tcase_add_test(core, core_057);
+	tcase_add_test(core, core_058);
+	tcase_add_test(core, core_059);
+	tcase_add_test(core, core_060);
+	tcase_add_test(core, core_061);
+	tcase_add_test(core, core_062);
+	tcase_add_test(core, core_063);
+	tcase_add_test(core, core_064);
+	tcase_add_test(core, core_065);
 	suite_add_tcase(suite, core);
 	/* Run tests */
 	SRunner *runner = srunner_create(suite);
@@ -44,6 +44,7 @@
 #include <check.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static int
 tWrite(const void *buf, size_t elsize, size_t nelem, void *parm)
@@ -550,6 +551,752 @@ START_TEST(core_016)
 }
 END_TEST
 
+static int
+test17_0(void *parm, int ofs, int len, int which)
+{
+	bstring b = (bstring)parm;
+	if (b->slen > 64) {
+		return -2;
+	}
+	return bformata(b, "[%d,%d,%d]", ofs, len, which);
+}
+
+START_TEST(core_017)
+{
+	struct tagbstring t = bsStatic("he,she,his,hers");
+	struct tagbstring u = bsStatic("HE,SHE,HIS,HERS");
+	struct tagbstring s = bsStatic("ushers");
+	struct tagbstring v = bsStatic("xabcdy");
+	struct bstrList *needles, *repl;
+	struct bNeedleSet *ns;
+	bstring b;
+	unsigned char c;
+	int i, k, ret, which = -1;
+	needles = bsplit(&t, ',');
+	ck_assert(needles != NULL);
+	repl = bsplit(&u, ',');
+	ck_assert(repl != NULL);
+	/* tests with NULL */
+	ck_assert(bNeedleSetCreate(NULL) == NULL);
+	ck_assert_int_eq(bNeedleSetDestroy(NULL), BSTR_ERR);
+	ck_assert_int_eq(binstrNeedleSet(&s, 0, NULL, NULL), BSTR_ERR);
+	ns = bNeedleSetCreate(needles);
+	ck_assert(ns != NULL);
+	ck_assert_int_eq(binstrNeedleSet(NULL, 0, ns, NULL), BSTR_ERR);
+	ck_assert_int_eq(binstrNeedleSet(&s, -1, ns, NULL), BSTR_ERR);
+	ck_assert_int_eq(binstrNeedleSet(&s, 7, ns, NULL), BSTR_ERR);
+	/* find first */
+	ret = binstrNeedleSet(&s, 0, ns, &which);
+	ck_assert_int_eq(ret, 1);
+	ck_assert_int_eq(which, 1);
+	ret = binstrNeedleSet(&s, 2, ns, &which);
+	ck_assert_int_eq(ret, 2);
+	ck_assert_int_eq(which, 3);
+	ret = binstrNeedleSet(&s, 4, ns, &which);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = binstrNeedleSet(&u, 0, ns, &which);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	/* find all */
+	b = bfromcstr("");
+	ck_assert(b != NULL);
+	ret = bNeedleSetFindAll(&s, 0, ns, test17_0, b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(b, "[1,3,1][2,2,0][2,4,3]");
+	ck_assert_int_eq(ret, 1);
+	ck_assert_int_eq(bNeedleSetFindAll(&s, 0, ns, NULL, b), BSTR_ERR);
+	/* replace */
+	ret = bassigncstr(b, "> ");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bNeedleSetReplace(b, &s, 0, ns, repl);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(b, "> uSHErs");
+	ck_assert_int_eq(ret, 1);
+	ret = bNeedleSetReplace(b, b, 0, ns, repl);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bNeedleSetReplace(b, &s, 0, ns, NULL);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bNeedleSetDestroy(ns);
+	ck_assert_int_eq(ret, BSTR_OK);
+	/* caseless, and a longer needle which starts earlier */
+	ns = bNeedleSetCreateCaseless(repl);
+	ck_assert(ns != NULL);
+	ret = binstrNeedleSet(&s, 0, ns, &which);
+	ck_assert_int_eq(ret, 1);
+	ck_assert_int_eq(which, 1);
+	ret = bassigncstr(b, "");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bNeedleSetFindAll(&s, 0, ns, test17_0, b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(b, "[1,3,1][2,2,0][2,4,3]");
+	ck_assert_int_eq(ret, 1);
+	ret = bNeedleSetDestroy(ns);
+	ck_assert_int_eq(ret, BSTR_OK);
+	/* repeated needles are reported under each of their indexes */
+	ret = bstrListAlloc(repl, 6);
+	ck_assert_int_eq(ret, BSTR_OK);
+	repl->entry[repl->qty++] = bfromcstr("she");
+	repl->entry[repl->qty++] = bfromcstr("He");
+	ns = bNeedleSetCreateCaseless(repl);
+	ck_assert(ns != NULL);
+	ret = bassigncstr(b, "");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bNeedleSetFindAll(&s, 0, ns, test17_0, b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(b, "[1,3,1][1,3,4][2,2,0][2,2,5][2,4,3]");
+	ck_assert_int_eq(ret, 1);
+	ret = binstrNeedleSet(&s, 0, ns, &which);
+	ck_assert_int_eq(ret, 1);
+	ck_assert_int_eq(which, 1);
+	ret = bNeedleSetDestroy(ns);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bassigncstr(b, "bc,abcd");
+	ck_assert_int_eq(ret, BSTR_OK);
+	bstrListDestroy(needles);
+	needles = bsplit(b, ',');
+	ck_assert(needles != NULL);
+	ns = bNeedleSetCreate(needles);
+	ck_assert(ns != NULL);
+	ret = binstrNeedleSet(&v, 0, ns, &which);
+	ck_assert_int_eq(ret, 1);
+	ck_assert_int_eq(which, 1);
+	ret = bassigncstr(b, "");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bNeedleSetReplace(b, &v, 0, ns, repl);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(b, "xSHEy");
+	ck_assert_int_eq(ret, 1);
+	ret = bNeedleSetDestroy(ns);
+	ck_assert_int_eq(ret, BSTR_OK);
+	/* caseless sets fold as binstrcaseless does, in either ctype mode */
+	ret = bassigncstr(b, "");
+	ck_assert_int_eq(ret, BSTR_OK);
+	for (i = 1; i < 256; i++) {
+		ret = bconchar(b, (char)i);
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	bstrListDestroy(needles);
+	needles = bsplit(&v, ',');
+	ck_assert(needles != NULL);
+	ck_assert_int_eq(needles->qty, 1);
+	for (k = 0; k < 2; k++) {
+		bsetctype(k ? BSTR_CTYPE_LOCALE : BSTR_CTYPE_ASCII);
+		for (i = 1; i < 256; i++) {
+			c = (unsigned char)i;
+			ret = bassignblk(needles->entry[0], &c, 1);
+			ck_assert_int_eq(ret, BSTR_OK);
+			ns = bNeedleSetCreateCaseless(needles);
+			ck_assert(ns != NULL);
+			ret = binstrNeedleSet(b, 0, ns, &which);
+			ck_assert_int_eq(ret, binstrcaseless(b, 0,
+							     needles->entry[0]));
+			ret = bNeedleSetDestroy(ns);
+			ck_assert_int_eq(ret, BSTR_OK);
+		}
+	}
+	bsetctype(BSTR_CTYPE_ASCII);
+	/* an empty needle is rejected */
+	ret = bassigncstr(b, "a,,b");
+	ck_assert_int_eq(ret, BSTR_OK);
+	bstrListDestroy(needles);
+	needles = bsplit(b, ',');
+	ck_assert(needles != NULL);
+	ck_assert(bNeedleSetCreate(needles) == NULL);
+	bstrListDestroy(needles);
+	bstrListDestroy(repl);
+	ret = bdestroy(b);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+START_TEST(core_018)
+{
+	struct tagbstring t = bsStatic("alpha,beta,,gamma");
+	struct bstrList *l;
+	struct bArena *a;
+	bstring b, c;
+	void *p;
+	int ret, i;
+	/* tests with NULL */
+	ck_assert(bArenaCreate(-1) == NULL);
+	ck_assert(bArenaAlloc(NULL, 8) == NULL);
+	ck_assert_int_eq(bArenaReset(NULL), BSTR_ERR);
+	ck_assert_int_eq(bArenaDestroy(NULL), BSTR_ERR);
+	a = bArenaCreate(64);
+	ck_assert(a != NULL);
+	ck_assert(bArenaAlloc(a, -1) == NULL);
+	ck_assert(bArenaFromCstr(a, NULL) == NULL);
+	ck_assert(bArenaFromCstr(NULL, "x") == NULL);
+	ck_assert(bArenaStrcpy(a, NULL) == NULL);
+	ck_assert(bArenaSplit(a, NULL, ',') == NULL);
+	/* constructors */
+	b = bArenaFromCstr(a, "Hello world");
+	ck_assert(b != NULL);
+	ret = biseqcstr(b, "Hello world");
+	ck_assert_int_eq(ret, 1);
+	ck_assert_int_eq(b->data[b->slen], '\0');
+	c = bArenaMidstr(a, b, 6, 100);
+	ck_assert(c != NULL);
+	ret = biseqcstr(c, "world");
+	ck_assert_int_eq(ret, 1);
+	c = bArenaMidstr(a, b, 20, 5);
+	ck_assert(c != NULL);
+	ck_assert_int_eq(c->slen, 0);
+	c = bArenaStrcpy(a, b);
+	ck_assert(c != NULL);
+	ret = biseq(b, c);
+	ck_assert_int_eq(ret, 1);
+	/* arena strings are read only */
+	ck_assert_int_eq(bstrchr(c, 'w'), 6);
+	ret = bcatcstr(c, "!");
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bdestroy(c);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	/* a block larger than the chunk size */
+	c = bArenaBlk2bstr(a, t.data, 0);
+	ck_assert(c != NULL);
+	p = bArenaAlloc(a, 1000);
+	ck_assert(p != NULL);
+	memset(p, 'x', 1000);
+	/* split */
+	l = bArenaSplit(a, &t, ',');
+	ck_assert(l != NULL);
+	ck_assert_int_eq(l->qty, 4);
+	ret = biseqcstr(l->entry[0], "alpha");
+	ck_assert_int_eq(ret, 1);
+	ret = biseqcstr(l->entry[2], "");
+	ck_assert_int_eq(ret, 1);
+	ret = biseqcstr(l->entry[3], "gamma");
+	ck_assert_int_eq(ret, 1);
+	/* memory is reused after a reset */
+	ret = bArenaReset(a);
+	ck_assert_int_eq(ret, BSTR_OK);
+	c = bArenaFromCstr(a, "Hello world");
+	ck_assert(c == b);
+	for (i = 0; i < 100; i++) {
+		b = bArenaFromCstr(a, "some more text");
+		ck_assert(b != NULL);
+	}
+	ret = biseqcstr(b, "some more text");
+	ck_assert_int_eq(ret, 1);
+	ret = bArenaDestroy(a);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+START_TEST(core_019)
+{
+	struct tagbstring t = bsStatic("Hello");
+	struct tagbstring u = bsStatic(", ");
+	struct bStrBuilder *sb;
+	bstring b, c, big;
+	int ret, i;
+	/* tests with NULL */
+	ck_assert_int_eq(bsbDestroy(NULL), BSTR_ERR);
+	ck_assert_int_eq(bsbReset(NULL), BSTR_ERR);
+	ck_assert_int_eq(bsbLength(NULL), BSTR_ERR);
+	ck_assert_int_eq(bsbAppend(NULL, &t), BSTR_ERR);
+	ck_assert_int_eq(bsbAppendRef(NULL, &t), BSTR_ERR);
+	ck_assert_int_eq(bsbFormat(NULL, "%d", 1), BSTR_ERR);
+	ck_assert(bsbFlatten(NULL) == NULL);
+	sb = bsbCreate();
+	ck_assert(sb != NULL);
+	ck_assert_int_eq(bsbAppend(sb, NULL), BSTR_ERR);
+	ck_assert_int_eq(bsbAppendRef(sb, NULL), BSTR_ERR);
+	ck_assert_int_eq(bsbAppendBlk(sb, "x", -1), BSTR_ERR);
+	ck_assert_int_eq(bsbAppendRefBlk(sb, NULL, 1), BSTR_ERR);
+	ck_assert_int_eq(bsbAppendCstr(sb, NULL), BSTR_ERR);
+	ck_assert_int_eq(bsbFormat(sb, NULL), BSTR_ERR);
+	ck_assert_int_eq(bsbFlattenTo(sb, NULL), BSTR_ERR);
+	b = bsbFlatten(sb);
+	ck_assert(b != NULL);
+	ck_assert_int_eq(b->slen, 0);
+	bdestroy(b);
+	/* mixed pieces */
+	ret = bsbAppendRef(sb, &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bsbAppend(sb, &u);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bsbAppendCstr(sb, "world");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bsbAppendChar(sb, '!');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bsbFormat(sb, " %d+%d=%s", 2, 2, "four");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bsbAppendRefBlk(sb, "", 0);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(bsbLength(sb), 22);
+	b = bsbFlatten(sb);
+	ck_assert(b != NULL);
+	ret = biseqcstr(b, "Hello, world! 2+2=four");
+	ck_assert_int_eq(ret, 1);
+	ck_assert_int_eq(b->mlen, b->slen + 1);
+	ck_assert_int_eq(b->data[b->slen], '\0');
+	/* appending to an existing string, including one of the pieces */
+	c = bfromcstr(">> ");
+	ret = bsbFlattenTo(sb, c);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(c, ">> Hello, world! 2+2=four");
+	ck_assert_int_eq(ret, 1);
+	ret = bsbReset(sb);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(bsbLength(sb), 0);
+	ret = bsbAppendRef(sb, c);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bsbAppendRef(sb, c);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bsbFlattenTo(sb, c);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(c, ">> Hello, world! 2+2=four"
+			   ">> Hello, world! 2+2=four"
+			   ">> Hello, world! 2+2=four");
+	ck_assert_int_eq(ret, 1);
+	bdestroy(c);
+	bdestroy(b);
+	/* large copies and formatted text */
+	ret = bsbReset(sb);
+	ck_assert_int_eq(ret, BSTR_OK);
+	big = bfromcstr("");
+	for (i = 0; i < 500; i++) {
+		ret = bsbFormat(sb, "%05d:%s;", i, i % 50 ? "" :
+				"a longer piece of formatted text which will "
+				"not fit in whatever space is left over");
+		ck_assert_int_eq(ret, BSTR_OK);
+		ret = bformata(big, "%05d:%s;", i, i % 50 ? "" :
+			       "a longer piece of formatted text which will "
+			       "not fit in whatever space is left over");
+		ck_assert_int_eq(ret, BSTR_OK);
+		if (i % 100 == 0) {
+			c = bfromcstr("");
+			ret = bsetstr(c, 2999, NULL, 'q');
+			ck_assert_int_eq(ret, BSTR_OK);
+			ret = bsbAppend(sb, c);
+			ck_assert_int_eq(ret, BSTR_OK);
+			ret = bconcat(big, c);
+			ck_assert_int_eq(ret, BSTR_OK);
+			bdestroy(c);
+		}
+	}
+	b = bsbFlatten(sb);
+	ck_assert(b != NULL);
+	ret = biseq(b, big);
+	ck_assert_int_eq(ret, 1);
+	bdestroy(b);
+	bdestroy(big);
+	ret = bsbDestroy(sb);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+static int
+test20_0(const struct bstrIoVec *iov, int iovcnt, void *parm)
+{
+	bstring b = (bstring)parm;
+	int i, n = 0;
+	for (i = 0; i < iovcnt; i++) {
+		if (0 > bcatblk(b, iov[i].base, (int)iov[i].len)) {
+			return -1;
+		}
+		n += (int)iov[i].len;
+	}
+	return n;
+}
+
+static int
+test20_1(const struct bstrIoVec *iov, int iovcnt, void *parm)
+{
+	(void)iov;
+	(void)parm;
+	return iovcnt - 1;
+}
+
+START_TEST(core_020)
+{
+	struct tagbstring t = bsStatic("alpha,beta,,gamma");
+	struct tagbstring sep = bsStatic(" | ");
+	struct bstrList *l;
+	struct bStrBuilder *sb;
+	bstring b, c;
+	int ret, i;
+	l = bsplit(&t, ',');
+	ck_assert(l != NULL);
+	sb = bsbCreate();
+	ck_assert(sb != NULL);
+	ck_assert_int_eq(bsbJoin(NULL, l, &sep), BSTR_ERR);
+	ck_assert_int_eq(bsbJoin(sb, NULL, &sep), BSTR_ERR);
+	ck_assert_int_eq(bsbJoinBlk(sb, l, NULL, 1), BSTR_ERR);
+	ck_assert_int_eq(bsbJoinBlk(sb, l, "x", -1), BSTR_ERR);
+	/* joining agrees with bjoin */
+	ret = bsbAppendCstr(sb, "[");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bsbJoin(sb, l, &sep);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bsbAppendCstr(sb, "]");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bsbJoin(sb, l, NULL);
+	ck_assert_int_eq(ret, BSTR_OK);
+	b = bsbFlatten(sb);
+	ck_assert(b != NULL);
+	c = bjoin(l, &sep);
+	ck_assert(c != NULL);
+	ret = binsertch(c, 0, 1, '[');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bcatcstr(c, "]alphabetagamma");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseq(b, c);
+	ck_assert_int_eq(ret, 1);
+	bdestroy(b);
+	/* vectored output */
+	ck_assert_int_eq(bsbWritev(NULL, test20_0, NULL), BSTR_ERR);
+	ck_assert_int_eq(bsbWritev(sb, NULL, NULL), BSTR_ERR);
+	for (i = 0; i < 1000; i++) {
+		ret = bsbAppendRef(sb, &sep);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ret = bsbAppendRef(sb, &t);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ret = bconcat(c, &sep);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ret = bconcat(c, &t);
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	b = bfromcstr("");
+	ret = bsbWritev(sb, test20_0, b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseq(b, c);
+	ck_assert_int_eq(ret, 1);
+	ret = bsbWritev(sb, test20_1, NULL);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	bdestroy(b);
+	bdestroy(c);
+	ret = bsbDestroy(sb);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bstrListDestroy(l);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+struct test21 {
+	bstring out;
+	const void *big;
+	int calls;
+	int direct;
+};
+
+static int
+test21_0(const struct bstrIoVec *iov, int iovcnt, void *parm)
+{
+	struct test21 *w = (struct test21 *)parm;
+	int i, n = 0;
+	w->calls++;
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].base == w->big) {
+			w->direct++;
+		}
+		if (0 > bcatblk(w->out, iov[i].base, (int)iov[i].len)) {
+			return -1;
+		}
+		n += (int)iov[i].len;
+	}
+	return n;
+}
+
+START_TEST(core_021)
+{
+	struct tagbstring t = bsStatic("alpha,beta,,gamma");
+	struct tagbstring sep = bsStatic(" | ");
+	struct bstrIoVec iov[8];
+	struct bwriteStream *ws;
+	struct bstrList *l;
+	struct test21 w;
+	bstring b, c, big;
+	int ret, i;
+	l = bsplit(&t, ',');
+	ck_assert(l != NULL);
+	/* Exporting a list */
+	ret = bstrListIoVec(iov, 8, NULL, sep.data, sep.slen);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bstrListIoVec(NULL, 8, l, sep.data, sep.slen);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bstrListIoVec(iov, 8, l, NULL, 1);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bstrListIoVec(iov, -1, l, sep.data, sep.slen);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bstrListIoVec(NULL, 0, l, sep.data, sep.slen);
+	ck_assert_int_eq(ret, 7);
+	ret = bstrListIoVec(NULL, 0, l, NULL, 0);
+	ck_assert_int_eq(ret, 4);
+	ret = bstrListIoVec(iov, 3, l, sep.data, sep.slen);
+	ck_assert_int_eq(ret, 7);
+	ck_assert(iov[0].base == l->entry[0]->data);
+	ck_assert_int_eq((int)iov[0].len, 5);
+	ck_assert(iov[1].base == sep.data);
+	ck_assert_int_eq((int)iov[1].len, 3);
+	ck_assert(iov[2].base == l->entry[1]->data);
+	b = bfromcstr("");
+	ck_assert(b != NULL);
+	ret = bstrListIoVec(iov, 8, l, sep.data, sep.slen);
+	ck_assert_int_eq(ret, 7);
+	ret = test20_0(iov, ret, b);
+	ck_assert_int_eq(ret, 23);
+	ret = biseqcstr(b, "alpha | beta |  | gamma");
+	ck_assert_int_eq(ret, 1);
+	bdestroy(b);
+	/* Vectored streams */
+	ck_assert(bwsOpenv(NULL, NULL) == NULL);
+	w.out = bfromcstr("");
+	ck_assert(w.out != NULL);
+	big = bfromcstr("");
+	ck_assert(big != NULL);
+	for (i = 0; i < 5000; i++) {
+		ret = bformata(big, "%04d", i);
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	w.big = big->data;
+	w.calls = w.direct = 0;
+	ws = bwsOpenv(test21_0, &w);
+	ck_assert(ws != NULL);
+	(void)bwsBuffLength(ws, 64);
+	ret = bwsWriteBlk(ws, bsStaticBlkParms("Hello "));
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(w.out->slen, 0);
+	ret = bwsWriteBstr(ws, big);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(w.calls, 1);
+	ck_assert_int_eq(w.direct, 1);
+	ck_assert_int_eq(w.out->slen, 6 + big->slen);
+	ret = bwsWriteList(ws, l, &sep);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert(bwsClose(ws) == &w);
+	c = bfromcstr("Hello ");
+	ck_assert(c != NULL);
+	ret = bconcat(c, big);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bcatcstr(c, "alpha | beta |  | gamma");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseq(w.out, c);
+	ck_assert_int_eq(ret, 1);
+	bdestroy(c);
+	ret = bstrListDestroy(l);
+	ck_assert_int_eq(ret, BSTR_OK);
+	/* A large list is sent from its entries on either kind of stream */
+	l = bsplit(big, '9');
+	ck_assert(l != NULL);
+	for (i = 0; i < l->qty; i++) {
+		ret = bconcat(l->entry[i], big);
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	c = bjoin(l, &sep);
+	ck_assert(c != NULL);
+	w.out->slen = 0;
+	w.big = l->entry[1]->data;
+	w.calls = w.direct = 0;
+	ws = bwsOpenv(test21_0, &w);
+	ck_assert(ws != NULL);
+	ret = bwsWriteBlk(ws, bsStaticBlkParms("x"));
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bwsWriteList(ws, l, &sep);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(w.direct, 1);
+	ck_assert(bwsClose(ws) == &w);
+	ret = bisstemeqblk(w.out, "x", 1);
+	ck_assert_int_eq(ret, 1);
+	ret = bdelete(w.out, 0, 1);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseq(w.out, c);
+	ck_assert_int_eq(ret, 1);
+	b = bfromcstr("");
+	ck_assert(b != NULL);
+	ws = bwsOpen((bNwrite)tWrite, b);
+	ck_assert(ws != NULL);
+	ret = bwsWriteList(ws, l, &sep);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bwsWriteList(ws, NULL, &sep);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ck_assert(bwsClose(ws) == b);
+	ret = biseq(b, c);
+	ck_assert_int_eq(ret, 1);
+	/* A short write puts the stream at EOF */
+	ws = bwsOpenv(test20_1, NULL);
+	ck_assert(ws != NULL);
+	ret = bwsWriteBstr(ws, big);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bwsIsEOF(ws);
+	ck_assert_int_eq(ret, 1);
+	ck_assert(bwsClose(ws) == NULL);
+	bdestroy(b);
+	bdestroy(c);
+	bdestroy(big);
+	bdestroy(w.out);
+	ret = bstrListDestroy(l);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+/* Encode the n bytes at s as base64, one character at a time */
+static void
+test22_0(bstring out, const unsigned char *s, int n, int flags)
+{
+	const char *t = (flags & BSTR_B64_URL) ?
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"abcdefghijklmnopqrstuvwxyz0123456789-_" :
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"abcdefghijklmnopqrstuvwxyz0123456789+/";
+	unsigned long v;
+	int i, k;
+	for (i = 0; i < n; i += 3) {
+		k = n - i < 3 ? n - i : 3;
+		v = (unsigned long)s[i] << 16;
+		v |= k > 1 ? (unsigned long)s[i + 1] << 8 : 0;
+		v |= k > 2 ? (unsigned long)s[i + 2] : 0;
+		bconchar(out, t[v >> 18]);
+		bconchar(out, t[(v >> 12) & 63]);
+		if (k > 1) {
+			bconchar(out, t[(v >> 6) & 63]);
+		} else if (!(flags & BSTR_B64_NOPAD)) {
+			bconchar(out, '=');
+		}
+		if (k > 2) {
+			bconchar(out, t[v & 63]);
+		} else if (!(flags & BSTR_B64_NOPAD)) {
+			bconchar(out, '=');
+		}
+		if (k == 3 && (i + 3) % 57 == 0 &&
+		    !(flags & BSTR_B64_NOWRAP)) {
+			bcatcstr(out, "\r\n");
+		}
+	}
+}
+
+START_TEST(core_022)
+{
+	static const char *const bad[] = {
+		"Q", "QQ=", "QQ==Q", "Q===", "QQQ==", "QUJD*", "QQ==QQ==",
+		"QUJD\x80", "QUJ-", "=QUJD"
+	};
+	struct tagbstring t = bsStatic("Hello world");
+	struct bBase64State st;
+	unsigned char data[1100];
+	unsigned int r = 1;
+	bstring a, b, c;
+	int ret, i, n, k, flags;
+	for (i = 0; i < (int)sizeof(data); i++) {
+		r = r * 1103515245u + 12345u;
+		data[i] = (unsigned char)(r >> 16);
+	}
+	/* tests with NULL and invalid input */
+	a = bfromcstr("");
+	ck_assert(a != NULL);
+	ck_assert_int_eq(bBase64EncodeLen(-1, 0), BSTR_ERR);
+	ret = bBase64EncodeBlk(NULL, data, 1, 0);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bBase64EncodeBlk(a, NULL, 1, 0);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bBase64EncodeBlk(a, data, -1, 0);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bBase64DecodeBlk(NULL, "QQ==", 4, 0);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bBase64DecodeBlk(a, NULL, 4, 0);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bBase64EncodeStep(NULL, a, data, 1);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bBase64DecodeEnd(NULL, a);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bBase64EncodeBlk(a, NULL, 0, 0);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(a->slen, 0);
+	/* the variants */
+	ret = bBase64EncodeBlk(a, "\xfb\xff\xfe", 3, 0);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bBase64EncodeBlk(a, "\xfb\xff\xfe", 3, BSTR_B64_URL);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bBase64EncodeBlk(a, t.data, t.slen, BSTR_B64_NOPAD);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(a, "+//+-__-SGVsbG8gd29ybGQ");
+	ck_assert_int_eq(ret, 1);
+	ret = bBase64DecodeBlk(a, a->data + 8, a->slen - 8, 0);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bBase64DecodeBlk(a, " +//+\r\n", 7, 0);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bBase64DecodeBlk(a, "-__-", 4, BSTR_B64_URL);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(a, "+//+-__-SGVsbG8gd29ybGQHello world"
+			   "\xfb\xff\xfe\xfb\xff\xfe");
+	ck_assert_int_eq(ret, 1);
+	/* invalid input leaves the output alone */
+	for (i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++) {
+		ret = bBase64DecodeBlk(a, bad[i], (int)strlen(bad[i]), 0);
+		ck_assert_int_eq(ret, BSTR_ERR);
+		ck_assert_int_eq(a->slen, 40);
+	}
+	ret = bBase64DecodeBlk(a, "-__-", 4, 0);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bBase64DecodeBlk(a, "+//+", 4, BSTR_B64_URL);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ck_assert_int_eq(a->slen, 40);
+	/* every length and variant against a plain encoder, in one piece and
+	 * in several, with the lengths given by bBase64EncodeLen
+	 */
+	b = bfromcstr("");
+	c = bfromcstr("");
+	ck_assert(b != NULL && c != NULL);
+	for (n = 0; n < (int)sizeof(data); n += 1 + n / 64) {
+		for (flags = 0; flags < 8; flags++) {
+			a->slen = b->slen = c->slen = 0;
+			test22_0(a, data, n, flags);
+			ret = bBase64EncodeBlk(b, data, n, flags);
+			ck_assert_int_eq(ret, BSTR_OK);
+			ret = biseq(a, b);
+			ck_assert_int_eq(ret, 1);
+			ck_assert_int_eq(bBase64EncodeLen(n, flags), b->slen);
+			bBase64Init(&st, flags);
+			for (i = 0; i < n; i += k) {
+				r = r * 1103515245u + 12345u;
+				k = (int)((r >> 16) % 80);
+				k = k > n - i ? n - i : k;
+				ret = bBase64EncodeStep(&st, c, data + i, k);
+				ck_assert_int_eq(ret, BSTR_OK);
+			}
+			ret = bBase64EncodeEnd(&st, c);
+			ck_assert_int_eq(ret, BSTR_OK);
+			ret = biseq(a, c);
+			ck_assert_int_eq(ret, 1);
+			/* and back */
+			a->slen = c->slen = 0;
+			ret = bBase64DecodeBlk(a, b->data, b->slen, flags);
+			ck_assert_int_eq(ret, BSTR_OK);
+			ret = biseqblk(a, data, n);
+			ck_assert_int_eq(ret, 1);
+			bBase64Init(&st, flags);
+			for (i = 0; i < b->slen; i += k) {
+				r = r * 1103515245u + 12345u;
+				k = (int)((r >> 16) % 80);
+				k = k > b->slen - i ? b->slen - i : k;
+				ret = bBase64DecodeStep(&st, c, b->data + i, k);
+				ck_assert_int_eq(ret, BSTR_OK);
+			}
+			ret = bBase64DecodeEnd(&st, c);
+			ck_assert_int_eq(ret, BSTR_OK);
+			ret = biseq(a, c);
+			ck_assert_int_eq(ret, 1);
+		}
+	}
+	/* a bad character anywhere in a long input is found */
+	a->slen = b->slen = 0;
+	ret = bBase64EncodeBlk(b, data, 900, BSTR_B64_NOWRAP);
+	ck_assert_int_eq(ret, BSTR_OK);
+	for (i = 0; i < b->slen; i += 7) {
+		unsigned char o = b->data[i];
+		b->data[i] = (unsigned char)(i & 1 ? '-' : 0xc1);
+		ret = bBase64DecodeBlk(a, b->data, b->slen, 0);
+		ck_assert_int_eq(ret, BSTR_ERR);
+		ck_assert_int_eq(a->slen, 0);
+		b->data[i] = o;
+	}
+	bdestroy(a);
+	bdestroy(b);
+	bdestroy(c);
+}
+END_TEST
+
 int
 main(void)
 {
@@ -574,6 +1321,12 @@ main(void)
 	tcase_add_test(core, core_014);
 	tcase_add_test(core, core_015);
 	tcase_add_test(core, core_016);
+	tcase_add_test(core, core_017);
+	tcase_add_test(core, core_018);
+	tcase_add_test(core, core_019);
+	tcase_add_test(core, core_020);
+	tcase_add_test(core, core_021);
+	tcase_add_test(core, core_022);
 	suite_add_tcase(suite, core);
 	/* Run tests */
 	SRunner *runner = srunner_create(suite);
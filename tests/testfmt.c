@@ -0,0 +1,478 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * This file is the C unit test for the bstrfmt module of Bstrlib.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "bstrfmt.h"
+#include "bstrlib.h"
+#include <check.h>
+#include <float.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+static unsigned int seed = 12345;
+
+static unsigned int
+test_rand(void)
+{
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 16) & 0x7fff;
+}
+
+static unsigned long long
+test_rand64(void)
+{
+	unsigned long long v = 0;
+	int i;
+	for (i = 0; i < 5; i++) {
+		v = (v << 15) | test_rand();
+	}
+	return v;
+}
+
+/* Check the output of bcatdouble for v */
+static void
+test1_0(double v, const char *expected)
+{
+	bstring b = bfromcstr("<");
+	int ret;
+	ck_assert(b != NULL);
+	ret = bcatdouble(b, v);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_str_eq((char *)b->data + 1, expected);
+	bdestroy(b);
+}
+
+/* Check that the output of bcatdouble for v reads back as v, and that one
+ * significant digit fewer would not.
+ */
+static void
+test1_1(double v)
+{
+	char buf[40];
+	bstring b = bfromcstr("");
+	int ret, i, digits = 0, lead = 1;
+	ck_assert(b != NULL);
+	ret = bcatdouble(b, v);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert(strtod((char *)b->data, NULL) == v);
+	for (i = 0; i < b->slen && b->data[i] != 'e'; i++) {
+		if (b->data[i] >= '1' && b->data[i] <= '9') {
+			lead = 0;
+		}
+		if (!lead && b->data[i] >= '0' && b->data[i] <= '9') {
+			digits++;
+		}
+	}
+	/* Trailing zeros of an integer are not significant */
+	if (v == 0) {
+		digits = 1;
+	}
+	while (digits > 1 && b->data[i - 1] == '0' &&
+	       memchr(b->data, '.', b->slen) == NULL) {
+		i--;
+		digits--;
+	}
+	ck_assert(digits >= 1 && digits <= 17);
+	if (digits > 1) {
+		snprintf(buf, sizeof(buf), "%.*e", digits - 2, v);
+		ck_assert(strtod(buf, NULL) != v);
+	}
+	bdestroy(b);
+}
+
+START_TEST(core_000)
+{
+	char buf[128];
+	bstring b;
+	long long v;
+	unsigned long long u;
+	int i, ret;
+	/* tests with NULL and invalid input */
+	ck_assert_int_eq(bcatint(NULL, 1), BSTR_ERR);
+	ck_assert_int_eq(bcatuint(NULL, 1), BSTR_ERR);
+	ck_assert_int_eq(bcathex(NULL, 1), BSTR_ERR);
+	ck_assert_int_eq(bcatdouble(NULL, 1), BSTR_ERR);
+	b = bfromcstr("");
+	ck_assert(b != NULL);
+	ret = bcatint(b, 0);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bcatint(b, -1);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bcatint(b, LLONG_MIN);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bcatint(b, LLONG_MAX);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bcatuint(b, ULLONG_MAX);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bcathex(b, 0);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bcathex(b, 0xdeadbeefULL);
+	ck_assert_int_eq(ret, BSTR_OK);
+	snprintf(buf, sizeof(buf), "0-1%lld%lld%llu0deadbeef", LLONG_MIN,
+		 LLONG_MAX, ULLONG_MAX);
+	ck_assert_str_eq((char *)b->data, buf);
+	for (i = 0; i < 10000; i++) {
+		u = test_rand64() >> (test_rand() % 64);
+		v = (long long)(u >> 1) * (test_rand() & 1 ? -1 : 1);
+		b->slen = 0;
+		ret = bcatint(b, v);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ret = bcatuint(b, u);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ret = bcathex(b, u);
+		ck_assert_int_eq(ret, BSTR_OK);
+		snprintf(buf, sizeof(buf), "%lld%llu%llx", v, u, u);
+		ck_assert_str_eq((char *)b->data, buf);
+	}
+	bdestroy(b);
+}
+END_TEST
+
+START_TEST(core_001)
+{
+	union {
+		double d;
+		uint64_t u;
+	} x;
+	int i, k;
+	test1_0(0.0, "0");
+	test1_0(-0.0, "-0");
+	test1_0(1.0, "1");
+	test1_0(-2.5, "-2.5");
+	test1_0(1200.0, "1200");
+	test1_0(0.1, "0.1");
+	test1_0(0.1 + 0.2, "0.30000000000000004");
+	test1_0(1.0 / 3, "0.3333333333333333");
+	test1_0(123.456, "123.456");
+	test1_0(0.000001, "0.000001");
+	test1_0(1.5e-7, "1.5e-7");
+	test1_0(1e21, "1e+21");
+	test1_0(1.2345678901234568e20, "123456789012345680000");
+	test1_0(9007199254740993.0, "9007199254740992");
+	test1_0(5e-324, "5e-324");
+	test1_0(DBL_MAX, "1.7976931348623157e+308");
+	test1_0(-DBL_MIN, "-2.2250738585072014e-308");
+	test1_0(1.0 / 0.0, "inf");
+	test1_0(-1.0 / 0.0, "-inf");
+	test1_0(0.0 / 0.0, "nan");
+	/* random bit patterns, and short decimals */
+	for (i = 0; i < 20000; i++) {
+		x.u = (uint64_t)test_rand64() << 1 ^ (uint64_t)test_rand();
+		if (x.d == x.d && x.d - x.d == 0) {
+			test1_1(x.d);
+		}
+		k = test_rand() % 12;
+		test1_1((double)test_rand64() / 1e12 / (k + 1));
+		test1_1((double)(test_rand() % 100000) / 1e3);
+		test1_1((double)(test_rand() % 1000) * 1e-9);
+	}
+}
+END_TEST
+
+/* Check that bcatformat appends exactly what bformata does */
+#define test2_0(fmt, ...) \
+do { \
+	bstring a_ = bfromcstr("x"), b_ = bfromcstr("x"); \
+	ck_assert(a_ != NULL && b_ != NULL); \
+	ck_assert_int_eq(bformata(a_, fmt, __VA_ARGS__), BSTR_OK); \
+	ck_assert_int_eq(bcatformat(b_, fmt, __VA_ARGS__), BSTR_OK); \
+	ck_assert_int_eq(biseq(a_, b_), 1); \
+	bdestroy(a_); \
+	bdestroy(b_); \
+} while (0)
+
+START_TEST(core_002)
+{
+	char big[3000];
+	int i;
+	memset(big, 'q', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+	test2_0("%s", "plain text");
+	test2_0("%d %i %u %x %X %c %s %%", -12, 34, 56u, 0xabcu, 0xdefu,
+		'z', "str");
+	test2_0("%d %d %u %x", INT_MIN, INT_MAX, UINT_MAX, UINT_MAX);
+	test2_0("%5d|%-5d|%05d|%+d|% d|%*d|%-*d|", 42, 42, 42, 42, 42, 6,
+		42, 6, 42);
+	test2_0("%*d|", -7, 42);
+	test2_0("%08x|%-08X|%010d|%0*d|%-05u|%3d|%03lld|", 0xbeefu, 0xbeefu,
+		-1234, 7, -5, 9u, 123456, LLONG_MIN);
+	test2_0("%.3s|%10s|%-10s|%.*s|%*s|", "abcdef", "abc", "abc", 2,
+		"xyz", -4, "p");
+	test2_0("%ld %lld %lu %llu %zu %hd %hhu %jd %td", -1L, LLONG_MIN,
+		ULONG_MAX, ULLONG_MAX, (size_t)77, (short)-5,
+		(unsigned char)200, (intmax_t)-9, (ptrdiff_t)-3);
+	test2_0("%hhd %hu %hx", 300, 70000, 70000);
+	test2_0("%f %g %e %.3f %10.4g %-12.2e| %a", 3.25, 1e-5, 12345.678,
+		2.0 / 3, 1.0 / 7, -5e10, 1.0);
+	test2_0("%Lf %Lg", (long double)1.5, (long double)2.5e100);
+	test2_0("%o %#o %#x %#X %.0d|%.5u", 8u, 8u, 255u, 255u, 0, 7u);
+	test2_0("%p", (void *)&i);
+	test2_0("%s%s%d", big, big, 1);
+	test2_0("%3000d|%.2000f", 5, 1.0);
+	for (i = -1000; i < 1000; i += 7) {
+		test2_0("[%d] %s=%u (%x)", i * 997, "key", (unsigned)i * 13u,
+			(unsigned)i);
+	}
+}
+END_TEST
+
+START_TEST(core_003)
+{
+	struct tagbstring t = bsStatic("ab\0cd");
+	struct tagbstring ro = bsStatic("read only");
+	struct tagbstring v;
+	bstring b, c;
+	int ret, i;
+	/* tests with NULL and invalid input */
+	ck_assert_int_eq(bcatformat(NULL, "%d", 1), BSTR_ERR);
+	b = bfromcstr("keep");
+	ck_assert(b != NULL);
+	ck_assert_int_eq(bcatformat(b, NULL), BSTR_ERR);
+	ck_assert_int_eq(bcatformat(&ro, "%d", 1), BSTR_ERR);
+	ck_assert_int_eq(bcatformat(b, "x%s", (char *)NULL), BSTR_ERR);
+	ck_assert_int_eq(bcatformat(b, "x%B", (bstring)NULL), BSTR_ERR);
+	ck_assert_int_eq(bcatformat(b, "%d%n", 1, &ret), BSTR_ERR);
+	ck_assert_int_eq(bcatformat(b, "%d%k", 1, 2), BSTR_ERR);
+	ck_assert_int_eq(bcatformat(b, "%d%", 1), BSTR_ERR);
+	ck_assert_int_eq(bcatformat(b, "%d%5", 1), BSTR_ERR);
+	ret = biseqcstr(b, "keep");
+	ck_assert_int_eq(ret, 1);
+	/* %B uses the stored length */
+	ret = bcatformat(b, "[%B]", &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(b->slen, 11);
+	ck_assert(memcmp(b->data, "keep[ab\0cd]", 11) == 0);
+	b->slen = 0;
+	ret = bcatformat(b, "[%.3B|%7B|%-7B|%*.*B]", &t, &t, &t, 4, 1, &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(b->slen, 26);
+	ck_assert(memcmp(b->data, "[ab\0|  ab\0cd|ab\0cd  |   a]", 26) == 0);
+	/* a '\0' from %c does not end the output */
+	b->slen = 0;
+	ret = bcatformat(b, "a%cb", '\0');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(b->slen, 3);
+	/* arguments and format which refer to the output */
+	ret = bassigncstr(b, "abc");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bcatformat(b, "|%s|%B|%s|%.2s|%B", b->data, b, b->data + 1,
+			 b->data, b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(b, "abc|abc|abc|bc|ab|abc");
+	ck_assert_int_eq(ret, 1);
+	c = bfromcstr("<%d>");
+	ck_assert(c != NULL);
+	ret = bcatformat(c, (char *)c->data, 5);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(c, "<%d><5>");
+	ck_assert_int_eq(ret, 1);
+	/* and which still refer to it after it has had to grow */
+	ret = bassigncstr(b, "");
+	ck_assert_int_eq(ret, BSTR_OK);
+	for (i = 0; i < 50; i++) {
+		ret = bconchar(b, (char)('a' + i % 26));
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	ret = ballocmin(b, 51);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bassigncstr(c, "");
+	ck_assert_int_eq(ret, BSTR_OK);
+	for (i = 0; i < 2000; i++) {
+		ret = bconchar(c, 'x');
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	bmid2tbstr(v, b, 10, 5);
+	ret = bcatformat(b, "%s|%s|%B|%.3s", (char *)c->data,
+			 (char *)b->data, &v, (char *)b->data + 1);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(b->slen, 50 + 2000 + 1 + 50 + 1 + 5 + 1 + 3);
+	ck_assert(memcmp(b->data + 50, c->data, 2000) == 0);
+	ck_assert_int_eq(b->data[2050], '|');
+	ck_assert(memcmp(b->data + 2051, b->data, 50) == 0);
+	ck_assert(memcmp(b->data + 2101, "|klmno|bcd", 10) == 0);
+	ret = bcatformat(b, "%*s", 9000, (char *)b->data);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(b->slen, 2111 + 9000);
+	ck_assert(memcmp(b->data + 9000, b->data, 2111) == 0);
+	/* growth from a small buffer */
+	ret = bassigncstr(c, "");
+	ck_assert_int_eq(ret, BSTR_OK);
+	while (c->slen < 100000) {
+		ret = bcatformat(c, "%B%d", c, c->slen);
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	bdestroy(b);
+	bdestroy(c);
+}
+END_TEST
+
+/* Check that a compiled format renders exactly what bcatformat does */
+#define test4_0(fmt, ...) \
+do { \
+	struct bstrFormat *f_ = bstrFormatCreate(fmt); \
+	bstring a_ = bfromcstr("x"), b_ = bfromcstr("x"); \
+	int k_; \
+	ck_assert(f_ != NULL && a_ != NULL && b_ != NULL); \
+	for (k_ = 0; k_ < 2; k_++) { \
+		ck_assert_int_eq(bcatformat(a_, fmt, __VA_ARGS__), BSTR_OK); \
+		ck_assert_int_eq(bstrFormatCat(b_, f_, __VA_ARGS__), BSTR_OK); \
+		ck_assert_int_eq(biseq(a_, b_), 1); \
+	} \
+	ck_assert_int_eq(bstrFormatDestroy(f_), BSTR_OK); \
+	bdestroy(a_); \
+	bdestroy(b_); \
+} while (0)
+
+START_TEST(core_004)
+{
+	struct tagbstring t = bsStatic("ab\0cd");
+	struct tagbstring ro = bsStatic("read only");
+	struct tagbstring s;
+	struct bstrFormat *f;
+	char big[3000];
+	bstring b;
+	int i, ret;
+	memset(big, 'q', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+	/* tests with NULL and invalid input */
+	ck_assert(bstrFormatCreate(NULL) == NULL);
+	ck_assert(bstrFormatCreate("%d%n") == NULL);
+	ck_assert(bstrFormatCreate("%d%k") == NULL);
+	ck_assert(bstrFormatCreate("%d%") == NULL);
+	ck_assert(bstrFormatCreate("%d%5") == NULL);
+	ck_assert_int_eq(bstrFormatDestroy(NULL), BSTR_ERR);
+	f = bstrFormatCreate("<%s>");
+	ck_assert(f != NULL);
+	b = bfromcstr("keep");
+	ck_assert(b != NULL);
+	ck_assert_int_eq(bstrFormatCat(NULL, f, "a"), BSTR_ERR);
+	ck_assert_int_eq(bstrFormatCat(b, NULL, "a"), BSTR_ERR);
+	ck_assert_int_eq(bstrFormatCat(&ro, f, "a"), BSTR_ERR);
+	ck_assert_int_eq(bstrFormatCat(b, f, (char *)NULL), BSTR_ERR);
+	ret = biseqcstr(b, "keep");
+	ck_assert_int_eq(ret, 1);
+	/* arguments which refer to the output */
+	ret = bstrFormatCat(b, f, b->data + 1);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(b, "keep<eep>");
+	ck_assert_int_eq(ret, 1);
+	ck_assert_int_eq(bstrFormatDestroy(f), BSTR_OK);
+	f = bstrFormatCreate("%B|%.3s|%B");
+	ck_assert(f != NULL);
+	ret = bstrFormatCat(b, f, b, b->data, b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = biseqcstr(b, "keep<eep>keep<eep>|kee|keep<eep>");
+	ck_assert_int_eq(ret, 1);
+	ck_assert_int_eq(bstrFormatDestroy(f), BSTR_OK);
+	/* text in the spare capacity of b, while b grows */
+	ck_assert_int_eq(btrunc(b, 3), BSTR_OK);
+	blk2tbstr(s, b->data + 4, 3);
+	f = bstrFormatCreate("%s|%s|%B");
+	ck_assert(f != NULL);
+	ret = bstrFormatCat(b, f, big, (char *)b->data + 6, &s);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(b->slen, 3 + (int)strlen(big) + 2);
+	ck_assert_int_eq(memcmp(b->data, "kee", 3), 0);
+	ck_assert_int_eq(memcmp(b->data + b->slen - 2, "||", 2), 0);
+	ck_assert_int_eq(bstrFormatDestroy(f), BSTR_OK);
+	bdestroy(b);
+	/* the same output as bcatformat */
+	test4_0("plain text with %% only", 0);
+	test4_0("%s", "");
+	test4_0("[%B] [%.3B|%7B|%-7B|%*.*B]", &t, &t, &t, &t, 4, 1, &t);
+	test4_0("%d %i %u %x %X %c %s %%", -12, 34, 56u, 0xabcu, 0xdefu, 'z',
+		"str");
+	test4_0("%d %d %u %x %lld %llu", INT_MIN, INT_MAX, UINT_MAX,
+		UINT_MAX, LLONG_MIN, ULLONG_MAX);
+	test4_0("%5d|%-5d|%05d|%+d|% d|%*d|%-*d|%*d|", 42, 42, 42, 42, 42, 6,
+		42, 6, 42, -6, 42);
+	test4_0("%08x|%-08X|%010d|%0*d|%-05u|%3d|%03lld|%*x|", 0xbeefu,
+		0xbeefu, -1234, 7, -5, 9u, 123456, LLONG_MIN, -6, 0xabu);
+	test4_0("%.3s|%10s|%-10s|%.*s|%*s|", "abcdef", "abc", "abc", 2, "xyz",
+		-4, "p");
+	test4_0("%ld %lu %zu %hd %hhu %jd %td %lc %ls", -1L, ULONG_MAX,
+		(size_t)77, (short)-5, (unsigned char)200, (intmax_t)-9,
+		(ptrdiff_t)-3, (wint_t)'w', L"wide");
+	test4_0("%f %g %e %.3f %10.4g %-12.2e| %a %Lg %*.*f", 3.25, 1e-5,
+		12345.678, 2.0 / 3, 1.0 / 7, -5e10, 1.0, (long double)2.5e100,
+		12, 3, 1.0 / 3);
+	test4_0("%o %#o %#x %#X %.0d|%.5u %p a%cb", 8u, 8u, 255u, 255u, 0, 7u,
+		(void *)big, '\0');
+	/* output which does not fit the scratch space */
+	test4_0("%s%d%300d%.400f%300d%.400f%s", big, 1, 2, 1e10, 3, -2e10,
+		big);
+	test4_0("%.*f|%*d", 2000, 1.0, 3000, 5);
+	/* more arguments than are kept on the stack */
+	test4_0("%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d"
+		"%d%d%d%d%d%d%d%d%d%d%d", 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+		12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27,
+		28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39);
+	for (i = -1000; i < 1000; i += 7) {
+		test4_0("[%d] %s=%u (%x) %hd", i * 997, "key",
+			(unsigned)i * 13u, (unsigned)i, (short)(i * 100));
+	}
+}
+END_TEST
+
+int
+main(void)
+{
+	/* Build test suite */
+	Suite *suite = suite_create("bstr-fmt");
+	/* Core tests */
+	TCase *core = tcase_create("Core");
+	tcase_add_test(core, core_000);
+	tcase_add_test(core, core_001);
+	tcase_add_test(core, core_002);
+	tcase_add_test(core, core_003);
+	tcase_add_test(core, core_004);
+	suite_add_tcase(suite, core);
+	/* Run tests */
+	SRunner *runner = srunner_create(suite);
+	srunner_run_all(runner, CK_ENV);
+	int number_failed = srunner_ntests_failed(runner);
+	srunner_free(runner);
+	return (0 == number_failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,537 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * This file is the C unit test for the bstrmap module of Bstrlib.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "bstrmap.h"
+#include "bstrlib.h"
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+static int values[12000];
+
+static bstring
+test_key(int i)
+{
+	return bformat("key-%d-%x%s", i, (unsigned int)i * 2654435761u,
+		       i % 3 ? "" : "-long-enough-for-the-arena");
+}
+
+START_TEST(core_000)
+{
+	struct tagbstring t = bsStatic("alpha");
+	struct tagbstring key;
+	struct bstrMap *m;
+	void *v = NULL;
+	int ret, pos = 0;
+	ck_assert(bstrMapDestroy(NULL) == BSTR_ERR);
+	ck_assert(bstrMapClear(NULL) == BSTR_ERR);
+	ck_assert(bstrMapCount(NULL) == BSTR_ERR);
+	ck_assert(bstrMapReserve(NULL, 10) == BSTR_ERR);
+	ck_assert(bstrMapSet(NULL, &t, NULL) == BSTR_ERR);
+	ck_assert(bstrMapFind(NULL, &t, &v) == BSTR_ERR);
+	ck_assert(bstrMapErase(NULL, &t, &v) == BSTR_ERR);
+	ck_assert(bstrMapNext(NULL, &pos, &key, &v) == BSTR_ERR);
+	m = bstrMapCreate();
+	ck_assert(m != NULL);
+	ck_assert_int_eq(bstrMapCount(m), 0);
+	ck_assert(bstrMapSet(m, NULL, NULL) == BSTR_ERR);
+	ck_assert(bstrMapSetBlk(m, NULL, 3, NULL) == BSTR_ERR);
+	ck_assert(bstrMapSetBlk(m, "abc", -1, NULL) == BSTR_ERR);
+	ck_assert(bstrMapFind(m, NULL, &v) == BSTR_ERR);
+	ck_assert(bstrMapFindBlk(m, "abc", -1, &v) == BSTR_ERR);
+	ck_assert(bstrMapErase(m, NULL, &v) == BSTR_ERR);
+	ck_assert(bstrMapReserve(m, -1) == BSTR_ERR);
+	ck_assert(bstrMapNext(m, NULL, &key, &v) == BSTR_ERR);
+	ck_assert(bstrMapNext(m, &pos, NULL, &v) == BSTR_ERR);
+	/* Operations on an empty map */
+	ret = bstrMapFind(m, &t, &v);
+	ck_assert_int_eq(ret, 0);
+	ck_assert(v == NULL);
+	ret = bstrMapErase(m, &t, &v);
+	ck_assert_int_eq(ret, 0);
+	ret = bstrMapNext(m, &pos, &key, &v);
+	ck_assert_int_eq(ret, 0);
+	ret = bstrMapDestroy(m);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+START_TEST(core_001)
+{
+	struct tagbstring t = bsStatic("alpha");
+	struct tagbstring u = bsStatic("beta");
+	struct bstrMap *m;
+	bstring b;
+	int a = 1, c = 2, d = 3;
+	void *v = NULL;
+	int ret;
+	m = bstrMapCreate();
+	ck_assert(m != NULL);
+	ret = bstrMapSet(m, &t, &a);
+	ck_assert_int_eq(ret, 1);
+	ret = bstrMapSet(m, &u, &c);
+	ck_assert_int_eq(ret, 1);
+	ck_assert_int_eq(bstrMapCount(m), 2);
+	/* The map keeps its own copy of the key */
+	b = bfromcstr("alpha");
+	ck_assert(b != NULL);
+	ret = bstrMapFind(m, b, &v);
+	ck_assert_int_eq(ret, 1);
+	ck_assert(v == &a);
+	ret = bstrMapSet(m, b, &d);
+	ck_assert_int_eq(ret, 0);
+	ck_assert_int_eq(bstrMapCount(m), 2);
+	ret = bassigncstr(b, "gamma");
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bstrMapFind(m, &t, &v);
+	ck_assert_int_eq(ret, 1);
+	ck_assert(v == &d);
+	ret = bstrMapFind(m, b, &v);
+	ck_assert_int_eq(ret, 0);
+	ck_assert(v == &d);
+	ret = bstrMapFind(m, &u, NULL);
+	ck_assert_int_eq(ret, 1);
+	/* Lookups by block need no bstring */
+	ret = bstrMapFindBlk(m, "beta", 4, &v);
+	ck_assert_int_eq(ret, 1);
+	ck_assert(v == &c);
+	ret = bstrMapFindBlk(m, "betamax", 4, &v);
+	ck_assert_int_eq(ret, 1);
+	ret = bstrMapFindBlk(m, "bet", 3, &v);
+	ck_assert_int_eq(ret, 0);
+	/* Empty keys and keys with embedded NULs */
+	ret = bstrMapSetBlk(m, "", 0, &a);
+	ck_assert_int_eq(ret, 1);
+	ret = bstrMapSetBlk(m, "a\0b", 3, &c);
+	ck_assert_int_eq(ret, 1);
+	ret = bstrMapSetBlk(m, "a\0c", 3, &d);
+	ck_assert_int_eq(ret, 1);
+	ck_assert_int_eq(bstrMapCount(m), 5);
+	ret = bstrMapFindBlk(m, "", 0, &v);
+	ck_assert_int_eq(ret, 1);
+	ck_assert(v == &a);
+	ret = bstrMapFindBlk(m, "a\0b", 3, &v);
+	ck_assert_int_eq(ret, 1);
+	ck_assert(v == &c);
+	ret = bstrMapFindBlk(m, "a", 1, &v);
+	ck_assert_int_eq(ret, 0);
+	ret = bdestroy(b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bstrMapDestroy(m);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+START_TEST(core_002)
+{
+	struct bstrMap *m;
+	bstring b;
+	void *v;
+	int i, ret, n = 5000;
+	m = bstrMapCreate();
+	ck_assert(m != NULL);
+	for (i = 0; i < n; i++) {
+		b = test_key(i);
+		ck_assert(b != NULL);
+		ret = bstrMapSet(m, b, &values[i]);
+		ck_assert_int_eq(ret, 1);
+		bdestroy(b);
+	}
+	ck_assert_int_eq(bstrMapCount(m), n);
+	/* Erase the odd keys */
+	for (i = 1; i < n; i += 2) {
+		b = test_key(i);
+		v = NULL;
+		ret = bstrMapErase(m, b, &v);
+		ck_assert_int_eq(ret, 1);
+		ck_assert(v == &values[i]);
+		ret = bstrMapErase(m, b, &v);
+		ck_assert_int_eq(ret, 0);
+		bdestroy(b);
+	}
+	ck_assert_int_eq(bstrMapCount(m), n / 2);
+	for (i = 0; i < n; i++) {
+		b = test_key(i);
+		v = NULL;
+		ret = bstrMapFind(m, b, &v);
+		if (i & 1) {
+			ck_assert_int_eq(ret, 0);
+		} else {
+			ck_assert_int_eq(ret, 1);
+			ck_assert(v == &values[i]);
+		}
+		bdestroy(b);
+	}
+	/* Churn through many more keys than the map ever holds at once */
+	for (i = n; i < 20 * n; i++) {
+		b = test_key(i);
+		ret = bstrMapSet(m, b, NULL);
+		ck_assert_int_eq(ret, 1);
+		ret = bstrMapErase(m, b, NULL);
+		ck_assert_int_eq(ret, 1);
+		bdestroy(b);
+	}
+	ck_assert_int_eq(bstrMapCount(m), n / 2);
+	for (i = 0; i < n; i += 2) {
+		b = test_key(i);
+		ret = bstrMapFind(m, b, &v);
+		ck_assert_int_eq(ret, 1);
+		ck_assert(v == &values[i]);
+		bdestroy(b);
+	}
+	ret = bstrMapDestroy(m);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+START_TEST(core_003)
+{
+	struct bstrMap *m;
+	struct tagbstring key;
+	bstring b;
+	char *seen;
+	void *v;
+	int i, ret, pos = 0, count = 0, n = 1000;
+	m = bstrMapCreate();
+	ck_assert(m != NULL);
+	seen = calloc((size_t)n, 1);
+	ck_assert(seen != NULL);
+	for (i = 0; i < n; i++) {
+		b = test_key(i);
+		ret = bstrMapSet(m, b, &values[i]);
+		ck_assert_int_eq(ret, 1);
+		bdestroy(b);
+	}
+	while ((ret = bstrMapNext(m, &pos, &key, &v)) == 1) {
+		i = (int)((int *)v - values);
+		ck_assert(i >= 0 && i < n);
+		ck_assert(!seen[i]);
+		seen[i] = 1;
+		ck_assert(key.mlen < 0);
+		ck_assert(key.data[key.slen] == '\0');
+		b = test_key(i);
+		ck_assert_int_eq(biseq(b, &key), 1);
+		bdestroy(b);
+		count++;
+	}
+	ck_assert_int_eq(ret, 0);
+	ck_assert_int_eq(count, n);
+	ret = bstrMapNext(m, &pos, &key, &v);
+	ck_assert_int_eq(ret, 0);
+	free(seen);
+	ret = bstrMapDestroy(m);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+START_TEST(core_004)
+{
+	struct tagbstring t = bsStatic("precomputed");
+	struct bstrHashKey k;
+	struct bstrMap *m, *m2;
+	int a = 1;
+	void *v = NULL;
+	int ret;
+	m = bstrMapCreate();
+	ck_assert(m != NULL);
+	m2 = bstrMapCreate();
+	ck_assert(m2 != NULL);
+	ck_assert(bstrMapSeed(NULL) == 0);
+	ck_assert(bstrMapSeed(m) != bstrMapSeed(m2));
+	ret = bstrMapSet(m, &t, &a);
+	ck_assert_int_eq(ret, 1);
+	ret = bstrMapSet(m2, &t, &a);
+	ck_assert_int_eq(ret, 1);
+	ret = bhashkeyinit(&k, &t, bstrMapSeed(m));
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bstrMapFindKey(m, &k, &v);
+	ck_assert_int_eq(ret, 1);
+	ck_assert(v == &a);
+	/* A key hashed for another map is rehashed */
+	v = NULL;
+	ret = bstrMapFindKey(m2, &k, &v);
+	ck_assert_int_eq(ret, 1);
+	ck_assert(v == &a);
+	ck_assert(k.seed == bstrMapSeed(m2));
+	ck_assert(bstrMapFindKey(m, NULL, &v) == BSTR_ERR);
+	ck_assert(bstrMapFindKey(NULL, &k, &v) == BSTR_ERR);
+	ret = bstrMapDestroy(m);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bstrMapDestroy(m2);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+START_TEST(core_005)
+{
+	struct bstrMap *m;
+	struct tagbstring key;
+	bstring b, big;
+	void *v;
+	int i, ret, pos = 0, n = 3000;
+	m = bstrMapCreate();
+	ck_assert(m != NULL);
+	ret = bstrMapReserve(m, n);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bstrMapReserve(m, 10);
+	ck_assert_int_eq(ret, BSTR_OK);
+	/* Keys larger than a block of the arena */
+	big = bfromcstr("");
+	ck_assert(big != NULL);
+	ret = bsetstr(big, 10000, NULL, 'x');
+	ck_assert_int_eq(ret, BSTR_OK);
+	for (i = 0; i < 8; i++) {
+		big->data[0] = (unsigned char)('a' + i);
+		ret = bstrMapSet(m, big, NULL);
+		ck_assert_int_eq(ret, 1);
+	}
+	for (i = 0; i < n; i++) {
+		b = test_key(i);
+		ret = bstrMapSet(m, b, &values[i]);
+		ck_assert_int_eq(ret, 1);
+		bdestroy(b);
+	}
+	/* Erasing most keys and growing again compacts the arena */
+	for (i = 0; i < n - 10; i++) {
+		b = test_key(i);
+		ret = bstrMapErase(m, b, NULL);
+		ck_assert_int_eq(ret, 1);
+		bdestroy(b);
+	}
+	for (i = 0; i < 8; i++) {
+		big->data[0] = (unsigned char)('a' + i);
+		ret = bstrMapErase(m, big, NULL);
+		ck_assert_int_eq(ret, 1);
+	}
+	for (i = n; i < 4 * n; i++) {
+		b = test_key(i);
+		ret = bstrMapSet(m, b, &values[i]);
+		ck_assert_int_eq(ret, 1);
+		bdestroy(b);
+	}
+	ck_assert_int_eq(bstrMapCount(m), 3 * n + 10);
+	for (i = n - 10; i < 4 * n; i++) {
+		b = test_key(i);
+		ret = bstrMapFind(m, b, &v);
+		ck_assert_int_eq(ret, 1);
+		ck_assert(v == &values[i]);
+		bdestroy(b);
+	}
+	/* Clearing keeps the map usable */
+	ret = bstrMapClear(m);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(bstrMapCount(m), 0);
+	ret = bstrMapNext(m, &pos, &key, &v);
+	ck_assert_int_eq(ret, 0);
+	b = test_key(7);
+	ret = bstrMapFind(m, b, &v);
+	ck_assert_int_eq(ret, 0);
+	ret = bstrMapSet(m, b, NULL);
+	ck_assert_int_eq(ret, 1);
+	ret = bstrMapFind(m, b, NULL);
+	ck_assert_int_eq(ret, 1);
+	bdestroy(b);
+	bdestroy(big);
+	ret = bstrMapDestroy(m);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+START_TEST(core_006)
+{
+	struct tagbstring t = bsStatic("content-length");
+	struct bstrPool *pool;
+	bstring a, b, c, d;
+	int ret;
+	ck_assert(bstrPoolDestroy(NULL) == BSTR_ERR);
+	ck_assert(bstrPoolCount(NULL) == BSTR_ERR);
+	ck_assert(bstrPoolIntern(NULL, &t) == NULL);
+	ck_assert(bstrPoolFind(NULL, &t) == NULL);
+	pool = bstrPoolCreate(0);
+	ck_assert(pool != NULL);
+	ck_assert(bstrPoolIntern(pool, NULL) == NULL);
+	ck_assert(bstrPoolInternBlk(pool, NULL, 1) == NULL);
+	ck_assert(bstrPoolInternBlk(pool, "a", -1) == NULL);
+	ck_assert(bstrPoolFind(pool, &t) == NULL);
+	a = bstrPoolIntern(pool, &t);
+	ck_assert(a != NULL);
+	ck_assert(a != &t);
+	ck_assert_int_eq(biseq(a, &t), 1);
+	ck_assert_int_eq(a->data[a->slen], '\0');
+	/* Equal contents give the same string */
+	c = bfromcstr("content-length");
+	ck_assert(c != NULL);
+	b = bstrPoolIntern(pool, c);
+	ck_assert(b == a);
+	b = bstrPoolInternBlk(pool, "content-length: 5", 14);
+	ck_assert(b == a);
+	ck_assert(bstrPoolFind(pool, c) == a);
+	ck_assert(bstrPoolFindBlk(pool, "content-type", 12) == NULL);
+	b = bstrPoolInternBlk(pool, "content-type", 12);
+	ck_assert(b != NULL);
+	ck_assert(b != a);
+	ck_assert_int_eq(bstrPoolCount(pool), 2);
+	/* Interned strings are write protected */
+	ret = bconcat(a, c);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ret = bdestroy(a);
+	ck_assert_int_eq(ret, BSTR_ERR);
+	ck_assert_int_eq(biseqcstr(a, "content-length"), 1);
+	/* Empty strings, embedded NULs and long strings */
+	d = bstrPoolInternBlk(pool, "", 0);
+	ck_assert(d != NULL);
+	ck_assert_int_eq(d->slen, 0);
+	ck_assert(bstrPoolInternBlk(pool, "x", 0) == d);
+	d = bstrPoolInternBlk(pool, "a\0b", 3);
+	ck_assert(d != NULL);
+	ck_assert_int_eq(d->slen, 3);
+	ck_assert(bstrPoolInternBlk(pool, "a\0c", 3) != d);
+	ret = bsetstr(c, 5000, NULL, 'z');
+	ck_assert_int_eq(ret, BSTR_OK);
+	d = bstrPoolIntern(pool, c);
+	ck_assert(d != NULL);
+	ck_assert_int_eq(biseq(d, c), 1);
+	ret = bconchar(c, 'z');
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert(bstrPoolIntern(pool, c) != d);
+	ret = btrunc(c, 5000);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert(bstrPoolIntern(pool, c) == d);
+	ck_assert_int_eq(bstrPoolCount(pool), 7);
+	ck_assert(bstrPoolIntern(pool, &t) == a);
+	bdestroy(c);
+	ret = bstrPoolDestroy(pool);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+static struct bstrPool *test7_pool;
+static bstring test7_seen[4][500];
+static int test7_ids[4] = { 0, 1, 2, 3 };
+
+static void *
+test7_0(void *arg)
+{
+	int i, id = *(int *)arg;
+	bstring b;
+	for (i = 0; i < 500; i++) {
+		b = test_key((i * 7 + id * 131) % 500);
+		test7_seen[id][(i * 7 + id * 131) % 500] =
+			bstrPoolIntern(test7_pool, b);
+		bdestroy(b);
+	}
+	return NULL;
+}
+
+START_TEST(core_007)
+{
+	bstring b;
+	int i, j, ret;
+	test7_pool = bstrPoolCreate(BSTR_POOL_LOCKED);
+#if defined(BSTRLIB_NO_THREADS)
+	ck_assert(test7_pool == NULL);
+	return;
+#endif
+	ck_assert(test7_pool != NULL);
+#if !defined(_WIN32)
+	{
+		pthread_t threads[4];
+		for (i = 0; i < 4; i++) {
+			ret = pthread_create(&threads[i], NULL, test7_0,
+					     &test7_ids[i]);
+			ck_assert_int_eq(ret, 0);
+		}
+		for (i = 0; i < 4; i++) {
+			pthread_join(threads[i], NULL);
+		}
+	}
+#else
+	for (i = 0; i < 4; i++) {
+		test7_0(&test7_ids[i]);
+	}
+#endif
+	ck_assert_int_eq(bstrPoolCount(test7_pool), 500);
+	for (j = 0; j < 500; j++) {
+		b = test_key(j);
+		ck_assert(test7_seen[0][j] != NULL);
+		ck_assert_int_eq(biseq(test7_seen[0][j], b), 1);
+		ck_assert(bstrPoolFind(test7_pool, b) == test7_seen[0][j]);
+		for (i = 1; i < 4; i++) {
+			ck_assert(test7_seen[i][j] == test7_seen[0][j]);
+		}
+		bdestroy(b);
+	}
+	ret = bstrPoolDestroy(test7_pool);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+int
+main(void)
+{
+	/* Build test suite */
+	Suite *suite = suite_create("bstr-map");
+	/* Core tests */
+	TCase *core = tcase_create("Core");
+	tcase_add_test(core, core_000);
+	tcase_add_test(core, core_001);
+	tcase_add_test(core, core_002);
+	tcase_add_test(core, core_003);
+	tcase_add_test(core, core_004);
+	tcase_add_test(core, core_005);
+	tcase_add_test(core, core_006);
+	tcase_add_test(core, core_007);
+	suite_add_tcase(suite, core);
+	/* Run tests */
+	SRunner *runner = srunner_create(suite);
+	srunner_run_all(runner, CK_ENV);
+	int number_failed = srunner_ntests_failed(runner);
+	srunner_free(runner);
+	return (0 == number_failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,398 @@
+/* Copyright 2026 The bstring contributors
+ * This file is part of Bstrlib.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ *    3. Neither the name of bstrlib nor the names of its contributors may be
+ *       used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Alternatively, the contents of this file may be used under the terms of
+ * GNU General Public License Version 2 (the "GPL").
+ */
+
+/*
+ * This file is the C unit test for the bstrrope module of Bstrlib.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "bstrrope.h"
+#include "bstrlib.h"
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int seed = 12345;
+
+static unsigned int
+test_rand(void)
+{
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 16) & 0x7fff;
+}
+
+/* Check that the rope r holds exactly the contents of b */
+static void
+test_same(const struct bstrRope *r, const bstring b)
+{
+	bstring f = bstrRopeFlatten(r);
+	ck_assert(f != NULL);
+	ck_assert_int_eq(bstrRopeLength(r), b->slen);
+	ck_assert_int_eq(biseq(f, b), 1);
+	ck_assert_int_eq(f->data[f->slen], '\0');
+	ck_assert_int_eq(bdestroy(f), BSTR_OK);
+}
+
+static int
+test3_0(void *parm, int ofs, const bstring chunk)
+{
+	bstring b = (bstring)parm;
+	ck_assert_int_eq(ofs, b->slen);
+	ck_assert(chunk->slen > 0);
+	ck_assert(chunk->mlen < 0);
+	ck_assert_int_eq(bconcat(b, chunk), BSTR_OK);
+	return 0;
+}
+
+static int
+test3_1(void *parm, int ofs, const bstring chunk)
+{
+	(void)chunk;
+	(*(int *)parm)++;
+	return ofs > 0 ? -42 : 0;
+}
+
+START_TEST(core_000)
+{
+	struct tagbstring t = bsStatic("Hello world");
+	struct bstrRope *r;
+	bstring b;
+	int ret;
+	ck_assert(bstrRopeFromBstr(NULL) == NULL);
+	ck_assert(bstrRopeDestroy(NULL) == BSTR_ERR);
+	ck_assert(bstrRopeLength(NULL) == BSTR_ERR);
+	ck_assert(bstrRopeCharAt(NULL, 0) == BSTR_ERR);
+	ck_assert(bstrRopeInsert(NULL, 0, &t) == BSTR_ERR);
+	ck_assert(bstrRopeDelete(NULL, 0, 1) == BSTR_ERR);
+	ck_assert(bstrRopeFlatten(NULL) == NULL);
+	ck_assert(bstrRopeSplit(NULL, 0) == NULL);
+	ck_assert(bstrRopeInStr(NULL, 0, &t) == BSTR_ERR);
+	r = bstrRopeCreate();
+	ck_assert(r != NULL);
+	ck_assert_int_eq(bstrRopeLength(r), 0);
+	b = bstrRopeFlatten(r);
+	ck_assert(b != NULL);
+	ck_assert_int_eq(b->slen, 0);
+	bdestroy(b);
+	ck_assert(bstrRopeInsert(r, 0, NULL) == BSTR_ERR);
+	ck_assert(bstrRopeInsert(r, 1, &t) == BSTR_ERR);
+	ck_assert(bstrRopeInsert(r, -1, &t) == BSTR_ERR);
+	ck_assert(bstrRopeInsertBlk(r, 0, "a", -1) == BSTR_ERR);
+	ck_assert(bstrRopeDelete(r, 0, -1) == BSTR_ERR);
+	ck_assert(bstrRopeCharAt(r, 0) == BSTR_ERR);
+	ck_assert(bstrRopeInStr(r, 0, &t) == BSTR_ERR);
+	ret = bstrRopeInsert(r, 0, &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bstrRopeInsertBlk(r, 5, ",", 1);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bstrRopeAppend(r, &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(bstrRopeCharAt(r, 5), ',');
+	ck_assert_int_eq(bstrRopeCharAt(r, 22), 'd');
+	ck_assert(bstrRopeCharAt(r, 23) == BSTR_ERR);
+	ck_assert(bstrRopeCharAt(r, -1) == BSTR_ERR);
+	b = bstrRopeFlatten(r);
+	ck_assert_int_eq(biseqcstr(b, "Hello, worldHello world"), 1);
+	bdestroy(b);
+	/* Deletion clips like bdelete */
+	ret = bstrRopeDelete(r, -3, 5);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bstrRopeDelete(r, 10, 100);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bstrRopeDelete(r, 100, 1);
+	ck_assert_int_eq(ret, BSTR_OK);
+	b = bstrRopeFlatten(r);
+	ck_assert_int_eq(biseqcstr(b, "llo, world"), 1);
+	bdestroy(b);
+	b = bstrRopeSubstr(r, -2, 6);
+	ck_assert_int_eq(biseqcstr(b, "llo,"), 1);
+	bdestroy(b);
+	b = bstrRopeSubstr(r, 8, 6);
+	ck_assert_int_eq(biseqcstr(b, "ld"), 1);
+	bdestroy(b);
+	b = bstrRopeSubstr(r, 20, 6);
+	ck_assert_int_eq(biseqcstr(b, ""), 1);
+	bdestroy(b);
+	ret = bstrRopeReplace(r, 0, 2, &t);
+	ck_assert_int_eq(ret, BSTR_OK);
+	b = bstrRopeFlatten(r);
+	ck_assert_int_eq(biseqcstr(b, "Hello worldo, world"), 1);
+	bdestroy(b);
+	ck_assert(bstrRopeReplace(r, 100, 0, &t) == BSTR_ERR);
+	ret = bstrRopeDestroy(r);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+START_TEST(core_001)
+{
+	struct bstrRope *r;
+	bstring b, c;
+	int i, pos, len, ret, op;
+	/* Random edits of all sizes, checked against a bstring */
+	b = bfromcstr("");
+	ck_assert(b != NULL);
+	c = bfromcstr("");
+	ck_assert(c != NULL);
+	r = bstrRopeCreate();
+	ck_assert(r != NULL);
+	for (i = 0; i < 3000; i++) {
+		op = (int)(test_rand() % 8);
+		pos = (int)(test_rand() % (unsigned int)(b->slen + 1));
+		if (op < 4) {
+			len = op == 0 ? (int)(test_rand() % 10000) :
+					(int)(test_rand() % 40);
+			ret = bassigncstr(c, "");
+			ck_assert_int_eq(ret, BSTR_OK);
+			while (c->slen < len) {
+				ret = bconchar(c,
+					       (char)('a' + test_rand() % 26));
+				ck_assert_int_eq(ret, BSTR_OK);
+			}
+			ret = binsert(b, pos, c, ' ');
+			ck_assert_int_eq(ret, BSTR_OK);
+			ret = bstrRopeInsert(r, pos, c);
+			ck_assert_int_eq(ret, BSTR_OK);
+		} else if (op < 7) {
+			len = op == 4 ? (int)(test_rand() % 20000) :
+					(int)(test_rand() % 50);
+			ret = bdelete(b, pos, len);
+			ck_assert_int_eq(ret, BSTR_OK);
+			ret = bstrRopeDelete(r, pos, len);
+			ck_assert_int_eq(ret, BSTR_OK);
+		} else {
+			len = (int)(test_rand() % 100);
+			ret = bassigncstr(c, "[replaced]");
+			ck_assert_int_eq(ret, BSTR_OK);
+			ret = breplace(b, pos, len, c, ' ');
+			ck_assert_int_eq(ret, BSTR_OK);
+			ret = bstrRopeReplace(r, pos, len, c);
+			ck_assert_int_eq(ret, BSTR_OK);
+		}
+		if (i % 100 == 0) {
+			test_same(r, b);
+		}
+	}
+	test_same(r, b);
+	for (i = 0; i < 200; i++) {
+		pos = b->slen ? (int)(test_rand() % (unsigned int)b->slen) : 0;
+		ck_assert_int_eq(bstrRopeCharAt(r, pos), b->data[pos]);
+	}
+	bdestroy(b);
+	bdestroy(c);
+	ret = bstrRopeDestroy(r);
+	ck_assert_int_eq(ret, BSTR_OK);
+}
+END_TEST
+
+START_TEST(core_002)
+{
+	struct bstrRope *r, *s, *e;
+	bstring b, c;
+	int i, ret;
+	b = bfromcstr("");
+	ck_assert(b != NULL);
+	for (i = 0; i < 30000; i++) {
+		ret = bconchar(b, (char)('0' + i % 10));
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	r = bstrRopeFromBstr(b);
+	ck_assert(r != NULL);
+	test_same(r, b);
+	/* Split in the middle of a chunk and at both ends */
+	s = bstrRopeSplit(r, 12345);
+	ck_assert(s != NULL);
+	ck_assert_int_eq(bstrRopeLength(r), 12345);
+	ck_assert_int_eq(bstrRopeLength(s), 30000 - 12345);
+	c = bstrRopeFlatten(s);
+	ck_assert_int_eq(bisstemeqblk(c, b->data + 12345, 30000 - 12345), 1);
+	bdestroy(c);
+	e = bstrRopeSplit(s, 0);
+	ck_assert(e != NULL);
+	ck_assert_int_eq(bstrRopeLength(s), 0);
+	ret = bstrRopeConcat(s, e);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(bstrRopeLength(e), 0);
+	ck_assert(bstrRopeConcat(r, r) == BSTR_ERR);
+	ck_assert(bstrRopeConcat(r, NULL) == BSTR_ERR);
+	ck_assert(bstrRopeSplit(r, 20000) == NULL);
+	ret = bstrRopeConcat(r, s);
+	ck_assert_int_eq(ret, BSTR_OK);
+	test_same(r, b);
+	bstrRopeDestroy(e);
+	bstrRopeDestroy(s);
+	bstrRopeDestroy(r);
+	bdestroy(b);
+}
+END_TEST
+
+START_TEST(core_003)
+{
+	struct bstrRope *r;
+	bstring b, c;
+	int i, ret, count = 0;
+	b = bfromcstr("");
+	ck_assert(b != NULL);
+	r = bstrRopeCreate();
+	ck_assert(r != NULL);
+	for (i = 0; i < 20000; i += 7) {
+		ret = bsetstr(b, i, NULL, (char)('a' + i % 26));
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	ret = bstrRopeInsert(r, 0, b);
+	ck_assert_int_eq(ret, BSTR_OK);
+	/* Insertions in the middle produce chunks of uneven sizes */
+	for (i = 0; i < 50; i++) {
+		ret = bstrRopeInsertBlk(r, i * 331, "xyz", 3);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ret = binsertblk(b, i * 331, "xyz", 3, ' ');
+		ck_assert_int_eq(ret, BSTR_OK);
+	}
+	c = bfromcstr("");
+	ret = bstrRopeChunks(r, test3_0, c);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ck_assert_int_eq(biseq(b, c), 1);
+	bdestroy(c);
+	ret = bstrRopeChunks(r, test3_1, &count);
+	ck_assert_int_eq(ret, -42);
+	ck_assert_int_eq(count, 2);
+	ck_assert(bstrRopeChunks(r, NULL, NULL) == BSTR_ERR);
+	bdestroy(b);
+	bstrRopeDestroy(r);
+}
+END_TEST
+
+START_TEST(core_004)
+{
+	struct tagbstring empty = bsStatic("");
+	struct bstrRope *r, *s;
+	bstring b, f;
+	int i, j, pos, len, ret;
+	/* A text built from many small pieces, so that matches straddle
+	 * chunks in every way */
+	b = bfromcstr("");
+	ck_assert(b != NULL);
+	r = bstrRopeCreate();
+	ck_assert(r != NULL);
+	for (i = 0; i < 2000; i++) {
+		len = 1 + (int)(test_rand() % 12);
+		f = bfromcstr("");
+		for (j = 0; j < len; j++) {
+			bconchar(f, (char)("abAB"[test_rand() % 4]));
+		}
+		s = bstrRopeFromBstr(f);
+		ck_assert(s != NULL);
+		ret = bstrRopeConcat(r, s);
+		ck_assert_int_eq(ret, BSTR_OK);
+		bstrRopeDestroy(s);
+		bconcat(b, f);
+		bdestroy(f);
+		if (i % 16 == 0) {
+			/* Split and rejoin, leaving chunk boundaries behind */
+			s = bstrRopeSplit(r, (int)(test_rand() %
+					  (unsigned int)(b->slen + 1)));
+			ck_assert(s != NULL);
+			ck_assert_int_eq(bstrRopeConcat(r, s), BSTR_OK);
+			bstrRopeDestroy(s);
+		}
+	}
+	test_same(r, b);
+	for (i = 0; i < 300; i++) {
+		len = 1 + (int)(test_rand() % 9);
+		pos = (int)(test_rand() % (unsigned int)(b->slen - len));
+		f = bmidstr(b, pos, len);
+		pos = (int)(test_rand() % (unsigned int)b->slen);
+		ck_assert_int_eq(bstrRopeInStr(r, pos, f), binstr(b, pos, f));
+		ck_assert_int_eq(bstrRopeInStrCaseless(r, pos, f),
+				 binstrcaseless(b, pos, f));
+		ret = btoupper(f);
+		ck_assert_int_eq(ret, BSTR_OK);
+		ck_assert_int_eq(bstrRopeInStr(r, 0, f), binstr(b, 0, f));
+		ck_assert_int_eq(bstrRopeInStrCaseless(r, 0, f),
+				 binstrcaseless(b, 0, f));
+		bdestroy(f);
+	}
+	f = bfromcstr("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+	ck_assert_int_eq(bstrRopeInStr(r, 0, f), binstr(b, 0, f));
+	ck_assert(bstrRopeInStr(r, b->slen, f) == BSTR_ERR);
+	bdestroy(f);
+	/* Single characters, which keep nothing across chunk boundaries */
+	for (i = 0; i < 200; i++) {
+		pos = (int)(test_rand() % (unsigned int)b->slen);
+		f = bmidstr(b, (int)(test_rand() % (unsigned int)b->slen), 1);
+		ck_assert_int_eq(bstrRopeInStr(r, pos, f), binstr(b, pos, f));
+		ck_assert_int_eq(bstrRopeInStrCaseless(r, pos, f),
+				 binstrcaseless(b, pos, f));
+		bdestroy(f);
+	}
+	ret = bstrRopeInsertBlk(r, b->slen, "z", 1);
+	ck_assert_int_eq(ret, BSTR_OK);
+	ret = bconchar(b, 'z');
+	ck_assert_int_eq(ret, BSTR_OK);
+	f = bfromcstr("z");
+	ck_assert_int_eq(bstrRopeInStr(r, 0, f), b->slen - 1);
+	ck_assert_int_eq(bstrRopeInStr(r, b->slen - 1, f), b->slen - 1);
+	bdestroy(f);
+	ck_assert_int_eq(bstrRopeInStr(r, 5, &empty), 5);
+	ck_assert_int_eq(bstrRopeInStr(r, b->slen, &empty), b->slen);
+	ck_assert(bstrRopeInStr(r, b->slen + 1, &empty) == BSTR_ERR);
+	ck_assert(bstrRopeInStr(r, -1, &empty) == BSTR_ERR);
+	bdestroy(b);
+	bstrRopeDestroy(r);
+}
+END_TEST
+
+int
+main(void)
+{
+	/* Build test suite */
+	Suite *suite = suite_create("bstr-rope");
+	/* Core tests */
+	TCase *core = tcase_create("Core");
+	tcase_add_test(core, core_000);
+	tcase_add_test(core, core_001);
+	tcase_add_test(core, core_002);
+	tcase_add_test(core, core_003);
+	tcase_add_test(core, core_004);
+	suite_add_tcase(suite, core);
+	/* Run tests */
+	SRunner *runner = srunner_create(suite);
+	srunner_run_all(runner, CK_ENV);
+	int number_failed = srunner_ntests_failed(runner);
+	srunner_free(runner);
+	return (0 == number_failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}